@@ -17,6 +17,7 @@ extern "C" {
 typedef enum AacObjectType_ {
   AAC_AOT_LC = 2,  /* AAC-LC */
   AAC_AOT_SBR = 5, /* HE-AAC v1 (SBR) */
+  AAC_AOT_LD = 23, /* AAC-LD: 512/480-sample frames, no reservoir; raw access units */
   AAC_AOT_PS = 29, /* HE-AAC v2 (SBR + Parametric Stereo) */
 } AacObjectType;
 
@@ -28,6 +29,66 @@ typedef enum AacRateControl_ {
   AAC_RC_CBR = 3,  /* Constant Bitrate */
 } AacRateControl;
 
+/* Encoder Complexity Presets — speed/quality trade-off, fastest first */
+typedef enum AacComplexity_ {
+  AAC_COMPLEXITY_FAST = 0,   /* live / on-the-fly transcoding */
+  AAC_COMPLEXITY_MEDIUM = 1, /* narrower search, fewer rate-control passes */
+  AAC_COMPLEXITY_HIGH = 2,   /* default — full scalefactor sweep */
+  AAC_COMPLEXITY_BEST = 3,   /* archival — tighter rate control convergence */
+} AacComplexity;
+
+/* Two-pass encoding — run the whole input through FIRST, then again
+ * through SECOND with the same settings and stats file */
+typedef enum AacPassMode_ {
+  AAC_PASS_SINGLE = 0, /* default — no stats file */
+  AAC_PASS_FIRST = 1,  /* analyse and write per-frame statistics */
+  AAC_PASS_SECOND = 2, /* distribute the bitrate budget from the statistics */
+} AacPassMode;
+
+/* Framing of aac_encoder_encode output */
+typedef enum AacTransport_ {
+  AAC_TRANSPORT_ADTS = 0, /* default — a 7-byte ADTS header per frame */
+  AAC_TRANSPORT_RAW = 1,  /* raw access units, for a container; AAC-LD is always raw */
+} AacTransport;
+
+/* Stereo downmix of multichannel streams (ITU-R BS.775 coefficients) */
+typedef enum AacDownmix_ {
+  AAC_DOWNMIX_OFF = 0,  /* default — a multichannel stream needs a multichannel decoder */
+  AAC_DOWNMIX_AUTO = 1, /* mix the spectra where window sequences and shapes match */
+  AAC_DOWNMIX_TIME = 2, /* always mix the reconstructed channels */
+} AacDownmix;
+
+/* Where the last frame was downmixed */
+typedef enum AacDownmixPath_ {
+  AAC_DOWNMIX_PATH_NONE = 0, /* nothing to mix: the stream has the decoder's layout */
+  AAC_DOWNMIX_PATH_MDCT = 1, /* before the IMDCT: two inverse transforms per frame */
+  AAC_DOWNMIX_PATH_TIME = 2, /* after the IMDCT (and SBR) of every channel */
+} AacDownmixPath;
+
+/* Per-frame encoder telemetry, delivered through AacFrameStatsCallback */
+typedef struct AacFrameStats_ {
+  int64_t frame_index;
+  int rc_iterations;       /* quantize/rate-control passes run */
+  float lambda;            /* lambda of the pass that was written */
+  int target_bits;         /* rate-control payload target */
+  int frame_bits;          /* bits written, ADTS header included */
+  int channel_bits[2];     /* ICS bits per channel (the first two of a multichannel frame) */
+  int sbr_bits;            /* SBR payload bits, FIL element included (0 for AAC-LC) */
+  int reservoir_bits;      /* bit reservoir level after this frame */
+  int ms_bands;            /* bands written as mid/side */
+  int window_sequence;     /* 0 long, 1 start, 2 eight short, 3 stop */
+  int64_t mdct_ns;         /* stage wall-clock times */
+  int64_t psycho_ns;
+  int64_t quant_ns;
+  int64_t bitstream_ns;
+} AacFrameStats;
+
+typedef void (*AacFrameStatsCallback)(const AacFrameStats* stats, void* user);
+
+/* Receives a muxer's or splicer's output; anything but AAC_OK stops it, and
+ * the call that wrote returns it */
+typedef int (*AacWriteCallback)(const uint8_t* data, int size, void* user);
+
 /* Error Codes */
 typedef enum AacError_ {
   AAC_OK = 0,
@@ -47,6 +108,9 @@ typedef void* AacDecoderHandle;
 
 /* ── Encoder API ─────────────────────────────────────────────────── */
 
+/* channels is 1-6 or 8 (channel configurations 1-7). Multichannel PCM is
+ * interleaved in bitstream order: 5.1 is C, L, R, Ls, Rs, LFE and 7.1 adds
+ * Lb, Rb before the LFE. HE-AAC v2 takes stereo input only. */
 AacEncoderHandle aac_encoder_create(int sample_rate, int channels, int bitrate, AacObjectType aot,
                                     AacRateControl rc_mode);
 
@@ -56,23 +120,291 @@ int aac_encoder_encode(AacEncoderHandle ctx, const float* pcm, int n_samples, ui
                        int out_size);
 
 int aac_encoder_set_quality(AacEncoderHandle ctx, int quality);
+int aac_encoder_set_complexity(AacEncoderHandle ctx, AacComplexity complexity);
+int aac_encoder_set_pass(AacEncoderHandle ctx, AacPassMode pass, const char* stats_path);
+int aac_encoder_set_stats_callback(AacEncoderHandle ctx, AacFrameStatsCallback cb, void* user);
+/* Encode a multichannel frame's elements on threads workers (the caller
+ * included); 1 restores single-threaded encoding. AAC_ERR_UNSUPPORTED where
+ * the build has no threads. */
+int aac_encoder_set_threads(AacEncoderHandle ctx, int threads);
+/* AAC-LD only, before the first frame: 512 (the default) or 480 samples */
+int aac_encoder_set_frame_length(AacEncoderHandle ctx, int frame_length);
+/* Before the first frame. Raw access units carry the bits an ADTS header
+ * would have taken. */
+int aac_encoder_set_transport(AacEncoderHandle ctx, AacTransport transport);
+/* The stream's AudioSpecificConfig, for a container or aac_decoder_set_config.
+ * Returns its length in bytes. */
+int aac_encoder_get_config(AacEncoderHandle ctx, uint8_t* asc, int asc_size);
 int aac_encoder_frame_size(AacEncoderHandle ctx);
 int aac_encoder_delay(AacEncoderHandle ctx);
 int aac_encoder_flush(AacEncoderHandle ctx, uint8_t* out, int out_size);
 
 /* ── Decoder API ─────────────────────────────────────────────────── */
 
+/* sample_rate is the output rate. An ADTS stream whose core runs at half of
+ * it is decoded as HE-AAC (implicit SBR). channels is 1-6 or 8 and must
+ * match the stream, except that a stereo decoder also plays mono streams.
+ * Output channels are in bitstream order, as for the encoder. */
 AacDecoderHandle aac_decoder_create(int sample_rate, int channels);
 void aac_decoder_destroy(AacDecoderHandle ctx);
+/* Reconstruct a frame's channel elements on threads workers (the caller
+ * included); 1 restores single-threaded decoding */
+int aac_decoder_set_threads(AacDecoderHandle ctx, int threads);
+/* Stereo decoders only: play 3.0 to 7.1 streams as stereo. LFE is dropped;
+ * HE-AAC streams always take the time path, since SBR runs per channel. */
+int aac_decoder_set_downmix(AacDecoderHandle ctx, AacDownmix mode);
+/* AacDownmixPath of the last frame */
+int aac_decoder_downmix_path(AacDecoderHandle ctx);
+/* Describe the stream by its AudioSpecificConfig, before the first frame.
+ * Required for AAC-LD, whose access units have no ADTS header. */
+int aac_decoder_set_config(AacDecoderHandle ctx, const uint8_t* asc, int asc_size);
 
+/* Interleaved output; pcm_size counts floats. Returns samples per channel. */
 int aac_decoder_decode(AacDecoderHandle ctx, const uint8_t* data, int size, float* pcm,
                        int pcm_size);
+/* Planar output: pcm[c] receives up to pcm_samples samples of channel c */
+int aac_decoder_decode_planar(AacDecoderHandle ctx, const uint8_t* data, int size,
+                              float* const* pcm, int pcm_samples);
+/* Planar output without a copy: pcm[c] is pointed at the decoder's own
+ * buffer for channel c, valid until the next call on ctx. A mono stream on a
+ * stereo decoder gives the same pointer twice. */
+int aac_decoder_decode_planar_ref(AacDecoderHandle ctx, const uint8_t* data, int size,
+                                  const float** pcm);
+/* Decode up to max_frames consecutive ADTS frames from data into pcm, one
+ * frame's interleaved samples after another. frame_samples[i] receives frame
+ * i's samples per channel, or the negative AacError of a frame that failed
+ * (it produces no samples and decoding goes on). Stops before a frame that
+ * is incomplete, out of sync or does not fit in pcm; *consumed is the bytes
+ * of the frames walked. Returns the frames walked, or a negative AacError
+ * when there was none: AAC_ERR_DECODE without sync at data,
+ * AAC_ERR_OVERFLOW when pcm cannot hold the first frame, and
+ * AAC_ERR_UNSUPPORTED for AAC-LD, whose access units are not self-framing. */
+int aac_decoder_decode_many(AacDecoderHandle ctx, const uint8_t* data, int size, float* pcm,
+                            int pcm_size, int max_frames, int* frame_samples, int* consumed);
+/* Interleaved integer output, saturated; pcm_size counts samples of all
+ * channels. s24 holds 24-bit values in the low bits of each int32. */
+int aac_decoder_decode_s16(AacDecoderHandle ctx, const uint8_t* data, int size, int16_t* pcm,
+                           int pcm_size);
+int aac_decoder_decode_s24(AacDecoderHandle ctx, const uint8_t* data, int size, int32_t* pcm,
+                           int pcm_size);
+/* 1: add TPDF dither of ±1 LSB before integer rounding (default 0) */
+int aac_decoder_set_dither(AacDecoderHandle ctx, int enable);
 
+/* Samples per channel of the last frame: 1024, 2048 for HE-AAC, 512 or 480 for AAC-LD */
 int aac_decoder_frame_size(AacDecoderHandle ctx);
 int aac_decoder_sample_rate(AacDecoderHandle ctx);
 int aac_decoder_channels(AacDecoderHandle ctx);
 int aac_decoder_get_sbr_ps(AacDecoderHandle ctx, int* has_sbr, int* has_ps);
 
+/* ── ADTS Framer ─────────────────────────────────────────────────── */
+
+/* Splits ADTS arriving in chunks of any size (an HTTP stream) into frames,
+ * skipping garbage and resynchronising after corruption */
+typedef void* AacAdtsFramerHandle;
+
+AacAdtsFramerHandle aac_adts_framer_create(void);
+void aac_adts_framer_destroy(AacAdtsFramerHandle ctx);
+/* Hand over the next chunk, once aac_adts_framer_next has returned 0; data
+ * must stay valid until then. size 0 marks the end of the stream, which
+ * releases a final frame that has no header after it to confirm it. */
+int aac_adts_framer_feed(AacAdtsFramerHandle ctx, const uint8_t* data, int size);
+/* 1 with the next whole frame, header included, in *frame and *size: a span
+ * of the chunk, or of an internal buffer for a frame that straddles chunks.
+ * Valid until the next call on ctx. 0 when the chunk is used up. */
+int aac_adts_framer_next(AacAdtsFramerHandle ctx, const uint8_t** frame, int* size);
+/* Bytes skipped so far while searching for sync */
+int64_t aac_adts_framer_dropped(AacAdtsFramerHandle ctx);
+
+/* ── ADTS File Index ─────────────────────────────────────────────── */
+
+/* Duration and seeking for .aac files without reading them through: the
+ * file is mapped and only frame headers are touched */
+typedef void* AacAdtsIndexHandle;
+
+typedef struct AacAdtsIndexInfo_ {
+  int sample_rate;     /* core rate of the headers; implicit HE-AAC plays at twice it */
+  int channel_config;
+  AacObjectType profile;
+  int64_t frames;      /* ADTS frames */
+  int64_t samples;     /* core samples per channel, 1024 per raw data block */
+  int64_t data_offset; /* the first frame, after any ID3v2 tag */
+  int64_t dropped;     /* bytes after data_offset outside any frame */
+  int from_sidecar;    /* 1 when the offsets came from the sidecar */
+} AacAdtsIndexInfo;
+
+/* Index the ADTS file at path. With a sidecar path, a sidecar that matches
+ * the file's size and mtime is loaded instead of walking the headers, and a
+ * missing or stale one is (re)written. NULL when the file cannot be read,
+ * holds no frames or is over 4 GiB. */
+AacAdtsIndexHandle aac_adts_index_open(const char* path, const char* sidecar_path);
+void aac_adts_index_close(AacAdtsIndexHandle ctx);
+int aac_adts_index_info(AacAdtsIndexHandle ctx, AacAdtsIndexInfo* info);
+/* The frame holding core sample `sample` (sample_rate × seconds), or a
+ * negative AacError past the end */
+int64_t aac_adts_index_find(AacAdtsIndexHandle ctx, int64_t sample);
+/* Frame `frame`, ADTS header included, in the mapped file: valid until
+ * aac_adts_index_close */
+int aac_adts_index_frame(AacAdtsIndexHandle ctx, int64_t frame, const uint8_t** data, int* size);
+
+/* ── ADTS Splicer ────────────────────────────────────────────────── */
+
+/* Cuts indexed ADTS files at frame boundaries and joins the pieces, without
+ * re-encoding: HLS segments, intros and ad breaks */
+typedef void* AacAdtsSplicerHandle;
+
+typedef struct AacAdtsSegment_ {
+  int64_t first_frame;   /* index of the segment's first frame */
+  int64_t frames;
+  int64_t preroll_frame; /* decode (and discard) from here to start the segment cleanly */
+  int64_t start_sample;  /* core samples ahead of the segment */
+  int64_t offset;        /* the segment's bytes in the file, from its first frame */
+  int64_t size;          /* to the end of its last */
+  int contiguous;        /* 1 when those bytes are the frames and nothing else,
+                          * so they can go out as they are (sendfile) */
+} AacAdtsSegment;
+
+/* Plan segments of the whole number of raw data blocks nearest segment_ms,
+ * cut at the frame holding each boundary. preroll frames ahead of a segment
+ * are listed for decoding it on its own: 1 covers the AAC-LC overlap, and
+ * HE-AAC needs an SBR header too (this encoder repeats it every 16 frames).
+ * Fills at most max_segments of segs (which may be NULL) and returns the
+ * number of segments. */
+int64_t aac_adts_index_segments(AacAdtsIndexHandle ctx, int segment_ms, int preroll,
+                                AacAdtsSegment* segs, int64_t max_segments);
+
+/* The output is one ADTS stream, handed to write as it is produced */
+AacAdtsSplicerHandle aac_adts_splicer_create(AacWriteCallback write, void* user);
+void aac_adts_splicer_destroy(AacAdtsSplicerHandle ctx);
+/* Append frames [first, first + count) of idx, written before this returns,
+ * so idx may be closed after. Runs of frames adjacent in the file go to
+ * write as spans of the mapped file. From the first seam on (a run that
+ * does not continue the previous one) a CBR buffer_fullness is rewritten to
+ * 0x7FF, through a copy of the frame. AAC_ERR_UNSUPPORTED when idx differs
+ * from the first run's stream in rate, channels or profile. */
+int aac_adts_splicer_append(AacAdtsSplicerHandle ctx, AacAdtsIndexHandle idx, int64_t first,
+                            int64_t count);
+/* Frames written so far, and how many went through a copy to be rewritten */
+int64_t aac_adts_splicer_frames(AacAdtsSplicerHandle ctx, int64_t* patched);
+/* Rewrite frames appended from now on with aac_gain_adts_frame: a whole
+ * file at the speed of its I/O. 0 (the default) passes them through. */
+int aac_adts_splicer_set_gain(AacAdtsSplicerHandle ctx, int steps);
+
+/* ── MP4 Demuxer ─────────────────────────────────────────────────── */
+
+/* Raw access units of the first AAC track of an .m4a/.mp4 file, as spans of
+ * the mapped file. Decode them with a decoder created from the info and
+ * configured with aac_decoder_set_config. */
+typedef void* AacMp4DemuxerHandle;
+
+typedef struct AacMp4Info_ {
+  int sample_rate;           /* output rate: the SBR rate for explicit HE-AAC signalling */
+  int channels;              /* for aac_decoder_create: 1-6, or 8 for 7.1 */
+  AacObjectType object_type; /* as signalled: AAC_AOT_SBR or AAC_AOT_PS for HE-AAC */
+  int bitrate;               /* esds average bitrate, 0 when unknown */
+  int timescale;             /* units of duration and aac_mp4_demuxer_find */
+  int64_t frames;            /* access units */
+  int64_t duration;
+} AacMp4Info;
+
+/* NULL when the file cannot be read or has no AAC track with samples
+ * (fragmented files keep theirs outside moov) */
+AacMp4DemuxerHandle aac_mp4_demuxer_open(const char* path);
+void aac_mp4_demuxer_close(AacMp4DemuxerHandle ctx);
+/* AAC_ERR_UNSUPPORTED for a channel configuration the decoder lacks (0: a
+ * program config element) */
+int aac_mp4_demuxer_info(AacMp4DemuxerHandle ctx, AacMp4Info* info);
+/* The track's AudioSpecificConfig. Returns its length in bytes. */
+int aac_mp4_demuxer_config(AacMp4DemuxerHandle ctx, uint8_t* asc, int asc_size);
+/* The access unit playing at `time` (timescale units), or a negative
+ * AacError past the end */
+int64_t aac_mp4_demuxer_find(AacMp4DemuxerHandle ctx, int64_t time);
+/* Access unit `frame` in the mapped file: valid until aac_mp4_demuxer_close */
+int aac_mp4_demuxer_frame(AacMp4DemuxerHandle ctx, int64_t frame, const uint8_t** data,
+                          int* size);
+
+/* ── Fragmented MP4 Muxer ────────────────────────────────────────── */
+
+/* CMAF/fMP4 for HLS and DASH: an init segment, then moof/mdat fragments of
+ * a fixed number of access units */
+typedef void* AacFmp4MuxerHandle;
+
+/* asc describes the track (aac_encoder_get_config); bitrate goes into esds,
+ * 0 when unknown. Fragments hold the whole number of access units nearest
+ * fragment_ms, at most 4096. The init segment is written before this
+ * returns, and each later write is one whole fragment. NULL for a
+ * configuration without channels (a PCE) or a failed write. */
+AacFmp4MuxerHandle aac_fmp4_muxer_create(const uint8_t* asc, int asc_size, int bitrate,
+                                         int fragment_ms, AacWriteCallback write, void* user);
+/* Frees the muxer; an open fragment is dropped, so flush first */
+void aac_fmp4_muxer_destroy(AacFmp4MuxerHandle ctx);
+/* Add one access unit, raw or ADTS (whose header is dropped) */
+int aac_fmp4_muxer_write(AacFmp4MuxerHandle ctx, const uint8_t* frame, int size);
+/* Encode a frame into the open fragment. With AAC_TRANSPORT_RAW on enc it is
+ * encoded in place; ADTS output is moved over its header. */
+int aac_fmp4_muxer_encode(AacFmp4MuxerHandle ctx, AacEncoderHandle enc, const float* pcm,
+                          int n_samples);
+/* Write the open fragment even if it is short, at the end of the stream */
+int aac_fmp4_muxer_flush(AacFmp4MuxerHandle ctx);
+
+/* ── LOAS/LATM ───────────────────────────────────────────────────── */
+
+/* AAC in LOAS/LATM (ISO 14496-3 1.7), as broadcast relays carry it: 3 bytes
+ * of sync and length per frame, with the AudioSpecificConfig repeated in
+ * band. One program of one layer, with frameLengthType 0. */
+typedef void* AacLatmReaderHandle;
+typedef void* AacLatmWriterHandle;
+
+AacLatmReaderHandle aac_latm_reader_create(void);
+void aac_latm_reader_destroy(AacLatmReaderHandle ctx);
+/* As aac_adts_framer_feed: the next chunk, once aac_latm_reader_next has
+ * returned 0; size 0 marks the end of the stream */
+int aac_latm_reader_feed(AacLatmReaderHandle ctx, const uint8_t* data, int size);
+/* 1 with the next raw access unit in *au and *size, valid until the next
+ * call on ctx; 2 for the first access unit under a new AudioSpecificConfig,
+ * which is when to hand aac_latm_reader_config to aac_decoder_set_config.
+ * 0 when the chunk is used up. */
+int aac_latm_reader_next(AacLatmReaderHandle ctx, const uint8_t** au, int* size);
+/* Copy the current AudioSpecificConfig to asc; returns its bytes,
+ * AAC_ERR_STATE before the first StreamMuxConfig */
+int aac_latm_reader_config(AacLatmReaderHandle ctx, uint8_t* asc, int asc_size);
+/* AudioMuxElements skipped: ahead of the first StreamMuxConfig, malformed,
+ * or under a StreamMuxConfig this reader does not support */
+int64_t aac_latm_reader_dropped(AacLatmReaderHandle ctx);
+
+/* Wraps raw access units (AAC_TRANSPORT_RAW) into LOAS frames. asc is as
+ * from aac_encoder_get_config; the first frame and every config_interval-th
+ * after it carry the StreamMuxConfig, so receivers can join mid-stream.
+ * NULL for a config LATM cannot describe or config_interval < 1. */
+AacLatmWriterHandle aac_latm_writer_create(const uint8_t* asc, int asc_size, int config_interval);
+void aac_latm_writer_destroy(AacLatmWriterHandle ctx);
+/* Write the LOAS frame for one access unit to out; returns its bytes, or
+ * AAC_ERR_OVERFLOW when out holds less than size + size / 255 + 14 bytes or
+ * the frame would pass 8194 */
+int aac_latm_writer_write(AacLatmWriterHandle ctx, const uint8_t* au, int size, uint8_t* out,
+                          int out_size);
+
+/* ── Gain ────────────────────────────────────────────────────────── */
+
+/* Loudness normalisation (ReplayGain, EBU R 128) without re-encoding: the
+ * global_gain of every channel stream moves, and with it all its
+ * scalefactors and noise (PNS) energies. A step is 2^(1/4) in amplitude,
+ * 1.5 dB, as ISO 14496-3 dequantizes; positive steps are louder. Frames keep
+ * their size and are rewritten in place, and -steps undoes the change
+ * exactly.
+ *
+ * HE-AAC is refused with AAC_ERR_UNSUPPORTED: SBR envelopes do not follow
+ * global_gain. AAC_ERR_OVERFLOW when a frame cannot move that far (8-bit
+ * global_gain); that frame is left as it was. */
+#define AAC_GAIN_STEP_DB 1.5f
+
+/* The nearest whole number of steps to db */
+int aac_gain_steps(float db);
+/* One ADTS frame, without a CRC */
+int aac_gain_adts_frame(uint8_t* frame, int size, int steps);
+/* One raw access unit under the AudioSpecificConfig asc (AAC-LC or AAC-LD),
+ * such as a copy of one from aac_mp4_demuxer_frame */
+int aac_gain_access_unit(const uint8_t* asc, int asc_size, uint8_t* au, int size, int steps);
+
 #ifdef __cplusplus
 }
 #endif
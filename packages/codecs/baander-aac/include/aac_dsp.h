@@ -31,17 +31,69 @@ using AacDSP = struct AacDSP_ {
   void (*vector_fmul_window)(float* dst, const float* a, const float* b, const float* win, int n);
   void (*vector_fmul_reverse)(float* dst, const float* a, const float* b, int len);
   void (*vector_fmul_accumulate)(float* dst, const float* a, const float* b, int len);
+  /* 1 when every element is ±0.0f (NaN counts as non-zero) */
+  int (*vector_is_zero)(const float* a, int len);
 
   /* ── Huffman Decode ──────────────────────────────────────────── */
   int (*huffman_decode)(const uint8_t* data, int bit_pos, int codebook, int* x, int* y,
                         int* bits_used);
 
   /* ── SBR QMF ─────────────────────────────────────────────────── */
-  void (*sbr_qmf_analysis)(float* out, const float* in, int bands);
-  void (*sbr_qmf_synthesis)(float* out, const float* in, int bands);
+  /* Polyphase halves of the QMF banks, M = bands (a multiple of 8), win has 10 * M taps.
+   * analysis fold:   out[i] = Σ_{l<5}  win[i + 2M*l] * in[i + 2M*l],           i < 2M
+   * synthesis sum:   out[r] = Σ_{q<10} win[M*q + r] * v[2M*q + M*(q & 1) + r],  r < M */
+  void (*sbr_qmf_analysis)(float* out, const float* in, const float* win, int bands);
+  void (*sbr_qmf_synthesis)(float* out, const float* v, const float* win, int bands);
+  /* HF generator, one patch of n bands over all slots; rows are AAC_SBR_QMF_BANDS apart
+   * and lo has two rows of history before it (complex):
+   *   hi[m][k] = lo[m][k] + a0[k] * lo[m-1][k] + a1[k] * lo[m-2][k]                    */
+  void (*sbr_hf_gen)(float* hi_re, float* hi_im, const float* lo_re, const float* lo_im,
+                     const float* a0_re, const float* a0_im, const float* a1_re,
+                     const float* a1_im, int n, int slots);
+  /* Envelope adjuster, one slot: y = gain * y + noise_gain * noise (complex y and noise) */
+  void (*sbr_hf_apply)(float* y_re, float* y_im, const float* gain, const float* noise_gain,
+                       const float* noise_re, const float* noise_im, int n);
+
+  /* ── Parametric Stereo ───────────────────────────────────────── */
+  /* One slot of 2x2 mixing with per-band interpolation. h and h_step hold four
+   * arrays of n coefficients (h11, h12, h21, h22); l enters holding the mono
+   * signal s and r the decorrelated d (complex):
+   *   h += h_step;  l = h11 * s + h21 * d;  r = h12 * s + h22 * d              */
+  void (*ps_mix)(float* l_re, float* l_im, float* r_re, float* r_im, float* h,
+                 const float* h_step, int n);
+  /* Encoder statistics of one slot, accumulated per band over n bands:
+   *   el += |l|^2;  er += |r|^2;  cr += Re(l * conj(r))                      */
+  void (*ps_correlate)(float* el, float* er, float* cr, const float* l_re, const float* l_im,
+                       const float* r_re, const float* r_im, int n);
+
+  /* ── TNS ─────────────────────────────────────────────────────── */
+  /* Direct-form LPC filters over one TNS region, a = lpc[0..order-1] and
+   * history before the region is zero.
+   * fir (analysis, out of place): dst[n] = src[n] + Σ_k a[k-1] * src[n-k]
+   * iir (synthesis, in place):    x[n]  -= Σ_k a[k-1] * x[n-k]            */
+  void (*tns_fir)(float* dst, const float* src, int len, const float* lpc, int order);
+  void (*tns_iir)(float* x, int len, const float* lpc, int order);
 
   /* ── Psycho Spreading ────────────────────────────────────────── */
-  void (*psycho_spreading)(float* spread, const float* energy, const float* threshold, int n_sfb);
+  /* Banded convolution: spread[b] = Σ_t kernel[t] * energy[b + t - radius], t in [0, 2*radius].
+   * energy must be readable (zero padded) over [-radius, n_sfb + radius). */
+  void (*psycho_spreading)(float* spread, const float* energy, const float* kernel, int radius,
+                           int n_sfb);
+
+  /* ── PCM Output ──────────────────────────────────────────────── */
+  /* Stereo interleave: dst[2i] = l[i], dst[2i+1] = r[i]; l == r duplicates a mono channel */
+  void (*interleave2)(float* dst, const float* l, const float* r, int n);
+  /* Full-scale float (±1.0) to integers with saturation and round-to-nearest-even;
+   * dither (nullptr for none) is added in LSBs before rounding:
+   *   s16: dst[i] = clamp(rint(src[i] * 2^15 + dither[i]), -2^15, 2^15 - 1)
+   *   s24: the same at 2^23, in the low 24 bits of an int32                   */
+  void (*float_to_s16)(int16_t* dst, const float* src, const float* dither, int n);
+  void (*float_to_s24)(int32_t* dst, const float* src, const float* dither, int n);
+
+  /* ── Transport ───────────────────────────────────────────────── */
+  /* First ADTS sync candidate: the least i < size - 1 with
+   * data[i] == 0xFF && (data[i + 1] & 0xF6) == 0xF0 (syncword, layer 0), or -1 */
+  int (*adts_sync)(const uint8_t* data, int size);
 };
 
 /* Initialize DSP struct with scalar C defaults, then override per CPU flags */
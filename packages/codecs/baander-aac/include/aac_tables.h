@@ -8,9 +8,12 @@ extern "C" {
 #endif
 
 /* Constants */
-#define AAC_MAX_CHANNELS 2
+#define AAC_MAX_CHANNELS 8
+#define AAC_MAX_ELEMENTS 5 /* channel elements of the largest configuration (7.1) */
 #define AAC_FRAME_SIZE_LONG 1024
 #define AAC_FRAME_SIZE_SHORT 128
+#define AAC_FRAME_SIZE_LD 512 /* AAC-LD; 480 is the alternative frame length */
+#define AAC_FRAME_SIZE_LD_480 480
 #define AAC_NUM_WINDOWS_SHORT 8
 #define AAC_MAX_SFB_LONG 54
 #define AAC_MAX_SFB_SHORT 15
@@ -28,6 +31,12 @@ extern const int aac_num_sfb_long[AAC_NUM_SAMPLE_RATES];
 extern const int aac_sfb_offset_long[AAC_NUM_SAMPLE_RATES][AAC_MAX_SFB_LONG + 1];
 extern const int aac_num_sfb_short[AAC_NUM_SAMPLE_RATES];
 extern const int aac_sfb_offset_short[AAC_NUM_SAMPLE_RATES][AAC_MAX_SFB_SHORT + 1];
+/* Long-window bands for a core frame of 1024, 512 or 480 samples. AAC-LD
+ * (ISO 14496-3 swb_offset_long_512/480) has tables for 22050-48000 Hz only;
+ * aac_num_sfb is 0 elsewhere. */
+int aac_num_sfb(int ri, int frame_length);
+const int* aac_sfb_offsets(int ri, int frame_length);
+int aac_tns_max_bands(int ri, int frame_length);
 
 /* Huffman Codebook Metadata */
 using AacCodebookInfo = struct AacCodebookInfo_ {
@@ -39,10 +48,17 @@ extern const AacCodebookInfo aac_codebook_info[AAC_NUM_CODEBOOKS + 1];
 extern const int aac_huff_count[AAC_NUM_CODEBOOKS + 1];
 extern const uint32_t* aac_huff_code[AAC_NUM_CODEBOOKS + 1];
 extern const uint8_t* aac_huff_len[AAC_NUM_CODEBOOKS + 1];
+/* By the first AAC_HUFF_LOOKUP_BITS bits of a codeword, computed by
+ * aac_tables_init: (index << 5) | length of the longest codeword they match,
+ * or 0 when a longer codeword starts with them too (or none matches) */
+#define AAC_HUFF_LOOKUP_BITS 10
+extern uint16_t aac_huff_lookup[AAC_NUM_CODEBOOKS + 1][1 << AAC_HUFF_LOOKUP_BITS];
 
 /* Window Functions */
 void aac_sine_window(float* out, int n);
 void aac_kbd_window(float* out, int n, float alpha);
+/* AAC-LD window_shape 1 for a frame of n samples (2n outputs) */
+void aac_low_overlap_window(float* out, int n);
 #define AAC_KBD_ALPHA_LONG 4.0f
 #define AAC_KBD_ALPHA_SHORT 6.0f
 
@@ -52,11 +68,18 @@ extern const int aac_tns_max_bands_short[AAC_NUM_SAMPLE_RATES];
 extern const int aac_tns_max_order_long;
 extern const int aac_tns_max_order_short;
 
-/* Channel Configuration */
+/* Channel Configuration — ISO 14496-3 Table 1.19. Elements are listed in
+ * bitstream order (AAC_ELEM_SCE, CPE or LFE), and channels follow them:
+ * 5.1 is C, L, R, Ls, Rs, LFE. */
 using AacChannelConfig = struct AacChannelConfig_ {
-  int num_channels, has_cpe, has_sce, has_lfe;
+  int num_channels, num_elements;
+  int elements[AAC_MAX_ELEMENTS];
 };
 extern const AacChannelConfig aac_channel_config[8];
+/* Sampling frequency index of a rate, -1 if it has none */
+int aac_sample_rate_index(int sample_rate);
+/* Configuration index for a channel count, 0 if none has that many */
+int aac_channel_config_index(int channels);
 
 /* SBR Tables */
 #define AAC_SBR_NUM_FREQ_COEFFS 64
@@ -66,7 +89,8 @@ extern const AacChannelConfig aac_channel_config[8];
 
 extern const int aac_sbr_freq_band_table_lo[AAC_NUM_SAMPLE_RATES][AAC_SBR_NUM_FREQ_COEFFS];
 extern const int aac_sbr_freq_band_table_hi[AAC_NUM_SAMPLE_RATES][AAC_SBR_NUM_FREQ_COEFFS];
-extern const float aac_sbr_qmf_window[AAC_SBR_QMF_FILTER_LENGTH];
+/* QMF prototype filter, computed by aac_tables_init */
+extern float aac_sbr_qmf_window[AAC_SBR_QMF_FILTER_LENGTH];
 
 /* Table auto-init */
 void aac_tables_init(void);
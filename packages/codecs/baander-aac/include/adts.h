@@ -0,0 +1,155 @@
+#ifndef BAANDER_AAC_ADTS_H
+#define BAANDER_AAC_ADTS_H
+#include <cstdint>
+
+#include "aac_dsp.h"
+#include "bitstream.h"
+#include "mapped_file.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Incremental ADTS framer, which also frames LOAS (AudioSyncStream).
+ *
+ * Input arrives as chunks of any size. Frames inside the current chunk are
+ * handed out in place; only a frame that spans chunks is reassembled in the
+ * carry buffer, from the previous chunk's tail and as many bytes of the
+ * current one as it needs. Once the carry holds nothing but bytes that are
+ * still in the current chunk, the framer rewinds into the chunk and goes
+ * back to handing out spans of it.
+ *
+ * Sync is found with dsp->adts_sync, and a candidate header must validate
+ * (aac_adts_check). While unlocked, a candidate also needs a matching header
+ * right after it (or the end of the stream). Once locked, frames follow one
+ * another with no search; garbage between frames, or a header whose fixed
+ * fields change, drops the lock and the SIMD scan resumes one byte past the
+ * rejected candidate.
+ *
+ * With loas set the same applies to LOAS headers (aac_loas_check), found
+ * with memchr on the 0x56 syncword byte.
+ */
+#define AAC_ADTS_MAX_FRAME 8191 /* 13-bit frame_length */
+/* The longest frame plus the header that confirms it, for LOAS as well */
+#define AAC_ADTS_CARRY_SIZE (AAC_ADTS_MAX_FRAME + AAC_ADTS_HEADER_SIZE)
+
+using AacAdtsFramer = struct AacAdtsFramer_ {
+  const AacDSP* dsp;
+  int loas;             /* frame LOAS rather than ADTS */
+  const uint8_t* chunk; /* the caller's current chunk, read from pos */
+  int chunk_size, pos;
+  uint8_t carry[AAC_ADTS_CARRY_SIZE];
+  int carry_size;
+  int carry_tail; /* trailing carry bytes copied from the current chunk */
+  int carry_used; /* bytes of the frame handed out from the carry */
+  int locked, eos;
+  uint32_t key; /* aac_adts_check key of the locked stream */
+  int64_t dropped;
+};
+
+AacAdtsFramer* aac_adts_framer_state_create(const AacDSP* dsp, int loas);
+void aac_adts_framer_state_destroy(AacAdtsFramer* f);
+/* A new chunk once the last one is used up; size 0 marks the end of the
+ * stream. AAC_ERR_STATE while frames remain in the current chunk. */
+int aac_adts_framer_state_feed(AacAdtsFramer* f, const uint8_t* data, int size);
+/* 1 with the next frame in *frame and *size, valid until the next call; 0
+ * once the chunk is used up */
+int aac_adts_framer_state_next(AacAdtsFramer* f, const uint8_t** frame, int* size);
+
+/*
+ * Frame index of an ADTS file.
+ *
+ * The file is mapped, not read: the index walks frame_length from header to
+ * header (aac_adts_check), touching 7 bytes per frame, after skipping an
+ * ID3v2 tag. Junk between frames is skipped with dsp->adts_sync; the first
+ * frame must be confirmed by the header after it. Offsets are 32-bit, so
+ * files up to 4 GiB.
+ *
+ * Each raw data block holds 1024 core samples. When every frame has one
+ * block, a sample's frame is sample / 1024; otherwise first_block is
+ * binary-searched.
+ *
+ * Sidecar layout (native endianness): AacAdtsIndexHeader, then offsets and,
+ * with multi_block set, first_block, each frames × uint32. A sidecar is
+ * taken only when its file size and mtime match the file's.
+ */
+#define AAC_ADTS_INDEX_MAGIC 0x58494142u /* "BAIX" */
+#define AAC_ADTS_INDEX_VERSION 1
+
+using AacAdtsIndexHeader = struct AacAdtsIndexHeader_ {
+  uint32_t magic, version;
+  int64_t file_size, file_mtime;
+  int64_t frames, blocks; /* ADTS frames and the raw data blocks they carry */
+  int64_t data_offset;    /* the first frame, after any ID3v2 tag */
+  int64_t dropped;        /* bytes after data_offset outside any frame */
+  uint32_t key;           /* aac_adts_check key of the stream */
+  uint32_t multi_block;   /* a frame carries more than one raw data block */
+};
+
+using AacAdtsIndex = struct AacAdtsIndex_ {
+  AacMappedFile file;
+  AacAdtsIndexHeader header;
+  uint32_t* offsets;     /* per frame */
+  uint32_t* first_block; /* per frame, multi_block only */
+  int from_sidecar;
+};
+
+/* nullptr when the file cannot be mapped, holds no frame or is over 4 GiB */
+AacAdtsIndex* aac_adts_index_state_open(const char* path, const char* sidecar, const AacDSP* dsp);
+void aac_adts_index_state_close(AacAdtsIndex* x);
+/* The frame holding raw data block `block`, or -1 past the end */
+int64_t aac_adts_index_state_find(const AacAdtsIndex* x, int64_t block);
+/* Frame `frame` (which must be < frames) in the map; AAC_ERR_DECODE when
+ * its header is not one of the stream's, as with a stale sidecar */
+int aac_adts_index_state_frame(const AacAdtsIndex* x, int64_t frame, const uint8_t** data,
+                               int* size);
+/* Segments starting every segment_blocks raw data blocks, each with up to
+ * preroll frames ahead of it; fills at most max and returns the count */
+int64_t aac_adts_index_state_segments(const AacAdtsIndex* x, int64_t segment_blocks, int preroll,
+                                      AacAdtsSegment* segs, int64_t max);
+
+/*
+ * Splicer: runs of frames from one or more file indexes, joined into one
+ * ADTS stream without re-encoding.
+ *
+ * Frames go out as spans of the mapped files, one write per run of frames
+ * that are adjacent in their file. A seam is a run that does not continue
+ * the previous one. The buffer_fullness a frame carries is the encoder's
+ * reservoir level along its own stream, which no longer holds across a
+ * seam; from the first seam on, frames that signal a level are rewritten to
+ * 0x7FF (variable rate) in the stage buffer and written from there. Frames
+ * with a CRC, which covers the header, are left as they are.
+ *
+ * With a gain set, every frame goes through the stage and aac_gain_adts.
+ */
+#define AAC_ADTS_SPLICER_STAGE (64 * 1024)
+
+using AacAdtsSplicer = struct AacAdtsSplicer_ {
+  AacWriteCallback write;
+  void* user;
+  uint32_t key; /* aac_adts_check key of the first run */
+  const AacAdtsIndex* last;
+  int64_t next_frame; /* of last, just after the previous run */
+  int seam;
+  const uint8_t* run; /* span of the map not yet written */
+  int64_t run_size;
+  uint8_t* stage;
+  int stage_fill;
+  int gain; /* aac_gain_adts steps for frames appended from now on */
+  int64_t pending, pending_patched; /* frames in run and stage, not yet written */
+  int64_t frames, patched;          /* frames written, and of them rewritten */
+};
+
+AacAdtsSplicer* aac_adts_splicer_state_create(AacWriteCallback write, void* user);
+void aac_adts_splicer_state_destroy(AacAdtsSplicer* s);
+/* Frames [first, first + count) of x, which must be in range. Everything is
+ * written before this returns. AAC_ERR_UNSUPPORTED for a stream whose fixed
+ * header fields differ from the first run's; under a gain, the errors of
+ * aac_gain_adts, with the frames ahead of the failing one written. On any
+ * error the next run continues from the first frame not written. */
+int aac_adts_splicer_state_append(AacAdtsSplicer* s, const AacAdtsIndex* x, int64_t first,
+                                  int64_t count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BAANDER_AAC_ADTS_H */
@@ -19,12 +19,15 @@ using AacBitReader = struct AacBitReader_ {
 
 void aac_bitreader_init(AacBitReader* r, const uint8_t* data, int size);
 int aac_bitreader_bits_left(const AacBitReader* r);
+/* Reads and peeks take up to 32 bits; past the end they give zeros */
 uint32_t aac_bitreader_read(AacBitReader* r, int nbits);
 int32_t aac_bitreader_read_signed(AacBitReader* r, int nbits);
 uint32_t aac_bitreader_peek(AacBitReader* r, int nbits);
 void aac_bitreader_skip(AacBitReader* r, int nbits);
 void aac_bitreader_byte_align(AacBitReader* r);
 int aac_bitreader_read_huffman(AacBitReader* r, int codebook, int* x, int* y);
+/* Signed Exp-Golomb: 0, 1, -1, 2, -2, ... map to codes of 1, 3, 3, 5, 5, ... bits */
+int32_t aac_bitreader_read_golomb(AacBitReader* r);
 
 using AacBitWriter = struct AacBitWriter_ {
   uint8_t* data;
@@ -37,8 +40,11 @@ void aac_bitwriter_init(AacBitWriter* w, uint8_t* data, int capacity);
 void aac_bitwriter_write(AacBitWriter* w, uint32_t value, int nbits);
 void aac_bitwriter_write_signed(AacBitWriter* w, int32_t value, int nbits);
 int aac_bitwriter_write_huffman(AacBitWriter* w, int codebook, int x, int y);
+void aac_bitwriter_write_golomb(AacBitWriter* w, int32_t value);
+int aac_golomb_bits(int32_t value);
 void aac_bitwriter_byte_align(AacBitWriter* w);
 int aac_bitwriter_bytes_written(const AacBitWriter* w);
+int aac_bitwriter_bits_written(const AacBitWriter* w);
 
 #define AAC_ADTS_HEADER_SIZE 7
 
@@ -50,8 +56,38 @@ using AacAdtsHeader = struct AacAdtsHeader_ {
 };
 
 int aac_adts_parse(AacAdtsHeader* hdr, const uint8_t* data, int size);
+/* Validate the 7 header bytes at data with byte arithmetic: syncword, layer
+ * 0, a known sampling rate and a frame_length that holds the header (and
+ * CRC). Returns frame_length, or 0 for an invalid header. *key receives the
+ * fields that stay fixed over a stream: id, layer, protection_absent,
+ * profile, sampling rate and channel configuration. */
+int aac_adts_check(const uint8_t* data, uint32_t* key);
 int aac_adts_write(const AacAdtsHeader* hdr, uint8_t* out);
 
+/* LOAS AudioSyncStream header (ISO 14496-3 1.7.2): an 11-bit syncword 0x2B7
+ * and the 13-bit length of the AudioMuxElement that follows */
+#define AAC_LOAS_HEADER_SIZE 3
+#define AAC_LOAS_MAX_FRAME (AAC_LOAS_HEADER_SIZE + 8191)
+
+/* Frame length (header included) of the LOAS header at data, or 0 */
+int aac_loas_check(const uint8_t* data);
+
+/* AudioSpecificConfig (ISO 14496-3 1.6.2.1), the out-of-band stream
+ * description that AAC-LD needs in place of ADTS. object_type is the
+ * signalled AOT; SBR and PS are written with explicit hierarchical
+ * signalling, where sample_rate_index is the core's and ext_rate_index the
+ * output's. frame_length is the core frame: 1024 or 960, 512 or 480 (LD). */
+using AacAudioConfig = struct AacAudioConfig_ {
+  int object_type, sample_rate_index, ext_rate_index, channel_config, frame_length;
+};
+
+/* Returns the bytes written (2-4), or a negative AacError */
+int aac_audio_config_write(const AacAudioConfig* cfg, uint8_t* out, int size);
+int aac_audio_config_parse(AacAudioConfig* cfg, const uint8_t* data, int size);
+/* The same at any bit position, as LATM carries it; no byte alignment */
+int aac_audio_config_put(const AacAudioConfig* cfg, AacBitWriter* w);
+int aac_audio_config_read(AacAudioConfig* cfg, AacBitReader* r);
+
 using AacElementType = enum AacElementType_ {
   AAC_ELEM_SCE = 0,
   AAC_ELEM_CPE = 1,
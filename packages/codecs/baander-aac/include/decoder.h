@@ -5,33 +5,78 @@
 #include "aac_tables.h"
 #include "bitstream.h"
 #include "mdct.h"
+#include "sbr.h"
+#include "spectral.h"
+#include "threadpool.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
 using AacDecoderChannel = struct AacDecoderChannel_ {
   float spectral[1024];
-  float output[2048];
-  int scalefactors[49];
+  float output[2048]; /* 1024 core samples, or 2048 after SBR */
+  int scalefactors[49]; /* noise energy for PNS bands */
   int sfb_cb[49];
+  int max_sfb;       /* coded bands in the current ICS; the rest are zero */
+  int zero_spectrum; /* every coded band used cb=0 */
   AacWindowSequence win_seq;
   AacWindowShape win_shape;
   AacMdctContext mdct_ctx;
-  int tns_ncoef[8];
-  float tns_lpc[8][20];
+  AacTnsInfo tns;
   int tns_present;
   int has_sbr, has_ps;
+  uint32_t pns_seed; /* xorshift state for noise substitution, one per channel */
+};
+/* A channel element of the current frame: SCE, CPE or LFE, decoding into
+ * channels [ch0, ch0 + nch) */
+using AacDecoderElement = struct AacDecoderElement_ {
+  int type, ch0, nch;
+  AacSbrDecoder* sbr; /* each element carries its own SBR header and state */
 };
 using AacDecoderState = struct AacDecoderState_ {
-  int sample_rate, channels, aot, rate_index, frame_size;
-  AacDecoderChannel ch[2];
+  int sample_rate, channels, aot, frame_size;
+  int rate_index; /* core rate: the ADTS header's, else the creation rate */
+  int frame_length; /* core frame: 1024, or 512/480 for AAC-LD */
+  /* From an AudioSpecificConfig (0 without one): ADTS-less frames and AAC-LD
+   * frames, whose elements carry no ids, take their layout from it */
+  int channel_config;
+  AacDecoderChannel* ch; /* ch_count entries, in bitstream order */
+  int ch_count;          /* channels, or AAC_MAX_CHANNELS once downmix is on */
+  AacDecoderElement elem[AAC_MAX_ELEMENTS];
+  int n_elems;
+  AacThreadPool* pool; /* nullptr: elements are reconstructed in order */
   const AacDSP* dsp;
+  int dither;            /* TPDF dither on integer output */
+  uint32_t dither_seed;  /* xorshift state, the same sequence for every instance */
+  /* Stereo downmix of multichannel streams: the AacDownmix mode and the
+   * AacDownmixPath the last frame took. dmx_mdct holds the downmix's own
+   * overlap, so frames can switch between the MDCT and time paths. */
+  int downmix, downmix_path;
+  int dmx_canonical; /* dmx_mdct overlap holds only the part the next frame reads */
+  AacMdctContext dmx_mdct[2];
+  float dmx_spec[2][1024];
+  float dmx_out[2][2048];
 };
 AacDecoderState* aac_decoder_state_create(int sr, int ch, const AacDSP* dsp);
 void aac_decoder_state_destroy(AacDecoderState* s);
+/* A stereo decoder only; allocates the channel states a 7.1 stream needs */
+int aac_decoder_state_set_downmix(AacDecoderState* s, int mode);
+/* Takes the stream's object type, core rate, layout and frame length; the
+ * transform state restarts at the new length */
+int aac_decoder_state_set_config(AacDecoderState* s, const AacAudioConfig* cfg);
+/* Parse an element's ICS data into channel ch (SCE, LFE) or ch and ch + 1
+ * (CPE); reconstruction waits for aac_decode_frame */
 int aac_decode_sce(AacDecoderState* s, AacBitReader* r, int ch);
-int aac_decode_cpe(AacDecoderState* s, AacBitReader* r);
-void aac_dequantize(AacDecoderChannel* ch, int ri, int frame_size);
-void aac_apply_tns(AacDecoderChannel* ch, int ri, int frame_size);
+int aac_decode_cpe(AacDecoderState* s, AacBitReader* r, int ch);
+/* Parse a raw_data_block (er_raw_data_block for AAC-LD), then reconstruct
+ * every element, in parallel on s->pool. Returns the channels decoded into
+ * s->ch[].output (a mono element with PS data counts two, a downmixed
+ * multichannel frame two) or a negative AacError. */
+int aac_decode_frame(AacDecoderState* s, const uint8_t* data, int size, int channel_config);
+/* Output samples per channel of a frame whose core runs at rate index ri:
+ * twice the core frame under implicit SBR */
+int aac_decoder_state_frame_size(const AacDecoderState* s, int ri);
+void aac_dequantize(AacDecoderChannel* ch, int ri, int frame_length, uint32_t* pns_seed);
+void aac_apply_tns(AacDecoderChannel* ch, int ri, int frame_length, const AacDSP* dsp);
 #ifdef __cplusplus
 }
 #endif
@@ -6,35 +6,90 @@
 #include "bitstream.h"
 #include "mdct.h"
 #include "psycho.h"
+#include "sbr.h"
+#include "spectral.h"
+#include "threadpool.h"
+#include "twopass.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
+/* Per-complexity tuning, selected by aac_encoder_apply_complexity */
+using AacEncoderPreset = struct AacEncoderPreset_ {
+  int sf_search_below, sf_search_above; /* scalefactor sweep around sf_center */
+  int sf_search_step;      /* 1: every scalefactor in the sweep, k: every k-th */
+  int rc_max_iterations;   /* quantize/rate-control passes per frame */
+  float rc_tolerance;      /* accepted (target - bits) / target; never over */
+  int psycho_detail;       /* 0: spreading + ATH only, 1: + tonality and pre-echo */
+  int fast_mdct;           /* 1: FFT-based forward MDCT instead of the direct reference */
+  int tns_filters;         /* TNS filters per long window, 0 disables TNS */
+  int pns;                 /* 1: noise-like high bands may be coded as noise energy */
+};
 using AacEncoderState = struct AacEncoderState_ {
   int sample_rate, channels, bitrate, quality, frame_size, rate_index;
+  int core_rate; /* rate the AAC core runs at: sample_rate, or half of it with SBR */
+  int frame_length; /* core MDCT frame: 1024, or 512/480 for AAC-LD */
+  AacWindowShape window_shape; /* long-window shape of every frame */
+  int input_channels; /* channels of the PCM input; the core codes one under PS */
   AacObjectType aot;
   AacRateControl rc_mode;
+  AacComplexity complexity;
+  AacEncoderPreset preset;
   AacMdctContext mdct_ctx[2];
   AacPsychoState psycho_state[2];
   const AacDSP* dsp;
+  AacTwoPassState* twopass; /* nullptr for single-pass encoding */
+  AacSbrEncoder* sbr;       /* nullptr for AAC-LC */
+  AacFrameStatsCallback stats_cb; /* nullptr disables telemetry */
+  void* stats_user;
   float lambda;
   int bit_reservoir, target_bits_per_frame;
+  int bandwidth;      /* lowpass cutoff in Hz, from bitrate and sample rate */
+  int max_sfb;        /* bands below the cutoff; the rest are never coded */
+  int ics_max_sfb[2]; /* per-frame max_sfb written to each ICS */
+  AacTnsInfo tns[2];
+  int tns_present[2];
+  float tns_gain[2][49]; /* per-band noise gain of the TNS synthesis filter */
+  float flatness[2][49]; /* spectral flatness of PNS candidate bands, 0 otherwise */
   float spectral[2][1024];
   int scalefactors[2][49];
   int codebooks[2][49];
   int ms_used[49];
   int quant_coeffs[2][1024]; /* quantized spectral coefficients */
   AacBitWriter writer;
+  int64_t frame_count; /* frames produced by aac_encode_frame_internal */
   uint8_t output_buf[8192];
   float pcm_buf[2][2048];
   int pcm_buf_fill;
+  /* Sub-encoder of a multichannel stream: writes only its channel element
+   * (and SBR FIL) with this instance tag, no ADTS header or END */
+  int element_only, element_tag;
+  AacTransport transport; /* ADTS header or raw access units (AAC-LD: always raw) */
+  int lfe; /* LFE element: lowpassed to 120 Hz, no TNS, PNS or SBR payload */
+  /* Multichannel (channels > 2): one 1- or 2-channel sub-encoder per element
+   * of the channel configuration; the fields above are then unused */
+  int channel_config, n_elems;
+  struct AacEncoderState_* elems[AAC_MAX_ELEMENTS];
+  float elem_pcm[AAC_MAX_ELEMENTS][2 * 2048]; /* each element's input, interleaved */
+  int elem_bits[AAC_MAX_ELEMENTS];
+  AacFrameStats elem_stats[AAC_MAX_ELEMENTS];
+  AacThreadPool* pool; /* nullptr: elements are encoded in order */
 };
 AacEncoderState* aac_encoder_state_create(int sr, int ch, int br, AacObjectType aot,
                                           AacRateControl rc, const AacDSP* dsp);
 void aac_encoder_state_destroy(AacEncoderState* s);
+/* AAC-LD only, before the first frame: 512 or 480 samples per frame */
+int aac_encoder_state_set_frame_length(AacEncoderState* s, int frame_length);
+/* Returns the frame length in bytes; an element_only encoder returns the
+ * bits its elements took */
 int aac_encode_frame_internal(AacEncoderState* s, const float* pcm, int n_samples);
 int aac_quantize_bands(AacEncoderState* s, int ch, float lambda, const float* thr, const int* sfb,
                        int nb);
 float aac_rate_control_lambda(AacEncoderState* s, int bits_used, int bits_target);
+void aac_encoder_apply_complexity(AacEncoderState* s, AacComplexity complexity);
+/* Telemetry for a multichannel encoder: per-element stats are summed into
+ * one callback per frame */
+void aac_encoder_set_stats(AacEncoderState* s, AacFrameStatsCallback cb, void* user);
+int aac_encoder_bandwidth(int sample_rate, int channels, int bitrate);
 #ifdef __cplusplus
 }
 #endif
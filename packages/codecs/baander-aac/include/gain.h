@@ -0,0 +1,39 @@
+#ifndef BAANDER_AAC_GAIN_H
+#define BAANDER_AAC_GAIN_H
+#include <cstdint>
+
+#include "bitstream.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Gain change in the compressed domain.
+ *
+ * The scalefactors of an ICS are coded as differences, the first from its
+ * global_gain, so moving global_gain by k moves every band of the ICS by k:
+ * a factor 2^(k/4) in amplitude, 1.5 dB per step, as ISO 14496-3 and
+ * aac_dequantize read them. Noise (PNS) energies are differences from
+ * global_gain less 90 in the same 2^(1/4) steps, so noise bands follow
+ * exactly and their deltas stay as they are.
+ *
+ * Each frame is walked with the decoder's syntax (ics_info, TNS, codebooks,
+ * scalefactors and Huffman-coded spectra) to find those fields, and only
+ * once the whole frame has parsed are they rewritten, in place: 8 bits of
+ * global_gain each, so the frame keeps its size. An ICS without a coded
+ * band (a silent one) is left alone.
+ *
+ * SBR envelopes are coded against no global_gain, so a frame with an SBR
+ * payload is refused, as are elements the decoder does not read (CCE, DSE,
+ * PCE, a common window).
+ */
+/* Rewrite raw data block data (an er_raw_data_block for AAC-LD) of a stream
+ * under cfg to play 2^(steps/4) times as loud. AAC_ERR_OVERFLOW when a field
+ * would leave its range, in which case nothing is written. */
+int aac_gain_block(const AacAudioConfig* cfg, uint8_t* data, int size, int steps);
+/* The same for each raw data block of an ADTS frame without a CRC */
+int aac_gain_adts(uint8_t* frame, int size, int steps);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BAANDER_AAC_GAIN_H */
@@ -0,0 +1,74 @@
+#ifndef BAANDER_AAC_LATM_H
+#define BAANDER_AAC_LATM_H
+#include <cstdint>
+
+#include "adts.h"
+#include "bitstream.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * LATM (ISO 14496-3 1.7.3) in LOAS AudioSyncStream framing.
+ *
+ * The reader frames LOAS with the ADTS framer in loas mode, so chunked
+ * input, resync and the carry work as they do for ADTS. Each AudioMuxElement
+ * (muxConfigPresent = 1) is then read with AacBitReader: a StreamMuxConfig
+ * when useSameStreamMux is 0, then PayloadLengthInfo and PayloadMux per
+ * subframe. Payloads sit off the byte grid (behind the 1-bit
+ * useSameStreamMux), so each is shifted into au as it is handed out.
+ *
+ * Supported StreamMuxConfigs: audioMuxVersion 0 or 1 (not audioMuxVersionA),
+ * allStreamsSameTimeFraming, one program of one layer and frameLengthType 0,
+ * which is what broadcast encoders send. Elements under any other config are
+ * dropped until the next supported one.
+ */
+#define AAC_LATM_MAX_SUBFRAMES 64 /* numSubFrames is 6 bits */
+
+using AacLatmReader = struct AacLatmReader_ {
+  AacAdtsFramer* framer;
+  AacAudioConfig config;
+  uint8_t asc[64]; /* the AudioSpecificConfig bits, byte-aligned */
+  int asc_size;
+  int has_config;
+  int config_changed; /* since the last access unit handed out */
+  int num_subframes;  /* per element, under the current config */
+  const uint8_t* element;
+  int element_size;
+  int subframes, subframe; /* of the current element */
+  int offsets[AAC_LATM_MAX_SUBFRAMES]; /* payload bit offsets in element */
+  int sizes[AAC_LATM_MAX_SUBFRAMES];
+  uint8_t au[AAC_LOAS_MAX_FRAME];
+  int64_t dropped; /* elements */
+};
+
+AacLatmReader* aac_latm_reader_state_create(const AacDSP* dsp);
+void aac_latm_reader_state_destroy(AacLatmReader* r);
+/* As aac_adts_framer_state_feed */
+int aac_latm_reader_state_feed(AacLatmReader* r, const uint8_t* data, int size);
+/* 1 with the next access unit, 2 for the first under a changed config, 0
+ * once the chunk is used up */
+int aac_latm_reader_state_next(AacLatmReader* r, const uint8_t** au, int* size);
+
+/*
+ * LATM writer: one raw access unit per AudioMuxElement, in LOAS framing. A
+ * StreamMuxConfig (audioMuxVersion 0, the AudioSpecificConfig written with
+ * aac_audio_config_put) goes with every config_interval-th element.
+ */
+using AacLatmWriter = struct AacLatmWriter_ {
+  AacAudioConfig config;
+  int config_interval;
+  int64_t frames;
+};
+
+/* nullptr for a config aac_audio_config_parse rejects or an interval < 1 */
+AacLatmWriter* aac_latm_writer_state_create(const uint8_t* asc, int asc_size,
+                                            int config_interval);
+void aac_latm_writer_state_destroy(AacLatmWriter* w);
+/* Bytes of the LOAS frame written to out, or a negative AacError */
+int aac_latm_writer_state_write(AacLatmWriter* w, const uint8_t* au, int size, uint8_t* out,
+                                int out_size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BAANDER_AAC_LATM_H */
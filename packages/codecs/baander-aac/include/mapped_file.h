@@ -0,0 +1,28 @@
+#ifndef BAANDER_AAC_MAPPED_FILE_H
+#define BAANDER_AAC_MAPPED_FILE_H
+#include <cstdint>
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Read-only view of a whole file for the container and transport readers.
+ *
+ * POSIX builds mmap the file, so opening it reads nothing and only the
+ * pages a reader touches are faulted in. Windows and WASM builds read the
+ * file into memory instead.
+ */
+using AacMappedFile = struct AacMappedFile_ {
+  const uint8_t* data;
+  int64_t size;
+  int64_t mtime; /* modification time in seconds, to tell a stale sidecar */
+  int mapped;    /* 1 for an mmap, 0 for a heap copy */
+};
+
+/* AAC_OK, AAC_ERR_INIT when the file cannot be opened or mapped */
+int aac_mapped_file_open(AacMappedFile* f, const char* path);
+void aac_mapped_file_close(AacMappedFile* f);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BAANDER_AAC_MAPPED_FILE_H */
@@ -22,6 +22,7 @@ using AacWindowSequence = enum AacWindowSequence_ {
 using AacWindowShape = enum AacWindowShape_ {
   AAC_WIN_SINE = 0,
   AAC_WIN_KBD = 1,
+  AAC_WIN_LOW_OVERLAP = 1, /* window_shape 1 of AAC-LD */
 };
 
 using AacMdctContext = struct AacMdctContext_ {
@@ -34,6 +35,7 @@ using AacMdctContext = struct AacMdctContext_ {
   float* window_kbd_long;
   float* window_sine_short;
   float* window_kbd_short;
+  float* window_low_overlap; /* AAC-LD frames (512/480) only, else nullptr */
   /* Pre-allocated scratch buffers (avoid per-frame heap alloc) */
   float* scratch_re;   /* max(frame_size_long/4) */
   float* scratch_im;   /* max(frame_size_long/4) */
@@ -66,6 +68,12 @@ void aac_mdct_forward_c(float* out, const float* in, int n, const float* win);
  */
 void aac_mdct_forward_aac(AacMdctContext* ctx, float* out, const float* in, int n,
                           AacWindowSequence win_seq, AacWindowShape win_shape, int channel);
+/* Direct MDCT of the first n_bins bins only; bins [n_bins, n) are zeroed */
+void aac_mdct_forward_aac_bins(AacMdctContext* ctx, float* out, const float* in, int n, int n_bins,
+                               AacWindowSequence win_seq, AacWindowShape win_shape, int channel);
+/* FFT-based equivalent of aac_mdct_forward_aac (fold + DCT-IV), O(N log N) */
+void aac_mdct_forward_fast(AacMdctContext* ctx, float* out, const float* in, int n,
+                           AacWindowSequence win_seq, AacWindowShape win_shape, int channel);
 void aac_imdct_half_c(float* out, const float* in, int n, const float* win);
 
 /* Internal versions that can use caller-provided precomputed twiddles.
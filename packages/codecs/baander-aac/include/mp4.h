@@ -0,0 +1,111 @@
+#ifndef BAANDER_AAC_MP4_H
+#define BAANDER_AAC_MP4_H
+#include <cstdint>
+
+#include "aac.h"
+#include "bitstream.h"
+#include "mapped_file.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * MP4/M4A demuxer (ISO 14496-12, 14496-14) for the first AAC audio track.
+ *
+ * The file is mapped and the boxes are read in place: moov/trak/mdia (mdhd,
+ * hdlr), then stbl with stsd (mp4a/esds, for the AudioSpecificConfig), stts,
+ * stsc, stsz and stco or co64. The only allocation is the table of access
+ * unit offsets, resolved once from stsc and the chunk offsets; sizes are
+ * read from stsz in the map. Access units are raw, without ADTS headers.
+ *
+ * The table stops at the first access unit that runs past the end of the
+ * file, so a truncated download plays up to where it was cut.
+ */
+using AacMp4Demuxer = struct AacMp4Demuxer_ {
+  AacMappedFile file;
+  AacAudioConfig config;
+  uint8_t asc[64]; /* the DecoderSpecificInfo, as stored */
+  int asc_size;
+  int bitrate;     /* esds avgBitrate, 0 when unknown */
+  uint32_t timescale;
+  int64_t frames;
+  int64_t* offsets;     /* per access unit */
+  const uint8_t* sizes; /* stsz entries (big-endian), nullptr for fixed_size */
+  uint32_t fixed_size;
+  const uint8_t* stts; /* (count, delta) entries (big-endian) */
+  uint32_t stts_count;
+};
+
+/* nullptr when the file cannot be mapped or has no AAC track with samples */
+AacMp4Demuxer* aac_mp4_demuxer_state_open(const char* path);
+void aac_mp4_demuxer_state_close(AacMp4Demuxer* m);
+/* Bytes of access unit `frame` (which must be < frames) */
+int aac_mp4_demuxer_state_size(const AacMp4Demuxer* m, int64_t frame);
+/* Duration of all access units, in timescale units */
+int64_t aac_mp4_demuxer_state_duration(const AacMp4Demuxer* m);
+/* The access unit playing at `time` (timescale units), or -1 past the end */
+int64_t aac_mp4_demuxer_state_find(const AacMp4Demuxer* m, int64_t time);
+
+/* Output channels of a stream: 8 for configuration 7, 2 under PS, 0 for a
+ * program config element */
+int aac_mp4_config_channels(const AacAudioConfig* cfg);
+
+/*
+ * Fragmented MP4 (CMAF) muxer for a single AAC track.
+ *
+ * The init segment (ftyp, moov with an empty sample table and mvex) goes
+ * out first, then one moof/mdat fragment per frames_per_fragment access
+ * units. Access units are placed straight into the fragment buffer, after
+ * room for the largest moof; when the fragment closes its moof is written
+ * just ahead of the mdat header, so the fragment leaves in one call of
+ * write with no further copy:
+ *
+ *   buf: [ ..unused.. | moof | mdat header | access units ]
+ *                     ^ head - moof size   ^ head
+ *
+ * Each access unit takes at most 6144 bits per channel (ISO 14496-3 4.5.3),
+ * and a fragment at most AAC_FMP4_MAX_FRAGMENT_FRAMES of them.
+ */
+#define AAC_FMP4_MAX_FRAGMENT_FRAMES 4096
+
+using AacFmp4Muxer = struct AacFmp4Muxer_ {
+  AacAudioConfig config;
+  uint8_t asc[64];
+  int asc_size;
+  int bitrate;
+  uint32_t timescale;      /* the output sample rate */
+  uint32_t frame_duration; /* samples per access unit at the output rate */
+  int max_frame;           /* bytes an access unit may take, ADTS header included */
+  int frames_per_fragment;
+  uint8_t* buf;
+  int head;   /* bytes ahead of the mdat header, for the moof */
+  int fill;   /* end of the access units */
+  int frames; /* in the open fragment */
+  uint32_t* sizes;
+  uint32_t sequence;    /* of the next fragment, from 1 */
+  int64_t decode_time;  /* of the open fragment */
+  AacWriteCallback write;
+  void* user;
+};
+
+/* nullptr for a configuration without output channels or rate. Writes
+ * nothing yet: see aac_fmp4_muxer_state_start. */
+AacFmp4Muxer* aac_fmp4_muxer_state_create(const uint8_t* asc, int asc_size, int bitrate,
+                                          int fragment_ms, AacWriteCallback write, void* user);
+void aac_fmp4_muxer_state_destroy(AacFmp4Muxer* m);
+/* Write the init segment */
+int aac_fmp4_muxer_state_start(AacFmp4Muxer* m);
+/* Room for the next access unit: max_frame bytes */
+uint8_t* aac_fmp4_muxer_state_reserve(AacFmp4Muxer* m);
+/* Bytes of the ADTS header (and CRC) that start frame, 0 for a raw access
+ * unit; AAC-LD units are always raw */
+int aac_fmp4_muxer_state_header(const AacFmp4Muxer* m, const uint8_t* frame, int size);
+/* Take the size bytes written at the reserved room as an access unit; an
+ * ADTS header is dropped. Closes the fragment once it is full. */
+int aac_fmp4_muxer_state_commit(AacFmp4Muxer* m, int size);
+/* Write the open fragment, if it has access units */
+int aac_fmp4_muxer_state_flush(AacFmp4Muxer* m);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BAANDER_AAC_MP4_H */
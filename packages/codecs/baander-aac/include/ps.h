@@ -1,18 +1,128 @@
 #ifndef BAANDER_AAC_PS_H
 #define BAANDER_AAC_PS_H
 #include <cstdint>
+
+#include "aac_dsp.h"
+#include "aac_tables.h"
+#include "bitstream.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
-using AacPsParams = struct AacPsParams_ {
-  int enable_iid, enable_icc, enable_ext;
-  float iid[20], icc[20];
-  int num_iid_bands, num_icc_bands;
+/* extension_id of PS data inside the SBR payload's extended data */
+#define AAC_SBR_EXT_PS 2
+/* Parameter bands: 10 or 20 (the 34-band configuration is not supported) */
+#define AAC_PS_MAX_BANDS 20
+#define AAC_PS_MAX_ENVELOPES 4
+#define AAC_PS_IID_COARSE 7 /* IID index range +-7 (coarse) or +-15 (fine) */
+#define AAC_PS_IID_FINE 15
+#define AAC_PS_ICC_STEPS 8
+/* Hybrid filterbank: QMF band 0 splits into 8 complex sub-bands, bands 1
+ * and 2 into 2 each; bands 3..63 pass through delayed to match. Rows are
+ * the 12 hybrid sub-bands followed by QMF bands 3..63. */
+#define AAC_PS_HYBRID_ROWS 12
+#define AAC_PS_ROWS (AAC_PS_HYBRID_ROWS + AAC_SBR_QMF_BANDS - 3)
+#define AAC_PS_HYBRID_TAPS 13
+#define AAC_PS_HYBRID_DELAY 6 /* slots; the PS output lags its input by this much */
+/* Decorrelator: rows below AAC_PS_ALLPASS_ROWS (QMF band 23) run an all-pass
+ * cascade, QMF bands up to 34 a 14-slot delay, the rest a 1-slot delay */
+#define AAC_PS_ALLPASS_ROWS (AAC_PS_HYBRID_ROWS + 20)
+#define AAC_PS_ALLPASS_LINKS 3
+#define AAC_PS_MAX_DELAY 14
+
+/* Stream configuration carried by the PS header */
+using AacPsHeader = struct AacPsHeader_ {
+  int enable_iid, iid_fine, iid_bands; /* iid_bands 10 or 20 */
+  int enable_icc, icc_bands;
+};
+
+/* One frame's parameters; envelope e covers slots [32 e / n, 32 (e + 1) / n) */
+using AacPsFrame = struct AacPsFrame_ {
+  int n_env; /* 0 (keep the previous parameters), 1, 2 or 4 */
+  int iid[AAC_PS_MAX_ENVELOPES][AAC_PS_MAX_BANDS]; /* signed index */
+  int icc[AAC_PS_MAX_ENVELOPES][AAC_PS_MAX_BANDS]; /* 0 (coherent) .. 7 */
+};
+
+using AacPsDecoder = struct AacPsDecoder_ {
+  const AacDSP* dsp;
+  int have_header;
+  AacPsHeader header;
+  AacPsFrame frame; /* last frame with parameters, the reference for time deltas */
+  int have_frame;
+  int fresh; /* frame arrived since the last aac_ps_process */
+  /* Mixing matrices {h11, h12, h21, h22} by [fine][iid + 15][icc] */
+  float mix[2][2 * AAC_PS_IID_FINE + 1][AAC_PS_ICC_STEPS][4];
+  /* Per-row constants: 20-band parameter band, decorrelator phase rotations
+   * (fractional pre-delay and per link) and link gains */
+  int row_band[AAC_PS_ROWS];
+  float phi_re[AAC_PS_ALLPASS_ROWS], phi_im[AAC_PS_ALLPASS_ROWS];
+  float link_re[AAC_PS_ALLPASS_LINKS][AAC_PS_ALLPASS_ROWS];
+  float link_im[AAC_PS_ALLPASS_LINKS][AAC_PS_ALLPASS_ROWS];
+  float link_gain[AAC_PS_ALLPASS_LINKS][AAC_PS_ALLPASS_ROWS];
+  /* Complex hybrid filters: 8 for QMF band 0, 2 each for bands 1 and 2 */
+  float hyb8_re[8][AAC_PS_HYBRID_TAPS], hyb8_im[8][AAC_PS_HYBRID_TAPS];
+  float hyb2_re[2][AAC_PS_HYBRID_TAPS], hyb2_im[2][AAC_PS_HYBRID_TAPS];
+  /* Hybrid analysis input: QMF bands 0..2, band-major, 12 history slots */
+  float hyb_re[3][AAC_PS_HYBRID_TAPS - 1 + 32], hyb_im[3][AAC_PS_HYBRID_TAPS - 1 + 32];
+  /* QMF bands 3..63 waiting out the hybrid delay */
+  float qmf_re[AAC_PS_HYBRID_DELAY][AAC_SBR_QMF_BANDS];
+  float qmf_im[AAC_PS_HYBRID_DELAY][AAC_SBR_QMF_BANDS];
+  /* Hybrid-domain mono signal, AAC_PS_MAX_DELAY history slots first */
+  float s_re[AAC_PS_MAX_DELAY + 32][AAC_PS_ROWS], s_im[AAC_PS_MAX_DELAY + 32][AAC_PS_ROWS];
+  /* All-pass link states, 5 history slots first (link delays 3, 4, 5) */
+  float ap_re[AAC_PS_ALLPASS_LINKS][5 + 32][AAC_PS_ALLPASS_ROWS];
+  float ap_im[AAC_PS_ALLPASS_LINKS][5 + 32][AAC_PS_ALLPASS_ROWS];
+  /* Transient ducking state per parameter band */
+  float peak_decay[AAC_PS_MAX_BANDS], power_smooth[AAC_PS_MAX_BANDS];
+  float peak_diff_smooth[AAC_PS_MAX_BANDS];
+  /* Current mixing coefficients per row, {h11, h12, h21, h22} */
+  float h[4][AAC_PS_ROWS], h_step[4][AAC_PS_ROWS];
+  int have_mix;
+  /* Frame work buffers: l (mono in, left out) and r (decorrelated, right) */
+  float l_re[32][AAC_PS_ROWS], l_im[32][AAC_PS_ROWS];
+  float r_re[32][AAC_PS_ROWS], r_im[32][AAC_PS_ROWS];
+};
+
+AacPsDecoder* aac_ps_decoder_create(const AacDSP* dsp);
+void aac_ps_decoder_destroy(AacPsDecoder* p);
+/* Parse ps_data; on AAC_ERR_DECODE the previous parameters stay in use */
+int aac_ps_parse(AacPsDecoder* p, AacBitReader* r);
+/* One frame of 32 QMF slots: mono in y, left out in y and right in r_re/r_im.
+ * The output is AAC_PS_HYBRID_DELAY slots behind the input. */
+void aac_ps_process(AacPsDecoder* p, float y_re[][AAC_SBR_QMF_BANDS],
+                    float y_im[][AAC_SBR_QMF_BANDS], float r_re[][AAC_SBR_QMF_BANDS],
+                    float r_im[][AAC_SBR_QMF_BANDS]);
+
+/* ── Encoder ──────────────────────────────────────────────────── */
+
+/* Quarter-frame blocks the encoder measures before choosing envelopes */
+#define AAC_PS_ENC_BLOCKS 4
+
+using AacPsEncoder = struct AacPsEncoder_ {
+  const AacDSP* dsp;
+  AacPsHeader header;
+  AacPsFrame frame, prev; /* prev: the frame before, the reference for time deltas */
+  int have_frame, have_prev;
+  /* L and R QMF slots, the previous frame's last AAC_PS_HYBRID_DELAY first:
+   * the decoder applies a frame's parameters that many slots late */
+  float l_re[AAC_PS_HYBRID_DELAY + 32][AAC_SBR_QMF_BANDS];
+  float l_im[AAC_PS_HYBRID_DELAY + 32][AAC_SBR_QMF_BANDS];
+  float r_re[AAC_PS_HYBRID_DELAY + 32][AAC_SBR_QMF_BANDS];
+  float r_im[AAC_PS_HYBRID_DELAY + 32][AAC_SBR_QMF_BANDS];
+  /* Per-block QMF band statistics: |L|^2, |R|^2 and Re(L R*) */
+  float el[AAC_PS_ENC_BLOCKS][AAC_SBR_QMF_BANDS], er[AAC_PS_ENC_BLOCKS][AAC_SBR_QMF_BANDS];
+  float cr[AAC_PS_ENC_BLOCKS][AAC_SBR_QMF_BANDS];
 };
 
-void aac_ps_encode(AacPsParams* ps, const float qmf_L[64][32], const float qmf_R[64][32], int nb);
-void aac_ps_decode(AacPsParams* ps, const float qmf_mono[64][32], float qmf_L[64][32],
-                   float qmf_R[64][32], int nb);
+AacPsEncoder* aac_ps_encoder_create(const AacDSP* dsp);
+void aac_ps_encoder_destroy(AacPsEncoder* p);
+/* Estimate one frame's parameters from 32 QMF slots of each input channel */
+void aac_ps_encode_frame(AacPsEncoder* p, const float l_re[][AAC_SBR_QMF_BANDS],
+                         const float l_im[][AAC_SBR_QMF_BANDS],
+                         const float r_re[][AAC_SBR_QMF_BANDS],
+                         const float r_im[][AAC_SBR_QMF_BANDS]);
+/* Write the frame's ps_data, with the PS header if header is set. A header
+ * frame never references the past and always carries parameters. */
+void aac_ps_write(const AacPsEncoder* p, AacBitWriter* w, int header);
 
 #ifdef __cplusplus
 }
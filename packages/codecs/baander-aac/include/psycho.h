@@ -1,23 +1,39 @@
 #ifndef BAANDER_AAC_PSYCHO_H
 #define BAANDER_AAC_PSYCHO_H
 #include <cstdint>
+
+#include "aac_dsp.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
+/* Spreading is a banded convolution over scalefactor bands. Taps below
+ * AAC_PSY_SPREAD_FLOOR are dropped, which leaves at most
+ * 2 * AAC_PSY_SPREAD_MAX_RADIUS + 1 taps. */
+#define AAC_PSY_SPREAD_MAX_RADIUS 4
+#define AAC_PSY_SPREAD_FLOOR 1e-6f
+#define AAC_PSY_SPREAD_PAD 8 /* zero pad on each side of energy_pad, >= max radius */
+
 using AacPsychoBand = struct AacPsychoBand_ {
   float energy, threshold, pe, tonality, spreaded_energy;
 };
 using AacPsychoState = struct AacPsychoState_ {
   int sample_rate, rate_index, frame_size, num_bands;
   float prev_energy[49];
-  float spreading[49][49];
+  /* Truncated spreading kernel: spread[b] = Σ kernel[t] * energy[b + t - radius] */
+  float spread_kernel[2 * AAC_PSY_SPREAD_MAX_RADIUS + 1];
+  int spread_radius;
+  float energy_pad[AAC_PSY_SPREAD_PAD + 49 + AAC_PSY_SPREAD_PAD]; /* zero-padded band energies */
+  float spread_out[49];
+  float ath[49]; /* absolute threshold of hearing per band, filled at init */
   AacPsychoBand bands[49];
   float thresholds[49]; /* dedicated threshold array for encoder */
   float total_pe;
   float threshold_previous[49];
   float preecho_factor;
+  int detail; /* 0 skips tonality and pre-echo control */
+  const AacDSP* dsp;
 };
-void aac_psycho_init(AacPsychoState* s, int sr, int fs);
+void aac_psycho_init(AacPsychoState* s, int sr, int fs, const AacDSP* dsp);
 void aac_psycho_analyze(AacPsychoState* s, const float* mdct, int nb, const int* sfb);
 float aac_psycho_get_pe(const AacPsychoState* s);
 const float* aac_psycho_get_thresholds(const AacPsychoState* s);
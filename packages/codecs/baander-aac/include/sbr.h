@@ -4,31 +4,206 @@
 
 #include "aac_dsp.h"
 #include "aac_tables.h" /* AAC_SBR_QMF_BANDS defined here */
+#include "bitstream.h"
+#include "ps.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
 /* AAC_SBR_QMF_BANDS inherited from aac_tables.h — do not re-define */
 
-using AacSbrQmf = struct AacSbrQmf_ {
-  float analysis_buf[64][32];
-  float synthesis_buf[64][32];
-  float overlap[64][32];
+/* A 2048-sample output frame is 32 QMF slots of 64 samples. Envelopes
+ * split the frame into 1, 2 or 4 equal parts; the noise floor into 1 or 2. */
+#define AAC_SBR_SLOTS 32
+#define AAC_SBR_MAX_ENVELOPES 4
+#define AAC_SBR_MAX_NOISE_ENVELOPES 2
+#define AAC_SBR_MAX_ENV_BANDS 48
+#define AAC_SBR_MAX_NOISE_BANDS 5
+#define AAC_SBR_MAX_PATCHES 6
+/* Envelope energy E = 2^(idx / a - AAC_SBR_ENV_OFFSET), a = 2 at 1.5 dB
+ * steps and 1 at 3 dB; idx 0 is silence */
+#define AAC_SBR_ENV_OFFSET 40
+#define AAC_SBR_ENV_MAX 127
+/* Noise-to-signal ratio Q = 2^(AAC_SBR_NOISE_FLOOR_OFFSET - idx) */
+#define AAC_SBR_NOISE_FLOOR_OFFSET 6
+#define AAC_SBR_NOISE_MAX 30
+/* extension_type of an SBR payload in a FIL element */
+#define AAC_FIL_EXT_SBR_DATA 13
+
+/* Polyphase QMF bank with 32 or 64 bands and a 10 * bands tap prototype.
+ * Subband samples are band-contiguous: row s holds slot s, bands 0..bands-1
+ * (rows are AAC_SBR_QMF_BANDS wide for either size). Slot s of the analysis
+ * covers input samples up to (s + 1) * bands - 1; an analysis/synthesis
+ * pair of the same size reconstructs its input 9 * bands samples later. */
+using AacSbrQmfBank = struct AacSbrQmfBank_ {
+  int bands;
+  const AacDSP* dsp;
+  /* Unit-energy prototype with the fold's (-1)^l signs applied */
+  float win[AAC_SBR_QMF_FILTER_LENGTH];
+  /* Modulation twiddles: pre e^{-i pi n / M}, post e^{-i pi (2k + 1) / 2M},
+   * phase e^{i pi (k + 1/2) c / M} with c the prototype centre */
+  float pre_re[AAC_SBR_QMF_BANDS], pre_im[AAC_SBR_QMF_BANDS];
+  float post_re[AAC_SBR_QMF_BANDS], post_im[AAC_SBR_QMF_BANDS];
+  float rot_re[AAC_SBR_QMF_BANDS], rot_im[AAC_SBR_QMF_BANDS];
+  /* History, written twice so the window is always contiguous. Analysis:
+   * input samples, window at ring + pos. Synthesis: the last 10 slots of
+   * 2 * bands modulated samples, newest at row pos. */
+  float ring[4 * AAC_SBR_QMF_FILTER_LENGTH];
+  int pos;
+};
+
+/* Stream configuration carried by the SBR header */
+using AacSbrHeader = struct AacSbrHeader_ {
+  int amp_res;     /* envelope step of multi-envelope frames: 0 = 1.5 dB, 1 = 3 dB */
+  int start_band;  /* first QMF band SBR reconstructs (the crossover) */
+  int stop_band;   /* one past the last reconstructed QMF band, <= 64 */
+  int freq_scale;  /* 0: 2-band linear steps, 1..3: 12, 10, 8 bands per octave */
+  int noise_bands; /* noise-floor bands per octave, 1..3 */
+};
+
+/* QMF band layout derived from the header, identical in encoder and decoder.
+ * Patch p copies QMF bands [src, src + len) up to [dst, dst + len). */
+using AacSbrTables = struct AacSbrTables_ {
+  int n_env_bands;
+  int env_band[AAC_SBR_MAX_ENV_BANDS + 1];
+  int n_noise_bands;
+  int noise_band[AAC_SBR_MAX_NOISE_BANDS + 1];
+  int n_patches;
+  int patch_src[AAC_SBR_MAX_PATCHES], patch_dst[AAC_SBR_MAX_PATCHES];
+  int patch_len[AAC_SBR_MAX_PATCHES];
+};
+
+/* One channel's SBR data for one frame */
+using AacSbrFrame = struct AacSbrFrame_ {
+  int n_env;   /* 1, 2 or 4 */
+  int amp_res; /* 0 for single-envelope frames, the header's otherwise */
+  int env_dt[AAC_SBR_MAX_ENVELOPES];
+  int noise_dt[AAC_SBR_MAX_NOISE_ENVELOPES];
+  int invf[AAC_SBR_MAX_NOISE_BANDS]; /* inverse filtering level, 0 off .. 3 strong */
+  int env[AAC_SBR_MAX_ENVELOPES][AAC_SBR_MAX_ENV_BANDS];
+  int noise[AAC_SBR_MAX_NOISE_ENVELOPES][AAC_SBR_MAX_NOISE_BANDS];
+  int add_harmonic;                    /* any of harmonic[] set */
+  int harmonic[AAC_SBR_MAX_ENV_BANDS]; /* sinusoid in the middle of envelope band b */
+};
+
+static inline int aac_sbr_noise_envelopes(int n_env) { return n_env > 1 ? 2 : 1; }
+
+/* Fill the band tables for a header; AAC_ERR_INVALID_ARG if it is out of range */
+int aac_sbr_derive_tables(AacSbrTables* t, const AacSbrHeader* h);
+
+/* Downsampler: halfband FIR, odd length, so the core lags the input by
+ * (AAC_SBR_DOWN_TAPS - 1) / 2 full-rate samples */
+#define AAC_SBR_DOWN_TAPS 95
+#define AAC_SBR_DOWN_DELAY ((AAC_SBR_DOWN_TAPS - 1) / 2)
+/* The core decoder outputs the previous frame; SBR analysis runs on input
+ * delayed by the same amount so its envelopes describe what the core carries */
+#define AAC_SBR_ANALYSIS_DELAY (2048 + AAC_SBR_DOWN_DELAY)
+#define AAC_SBR_HEADER_INTERVAL 16 /* frames between repeated SBR headers */
+
+using AacSbrEncoder = struct AacSbrEncoder_ {
+  int sample_rate, channels;
+  AacSbrHeader header;
+  AacSbrTables tables;
+  float down_taps[AAC_SBR_DOWN_TAPS];
+  float down_hist[2][AAC_SBR_DOWN_TAPS - 1];
+  float delay[2][AAC_SBR_ANALYSIS_DELAY];
+  AacSbrQmfBank qmf[2];
+  float qmf_re[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS]; /* current frame, one channel at a time */
+  float qmf_im[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  float prev_hf_energy[2]; /* last quarter-frame high-band energy, for attacks */
+  AacSbrFrame frame[2], prev[2];
+  int have_prev;        /* prev[] may be referenced by delta-time coding */
+  int frames_to_header; /* frames until the next header repeat */
+  uint8_t payload[272]; /* sbr_extension_data of the frame, after the type nibble */
+  int payload_bits;
+  /* Parametric Stereo: two input channels coded as one SBR channel plus
+   * stereo parameters, or nullptr. The right channel's QMF slots. */
+  AacPsEncoder* ps;
+  float ps_re[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  float ps_im[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+};
+
+/* crossover_hz is the core lowpass; with ps set, two input channels are
+ * coded as a mono core plus PS. Returns nullptr if no band layout fits. */
+AacSbrEncoder* aac_sbr_encoder_create(int sample_rate, int channels, int bitrate,
+                                      int crossover_hz, int ps, const AacDSP* dsp);
+void aac_sbr_encoder_destroy(AacSbrEncoder* e);
+/* Estimate the frame's SBR data from ns full-rate samples per channel and
+ * replace pcm with the ns / 2 sample core input (pcm[0] only under PS) */
+void aac_sbr_encode_frame(AacSbrEncoder* e, float pcm[][2048], int ns);
+/* Size of the FIL element aac_sbr_write_fil emits for this frame */
+int aac_sbr_fil_bits(const AacSbrEncoder* e);
+void aac_sbr_write_fil(const AacSbrEncoder* e, AacBitWriter* w);
+
+/* bands is 32 or 64; the bank starts with silent history and serves
+ * either direction, one bank per channel and direction */
+void aac_sbr_qmf_init(AacSbrQmfBank* q, int bands, const AacDSP* dsp);
+/* slots * bands input samples to slots rows of complex subband samples */
+void aac_sbr_qmf_analysis(AacSbrQmfBank* q, const float* in, float re[][AAC_SBR_QMF_BANDS],
+                          float im[][AAC_SBR_QMF_BANDS], int slots);
+/* slots rows of subband samples to slots * bands output samples */
+void aac_sbr_qmf_synthesis(AacSbrQmfBank* q, const float re[][AAC_SBR_QMF_BANDS],
+                           const float im[][AAC_SBR_QMF_BANDS], float* out, int slots);
+/* ── Decoder ──────────────────────────────────────────────────── */
+
+/* Low-band slots kept from the previous frame for the HF generator's
+ * second-order prediction */
+#define AAC_SBR_LPC_HIST 2
+/* Gain smoothing over the current and the last AAC_SBR_SMOOTH slots */
+#define AAC_SBR_SMOOTH 4
+#define AAC_SBR_NOISE_TABLE 512
+
+using AacSbrChannel = struct AacSbrChannel_ {
+  AacSbrQmfBank analysis, synthesis; /* 32 bands at the core rate, 64 at the output rate */
+  AacSbrFrame frame;                 /* last frame received, reused if one is lost */
+  int have_frame;
+  /* Core signal in the QMF domain (bands < 32), history rows first */
+  float lo_re[AAC_SBR_LPC_HIST + AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  float lo_im[AAC_SBR_LPC_HIST + AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  /* Synthesis input: the core below the crossover, adjusted HF above */
+  float y_re[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  float y_im[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  float bw[AAC_SBR_MAX_NOISE_BANDS]; /* chirp factors of the previous frame */
+  /* Gains of the last AAC_SBR_SMOOTH slots, newest first */
+  float gain_hist[AAC_SBR_SMOOTH][AAC_SBR_QMF_BANDS];
+  float noise_hist[AAC_SBR_SMOOTH][AAC_SBR_QMF_BANDS];
+  int have_hist;
+  int noise_index; /* read position in the noise table */
+  int sine_phase;  /* slot count mod 4, the sinusoid rotation */
 };
 
-using AacSbrEnvelope = struct AacSbrEnvelope_ {
-  int freq_bands_lo, freq_bands_hi, time_slots;
-  float envelope[8][64];
-  float noise_floor[8][64];
+using AacSbrDecoder = struct AacSbrDecoder_ {
+  const AacDSP* dsp;
+  int channels;
+  int have_header; /* frames before the first header are not decodable */
+  AacSbrHeader header;
+  AacSbrTables tables;
+  AacSbrChannel ch[2];
+  /* Dequantisation: envelope energy by [amp_res][idx], noise-to-signal ratio
+   * Q as Q / (1 + Q) and 1 / (1 + Q) by idx */
+  float env_energy[2][AAC_SBR_ENV_MAX + 1];
+  float noise_share[AAC_SBR_NOISE_MAX + 1], signal_share[AAC_SBR_NOISE_MAX + 1];
+  /* Unit-power complex noise; the first 64 entries repeat at the end so a
+   * band range is always one contiguous read */
+  float noise_re[AAC_SBR_NOISE_TABLE + AAC_SBR_QMF_BANDS];
+  float noise_im[AAC_SBR_NOISE_TABLE + AAC_SBR_QMF_BANDS];
+  AacPsDecoder* ps; /* created by the first PS extension of a mono stream */
 };
 
-void aac_sbr_qmf_analysis(AacSbrQmf* qmf, const float* time_in, float qmf_out[64][32],
-                          const struct AacDSP_* dsp);
-void aac_sbr_qmf_synthesis(AacSbrQmf* qmf, const float qmf_in[64][32], float* time_out,
-                           const struct AacDSP_* dsp);
-void aac_sbr_encode(AacSbrEnvelope* env, AacSbrQmf* qmf, const float* core_low, int core_bands,
-                    int sbr_bands);
-void aac_sbr_decode(AacSbrEnvelope* env, AacSbrQmf* qmf, const float* core_low, int core_bands,
-                    int sbr_bands, float* output);
+AacSbrDecoder* aac_sbr_decoder_create(int channels, const AacDSP* dsp);
+void aac_sbr_decoder_destroy(AacSbrDecoder* d);
+/* Parse sbr_extension_data (after the type nibble) for the nch channels of
+ * the preceding element, starting at channel ch0, including PS data in the
+ * extended data of a mono element. AAC_ERR_DECODE leaves the previous frame
+ * in use. */
+int aac_sbr_parse(AacSbrDecoder* d, AacBitReader* r, int ch0, int nch);
+/* 1024 core samples of channel c to 2048 output samples; out may alias
+ * core. Before the first header this is a plain 2x upsampler. */
+void aac_sbr_decode_channel(AacSbrDecoder* d, int c, const float* core, float* out);
+/* Mono core to stereo through Parametric Stereo once a PS header has been
+ * seen (aac_sbr_has_ps); out_l may alias core. The output is
+ * AAC_PS_HYBRID_DELAY slots later than aac_sbr_decode_channel's. */
+int aac_sbr_has_ps(const AacSbrDecoder* d);
+void aac_sbr_decode_ps(AacSbrDecoder* d, const float* core, float* out_l, float* out_r);
 
 #ifdef __cplusplus
 }
@@ -1,18 +1,89 @@
 #ifndef BAANDER_AAC_SPECTRAL_H
 #define BAANDER_AAC_SPECTRAL_H
 #include <cstdint>
+
+#include "aac_dsp.h"
+#include "bitstream.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
+/* TNS limits: n_filt is 2 bits per long window (1 bit per short window) */
+#define AAC_TNS_MAX_FILTERS_LONG 3
+#define AAC_TNS_MAX_FILTERS_SHORT 1
+#define AAC_TNS_MAX_ORDER 20
+
+/* PNS (codebook 13): a band's noise energy is coded like a scalefactor,
+ * DPCM against the previous noise band and starting from global_gain - 90.
+ * The substituted band has total energy 2^(nrg / 2). */
+#define AAC_PNS_CODEBOOK 13
+#define AAC_PNS_ENERGY_OFFSET 90
+
+/* Per-window TNS side info. Filters run from the top of the spectrum down;
+ * filter f covers `length` bands below the previous one. lpc holds a[1..order]
+ * of A(z) = 1 + Σ a_k z^-k, rebuilt from the quantized reflection
+ * coefficients so encoder and decoder filter with identical taps. */
 using AacTnsInfo = struct AacTnsInfo_ {
   int n_filt[8], coef_res[8], length[8][4], order[8][4], direction[8][4];
-  float lpc[8][4][20];
+  int coef_compress[8][4];
+  int coef[8][4][AAC_TNS_MAX_ORDER]; /* quantized reflection coefficient indices */
+  float lpc[8][4][AAC_TNS_MAX_ORDER];
+  float noise_gain[8][4]; /* encoder: synthesis filter power gain on white noise */
 };
 
-void aac_tns_encode(AacTnsInfo* tns, float* spec, int nb, const int* sfb, int ri, int ws);
-void aac_tns_decode(AacTnsInfo* tns, float* spec, int nb, const int* sfb, int ri, int ws);
-void aac_pns_replace(float* spec, int sfb, const int* sfb_off, float energy, int fs);
-void aac_pns_restore(float* spec, int sfb, const int* sfb_off, float energy, int fs);
+/* Scalar TNS filtering of the first n samples of a region, where the
+ * history is only partially inside it. Reference for AacDSP::tns_fir/iir
+ * (n = len) and the prologue of their SIMD versions. */
+static inline void aac_tns_fir_head(float* dst, const float* src, int n, const float* lpc,
+                                    int order) {
+  for (int i = 0; i < n; i++) {
+    float acc = src[i];
+    for (int k = 1; k <= order && k <= i; k++) {
+      acc += lpc[k - 1] * src[i - k];
+    }
+    dst[i] = acc;
+  }
+}
+
+static inline void aac_tns_iir_head(float* x, int n, const float* lpc, int order) {
+  for (int i = 0; i < n; i++) {
+    float acc = x[i];
+    for (int k = 1; k <= order && k <= i; k++) {
+      acc -= lpc[k - 1] * x[i - k];
+    }
+    x[i] = acc;
+  }
+}
+
+/* Analyse and filter spec in place (all-zero). max_filters is per long
+ * window; returns 1 when at least one filter was applied. ri and
+ * frame_length (1024, or 512/480 for AAC-LD) select the band table. */
+int aac_tns_encode(AacTnsInfo* tns, float* spec, int max_sfb, int ri, int frame_length, int ws,
+                   int max_filters, const AacDSP* dsp);
+/* Undo aac_tns_encode on dequantized spec (all-pole) */
+void aac_tns_decode(const AacTnsInfo* tns, float* spec, int max_sfb, int ri, int frame_length,
+                    int ws, const AacDSP* dsp);
+/* Per-band noise_gain of a long-window aac_tns_encode result (1 outside
+ * the filtered regions), for weighting quantization noise in the residual */
+void aac_tns_band_noise_gain(const AacTnsInfo* tns, float* gain, int max_sfb, int ri,
+                             int frame_length);
+void aac_tns_write(AacBitWriter* w, const AacTnsInfo* tns, int ws);
+/* Bits aac_tns_write would write */
+int aac_tns_bits(const AacTnsInfo* tns, int ws);
+int aac_tns_read(AacBitReader* r, AacTnsInfo* tns, int ws);
+/* xorshift32 step; state must be non-zero. Each decoder owns its state, so
+ * output is deterministic per stream and free of shared state. */
+static inline uint32_t aac_pns_random(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *state = x;
+  return x;
+}
+
+/* Fill band sfb with noise normalised to exactly `energy` */
+void aac_pns_replace(float* spec, int sfb, const int* sfb_off, float energy, uint32_t* seed);
+void aac_pns_restore(float* spec, int sfb, const int* sfb_off, float energy, uint32_t* seed);
 void aac_ms_encode(float* mid, float* side, const float* L, const float* R, int n);
 void aac_ms_decode(float* L, float* R, const float* mid, const float* side, int n);
 void aac_intensity_decode(float* L, float* R, const float* spec, float scale, int start, int end);
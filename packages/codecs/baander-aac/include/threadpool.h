@@ -0,0 +1,26 @@
+#ifndef BAANDER_AAC_THREADPOOL_H
+#define BAANDER_AAC_THREADPOOL_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Fork-join pool for element-level parallelism.
+ *
+ * aac_thread_pool_run hands out the indices of one job to the workers and
+ * the calling thread and returns once every index has run. Jobs never
+ * overlap: one codec instance owns the pool and runs a job at a time.
+ */
+using AacThreadPool = struct AacThreadPool_;
+using AacThreadTask = void (*)(void* ctx, int index);
+
+/* threads counts the caller; nullptr for threads < 2 or where the platform
+ * has no threads (WASM builds) */
+AacThreadPool* aac_thread_pool_create(int threads);
+void aac_thread_pool_destroy(AacThreadPool* p);
+/* task(ctx, i) for i in [0, n); p may be nullptr, which runs them in order */
+void aac_thread_pool_run(AacThreadPool* p, AacThreadTask task, void* ctx, int n);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BAANDER_AAC_THREADPOOL_H */
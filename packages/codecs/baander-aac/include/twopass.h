@@ -0,0 +1,69 @@
+#ifndef BAANDER_AAC_TWOPASS_H
+#define BAANDER_AAC_TWOPASS_H
+#include <cstdint>
+#include <cstdio>
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Two-pass VBR rate control.
+ *
+ * Pass 1 appends one fixed-size record per encoded frame to a statistics
+ * file. Pass 2 loads the whole file, splits the global bit budget
+ * (bitrate × duration) across frames by perceptual complexity, and seeds
+ * each frame's lambda from the recorded rate-distortion slope so the
+ * rate-control loop only needs to refine.
+ *
+ * File layout (little-endian, native float):
+ *   AacPassStatsHeader, then AacPassStatsFrame × n_frames
+ */
+#define AAC_PASS_STATS_MAGIC 0x50324142u /* "BA2P" */
+#define AAC_PASS_STATS_VERSION 1
+#define AAC_PASS_FLAG_TRANSIENT 1u
+/* Pass 2 starts close to the answer; cap its rate-control refinements */
+#define AAC_TWOPASS_MAX_ITERATIONS 3
+
+using AacPassStatsHeader = struct AacPassStatsHeader_ {
+  uint32_t magic, version;
+  int32_t sample_rate, channels, bitrate, frame_size;
+};
+
+using AacPassStatsFrame = struct AacPassStatsFrame_ {
+  float pe;           /* total perceptual entropy over channels */
+  float lambda;       /* lambda the frame converged to */
+  float slope;        /* -d log(bits) / d log(lambda) around lambda */
+  int32_t est_bits;   /* quantizer bit estimate at lambda */
+  int32_t frame_bits; /* bits actually written, headers included */
+  uint32_t flags;     /* AAC_PASS_FLAG_* */
+};
+
+using AacTwoPassState = struct AacTwoPassState_ {
+  int pass; /* 1 or 2 */
+  FILE* file;
+  AacPassStatsHeader header;
+  /* pass 2 */
+  AacPassStatsFrame* frames;
+  int64_t* target_bits; /* planned frame_bits per frame */
+  int n_frames;
+  int frame_index;
+  int64_t planned_total, spent_total;
+};
+
+/* Pass 1: create the stats file and write its header */
+AacTwoPassState* aac_twopass_open_first(const char* path, int sr, int ch, int br, int fs);
+/* Pass 2: load stats and plan per-frame budgets for bitrate br */
+AacTwoPassState* aac_twopass_open_second(const char* path, int sr, int ch, int br, int fs);
+void aac_twopass_close(AacTwoPassState* tp);
+
+int aac_twopass_record(AacTwoPassState* tp, const AacPassStatsFrame* frame);
+
+/* Pass 2: payload target and initial lambda for the next frame. Returns 0
+ * when stats are exhausted (caller keeps its own target). */
+int aac_twopass_frame_plan(AacTwoPassState* tp, int* target_bits, float* lambda);
+/* Pass 2: report the written size so later frames absorb the error */
+void aac_twopass_frame_done(AacTwoPassState* tp, int frame_bits);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* BAANDER_AAC_TWOPASS_H */
@@ -0,0 +1,515 @@
+#include "adts.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "aac.h"
+#include "aac_tables.h"
+#include "gain.h"
+
+AacAdtsFramer* aac_adts_framer_state_create(const AacDSP* dsp, int loas) {
+  auto* f = new AacAdtsFramer();
+  f->dsp = dsp;
+  f->loas = loas;
+  return f;
+}
+
+void aac_adts_framer_state_destroy(AacAdtsFramer* f) { delete f; }
+
+/* Offset of the first LOAS syncword in buf, or -1 */
+static int loas_sync(const uint8_t* buf, int size) {
+  for (int p = 0; p < size - 1;) {
+    const auto* hit = static_cast<const uint8_t*>(memchr(buf + p, 0x56, size - 1 - p));
+    if (!hit) {
+      return -1;
+    }
+    p = (int)(hit - buf);
+    if ((buf[p + 1] & 0xE0) == 0xE0) {
+      return p;
+    }
+    p++;
+  }
+  return -1;
+}
+
+static int sync(const AacAdtsFramer* f, const uint8_t* buf, int size) {
+  return f->loas ? loas_sync(buf, size) : f->dsp->adts_sync(buf, size);
+}
+
+/* Frame length at buf, or 0; LOAS frames all share key 0 */
+static int check(const AacAdtsFramer* f, const uint8_t* buf, uint32_t* key) {
+  if (f->loas) {
+    *key = 0;
+    return aac_loas_check(buf);
+  }
+  return aac_adts_check(buf, key);
+}
+
+/* Look for the next frame in buf. Returns 1 with the frame at [*start,
+ * *start + *need). Returns 0 when buf runs out: bytes before *start can go,
+ * and *need bytes from *start are wanted before trying again. */
+static int find_frame(AacAdtsFramer* f, const uint8_t* buf, int size, bool eos, int* start,
+                      int* need) {
+  const int header = f->loas ? AAC_LOAS_HEADER_SIZE : AAC_ADTS_HEADER_SIZE;
+  const uint8_t lead = f->loas ? 0x56 : 0xFF;
+  for (int p = 0;;) {
+    int off = sync(f, buf + p, size - p);
+    if (off < 0) {
+      /* A trailing first syncword byte may be the start of the next frame */
+      *start = !eos && size > 0 && buf[size - 1] == lead ? size - 1 : size;
+      *need = 2;
+      f->locked &= *start == 0;
+      return 0;
+    }
+    const int q = p + off;
+    f->locked &= q == 0;
+    if (size - q < header) {
+      *start = eos ? size : q;
+      *need = header;
+      return 0;
+    }
+    uint32_t key;
+    const int len = check(f, buf + q, &key);
+    if (len == 0) {
+      p = q + 1;
+      continue;
+    }
+    f->locked &= key == f->key; /* a new stream configuration is confirmed afresh */
+    if (!f->locked) {
+      uint32_t next_key;
+      if (size - q >= len + header) {
+        if (check(f, buf + q + len, &next_key) == 0 || next_key != key) {
+          p = q + 1;
+          continue;
+        }
+      } else if (!eos) {
+        *start = q;
+        *need = len + header;
+        return 0;
+      }
+    }
+    if (size - q < len) {
+      if (eos) { /* truncated last frame */
+        p = q + 1;
+        continue;
+      }
+      *start = q;
+      *need = len;
+      return 0;
+    }
+    f->locked = 1;
+    f->key = key;
+    *start = q;
+    *need = len;
+    return 1;
+  }
+}
+
+/* Drop n bytes from the front of the carry */
+static void carry_drop(AacAdtsFramer* f, int n) {
+  memmove(f->carry, f->carry + n, f->carry_size - n);
+  f->carry_size -= n;
+  f->carry_tail = std::min(f->carry_tail, f->carry_size);
+}
+
+/* Leave the carry once what it holds is still in the chunk. Returns true
+ * when the carry is empty. */
+static bool carry_rewind(AacAdtsFramer* f) {
+  if (f->carry_size <= f->carry_tail) {
+    f->pos -= f->carry_size;
+    f->carry_size = f->carry_tail = 0;
+  }
+  return f->carry_size == 0;
+}
+
+static void release_frame(AacAdtsFramer* f) {
+  if (f->carry_used > 0) {
+    carry_drop(f, f->carry_used);
+    f->carry_used = 0;
+    carry_rewind(f);
+  }
+}
+
+int aac_adts_framer_state_feed(AacAdtsFramer* f, const uint8_t* data, int size) {
+  release_frame(f);
+  if (f->pos < f->chunk_size || f->eos) {
+    return AAC_ERR_STATE;
+  }
+  f->chunk = data;
+  f->chunk_size = size;
+  f->pos = 0;
+  f->carry_tail = 0;
+  f->eos = size == 0;
+  return AAC_OK;
+}
+
+int aac_adts_framer_state_next(AacAdtsFramer* f, const uint8_t** frame, int* size) {
+  release_frame(f);
+  int start, need;
+  for (;;) {
+    const int left = f->chunk_size - f->pos;
+    if (f->carry_size == 0) {
+      const uint8_t* buf = f->chunk + f->pos;
+      const int found = find_frame(f, buf, left, f->eos, &start, &need);
+      f->dropped += start;
+      if (found) {
+        *frame = buf + start;
+        *size = need;
+        f->pos += start + need;
+        return 1;
+      }
+      /* Keep the unfinished tail for the next chunk */
+      f->carry_size = left - start;
+      if (f->carry_size > 0) {
+        memcpy(f->carry, buf + start, f->carry_size);
+      }
+      f->pos = f->chunk_size;
+      return 0;
+    }
+
+    const int found = find_frame(f, f->carry, f->carry_size, f->eos && left == 0, &start, &need);
+    f->dropped += start;
+    if (found) {
+      *frame = f->carry + start;
+      *size = need;
+      f->carry_used = start + need;
+      return 1;
+    }
+    carry_drop(f, start);
+    if (carry_rewind(f)) {
+      continue;
+    }
+    if (left == 0) {
+      return 0;
+    }
+    /* Just the bytes the carry is missing, so it empties soon after */
+    const int take = std::min(std::max(need - f->carry_size, 1), left);
+    memcpy(f->carry + f->carry_size, f->chunk + f->pos, take);
+    f->carry_size += take;
+    f->carry_tail += take;
+    f->pos += take;
+  }
+}
+
+/* ── File Index ───────────────────────────────────────────────── */
+
+/* Bytes of an ID3v2 tag at the start of the file (syncsafe size, optional
+ * footer), or 0 */
+static int64_t id3v2_size(const uint8_t* d, int64_t size) {
+  if (size < 10 || memcmp(d, "ID3", 3) != 0 || ((d[6] | d[7] | d[8] | d[9]) & 0x80)) {
+    return 0;
+  }
+  int64_t tag = 10 + ((d[6] << 21) | (d[7] << 14) | (d[8] << 7) | d[9]) + ((d[5] & 0x10) ? 10 : 0);
+  return std::min(tag, size);
+}
+
+/* The next sync candidate at or after pos, or size */
+static int64_t next_sync(const AacDSP* dsp, const uint8_t* d, int64_t pos, int64_t size) {
+  const int64_t kWindow = 1 << 30;
+  while (size - pos >= 2) {
+    const int n = (int)std::min(size - pos, kWindow + 1);
+    int off = dsp->adts_sync(d + pos, n);
+    if (off >= 0) {
+      return pos + off;
+    }
+    pos += n - 1;
+  }
+  return size;
+}
+
+/* Grow a new[] array from n to cap entries */
+static void grow(uint32_t** a, int64_t n, int64_t cap) {
+  auto* grown = new uint32_t[cap];
+  if (n > 0) {
+    memcpy(grown, *a, n * sizeof(uint32_t));
+  }
+  delete[] *a;
+  *a = grown;
+}
+
+static void build_index(AacAdtsIndex* x, const AacDSP* dsp) {
+  AacAdtsIndexHeader* h = &x->header;
+  const uint8_t* d = x->file.data;
+  const int64_t size = x->file.size;
+  int64_t pos = h->data_offset = id3v2_size(d, size), cap = 0;
+  bool locked = false;
+  while (size - pos >= AAC_ADTS_HEADER_SIZE) {
+    uint32_t key;
+    const int len = aac_adts_check(d + pos, &key);
+    bool ok = len > 0 && len <= size - pos && (!locked || key == h->key);
+    if (ok && !locked) {
+      uint32_t next_key;
+      const int64_t next = pos + len;
+      ok = next == size ||
+           (size - next >= AAC_ADTS_HEADER_SIZE && aac_adts_check(d + next, &next_key) > 0 &&
+            next_key == key);
+    }
+    if (!ok) {
+      const int64_t found = next_sync(dsp, d, pos + 1, size);
+      h->dropped += found - pos;
+      pos = found;
+      continue;
+    }
+    locked = true;
+    h->key = key;
+    const int blocks = (d[pos + 6] & 3) + 1;
+    h->multi_block |= blocks > 1;
+    if (h->frames == cap) {
+      cap = std::max<int64_t>(2 * cap, 1024);
+      grow(&x->offsets, h->frames, cap);
+      grow(&x->first_block, h->frames, cap);
+    }
+    x->offsets[h->frames] = (uint32_t)pos;
+    x->first_block[h->frames] = (uint32_t)h->blocks;
+    h->frames++;
+    h->blocks += blocks;
+    pos += len;
+  }
+  h->dropped += size - pos;
+  if (!h->multi_block) {
+    delete[] x->first_block;
+    x->first_block = nullptr;
+  }
+}
+
+static bool load_sidecar(AacAdtsIndex* x, const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    return false;
+  }
+  AacAdtsIndexHeader h;
+  bool ok = fread(&h, sizeof(h), 1, f) == 1 && h.magic == AAC_ADTS_INDEX_MAGIC &&
+            h.version == AAC_ADTS_INDEX_VERSION && h.file_size == x->file.size &&
+            h.file_mtime == x->file.mtime && h.frames > 0 && h.frames <= x->file.size;
+  if (ok) {
+    x->header = h;
+    x->offsets = new uint32_t[h.frames];
+    ok = fread(x->offsets, sizeof(uint32_t), h.frames, f) == (size_t)h.frames;
+    if (ok && h.multi_block) {
+      x->first_block = new uint32_t[h.frames];
+      ok = fread(x->first_block, sizeof(uint32_t), h.frames, f) == (size_t)h.frames;
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+static void save_sidecar(const AacAdtsIndex* x, const char* path) {
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    return;
+  }
+  const AacAdtsIndexHeader* h = &x->header;
+  bool ok = fwrite(h, sizeof(*h), 1, f) == 1 &&
+            fwrite(x->offsets, sizeof(uint32_t), h->frames, f) == (size_t)h->frames &&
+            (!h->multi_block ||
+             fwrite(x->first_block, sizeof(uint32_t), h->frames, f) == (size_t)h->frames);
+  fclose(f);
+  if (!ok) {
+    remove(path); /* never leave a truncated sidecar behind */
+  }
+}
+
+AacAdtsIndex* aac_adts_index_state_open(const char* path, const char* sidecar, const AacDSP* dsp) {
+  auto* x = new AacAdtsIndex();
+  if (aac_mapped_file_open(&x->file, path) != AAC_OK || x->file.size > UINT32_MAX) {
+    aac_adts_index_state_close(x);
+    return nullptr;
+  }
+  if (sidecar && load_sidecar(x, sidecar)) {
+    x->from_sidecar = 1;
+    return x;
+  }
+  delete[] x->offsets;
+  delete[] x->first_block;
+  x->offsets = x->first_block = nullptr;
+  x->header = AacAdtsIndexHeader{};
+  x->header.magic = AAC_ADTS_INDEX_MAGIC;
+  x->header.version = AAC_ADTS_INDEX_VERSION;
+  x->header.file_size = x->file.size;
+  x->header.file_mtime = x->file.mtime;
+  build_index(x, dsp);
+  if (x->header.frames == 0) {
+    aac_adts_index_state_close(x);
+    return nullptr;
+  }
+  if (sidecar) {
+    save_sidecar(x, sidecar);
+  }
+  return x;
+}
+
+void aac_adts_index_state_close(AacAdtsIndex* x) {
+  aac_mapped_file_close(&x->file);
+  delete[] x->offsets;
+  delete[] x->first_block;
+  delete x;
+}
+
+int64_t aac_adts_index_state_find(const AacAdtsIndex* x, int64_t block) {
+  if (block < 0 || block >= x->header.blocks) {
+    return -1;
+  }
+  if (!x->first_block) {
+    return block;
+  }
+  const uint32_t* first = x->first_block;
+  return std::upper_bound(first, first + x->header.frames, (uint32_t)block) - first - 1;
+}
+
+int aac_adts_index_state_frame(const AacAdtsIndex* x, int64_t frame, const uint8_t** data,
+                               int* size) {
+  /* A sidecar is trusted only as far as the header it points at */
+  const int64_t off = x->offsets[frame];
+  uint32_t key;
+  int len = 0;
+  if (off + AAC_ADTS_HEADER_SIZE <= x->file.size) {
+    len = aac_adts_check(x->file.data + off, &key);
+  }
+  if (len == 0 || key != x->header.key || len > x->file.size - off) {
+    return AAC_ERR_DECODE;
+  }
+  *data = x->file.data + off;
+  *size = len;
+  return AAC_OK;
+}
+
+static int64_t first_block(const AacAdtsIndex* x, int64_t frame) {
+  return x->first_block ? x->first_block[frame] : frame;
+}
+
+int64_t aac_adts_index_state_segments(const AacAdtsIndex* x, int64_t segment_blocks, int preroll,
+                                      AacAdtsSegment* segs, int64_t max) {
+  const int64_t frames = x->header.frames;
+  int64_t count = 0;
+  for (int64_t start = 0; start < frames; count++) {
+    /* The first boundary past the blocks of frame start; a frame of several
+     * blocks may hold more than one */
+    int64_t end = frames;
+    for (int64_t b = (first_block(x, start) / segment_blocks + 1) * segment_blocks;
+         b < x->header.blocks && end == frames; b += segment_blocks) {
+      const int64_t f = aac_adts_index_state_find(x, b);
+      end = f > start ? f : frames;
+    }
+    if (count < max) {
+      AacAdtsSegment* g = &segs[count];
+      g->first_frame = start;
+      g->frames = end - start;
+      g->preroll_frame = std::max<int64_t>(start - preroll, 0);
+      g->start_sample = first_block(x, start) * AAC_FRAME_SIZE_LONG;
+      g->offset = x->offsets[start];
+      g->contiguous = 1;
+      for (int64_t f = start; f < end; f++) {
+        const uint8_t* d;
+        int size;
+        if (aac_adts_index_state_frame(x, f, &d, &size) != AAC_OK) {
+          return AAC_ERR_DECODE;
+        }
+        g->size = x->offsets[f] + size - g->offset;
+        g->contiguous &= f + 1 == end || x->offsets[f] + size == x->offsets[f + 1];
+      }
+    }
+    start = end;
+  }
+  return count;
+}
+
+/* ── Splicer ──────────────────────────────────────────────────── */
+
+static int write_span(AacAdtsSplicer* s, const uint8_t* data, int64_t size) {
+  while (size > 0) {
+    const int n = (int)std::min<int64_t>(size, 1 << 30);
+    const int ret = s->write(data, n, s->user);
+    if (ret != AAC_OK) {
+      return ret;
+    }
+    data += n;
+    size -= n;
+  }
+  return AAC_OK;
+}
+
+/* Write whichever of the run and the stage is pending; one of them is empty.
+ * Its frames count as written only if the write succeeds. */
+static int splicer_drain(AacAdtsSplicer* s) {
+  int ret = write_span(s, s->run, s->run_size);
+  s->run_size = 0;
+  if (ret == AAC_OK) {
+    ret = write_span(s, s->stage, s->stage_fill);
+  }
+  s->stage_fill = 0;
+  if (ret == AAC_OK) {
+    s->frames += s->pending;
+    s->patched += s->pending_patched;
+  }
+  s->pending = s->pending_patched = 0;
+  return ret;
+}
+
+AacAdtsSplicer* aac_adts_splicer_state_create(AacWriteCallback write, void* user) {
+  auto* s = new AacAdtsSplicer();
+  s->write = write;
+  s->user = user;
+  s->stage = new uint8_t[AAC_ADTS_SPLICER_STAGE];
+  return s;
+}
+
+void aac_adts_splicer_state_destroy(AacAdtsSplicer* s) {
+  delete[] s->stage;
+  delete s;
+}
+
+int aac_adts_splicer_state_append(AacAdtsSplicer* s, const AacAdtsIndex* x, int64_t first,
+                                  int64_t count) {
+  if (s->last && x->header.key != s->key) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  s->seam |= s->last && (x != s->last || first != s->next_frame);
+  s->key = x->header.key;
+  s->last = x;
+  const int64_t written = s->frames;
+  int ret = AAC_OK;
+  for (int64_t f = first; f < first + count; f++) {
+    const uint8_t* d;
+    int size;
+    ret = aac_adts_index_state_frame(x, f, &d, &size);
+    if (ret != AAC_OK) {
+      break;
+    }
+    /* protection_absent set, buffer_fullness not 0x7FF */
+    const bool vbr = s->seam && (d[1] & 1) && ((d[5] & 0x1F) != 0x1F || (d[6] & 0xFC) != 0xFC);
+    if (!vbr && s->gain == 0) {
+      if (s->run_size == 0 || s->run + s->run_size != d) {
+        if ((ret = splicer_drain(s)) != AAC_OK) {
+          break;
+        }
+        s->run = d;
+      }
+      s->run_size += size;
+      s->pending++;
+      continue;
+    }
+    if ((s->run_size > 0 || s->stage_fill + size > AAC_ADTS_SPLICER_STAGE) &&
+        (ret = splicer_drain(s)) != AAC_OK) {
+      break;
+    }
+    uint8_t* out = s->stage + s->stage_fill;
+    memcpy(out, d, size);
+    if (vbr) {
+      out[5] |= 0x1F;
+      out[6] |= 0xFC;
+    }
+    if (s->gain != 0 && (ret = aac_gain_adts(out, size, s->gain)) != AAC_OK) {
+      break;
+    }
+    s->stage_fill += size;
+    s->pending++;
+    s->pending_patched++;
+  }
+  /* Frames ahead of a failure are still written; a failed write drops
+   * what it held, and the drain after it has nothing left to write */
+  const int drained = splicer_drain(s);
+  s->next_frame = first + (s->frames - written);
+  return ret != AAC_OK ? ret : drained;
+}
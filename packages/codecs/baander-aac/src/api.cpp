@@ -1,11 +1,18 @@
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 
 #include "aac.h"
 #include "aac_cpu.h"
 #include "aac_dsp.h"
+#include "adts.h"
 #include "bitstream.h"
 #include "decoder.h"
 #include "encoder.h"
+#include "gain.h"
+#include "latm.h"
+#include "mp4.h"
+#include "threadpool.h"
 
 /* Global DSP context — initialized once */
 static AacDSP g_dsp;
@@ -22,12 +29,20 @@ static void ensure_dsp_init() {
 
 AacEncoderHandle aac_encoder_create(int sample_rate, int channels, int bitrate, AacObjectType aot,
                                     AacRateControl rc_mode) {
-  if (sample_rate <= 0 || channels <= 0 || channels > 2 || bitrate <= 0) {
+  if (sample_rate <= 0 || aac_channel_config_index(channels) == 0 || bitrate <= 0) {
     return nullptr;
   }
 
-  /* Validate AOT */
-  if (aot != AAC_AOT_LC && aot != AAC_AOT_SBR && aot != AAC_AOT_PS) {
+  /* Validate AOT; Parametric Stereo codes a stereo pair only */
+  if (aot != AAC_AOT_LC && aot != AAC_AOT_SBR && aot != AAC_AOT_PS && aot != AAC_AOT_LD) {
+    return nullptr;
+  }
+  if (aot == AAC_AOT_PS && channels > 2) {
+    return nullptr;
+  }
+  /* AAC-LD band tables exist for 22.05 to 48 kHz; both frame lengths share them */
+  if (aot == AAC_AOT_LD &&
+      aac_num_sfb(aac_sample_rate_index(sample_rate), AAC_FRAME_SIZE_LD) == 0) {
     return nullptr;
   }
 
@@ -50,7 +65,7 @@ int aac_encoder_encode(AacEncoderHandle ctx, const float* pcm, int n_samples, ui
     return AAC_ERR_INVALID_ARG;
   }
   auto* s = static_cast<AacEncoderState*>(ctx);
-  if (n_samples != 1024) {
+  if (n_samples != s->frame_size) {
     return AAC_ERR_INVALID_ARG;
   }
 
@@ -75,9 +90,105 @@ int aac_encoder_set_quality(AacEncoderHandle ctx, int quality) {
     return AAC_ERR_INVALID_ARG;
   }
   s->quality = quality;
+  for (int e = 0; e < s->n_elems; e++) {
+    s->elems[e]->quality = quality;
+  }
+  return AAC_OK;
+}
+
+int aac_encoder_set_complexity(AacEncoderHandle ctx, AacComplexity complexity) {
+  if (!ctx) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  if (complexity < AAC_COMPLEXITY_FAST || complexity > AAC_COMPLEXITY_BEST) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  aac_encoder_apply_complexity(static_cast<AacEncoderState*>(ctx), complexity);
+  return AAC_OK;
+}
+
+int aac_encoder_set_pass(AacEncoderHandle ctx, AacPassMode pass, const char* stats_path) {
+  if (!ctx || pass < AAC_PASS_SINGLE || pass > AAC_PASS_SECOND) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  if (pass != AAC_PASS_SINGLE && !stats_path) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* s = static_cast<AacEncoderState*>(ctx);
+  /* The stats file holds one record per frame of a single element */
+  if (s->n_elems > 0) {
+    return pass == AAC_PASS_SINGLE ? AAC_OK : AAC_ERR_UNSUPPORTED;
+  }
+  /* Frame indices in the stats file must line up with the input */
+  if (s->frame_count > 0) {
+    return AAC_ERR_STATE;
+  }
+  aac_twopass_close(s->twopass);
+  s->twopass = nullptr;
+  /* The budget is split over core frames at the core rate */
+  if (pass == AAC_PASS_FIRST) {
+    s->twopass = aac_twopass_open_first(stats_path, s->core_rate, s->channels, s->bitrate,
+                                        s->frame_length);
+  } else if (pass == AAC_PASS_SECOND) {
+    s->twopass = aac_twopass_open_second(stats_path, s->core_rate, s->channels, s->bitrate,
+                                         s->frame_length);
+  } else {
+    return AAC_OK;
+  }
+  return s->twopass ? AAC_OK : AAC_ERR_INIT;
+}
+
+int aac_encoder_set_stats_callback(AacEncoderHandle ctx, AacFrameStatsCallback cb, void* user) {
+  if (!ctx) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  aac_encoder_set_stats(static_cast<AacEncoderState*>(ctx), cb, user);
+  return AAC_OK;
+}
+
+int aac_encoder_set_threads(AacEncoderHandle ctx, int threads) {
+  if (!ctx || threads < 1) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* s = static_cast<AacEncoderState*>(ctx);
+  aac_thread_pool_destroy(s->pool);
+  s->pool = aac_thread_pool_create(threads);
+  return threads > 1 && !s->pool ? AAC_ERR_UNSUPPORTED : AAC_OK;
+}
+
+int aac_encoder_set_frame_length(AacEncoderHandle ctx, int frame_length) {
+  if (!ctx) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_encoder_state_set_frame_length(static_cast<AacEncoderState*>(ctx), frame_length);
+}
+
+int aac_encoder_set_transport(AacEncoderHandle ctx, AacTransport transport) {
+  if (!ctx || transport < AAC_TRANSPORT_ADTS || transport > AAC_TRANSPORT_RAW) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* s = static_cast<AacEncoderState*>(ctx);
+  if (s->frame_count > 0) {
+    return AAC_ERR_STATE;
+  }
+  s->transport = transport;
   return AAC_OK;
 }
 
+int aac_encoder_get_config(AacEncoderHandle ctx, uint8_t* asc, int asc_size) {
+  if (!ctx || !asc || asc_size <= 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* s = static_cast<AacEncoderState*>(ctx);
+  AacAudioConfig cfg;
+  cfg.object_type = s->aot;
+  cfg.sample_rate_index = s->rate_index;
+  cfg.ext_rate_index = aac_sample_rate_index(s->sample_rate);
+  cfg.channel_config = aac_channel_config_index(s->channels); /* the core's: mono under PS */
+  cfg.frame_length = s->frame_length;
+  return aac_audio_config_write(&cfg, asc, asc_size);
+}
+
 int aac_encoder_frame_size(AacEncoderHandle ctx) {
   if (!ctx) {
     return AAC_ERR_INVALID_ARG;
@@ -90,14 +201,21 @@ int aac_encoder_delay(AacEncoderHandle ctx) {
   if (!ctx) {
     return AAC_ERR_INVALID_ARG;
   }
-  /* AAC-LC encoder delay = 1024 samples (one frame of lookahead).
-   * HE-AAC adds SBR delay (~960 samples) on top. */
+  /* AAC-LC encoder delay = 1024 samples (one frame of lookahead), AAC-LD
+   * likewise one 512- or 480-sample frame.
+   * HE-AAC: the same frame at the core rate, the downsampler, and the
+   * decoder's QMF pair (9 slots of 64); the half-rate core lands half a
+   * sample late, rounded up. PS adds the decoder's hybrid filterbank.
+   * Every element of a multichannel stream has the same delay. */
   auto* s = static_cast<AacEncoderState*>(ctx);
-  int delay = 1024; /* AAC-LC core delay */
-  if (s->aot == AAC_AOT_SBR || s->aot == AAC_AOT_PS) {
-    delay += 960; /* SBR analysis delay */
+  if (s->n_elems > 0) {
+    s = s->elems[0];
+  }
+  if (s->sbr) {
+    int ps = s->sbr->ps ? AAC_PS_HYBRID_DELAY * AAC_SBR_QMF_BANDS : 0;
+    return 2048 + AAC_SBR_DOWN_DELAY + 9 * AAC_SBR_QMF_BANDS + 1 + ps;
   }
-  return delay;
+  return s->frame_length; /* AAC-LC and AAC-LD core delay */
 }
 
 int aac_encoder_flush(AacEncoderHandle ctx, uint8_t* out, int out_size) {
@@ -106,14 +224,14 @@ int aac_encoder_flush(AacEncoderHandle ctx, uint8_t* out, int out_size) {
   }
   /* Produce a final frame with silence to drain the MDCT overlap */
   auto* s = static_cast<AacEncoderState*>(ctx);
-  float silence[1024] = {0};
-  return aac_encoder_encode(ctx, silence, 1024, out, out_size);
+  static const float silence[AAC_MAX_CHANNELS * 2048] = {0}; /* one frame, interleaved */
+  return aac_encoder_encode(ctx, silence, s->frame_size, out, out_size);
 }
 
 /* ── Decoder API ───────────────────────────────────────────────── */
 
 AacDecoderHandle aac_decoder_create(int sample_rate, int channels) {
-  if (sample_rate <= 0 || channels <= 0 || channels > 2) {
+  if (sample_rate <= 0 || aac_channel_config_index(channels) == 0) {
     return nullptr;
   }
 
@@ -130,101 +248,261 @@ void aac_decoder_destroy(AacDecoderHandle ctx) {
   aac_decoder_state_destroy(s);
 }
 
-int aac_decoder_decode(AacDecoderHandle ctx, const uint8_t* data, int size, float* pcm,
-                       int pcm_size) {
-  if (!ctx || !data || !pcm || size <= 0 || pcm_size <= 0) {
+int aac_decoder_set_threads(AacDecoderHandle ctx, int threads) {
+  if (!ctx || threads < 1) {
     return AAC_ERR_INVALID_ARG;
   }
-
   auto* s = static_cast<AacDecoderState*>(ctx);
+  aac_thread_pool_destroy(s->pool);
+  s->pool = aac_thread_pool_create(threads);
+  return threads > 1 && !s->pool ? AAC_ERR_UNSUPPORTED : AAC_OK;
+}
 
-  /* Parse ADTS header if present */
+int aac_decoder_set_downmix(AacDecoderHandle ctx, AacDownmix mode) {
+  if (!ctx || mode < AAC_DOWNMIX_OFF || mode > AAC_DOWNMIX_TIME) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_decoder_state_set_downmix(static_cast<AacDecoderState*>(ctx), mode);
+}
+
+int aac_decoder_downmix_path(AacDecoderHandle ctx) {
+  if (!ctx) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return static_cast<AacDecoderState*>(ctx)->downmix_path;
+}
+
+int aac_decoder_set_config(AacDecoderHandle ctx, const uint8_t* asc, int asc_size) {
+  if (!ctx || !asc || asc_size <= 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  AacAudioConfig cfg;
+  int ret = aac_audio_config_parse(&cfg, asc, asc_size);
+  if (ret != AAC_OK) {
+    return ret;
+  }
+  return aac_decoder_state_set_config(static_cast<AacDecoderState*>(ctx), &cfg);
+}
+
+/* Decode one raw_data_block into the channel states. Returns the channels
+ * decoded: the decoder's count (a downmix included), or 1 for a mono stream
+ * the caller duplicates. */
+static int decode_payload(AacDecoderState* s, const uint8_t* data, int size, int channel_config) {
+  int n_ch = aac_decode_frame(s, data, size, channel_config);
+  if (n_ch > 0 && n_ch != s->channels && !(n_ch == 1 && s->channels == 2)) {
+    return AAC_ERR_UNSUPPORTED; /* fewer channels than the decoder outputs */
+  }
+  return n_ch;
+}
+
+/* Take the core rate of an ADTS header */
+static void apply_adts(AacDecoderState* s, const AacAdtsHeader* hdr) {
+  if (hdr->sample_rate_index < AAC_NUM_SAMPLE_RATES) {
+    s->rate_index = hdr->sample_rate_index;
+  }
+}
+
+/* Bytes before the payload: the fixed header, and crc_check when present */
+static int adts_header_size(const AacAdtsHeader* hdr) {
+  return AAC_ADTS_HEADER_SIZE + (hdr->protection_absent ? 0 : 2);
+}
+
+/* As decode_payload, for a raw or ADTS-wrapped frame */
+static int decode_frame(AacDecoderState* s, const uint8_t* data, int size) {
+  /* Parse ADTS header if present; AAC-LD access units are always raw */
   AacAdtsHeader hdr;
-  int data_offset = 0;
-  if (size >= 7 && data[0] == 0xFF && (data[1] & 0xF0) == 0xF0) {
-    if (aac_adts_parse(&hdr, data, size) != 0) {
+  if (s->aot != AAC_AOT_LD && size >= 7 && data[0] == 0xFF && (data[1] & 0xF0) == 0xF0) {
+    const int header = aac_adts_parse(&hdr, data, size) == 0 ? adts_header_size(&hdr) : 0;
+    if (!header || hdr.frame_length > size || hdr.frame_length < header) {
       return AAC_ERR_DECODE;
     }
-    data_offset = AAC_ADTS_HEADER_SIZE;
-    if (hdr.frame_length > size) {
-      return AAC_ERR_DECODE;
+    apply_adts(s, &hdr);
+    return decode_payload(s, data + header, size - header, hdr.channel_config);
+  }
+  return decode_payload(s, data, size, s->channel_config);
+}
+
+/* Output channel c of a frame that decoded n_ch channels; a mono stream
+ * fills both channels of a stereo decoder */
+static const float* channel_output(const AacDecoderState* s, int n_ch, int c) {
+  return s->ch[n_ch == 1 ? 0 : c].output;
+}
+
+/* Samples [i0, i0 + n) of every output channel, interleaved into dst */
+static void interleave(const AacDecoderState* s, int n_ch, float* dst, int i0, int n) {
+  const int channels = s->channels;
+  if (channels == 1) {
+    memcpy(dst, s->ch[0].output + i0, n * sizeof(float));
+    return;
+  }
+  if (channels == 2) {
+    s->dsp->interleave2(dst, channel_output(s, n_ch, 0) + i0, channel_output(s, n_ch, 1) + i0, n);
+    return;
+  }
+  for (int c = 0; c < channels; c++) {
+    const float* src = channel_output(s, n_ch, c) + i0;
+    for (int i = 0; i < n; i++) {
+      dst[static_cast<ptrdiff_t>(i) * channels + c] = src[i];
     }
   }
+}
 
-  /* Parse raw data block */
-  AacBitReader reader;
-  aac_bitreader_init(&reader, data + data_offset, size - data_offset);
+int aac_decoder_decode(AacDecoderHandle ctx, const uint8_t* data, int size, float* pcm,
+                       int pcm_size) {
+  if (!ctx || !data || !pcm || size <= 0 || pcm_size <= 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* s = static_cast<AacDecoderState*>(ctx);
+  int n_ch = decode_frame(s, data, size);
+  if (n_ch <= 0) {
+    return n_ch;
+  }
+  const int n = std::min(s->frame_size, pcm_size / s->channels);
+  interleave(s, n_ch, pcm, 0, n);
+  return n;
+}
 
-  int total_samples = 0;
-  int max_elements = 16; /* safety limit to prevent infinite loops on malformed data */
-  while (aac_bitreader_bits_left(&reader) > 3 && max_elements-- > 0) {
-    int elem_type = aac_bitreader_read(&reader, 3);
-    if (elem_type == AAC_ELEM_END) {
+int aac_decoder_decode_many(AacDecoderHandle ctx, const uint8_t* data, int size, float* pcm,
+                            int pcm_size, int max_frames, int* frame_samples, int* consumed) {
+  if (!ctx || !data || !pcm || !frame_samples || !consumed || size < 0 || pcm_size <= 0 ||
+      max_frames <= 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* s = static_cast<AacDecoderState*>(ctx);
+  *consumed = 0;
+  if (s->aot == AAC_AOT_LD) {
+    return AAC_ERR_UNSUPPORTED; /* raw access units carry no length to walk */
+  }
+  int frames = 0, pos = 0, out = 0, ret = 0;
+  while (frames < max_frames && size - pos >= AAC_ADTS_HEADER_SIZE) {
+    AacAdtsHeader hdr;
+    if (aac_adts_parse(&hdr, data + pos, size - pos) != 0 ||
+        hdr.frame_length < adts_header_size(&hdr)) {
+      ret = AAC_ERR_DECODE; /* lost sync */
+      break;
+    }
+    if (hdr.frame_length > size - pos) {
+      break; /* completed by the caller's next buffer */
+    }
+    const int ri = hdr.sample_rate_index < AAC_NUM_SAMPLE_RATES ? hdr.sample_rate_index
+                                                                  : s->rate_index;
+    const int n = aac_decoder_state_frame_size(s, ri);
+    if (out + n * s->channels > pcm_size) {
+      ret = AAC_ERR_OVERFLOW;
       break;
     }
+    apply_adts(s, &hdr);
+    const int header = adts_header_size(&hdr);
+    int n_ch = decode_payload(s, data + pos + header, hdr.frame_length - header,
+                              hdr.channel_config);
+    if (n_ch > 0) {
+      interleave(s, n_ch, pcm + out, 0, n);
+      out += n * s->channels;
+    }
+    frame_samples[frames++] = n_ch > 0 ? n : n_ch;
+    pos += hdr.frame_length;
+  }
+  *consumed = pos;
+  return frames > 0 ? frames : ret;
+}
 
-    switch (elem_type) {
-      case AAC_ELEM_SCE: {
-        int tag = aac_bitreader_read(&reader, 4);
-        int ch = (tag == 0) ? 0 : 1;
-        int ret = aac_decode_sce(s, &reader, ch);
-        if (ret) {
-          return ret;
-        }
-        /* Copy decoded output to PCM */
-        int n = (pcm_size - total_samples >= 1024) ? 1024 : pcm_size - total_samples;
-        if (n > 0) {
-          if (s->channels == 1) {
-            memcpy(pcm + total_samples, s->ch[ch].output, n * sizeof(float));
-          } else {
-            /* Interleave for stereo output */
-            for (int i = 0; i < n && (total_samples + i) * 2 + 1 < pcm_size; i++) {
-              pcm[static_cast<ptrdiff_t>(total_samples + i) * 2] = s->ch[ch].output[i];
-              pcm[static_cast<ptrdiff_t>(total_samples + i) * 2 + 1] = s->ch[ch].output[i];
-            }
-          }
-          total_samples += n;
-        }
-        break;
-      }
-      case AAC_ELEM_CPE: {
-        int ret = aac_decode_cpe(s, &reader);
-        if (ret) {
-          return ret;
-        }
-        int n =
-            (pcm_size - total_samples * 2 >= 1024 * 2) ? 1024 : (pcm_size - total_samples * 2) / 2;
-        if (n > 0) {
-          for (int i = 0; i < n; i++) {
-            pcm[static_cast<ptrdiff_t>(total_samples + i) * 2] = s->ch[0].output[i];
-            pcm[static_cast<ptrdiff_t>(total_samples + i) * 2 + 1] = s->ch[1].output[i];
-          }
-          total_samples += n;
-        }
-        break;
-      }
-      case AAC_ELEM_FIL: {
-        int cnt = aac_bitreader_read(&reader, 4);
-        if (cnt == 15) {
-          cnt += aac_bitreader_read(&reader, 8) - 1;
-        }
-        aac_bitreader_skip(&reader, cnt * 8);
-        break;
-      }
-      default:
-        aac_bitreader_byte_align(&reader);
-        break;
+/* TPDF dither in LSBs: the difference of two uniform 16-bit halves of one
+ * xorshift32 draw, in (-1, 1) */
+static void tpdf_dither(float* d, int n, uint32_t* seed) {
+  uint32_t x = *seed;
+  for (int i = 0; i < n; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    d[i] = ((float)(x & 0xFFFF) - (float)(x >> 16)) * (1.0f / 65536.0f);
+  }
+  *seed = x;
+}
+
+/* Integer output in blocks that stay in L1: interleave, dither, convert */
+template <typename T>
+static int decode_int(AacDecoderHandle ctx, const uint8_t* data, int size, T* pcm, int pcm_size,
+                      void (*convert)(T*, const float*, const float*, int)) {
+  if (!ctx || !data || !pcm || size <= 0 || pcm_size <= 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* s = static_cast<AacDecoderState*>(ctx);
+  int n_ch = decode_frame(s, data, size);
+  if (n_ch <= 0) {
+    return n_ch;
+  }
+  const int channels = s->channels;
+  const int n = std::min(s->frame_size, pcm_size / channels);
+  const int kBlock = 256;
+  float buf[kBlock * AAC_MAX_CHANNELS], dither[kBlock * AAC_MAX_CHANNELS];
+  for (int i0 = 0; i0 < n; i0 += kBlock) {
+    const int m = std::min(kBlock, n - i0), count = m * channels;
+    interleave(s, n_ch, buf, i0, m);
+    if (s->dither) {
+      tpdf_dither(dither, count, &s->dither_seed);
     }
+    convert(pcm + static_cast<ptrdiff_t>(i0) * channels, buf, s->dither ? dither : nullptr,
+            count);
   }
+  return n;
+}
 
-  return total_samples;
+int aac_decoder_decode_s16(AacDecoderHandle ctx, const uint8_t* data, int size, int16_t* pcm,
+                           int pcm_size) {
+  return decode_int(ctx, data, size, pcm, pcm_size, g_dsp.float_to_s16);
+}
+
+int aac_decoder_decode_s24(AacDecoderHandle ctx, const uint8_t* data, int size, int32_t* pcm,
+                           int pcm_size) {
+  return decode_int(ctx, data, size, pcm, pcm_size, g_dsp.float_to_s24);
+}
+
+int aac_decoder_set_dither(AacDecoderHandle ctx, int enable) {
+  if (!ctx) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  static_cast<AacDecoderState*>(ctx)->dither = enable != 0;
+  return AAC_OK;
+}
+
+int aac_decoder_decode_planar(AacDecoderHandle ctx, const uint8_t* data, int size,
+                              float* const* pcm, int pcm_samples) {
+  if (!ctx || !data || !pcm || size <= 0 || pcm_samples <= 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* s = static_cast<AacDecoderState*>(ctx);
+  int n_ch = decode_frame(s, data, size);
+  if (n_ch <= 0) {
+    return n_ch;
+  }
+  const int n = std::min(s->frame_size, pcm_samples);
+  for (int c = 0; c < s->channels; c++) {
+    memcpy(pcm[c], channel_output(s, n_ch, c), n * sizeof(float));
+  }
+  return n;
+}
+
+int aac_decoder_decode_planar_ref(AacDecoderHandle ctx, const uint8_t* data, int size,
+                                  const float** pcm) {
+  if (!ctx || !data || !pcm || size <= 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* s = static_cast<AacDecoderState*>(ctx);
+  int n_ch = decode_frame(s, data, size);
+  if (n_ch <= 0) {
+    return n_ch;
+  }
+  for (int c = 0; c < s->channels; c++) {
+    pcm[c] = channel_output(s, n_ch, c);
+  }
+  return s->frame_size;
 }
 
 int aac_decoder_frame_size(AacDecoderHandle ctx) {
   if (!ctx) {
     return AAC_ERR_INVALID_ARG;
   }
-  return 1024;
+  return static_cast<AacDecoderState*>(ctx)->frame_size;
 }
 
 int aac_decoder_sample_rate(AacDecoderHandle ctx) {
@@ -254,3 +532,360 @@ int aac_decoder_get_sbr_ps(AacDecoderHandle ctx, int* has_sbr, int* has_ps) {
   }
   return AAC_OK;
 }
+
+/* ── ADTS Framer API ───────────────────────────────────────────── */
+
+AacAdtsFramerHandle aac_adts_framer_create(void) {
+  ensure_dsp_init();
+  return aac_adts_framer_state_create(&g_dsp, 0);
+}
+
+void aac_adts_framer_destroy(AacAdtsFramerHandle ctx) {
+  if (ctx) {
+    aac_adts_framer_state_destroy(static_cast<AacAdtsFramer*>(ctx));
+  }
+}
+
+int aac_adts_framer_feed(AacAdtsFramerHandle ctx, const uint8_t* data, int size) {
+  if (!ctx || size < 0 || (!data && size > 0)) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_adts_framer_state_feed(static_cast<AacAdtsFramer*>(ctx), data, size);
+}
+
+int aac_adts_framer_next(AacAdtsFramerHandle ctx, const uint8_t** frame, int* size) {
+  if (!ctx || !frame || !size) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_adts_framer_state_next(static_cast<AacAdtsFramer*>(ctx), frame, size);
+}
+
+int64_t aac_adts_framer_dropped(AacAdtsFramerHandle ctx) {
+  return ctx ? static_cast<AacAdtsFramer*>(ctx)->dropped : 0;
+}
+
+/* ── ADTS File Index API ───────────────────────────────────────── */
+
+AacAdtsIndexHandle aac_adts_index_open(const char* path, const char* sidecar_path) {
+  if (!path) {
+    return nullptr;
+  }
+  ensure_dsp_init();
+  return aac_adts_index_state_open(path, sidecar_path, &g_dsp);
+}
+
+void aac_adts_index_close(AacAdtsIndexHandle ctx) {
+  if (ctx) {
+    aac_adts_index_state_close(static_cast<AacAdtsIndex*>(ctx));
+  }
+}
+
+int aac_adts_index_info(AacAdtsIndexHandle ctx, AacAdtsIndexInfo* info) {
+  if (!ctx || !info) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  const auto* x = static_cast<const AacAdtsIndex*>(ctx);
+  const AacAdtsIndexHeader* h = &x->header;
+  const uint8_t* first;
+  int size;
+  AacAdtsHeader hdr;
+  if (aac_adts_index_frame(ctx, 0, &first, &size) != AAC_OK ||
+      aac_adts_parse(&hdr, first, size) != 0) {
+    return AAC_ERR_DECODE;
+  }
+  info->sample_rate = aac_sample_rates[hdr.sample_rate_index];
+  info->channel_config = hdr.channel_config;
+  info->profile = hdr.profile;
+  info->frames = h->frames;
+  info->samples = h->blocks * AAC_FRAME_SIZE_LONG;
+  info->data_offset = h->data_offset;
+  info->dropped = h->dropped;
+  info->from_sidecar = x->from_sidecar;
+  return AAC_OK;
+}
+
+int64_t aac_adts_index_find(AacAdtsIndexHandle ctx, int64_t sample) {
+  if (!ctx || sample < 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  int64_t frame = aac_adts_index_state_find(static_cast<const AacAdtsIndex*>(ctx),
+                                            sample / AAC_FRAME_SIZE_LONG);
+  return frame < 0 ? (int64_t)AAC_ERR_INVALID_ARG : frame;
+}
+
+int aac_adts_index_frame(AacAdtsIndexHandle ctx, int64_t frame, const uint8_t** data, int* size) {
+  if (!ctx || !data || !size) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  const auto* x = static_cast<const AacAdtsIndex*>(ctx);
+  if (frame < 0 || frame >= x->header.frames) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_adts_index_state_frame(x, frame, data, size);
+}
+
+int64_t aac_adts_index_segments(AacAdtsIndexHandle ctx, int segment_ms, int preroll,
+                                AacAdtsSegment* segs, int64_t max_segments) {
+  if (!ctx || segment_ms <= 0 || preroll < 0 || max_segments < 0 || (!segs && max_segments > 0)) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  const auto* x = static_cast<const AacAdtsIndex*>(ctx);
+  const uint8_t* first;
+  int size;
+  AacAdtsHeader hdr;
+  if (aac_adts_index_frame(ctx, 0, &first, &size) != AAC_OK ||
+      aac_adts_parse(&hdr, first, size) != 0) {
+    return AAC_ERR_DECODE;
+  }
+  const int64_t rate = aac_sample_rates[hdr.sample_rate_index];
+  const int64_t blocks = ((int64_t)segment_ms * rate / 1000 + AAC_FRAME_SIZE_LONG / 2) /
+                         AAC_FRAME_SIZE_LONG;
+  return aac_adts_index_state_segments(x, std::max<int64_t>(blocks, 1), preroll, segs,
+                                       max_segments);
+}
+
+/* ── ADTS Splicer API ──────────────────────────────────────────── */
+
+AacAdtsSplicerHandle aac_adts_splicer_create(AacWriteCallback write, void* user) {
+  return write ? aac_adts_splicer_state_create(write, user) : nullptr;
+}
+
+void aac_adts_splicer_destroy(AacAdtsSplicerHandle ctx) {
+  if (ctx) {
+    aac_adts_splicer_state_destroy(static_cast<AacAdtsSplicer*>(ctx));
+  }
+}
+
+int aac_adts_splicer_append(AacAdtsSplicerHandle ctx, AacAdtsIndexHandle idx, int64_t first,
+                            int64_t count) {
+  if (!ctx || !idx) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  const auto* x = static_cast<const AacAdtsIndex*>(idx);
+  if (first < 0 || count < 0 || first > x->header.frames - count) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_adts_splicer_state_append(static_cast<AacAdtsSplicer*>(ctx), x, first, count);
+}
+
+int64_t aac_adts_splicer_frames(AacAdtsSplicerHandle ctx, int64_t* patched) {
+  if (!ctx) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  const auto* s = static_cast<const AacAdtsSplicer*>(ctx);
+  if (patched) {
+    *patched = s->patched;
+  }
+  return s->frames;
+}
+
+int aac_adts_splicer_set_gain(AacAdtsSplicerHandle ctx, int steps) {
+  if (!ctx || steps < -255 || steps > 255) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  static_cast<AacAdtsSplicer*>(ctx)->gain = steps;
+  return AAC_OK;
+}
+
+/* ── MP4 Demuxer API ───────────────────────────────────────────── */
+
+AacMp4DemuxerHandle aac_mp4_demuxer_open(const char* path) {
+  return path ? aac_mp4_demuxer_state_open(path) : nullptr;
+}
+
+void aac_mp4_demuxer_close(AacMp4DemuxerHandle ctx) {
+  if (ctx) {
+    aac_mp4_demuxer_state_close(static_cast<AacMp4Demuxer*>(ctx));
+  }
+}
+
+int aac_mp4_demuxer_info(AacMp4DemuxerHandle ctx, AacMp4Info* info) {
+  if (!ctx || !info) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  const auto* m = static_cast<const AacMp4Demuxer*>(ctx);
+  const AacAudioConfig* cfg = &m->config;
+  if (cfg->channel_config == 0 || cfg->ext_rate_index >= AAC_NUM_SAMPLE_RATES) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  info->sample_rate = aac_sample_rates[cfg->ext_rate_index];
+  info->channels = aac_mp4_config_channels(cfg);
+  info->object_type = (AacObjectType)cfg->object_type;
+  info->bitrate = m->bitrate;
+  info->timescale = (int)std::min<uint32_t>(m->timescale, INT32_MAX);
+  info->frames = m->frames;
+  info->duration = aac_mp4_demuxer_state_duration(m);
+  return AAC_OK;
+}
+
+int aac_mp4_demuxer_config(AacMp4DemuxerHandle ctx, uint8_t* asc, int asc_size) {
+  if (!ctx || !asc) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  const auto* m = static_cast<const AacMp4Demuxer*>(ctx);
+  if (asc_size < m->asc_size) {
+    return AAC_ERR_OVERFLOW;
+  }
+  memcpy(asc, m->asc, m->asc_size);
+  return m->asc_size;
+}
+
+int64_t aac_mp4_demuxer_find(AacMp4DemuxerHandle ctx, int64_t time) {
+  if (!ctx || time < 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  int64_t frame = aac_mp4_demuxer_state_find(static_cast<const AacMp4Demuxer*>(ctx), time);
+  return frame < 0 ? (int64_t)AAC_ERR_INVALID_ARG : frame;
+}
+
+int aac_mp4_demuxer_frame(AacMp4DemuxerHandle ctx, int64_t frame, const uint8_t** data,
+                          int* size) {
+  if (!ctx || !data || !size) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  const auto* m = static_cast<const AacMp4Demuxer*>(ctx);
+  if (frame < 0 || frame >= m->frames) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  *data = m->file.data + m->offsets[frame];
+  *size = aac_mp4_demuxer_state_size(m, frame);
+  return AAC_OK;
+}
+
+/* ── Fragmented MP4 Muxer API ──────────────────────────────────── */
+
+AacFmp4MuxerHandle aac_fmp4_muxer_create(const uint8_t* asc, int asc_size, int bitrate,
+                                         int fragment_ms, AacWriteCallback write, void* user) {
+  if (!asc || asc_size <= 0 || fragment_ms <= 0 || !write) {
+    return nullptr;
+  }
+  AacFmp4Muxer* m = aac_fmp4_muxer_state_create(asc, asc_size, bitrate, fragment_ms, write, user);
+  if (m && aac_fmp4_muxer_state_start(m) != AAC_OK) {
+    aac_fmp4_muxer_state_destroy(m);
+    return nullptr;
+  }
+  return m;
+}
+
+void aac_fmp4_muxer_destroy(AacFmp4MuxerHandle ctx) {
+  if (ctx) {
+    aac_fmp4_muxer_state_destroy(static_cast<AacFmp4Muxer*>(ctx));
+  }
+}
+
+int aac_fmp4_muxer_write(AacFmp4MuxerHandle ctx, const uint8_t* frame, int size) {
+  if (!ctx || !frame || size <= 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* m = static_cast<AacFmp4Muxer*>(ctx);
+  const int header = aac_fmp4_muxer_state_header(m, frame, size);
+  if (size - header > m->max_frame) {
+    return AAC_ERR_OVERFLOW;
+  }
+  memcpy(aac_fmp4_muxer_state_reserve(m), frame + header, size - header);
+  return aac_fmp4_muxer_state_commit(m, size - header);
+}
+
+int aac_fmp4_muxer_encode(AacFmp4MuxerHandle ctx, AacEncoderHandle enc, const float* pcm,
+                          int n_samples) {
+  if (!ctx || !enc) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  auto* m = static_cast<AacFmp4Muxer*>(ctx);
+  int len = aac_encoder_encode(enc, pcm, n_samples, aac_fmp4_muxer_state_reserve(m), m->max_frame);
+  return len < 0 ? len : aac_fmp4_muxer_state_commit(m, len);
+}
+
+int aac_fmp4_muxer_flush(AacFmp4MuxerHandle ctx) {
+  if (!ctx) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_fmp4_muxer_state_flush(static_cast<AacFmp4Muxer*>(ctx));
+}
+
+/* ── LOAS/LATM API ─────────────────────────────────────────────── */
+
+AacLatmReaderHandle aac_latm_reader_create(void) {
+  ensure_dsp_init();
+  return aac_latm_reader_state_create(&g_dsp);
+}
+
+void aac_latm_reader_destroy(AacLatmReaderHandle ctx) {
+  if (ctx) {
+    aac_latm_reader_state_destroy(static_cast<AacLatmReader*>(ctx));
+  }
+}
+
+int aac_latm_reader_feed(AacLatmReaderHandle ctx, const uint8_t* data, int size) {
+  if (!ctx || size < 0 || (!data && size > 0)) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_latm_reader_state_feed(static_cast<AacLatmReader*>(ctx), data, size);
+}
+
+int aac_latm_reader_next(AacLatmReaderHandle ctx, const uint8_t** au, int* size) {
+  if (!ctx || !au || !size) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_latm_reader_state_next(static_cast<AacLatmReader*>(ctx), au, size);
+}
+
+int aac_latm_reader_config(AacLatmReaderHandle ctx, uint8_t* asc, int asc_size) {
+  if (!ctx || !asc) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  const auto* r = static_cast<const AacLatmReader*>(ctx);
+  if (!r->has_config) {
+    return AAC_ERR_STATE;
+  }
+  if (asc_size < r->asc_size) {
+    return AAC_ERR_OVERFLOW;
+  }
+  memcpy(asc, r->asc, r->asc_size);
+  return r->asc_size;
+}
+
+int64_t aac_latm_reader_dropped(AacLatmReaderHandle ctx) {
+  return ctx ? static_cast<AacLatmReader*>(ctx)->dropped : 0;
+}
+
+AacLatmWriterHandle aac_latm_writer_create(const uint8_t* asc, int asc_size, int config_interval) {
+  return asc ? aac_latm_writer_state_create(asc, asc_size, config_interval) : nullptr;
+}
+
+void aac_latm_writer_destroy(AacLatmWriterHandle ctx) {
+  if (ctx) {
+    aac_latm_writer_state_destroy(static_cast<AacLatmWriter*>(ctx));
+  }
+}
+
+int aac_latm_writer_write(AacLatmWriterHandle ctx, const uint8_t* au, int size, uint8_t* out,
+                          int out_size) {
+  if (!ctx || !out || (!au && size > 0)) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_latm_writer_state_write(static_cast<AacLatmWriter*>(ctx), au, size, out, out_size);
+}
+
+/* ── Gain API ──────────────────────────────────────────────────── */
+
+int aac_gain_steps(float db) { return (int)lroundf(db / AAC_GAIN_STEP_DB); }
+
+int aac_gain_adts_frame(uint8_t* frame, int size, int steps) {
+  if (!frame || size < 0 || steps < -255 || steps > 255) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  return aac_gain_adts(frame, size, steps);
+}
+
+int aac_gain_access_unit(const uint8_t* asc, int asc_size, uint8_t* au, int size, int steps) {
+  if (!asc || !au || size < 0 || steps < -255 || steps > 255) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  AacAudioConfig cfg;
+  const int ret = aac_audio_config_parse(&cfg, asc, asc_size);
+  if (ret != AAC_OK) {
+    return ret;
+  }
+  return aac_gain_block(&cfg, au, size, steps);
+}
@@ -1,5 +1,6 @@
 #include "bitstream.h"
 
+#include <cmath>
 #include <cstring>
 
 #include "aac_cpu.h"
@@ -7,6 +8,7 @@
 #include "aac_tables.h"
 #include "fft.h"
 #include "mdct.h"
+#include "spectral.h"
 
 /* ── Bit Reader ────────────────────────────────────────────────── */
 
@@ -22,19 +24,17 @@ int aac_bitreader_bits_left(const AacBitReader* r) {
 }
 
 uint32_t aac_bitreader_peek(AacBitReader* r, int n) {
-  uint32_t v = 0;
-  int bp = r->byte_pos, bitp = r->bit_pos;
-  for (int i = 0; i < n; i++) {
-    v <<= 1;
-    if (bp < r->size) { v |= (r->data[bp] >> (7 - bitp)) & 1;
-}
-    bitp++;
-    if (bitp >= 8) {
-      bitp = 0;
-      bp++;
-    }
+  if (n <= 0) {
+    return 0;
   }
-  return v;
+  /* The 5 bytes that hold up to 32 bits from any bit position, zeros past
+   * the end */
+  const int bp = r->byte_pos;
+  uint64_t w = 0;
+  for (int i = 0; i < 5; i++) {
+    w = (w << 8) | (bp + i < r->size ? r->data[bp + i] : 0);
+  }
+  return (uint32_t)((w << (24 + r->bit_pos)) >> (64 - n));
 }
 
 uint32_t aac_bitreader_read(AacBitReader* r, int n) {
@@ -51,7 +51,10 @@ int32_t aac_bitreader_read_signed(AacBitReader* r, int n) {
   return (int32_t)u;
 }
 
-void aac_bitreader_skip(AacBitReader* r, int n) { aac_bitreader_read(r, n); }
+void aac_bitreader_skip(AacBitReader* r, int n) {
+  r->byte_pos += (r->bit_pos + n) / 8;
+  r->bit_pos = (r->bit_pos + n) % 8;
+}
 
 void aac_bitreader_byte_align(AacBitReader* r) {
   if (r->bit_pos > 0) {
@@ -69,15 +72,19 @@ int aac_bitreader_read_huffman(AacBitReader* r, int cb, int* x, int* y) {
   int n = aac_huff_count[cb];
   const uint32_t* codes = aac_huff_code[cb];
   const uint8_t* lens = aac_huff_len[cb];
-  uint32_t peek = aac_bitreader_peek(r, 11);
-
-  /* Find longest matching codeword (handles non-prefix-free ordering) */
-  int best_idx = -1, best_len = 0;
-  for (int i = 0; i < n; i++) {
+  /* Long enough for every codeword: codebook 9 runs to 15 bits */
+  const int kPeekBits = 16;
+  uint32_t peek = aac_bitreader_peek(r, kPeekBits);
+
+  /* Find longest matching codeword (handles non-prefix-free ordering); the
+   * lookup table settles it from the first bits unless a longer one shares them */
+  const int hit = aac_huff_lookup[cb][peek >> (kPeekBits - AAC_HUFF_LOOKUP_BITS)];
+  int best_idx = hit ? hit >> 5 : -1, best_len = hit & 31;
+  for (int i = 0; i < n && !hit; i++) {
     int len = lens[i];
-    if (!len || len > 11) { continue;
+    if (!len || len > kPeekBits) { continue;
 }
-    if ((peek >> (11 - len)) == (codes[i] >> (32 - len))) {
+    if ((peek >> (kPeekBits - len)) == (codes[i] >> (32 - len))) {
       if (len > best_len) {
         best_idx = i;
         best_len = len;
@@ -100,6 +107,16 @@ int aac_bitreader_read_huffman(AacBitReader* r, int cb, int* x, int* y) {
   return 0;
 }
 
+int32_t aac_bitreader_read_golomb(AacBitReader* r) {
+  /* Longer prefixes than any writer emits are corrupt data; stop there */
+  int zeros = 0;
+  while (zeros < 24 && aac_bitreader_bits_left(r) > 0 && aac_bitreader_read(r, 1) == 0) {
+    zeros++;
+  }
+  uint32_t u = ((1u << zeros) | aac_bitreader_read(r, zeros)) - 1;
+  return (u & 1) ? (int32_t)((u + 1) >> 1) : -(int32_t)(u >> 1);
+}
+
 /* ── Bit Writer ────────────────────────────────────────────────── */
 
 void aac_bitwriter_init(AacBitWriter* w, uint8_t* d, int c) {
@@ -151,6 +168,26 @@ int aac_bitwriter_write_huffman(AacBitWriter* w, int cb, int x, int y) {
   return 0;
 }
 
+static uint32_t golomb_code(int32_t v) {
+  return (v > 0) ? 2u * (uint32_t)v - 1u : 2u * (uint32_t)-v;
+}
+
+int aac_golomb_bits(int32_t v) {
+  uint32_t u = golomb_code(v) + 1;
+  int len = 0;
+  while (u >> len) {
+    len++;
+  }
+  return 2 * len - 1;
+}
+
+void aac_bitwriter_write_golomb(AacBitWriter* w, int32_t v) {
+  uint32_t u = golomb_code(v) + 1;
+  int len = (aac_golomb_bits(v) + 1) / 2;
+  aac_bitwriter_write(w, 0, len - 1);
+  aac_bitwriter_write(w, u, len);
+}
+
 void aac_bitwriter_byte_align(AacBitWriter* w) {
   if (w->bit_pos > 0) {
     w->byte_pos++;
@@ -162,6 +199,8 @@ int aac_bitwriter_bytes_written(const AacBitWriter* w) {
   return w->byte_pos + (w->bit_pos > 0 ? 1 : 0);
 }
 
+int aac_bitwriter_bits_written(const AacBitWriter* w) { return w->byte_pos * 8 + w->bit_pos; }
+
 /* ── ADTS ──────────────────────────────────────────────────────── */
 
 int aac_adts_parse(AacAdtsHeader* h, const uint8_t* d, int s) {
@@ -187,6 +226,20 @@ int aac_adts_parse(AacAdtsHeader* h, const uint8_t* d, int s) {
   return 0;
 }
 
+int aac_adts_check(const uint8_t* d, uint32_t* key) {
+  if (d[0] != 0xFF || (d[1] & 0xF6) != 0xF0 || ((d[2] >> 2) & 0xF) >= AAC_NUM_SAMPLE_RATES) {
+    return 0;
+  }
+  const int frame_length = ((d[3] & 0x3) << 11) | (d[4] << 3) | (d[5] >> 5);
+  const int header = AAC_ADTS_HEADER_SIZE + ((d[1] & 1) ? 0 : 2);
+  if (frame_length < header) {
+    return 0;
+  }
+  /* Everything from id to channel_configuration except private_bit */
+  *key = ((uint32_t)(d[1] & 0x0F) << 16) | ((uint32_t)(d[2] & 0xFD) << 8) | (d[3] & 0xC0);
+  return frame_length;
+}
+
 int aac_adts_write(const AacAdtsHeader* h, uint8_t* o) {
   AacBitWriter w;
   aac_bitwriter_init(&w, o, 7);
@@ -208,6 +261,110 @@ int aac_adts_write(const AacAdtsHeader* h, uint8_t* o) {
   return aac_bitwriter_bytes_written(&w);
 }
 
+int aac_loas_check(const uint8_t* d) {
+  if (d[0] != 0x56 || (d[1] & 0xE0) != 0xE0) {
+    return 0;
+  }
+  const int length = ((d[1] & 0x1F) << 8) | d[2];
+  return length > 0 ? AAC_LOAS_HEADER_SIZE + length : 0;
+}
+
+/* ── AudioSpecificConfig ─────────────────────────────────────────── */
+
+/* The GA-coded object types this codec reads and writes */
+static bool audio_config_core(int aot) { return aot == AAC_AOT_LC || aot == AAC_AOT_LD; }
+
+int aac_audio_config_put(const AacAudioConfig* cfg, AacBitWriter* w) {
+  const bool sbr = cfg->object_type == AAC_AOT_SBR || cfg->object_type == AAC_AOT_PS;
+  const bool ld = cfg->object_type == AAC_AOT_LD;
+  if (!sbr && !audio_config_core(cfg->object_type)) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  const int short_length = ld ? AAC_FRAME_SIZE_LD_480 : 960; /* frameLengthFlag = 1 */
+  aac_bitwriter_write(w, cfg->object_type, 5);
+  aac_bitwriter_write(w, cfg->sample_rate_index, 4);
+  aac_bitwriter_write(w, cfg->channel_config, 4);
+  if (sbr) {
+    aac_bitwriter_write(w, cfg->ext_rate_index, 4);
+    aac_bitwriter_write(w, AAC_AOT_LC, 5);
+  }
+  /* GASpecificConfig */
+  aac_bitwriter_write(w, cfg->frame_length == short_length, 1);
+  aac_bitwriter_write(w, 0, 1);  /* dependsOnCoreCoder */
+  aac_bitwriter_write(w, ld, 1); /* extensionFlag */
+  if (ld) {
+    aac_bitwriter_write(w, 0, 3); /* section, scalefactor, spectral resilience off */
+    aac_bitwriter_write(w, 0, 1); /* extensionFlag3 */
+    aac_bitwriter_write(w, 0, 2); /* epConfig */
+  }
+  return AAC_OK;
+}
+
+int aac_audio_config_write(const AacAudioConfig* cfg, uint8_t* out, int size) {
+  if (size < 4) {
+    return AAC_ERR_OVERFLOW;
+  }
+  AacBitWriter w;
+  aac_bitwriter_init(&w, out, size);
+  int ret = aac_audio_config_put(cfg, &w);
+  if (ret != AAC_OK) {
+    return ret;
+  }
+  aac_bitwriter_byte_align(&w);
+  return aac_bitwriter_bytes_written(&w);
+}
+
+int aac_audio_config_read(AacAudioConfig* cfg, AacBitReader* r) {
+  cfg->object_type = aac_bitreader_read(r, 5);
+  if (cfg->object_type == 31) {
+    cfg->object_type = 32 + aac_bitreader_read(r, 6);
+  }
+  cfg->sample_rate_index = aac_bitreader_read(r, 4);
+  if (cfg->sample_rate_index == 15) {
+    return AAC_ERR_UNSUPPORTED; /* an explicit rate has no band tables */
+  }
+  cfg->channel_config = aac_bitreader_read(r, 4);
+  cfg->ext_rate_index = cfg->sample_rate_index;
+  int core = cfg->object_type;
+  if (core == AAC_AOT_SBR || core == AAC_AOT_PS) {
+    cfg->ext_rate_index = aac_bitreader_read(r, 4);
+    core = aac_bitreader_read(r, 5);
+  }
+  if (!audio_config_core(core) || cfg->ext_rate_index == 15) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  const bool ld = core == AAC_AOT_LD;
+  const int frame_length_flag = aac_bitreader_read(r, 1);
+  cfg->frame_length = ld ? (frame_length_flag ? AAC_FRAME_SIZE_LD_480 : AAC_FRAME_SIZE_LD)
+                         : (frame_length_flag ? 960 : AAC_FRAME_SIZE_LONG);
+  if (aac_bitreader_read(r, 1)) {
+    aac_bitreader_skip(r, 14); /* coreCoderDelay */
+  }
+  const int extension_flag = aac_bitreader_read(r, 1);
+  if (ld) {
+    /* Resilience tools and error protection change the ER syntax */
+    if (!extension_flag || aac_bitreader_read(r, 3) != 0) {
+      return AAC_ERR_UNSUPPORTED;
+    }
+    aac_bitreader_skip(r, 1); /* extensionFlag3 */
+    if (aac_bitreader_read(r, 2) != 0) {
+      return AAC_ERR_UNSUPPORTED;
+    }
+  } else if (extension_flag) {
+    aac_bitreader_skip(r, 1); /* extensionFlag3 */
+  }
+  return aac_bitreader_bits_left(r) >= 0 ? AAC_OK : AAC_ERR_DECODE;
+}
+
+int aac_audio_config_parse(AacAudioConfig* cfg, const uint8_t* data, int size) {
+  if (size < 2) {
+    return AAC_ERR_DECODE;
+  }
+  AacBitReader r;
+  aac_bitreader_init(&r, data, size);
+  return aac_audio_config_read(cfg, &r);
+}
+
 /* ── Scalar vector operation defaults ─────────────────────────────── */
 
 static void aac_vector_fmul_c(float* dst, const float* a, const float* b, int len) {
@@ -237,6 +394,145 @@ static void aac_vector_fmul_accumulate_c(float* dst, const float* a, const float
 }
 }
 
+static int aac_vector_is_zero_c(const float* a, int len) {
+  for (int i = 0; i < len; i++) {
+    if (a[i] != 0.0f) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void aac_tns_fir_c(float* dst, const float* src, int len, const float* lpc, int order) {
+  aac_tns_fir_head(dst, src, len, lpc, order);
+}
+
+static void aac_tns_iir_c(float* x, int len, const float* lpc, int order) {
+  aac_tns_iir_head(x, len, lpc, order);
+}
+
+static void aac_psycho_spreading_c(float* spread, const float* energy, const float* kernel,
+                                   int radius, int n_sfb) {
+  int taps = 2 * radius + 1;
+  for (int b = 0; b < n_sfb; b++) {
+    const float* e = energy + b - radius;
+    float sp = 0.0f;
+    for (int t = 0; t < taps; t++) { sp += kernel[t] * e[t];
+}
+    spread[b] = sp;
+  }
+}
+
+static void aac_sbr_qmf_analysis_c(float* out, const float* in, const float* win, int bands) {
+  int m2 = 2 * bands;
+  for (int i = 0; i < m2; i++) {
+    float acc = 0.0f;
+    for (int l = 0; l < 5; l++) {
+      acc += win[i + m2 * l] * in[i + m2 * l];
+    }
+    out[i] = acc;
+  }
+}
+
+static void aac_sbr_qmf_synthesis_c(float* out, const float* v, const float* win, int bands) {
+  for (int r = 0; r < bands; r++) {
+    float acc = 0.0f;
+    for (int q = 0; q < 10; q++) {
+      acc += win[bands * q + r] * v[2 * bands * q + bands * (q & 1) + r];
+    }
+    out[r] = acc;
+  }
+}
+
+static void aac_sbr_hf_gen_c(float* hi_re, float* hi_im, const float* lo_re, const float* lo_im,
+                             const float* a0_re, const float* a0_im, const float* a1_re,
+                             const float* a1_im, int n, int slots) {
+  const int S = AAC_SBR_QMF_BANDS;
+  for (int m = 0; m < slots; m++) {
+    const float* x0r = lo_re + m * S;
+    const float* x0i = lo_im + m * S;
+    const float* x1r = x0r - S;
+    const float* x1i = x0i - S;
+    const float* x2r = x1r - S;
+    const float* x2i = x1i - S;
+    for (int k = 0; k < n; k++) {
+      hi_re[m * S + k] = x0r[k] + a0_re[k] * x1r[k] - a0_im[k] * x1i[k] + a1_re[k] * x2r[k] -
+                         a1_im[k] * x2i[k];
+      hi_im[m * S + k] = x0i[k] + a0_re[k] * x1i[k] + a0_im[k] * x1r[k] + a1_re[k] * x2i[k] +
+                         a1_im[k] * x2r[k];
+    }
+  }
+}
+
+static void aac_sbr_hf_apply_c(float* y_re, float* y_im, const float* gain,
+                               const float* noise_gain, const float* noise_re,
+                               const float* noise_im, int n) {
+  for (int k = 0; k < n; k++) {
+    y_re[k] = gain[k] * y_re[k] + noise_gain[k] * noise_re[k];
+    y_im[k] = gain[k] * y_im[k] + noise_gain[k] * noise_im[k];
+  }
+}
+
+static void aac_ps_mix_c(float* l_re, float* l_im, float* r_re, float* r_im, float* h,
+                         const float* h_step, int n) {
+  for (int k = 0; k < n; k++) {
+    float h11 = h[k] += h_step[k];
+    float h12 = h[n + k] += h_step[n + k];
+    float h21 = h[2 * n + k] += h_step[2 * n + k];
+    float h22 = h[3 * n + k] += h_step[3 * n + k];
+    float s_re = l_re[k], s_im = l_im[k], d_re = r_re[k], d_im = r_im[k];
+    l_re[k] = h11 * s_re + h21 * d_re;
+    l_im[k] = h11 * s_im + h21 * d_im;
+    r_re[k] = h12 * s_re + h22 * d_re;
+    r_im[k] = h12 * s_im + h22 * d_im;
+  }
+}
+
+static void aac_ps_correlate_c(float* el, float* er, float* cr, const float* l_re,
+                               const float* l_im, const float* r_re, const float* r_im, int n) {
+  for (int k = 0; k < n; k++) {
+    el[k] += l_re[k] * l_re[k] + l_im[k] * l_im[k];
+    er[k] += r_re[k] * r_re[k] + r_im[k] * r_im[k];
+    cr[k] += l_re[k] * r_re[k] + l_im[k] * r_im[k];
+  }
+}
+
+static void aac_interleave2_c(float* dst, const float* l, const float* r, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[2 * i] = l[i];
+    dst[2 * i + 1] = r[i];
+  }
+}
+
+/* NaN clamps to the negative limit, as the SIMD min/max sequences do */
+static void aac_float_to_s16_c(int16_t* dst, const float* src, const float* dither, int n) {
+  for (int i = 0; i < n; i++) {
+    float v = src[i] * 32768.0f + (dither ? dither[i] : 0.0f);
+    dst[i] = (int16_t)lrintf(fminf(fmaxf(v, -32768.0f), 32767.0f));
+  }
+}
+
+static void aac_float_to_s24_c(int32_t* dst, const float* src, const float* dither, int n) {
+  for (int i = 0; i < n; i++) {
+    float v = src[i] * 8388608.0f + (dither ? dither[i] : 0.0f);
+    dst[i] = (int32_t)lrintf(fminf(fmaxf(v, -8388608.0f), 8388607.0f));
+  }
+}
+
+static int aac_adts_sync_c(const uint8_t* data, int size) {
+  for (int i = 0; i < size - 1; i++) {
+    const auto* p = static_cast<const uint8_t*>(memchr(data + i, 0xFF, size - 1 - i));
+    if (!p) {
+      break;
+    }
+    i = (int)(p - data);
+    if ((p[1] & 0xF6) == 0xF0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 /* ── DSP Init: wire all scalar defaults + platform overrides ────── */
 
 void aac_dsp_init(AacDSP* dsp) {
@@ -250,24 +546,22 @@ void aac_dsp_init(AacDSP* dsp) {
   dsp->vector_fmul_window = aac_vector_fmul_window_c;
   dsp->vector_fmul_reverse = aac_vector_fmul_reverse_c;
   dsp->vector_fmul_accumulate = aac_vector_fmul_accumulate_c;
+  dsp->vector_is_zero = aac_vector_is_zero_c;
   dsp->huffman_decode = nullptr;
-  dsp->sbr_qmf_analysis = nullptr;
-  dsp->sbr_qmf_synthesis = nullptr;
-
-  /* Default scalar psycho spreading (matrix-vector) */
-  dsp->psycho_spreading = [](float* spread, const float* energy, const float* /*threshold*/,
-                             int n_sfb) {
-    /* Note: threshold param currently unused in this default; real spreading only */
-    for (int b = 0; b < n_sfb; b++) {
-      float sp = 0.0f;
-      for (int j = 0; j < n_sfb; j++) {
-        sp += energy[j] * /* spreading would come from caller context, but for DSP we assume simple
-                             identity or external */
-              0.0f;       /* placeholder - real impl needs spreading matrix */
-      }
-      spread[b] = sp;
-    }
-  };
+  dsp->sbr_qmf_analysis = aac_sbr_qmf_analysis_c;
+  dsp->sbr_qmf_synthesis = aac_sbr_qmf_synthesis_c;
+  dsp->sbr_hf_gen = aac_sbr_hf_gen_c;
+  dsp->sbr_hf_apply = aac_sbr_hf_apply_c;
+  dsp->ps_mix = aac_ps_mix_c;
+  dsp->ps_correlate = aac_ps_correlate_c;
+
+  dsp->tns_fir = aac_tns_fir_c;
+  dsp->tns_iir = aac_tns_iir_c;
+  dsp->psycho_spreading = aac_psycho_spreading_c;
+  dsp->interleave2 = aac_interleave2_c;
+  dsp->float_to_s16 = aac_float_to_s16_c;
+  dsp->float_to_s24 = aac_float_to_s24_c;
+  dsp->adts_sync = aac_adts_sync_c;
 
   int flags = aac_get_cpu_flags();
 #if defined(BAAC_AAC_SSE2)
@@ -1,14 +1,24 @@
 #include "decoder.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
+static void init_channel(AacDecoderState* s, int c) {
+  aac_mdct_init(&s->ch[c].mdct_ctx, s->frame_length, s->dsp);
+  s->ch[c].win_seq = AAC_WIN_ONLY_LONG;
+  s->ch[c].win_shape = AAC_WIN_SINE;
+  /* Distinct noise per channel, reproducible across decoder instances */
+  s->ch[c].pns_seed = 0x1F2E3D4Cu + (uint32_t)c * 0x9E3779B9u;
+}
+
 AacDecoderState* aac_decoder_state_create(int sr, int ch, const AacDSP* dsp) {
   auto* s = new AacDecoderState();
   s->sample_rate = sr;
   s->channels = ch;
-  s->frame_size = 1024;
+  s->frame_size = s->frame_length = AAC_FRAME_SIZE_LONG;
   s->dsp = dsp;
+  s->dither_seed = 0x2545F491u;
   s->rate_index = 3; /* default 48000 */
   for (int i = 0; i < AAC_NUM_SAMPLE_RATES; i++) {
     if (aac_sample_rates[i] == sr) {
@@ -16,10 +26,13 @@ AacDecoderState* aac_decoder_state_create(int sr, int ch, const AacDSP* dsp) {
       break;
     }
   }
-  for (int c = 0; c < 2; c++) {
-    aac_mdct_init(&s->ch[c].mdct_ctx, 1024, dsp);
-    s->ch[c].win_seq = AAC_WIN_ONLY_LONG;
-    s->ch[c].win_shape = AAC_WIN_SINE;
+  s->ch = new AacDecoderChannel[ch]();
+  s->ch_count = ch;
+  for (int c = 0; c < ch; c++) {
+    init_channel(s, c);
+  }
+  for (auto& el : s->elem) {
+    el.type = -1;
   }
   return s;
 }
@@ -28,21 +41,78 @@ void aac_decoder_state_destroy(AacDecoderState* s) {
   if (!s) {
     return;
   }
-  for (int c = 0; c < 2; c++) {
+  for (int c = 0; c < s->ch_count; c++) {
     aac_mdct_free(&s->ch[c].mdct_ctx);
   }
+  if (s->ch_count > s->channels) {
+    aac_mdct_free(&s->dmx_mdct[0]);
+    aac_mdct_free(&s->dmx_mdct[1]);
+  }
+  for (auto& el : s->elem) {
+    aac_sbr_decoder_destroy(el.sbr);
+  }
+  aac_thread_pool_destroy(s->pool);
+  delete[] s->ch;
   delete s;
 }
 
+int aac_decoder_state_set_downmix(AacDecoderState* s, int mode) {
+  if (s->channels != 2) {
+    return mode == AAC_DOWNMIX_OFF ? AAC_OK : AAC_ERR_UNSUPPORTED;
+  }
+  if (mode != AAC_DOWNMIX_OFF && s->ch_count < AAC_MAX_CHANNELS) {
+    auto* ch = new AacDecoderChannel[AAC_MAX_CHANNELS]();
+    std::copy(s->ch, s->ch + s->ch_count, ch); /* keeps the stereo pair's state */
+    delete[] s->ch;
+    s->ch = ch;
+    for (int c = s->ch_count; c < AAC_MAX_CHANNELS; c++) {
+      init_channel(s, c);
+    }
+    s->ch_count = AAC_MAX_CHANNELS;
+    aac_mdct_init(&s->dmx_mdct[0], s->frame_length, s->dsp);
+    aac_mdct_init(&s->dmx_mdct[1], s->frame_length, s->dsp);
+    s->dmx_canonical = 1;
+  }
+  s->downmix = mode;
+  return AAC_OK;
+}
+
+int aac_decoder_state_set_config(AacDecoderState* s, const AacAudioConfig* cfg) {
+  const int ri = cfg->sample_rate_index;
+  if (ri >= AAC_NUM_SAMPLE_RATES || aac_num_sfb(ri, cfg->frame_length) == 0 ||
+      cfg->channel_config > 7) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  /* AAC-LD has no SBR here: the core runs at the output rate */
+  if (cfg->object_type == AAC_AOT_LD &&
+      (aac_sample_rates[ri] != s->sample_rate || cfg->channel_config == 0)) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  s->aot = cfg->object_type;
+  s->rate_index = ri;
+  s->channel_config = cfg->channel_config;
+  if (cfg->frame_length != s->frame_length) {
+    s->frame_length = s->frame_size = cfg->frame_length;
+    for (int c = 0; c < s->ch_count; c++) {
+      aac_mdct_free(&s->ch[c].mdct_ctx);
+      init_channel(s, c);
+    }
+    for (int o = 0; o < 2 && s->ch_count > s->channels; o++) {
+      aac_mdct_free(&s->dmx_mdct[o]);
+      aac_mdct_init(&s->dmx_mdct[o], s->frame_length, s->dsp);
+    }
+    s->dmx_canonical = 1;
+  }
+  return AAC_OK;
+}
+
 static int parse_ics(AacDecoderState* s, AacBitReader* r, int ch) {
   int global_gain = aac_bitreader_read(r, 8) - 100; /* subtract offset */
   int ws = aac_bitreader_read(r, 2);
   s->ch[ch].win_seq = (AacWindowSequence)ws;
   s->ch[ch].win_shape = (AacWindowShape)aac_bitreader_read(r, 1);
   int is_short = (ws == AAC_WIN_EIGHT_SHORT);
-  int max_sfb =
-      aac_bitreader_read(r, is_short ? 4 : 6);  // NOLINT(clang-analyzer-deadcode.DeadStores)
-  (void)max_sfb;
+  s->ch[ch].max_sfb = aac_bitreader_read(r, is_short ? 4 : 6);
   if (is_short) {
     aac_bitreader_read(r, 7); /* scale_factor_grouping */
   } else {
@@ -61,9 +131,14 @@ static int parse_ics(AacDecoderState* s, AacBitReader* r, int ch) {
 static int decode_spectral(AacDecoderState* s, AacBitReader* r, int ch, int gg) {
   AacDecoderChannel* dc = &s->ch[ch];
   int ri = s->rate_index;
+  const int n = s->frame_length;
   float* spec = dc->spectral;
-  memset(spec, 0, 1024 * sizeof(float));
+  memset(spec, 0, n * sizeof(float));
 
+  /* AAC-LD has no block switching */
+  if (n != AAC_FRAME_SIZE_LONG && dc->win_seq != AAC_WIN_ONLY_LONG) {
+    return AAC_ERR_DECODE;
+  }
   int is_short = (dc->win_seq == AAC_WIN_EIGHT_SHORT);
   int nsfb = 0;
   const int* sfb = nullptr;
@@ -72,18 +147,35 @@ static int decode_spectral(AacDecoderState* s, AacBitReader* r, int ch, int gg)
     nsfb = aac_num_sfb_short[ri];
     sfb = aac_sfb_offset_short[ri];
   } else {
-    nsfb = aac_num_sfb_long[ri];
-    sfb = aac_sfb_offset_long[ri];
+    nsfb = aac_num_sfb(ri, n);
+    sfb = aac_sfb_offsets(ri, n);
+  }
+
+  /* Bands from max_sfb up are not transmitted (encoder lowpass) */
+  int coded = dc->max_sfb < nsfb ? dc->max_sfb : nsfb;
+  for (int sfb_idx = coded; sfb_idx < nsfb; sfb_idx++) {
+    dc->sfb_cb[sfb_idx] = 0;
   }
 
+  dc->zero_spectrum = 1;
   int prev_sf = gg; /* first scalefactor = global_gain */
-  for (int sfb_idx = 0; sfb_idx < nsfb; sfb_idx++) {
-    if (aac_bitreader_bits_left(r) < 13) {
+  int prev_nrg = gg + 100 - AAC_PNS_ENERGY_OFFSET;
+  for (int sfb_idx = 0; sfb_idx < coded; sfb_idx++) {
+    /* A zero band is only its 4-bit codebook */
+    if (aac_bitreader_bits_left(r) < 4) {
       return AAC_ERR_DECODE;
     }
     int cb = aac_bitreader_read(r, 4);
     dc->sfb_cb[sfb_idx] = cb;
-    if (cb == 0 || cb >= 13) {
+    if (cb != 0) {
+      dc->zero_spectrum = 0;
+    }
+    if (cb == AAC_PNS_CODEBOOK) {
+      prev_nrg += aac_bitreader_read_signed(r, 9);
+      dc->scalefactors[sfb_idx] = prev_nrg;
+      continue;
+    }
+    if (cb == 0 || cb > AAC_PNS_CODEBOOK) {
       continue;
     }
 
@@ -92,7 +184,7 @@ static int decode_spectral(AacDecoderState* s, AacBitReader* r, int ch, int gg)
     dc->scalefactors[sfb_idx] = prev_sf;
 
     int start = sfb[sfb_idx], end = sfb[sfb_idx + 1];
-    for (int bin = start; bin < end && bin < 1024; bin += 2) {
+    for (int bin = start; bin < end && bin < n; bin += 2) {
       if (bin < 0) {
         continue;
       }
@@ -100,10 +192,10 @@ static int decode_spectral(AacDecoderState* s, AacBitReader* r, int ch, int gg)
       if (aac_bitreader_read_huffman(r, cb, &x, &y) != 0) {
         return AAC_ERR_DECODE;
       }
-      if (bin < 1024) {
+      if (bin < n) {
         spec[bin] = (float)x;
       }
-      if (bin + 1 < 1024) {
+      if (bin + 1 < n) {
         spec[bin + 1] = (float)y;
       }
     }
@@ -111,58 +203,428 @@ static int decode_spectral(AacDecoderState* s, AacBitReader* r, int ch, int gg)
   return 0;
 }
 
-void aac_dequantize(AacDecoderChannel* ch, int ri, int /*fs*/) {
+void aac_dequantize(AacDecoderChannel* ch, int ri, int frame_length, uint32_t* pns_seed) {
   float* spec = ch->spectral;
-  int nsfb = aac_num_sfb_long[ri];
+  int nsfb = aac_num_sfb(ri, frame_length);
+  const int* offsets = aac_sfb_offsets(ri, frame_length);
   for (int sfb = 0; sfb < nsfb; sfb++) {
     int cb = ch->sfb_cb[sfb];
-    if (cb == 0 || cb >= 13) {
+    if (cb == AAC_PNS_CODEBOOK) {
+      float energy = powf(2.0f, 0.5f * (float)ch->scalefactors[sfb]);
+      aac_pns_replace(spec, sfb, offsets, energy, pns_seed);
+      continue;
+    }
+    if (cb == 0 || cb > AAC_PNS_CODEBOOK) {
       continue;
     }
-    float sf_scale_inv = powf(2.0f, -0.25f * ch->scalefactors[sfb]);
-    int s = aac_sfb_offset_long[ri][sfb];
-    int e = aac_sfb_offset_long[ri][sfb + 1];
+    float sf_scale = powf(2.0f, 0.25f * ch->scalefactors[sfb]);
+    int s = offsets[sfb];
+    int e = offsets[sfb + 1];
     for (int i = s; i < e; i++) {
-      /* Dequantize: dq = sign(iq) * |iq * 2^(-sf/4)|^(4/3)
-       * Matches encoder: q = spec^(3/4) * 2^(sf/4), so inverse is dq = (q * 2^(-sf/4))^(4/3) */
+      /* Dequantize as ISO 14496-3: dq = sign(iq) * |iq|^(4/3) * 2^(sf/4),
+       * sf being the scalefactor less 100; one step is 1.5 dB */
       float iq = spec[i];
-      spec[i] = copysignf(powf(fabsf(iq * sf_scale_inv), 4.0f / 3.0f), iq);
+      spec[i] = copysignf(powf(fabsf(iq), 4.0f / 3.0f) * sf_scale, iq);
     }
   }
 }
 
-void aac_apply_tns(AacDecoderChannel* ch, int ri, int /*fs*/) {
+void aac_apply_tns(AacDecoderChannel* ch, int ri, int frame_length, const AacDSP* dsp) {
   if (!ch->tns_present) {
     return;
   }
-  int end = aac_sfb_offset_long[ri][aac_tns_max_bands_long[ri]];
-  for (int i = 0; i < end; i++) {
-    for (int k = 0; k < ch->tns_ncoef[0] && k < 20; k++) {
-      if (i - k - 1 >= 0) {
-        ch->spectral[i] += ch->tns_lpc[0][k] * ch->spectral[i - k - 1];
-      }
-    }
-  }
+  aac_tns_decode(&ch->tns, ch->spectral, ch->max_sfb, ri, frame_length, ch->win_seq, dsp);
 }
 
 int aac_decode_sce(AacDecoderState* s, AacBitReader* r, int ch) {
   int gg = parse_ics(s, r, ch);
-  decode_spectral(s, r, ch, gg);
-  aac_dequantize(&s->ch[ch], s->rate_index, 1024);
-  aac_apply_tns(&s->ch[ch], s->rate_index, 1024);
-  aac_imdct(&s->ch[ch].mdct_ctx, s->ch[ch].output, s->ch[ch].spectral, 1024, s->ch[ch].win_seq,
-            s->ch[ch].win_shape, ch);
-  return 0;
+  AacDecoderChannel* dc = &s->ch[ch];
+  dc->tns_present = (int)aac_bitreader_read(r, 1);
+  if (dc->tns_present && aac_tns_read(r, &dc->tns, dc->win_seq) != AAC_OK) {
+    return AAC_ERR_DECODE;
+  }
+  return decode_spectral(s, r, ch, gg);
 }
 
-int aac_decode_cpe(AacDecoderState* s, AacBitReader* r) {
-  int ms_mask_present = aac_bitreader_read(r, 2);
-  (void)ms_mask_present;
-  for (int ch = 0; ch < 2; ch++) {
-    int e = aac_decode_sce(s, r, ch);
+int aac_decode_cpe(AacDecoderState* s, AacBitReader* r, int ch) {
+  aac_bitreader_read(r, 4); /* element_instance_tag */
+  /* Each channel carries its own ICS header; the encoder never signals a
+   * common window, so there is no shared ics_info or ms_mask here */
+  if (aac_bitreader_read(r, 1)) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  for (int c = ch; c < ch + 2; c++) {
+    int e = aac_decode_sce(s, r, c);
     if (e) {
       return e;
     }
   }
   return 0;
 }
+
+/* ── Frame ────────────────────────────────────────────────────── */
+
+static void reconstruct_channel(AacDecoderState* s, int ch) {
+  AacDecoderChannel* dc = &s->ch[ch];
+  const int n = s->frame_length;
+  /* Every band cb=0 and nothing left in either overlap: the IMDCT would
+   * produce exact zeros, so write them directly and only record the window
+   * the IMDCT would have seen */
+  AacMdctContext* m = &dc->mdct_ctx;
+  bool silent = dc->zero_spectrum && dc->win_seq == AAC_WIN_ONLY_LONG &&
+                s->dsp->vector_is_zero(m->overlap_save_long, n);
+  for (int w = 0; w < 8 && silent; w++) {
+    silent = s->dsp->vector_is_zero(m->overlap_short[w], m->frame_size_short);
+  }
+  if (silent) {
+    memset(dc->output, 0, n * sizeof(float));
+    m->prev_win_seq = dc->win_seq;
+    m->prev_win_shape = dc->win_shape;
+    return;
+  }
+  aac_dequantize(dc, s->rate_index, n, &dc->pns_seed);
+  aac_apply_tns(dc, s->rate_index, n, s->dsp);
+  aac_imdct(&dc->mdct_ctx, dc->output, dc->spectral, n, dc->win_seq, dc->win_shape, ch);
+}
+
+/* HE-AAC v2: a mono stream's element with PS data becomes the stereo pair */
+static bool element_has_ps(const AacDecoderState* s, const AacDecoderElement* el) {
+  return s->frame_size == 2048 && s->n_elems == 1 && el->nch == 1 && s->channels == 2 &&
+         aac_sbr_has_ps(el->sbr);
+}
+
+/* Pool task: everything after parsing touches only the element's own
+ * channels and SBR state, so elements run independently */
+static void reconstruct_element(void* ctx, int e) {
+  auto* s = static_cast<AacDecoderState*>(ctx);
+  AacDecoderElement* el = &s->elem[e];
+  for (int c = el->ch0; c < el->ch0 + el->nch; c++) {
+    reconstruct_channel(s, c);
+  }
+  if (s->frame_size != 2048) {
+    return;
+  }
+  if (element_has_ps(s, el)) {
+    float* l = s->ch[el->ch0].output;
+    aac_sbr_decode_ps(el->sbr, l, l, s->ch[el->ch0 + 1].output);
+    s->ch[el->ch0].has_ps = 1;
+    return;
+  }
+  for (int c = 0; c < el->nch; c++) {
+    float* out = s->ch[el->ch0 + c].output;
+    aac_sbr_decode_channel(el->sbr, c, out, out);
+  }
+}
+
+/* ── Stereo downmix ───────────────────────────────────────────── */
+
+/* ITU-R BS.775 gains {left, right} for the frame's channels. Front pair at
+ * unity, centre and side pairs at -3 dB, a rear centre at -6 dB into both
+ * sides, LFE dropped; each side is then scaled so full-scale input cannot
+ * clip. False when the elements are not a standard layout. */
+static bool downmix_gains(const AacDecoderState* s, int n_ch, float g[][2]) {
+  const int config = aac_channel_config_index(n_ch);
+  const AacChannelConfig* layout = &aac_channel_config[config];
+  if (config < 3 || layout->num_elements != s->n_elems) {
+    return false;
+  }
+  const float kMinus3dB = 0.70710678f;
+  int pairs = 0;
+  for (int e = 0; e < s->n_elems; e++) {
+    const AacDecoderElement* el = &s->elem[e];
+    if (el->type != layout->elements[e]) {
+      return false;
+    }
+    float* l = g[el->ch0];
+    if (el->type == AAC_ELEM_CPE) {
+      const float w = pairs++ == 0 ? 1.0f : kMinus3dB;
+      l[0] = w, l[1] = 0.0f;
+      g[el->ch0 + 1][0] = 0.0f, g[el->ch0 + 1][1] = w;
+    } else if (el->type == AAC_ELEM_LFE) {
+      l[0] = l[1] = 0.0f;
+    } else {
+      l[0] = l[1] = e == 0 ? kMinus3dB : 0.5f;
+    }
+  }
+  float sum = 0.0f;
+  for (int c = 0; c < n_ch; c++) {
+    sum += g[c][0];
+  }
+  for (int c = 0; c < n_ch; c++) {
+    g[c][0] /= sum;
+    g[c][1] /= sum;
+  }
+  return true;
+}
+
+/* Pool task for the MDCT-domain paths: dequantisation and TNS only */
+static void dequantize_element(void* ctx, int e) {
+  auto* s = static_cast<AacDecoderState*>(ctx);
+  const AacDecoderElement* el = &s->elem[e];
+  if (el->type == AAC_ELEM_LFE) {
+    return;
+  }
+  for (int c = el->ch0; c < el->ch0 + el->nch; c++) {
+    AacDecoderChannel* dc = &s->ch[c];
+    aac_dequantize(dc, s->rate_index, s->frame_length, &dc->pns_seed);
+    aac_apply_tns(dc, s->rate_index, s->frame_length, s->dsp);
+  }
+}
+
+/* dst += gain * src */
+static void mix_into(float* dst, const float* src, float gain, int n) {
+  for (int i = 0; i < n; i++) {
+    dst[i] += gain * src[i];
+  }
+}
+
+/* Mix the spectra and run one IMDCT per output side. Linear, so this equals
+ * the time-domain mix whenever every channel uses the same windows. */
+static void downmix_mdct(AacDecoderState* s, const float g[][2], int n_ch, int lead) {
+  const AacDecoderChannel* ref = &s->ch[lead];
+  const int n = s->frame_length;
+  for (int o = 0; o < 2; o++) {
+    float* spec = s->dmx_spec[o];
+    memset(spec, 0, n * sizeof(float));
+    for (int c = 0; c < n_ch; c++) {
+      if (g[c][o] != 0.0f) {
+        mix_into(spec, s->ch[c].spectral, g[c][o], n);
+      }
+    }
+    aac_imdct(&s->dmx_mdct[o], s->dmx_out[o], spec, n, ref->win_seq, ref->win_shape, o);
+  }
+  s->dmx_canonical = 0;
+}
+
+/* Per-channel IMDCTs from a zero overlap give each channel's contribution to
+ * this frame and to the next; mixing both keeps dmx_mdct's overlap in step.
+ * The overlap must first be canonical: only the long or the short part that
+ * the next window sequence reads may be non-zero, since the channels of a
+ * mixed frame read different parts. */
+static void downmix_time(AacDecoderState* s, const float g[][2], int n_ch) {
+  const int n = s->frame_length;
+  for (int o = 0; o < 2; o++) {
+    AacMdctContext* m = &s->dmx_mdct[o];
+    const int ns = m->frame_size_short;
+    if (!s->dmx_canonical) {
+      const bool long_next =
+          m->prev_win_seq == AAC_WIN_ONLY_LONG || m->prev_win_seq == AAC_WIN_LONG_STOP;
+      for (int w = 0; w < 8 && long_next; w++) {
+        memset(m->overlap_short[w], 0, ns * sizeof(float));
+      }
+      if (!long_next) {
+        memset(m->overlap_save_long, 0, n * sizeof(float));
+      }
+    }
+    for (int i = 0; i < n; i++) {
+      s->dmx_out[o][i] = m->overlap_save_long[i] + m->overlap_short[i / ns][i % ns];
+    }
+    memset(m->overlap_save_long, 0, n * sizeof(float));
+    for (int w = 0; w < 8; w++) {
+      memset(m->overlap_short[w], 0, ns * sizeof(float));
+    }
+  }
+  for (int c = 0; c < n_ch; c++) {
+    if (g[c][0] == 0.0f && g[c][1] == 0.0f) {
+      continue;
+    }
+    AacDecoderChannel* dc = &s->ch[c];
+    AacMdctContext* m = &dc->mdct_ctx;
+    const int ns = m->frame_size_short;
+    memset(m->overlap_save_long, 0, n * sizeof(float));
+    for (int w = 0; w < 8; w++) {
+      memset(m->overlap_short[w], 0, ns * sizeof(float));
+    }
+    aac_imdct(m, dc->output, dc->spectral, n, dc->win_seq, dc->win_shape, c);
+    for (int o = 0; o < 2; o++) {
+      if (g[c][o] == 0.0f) {
+        continue;
+      }
+      AacMdctContext* d = &s->dmx_mdct[o];
+      mix_into(s->dmx_out[o], dc->output, g[c][o], n);
+      mix_into(d->overlap_save_long, m->overlap_save_long, g[c][o], n);
+      for (int w = 0; w < 8; w++) {
+        mix_into(d->overlap_short[w], m->overlap_short[w], g[c][o], ns);
+      }
+    }
+  }
+  s->dmx_canonical = 1;
+}
+
+/* A frame with more channels than the stereo decoder outputs, which
+ * aac_decode_frame only parses with downmix enabled */
+static int downmix_frame(AacDecoderState* s, int n_ch) {
+  float g[AAC_MAX_CHANNELS][2];
+  if (!downmix_gains(s, n_ch, g)) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  const int n = s->frame_size;
+  if (n == 2048) {
+    /* SBR envelopes are per channel: reconstruct everything, then mix */
+    aac_thread_pool_run(s->pool, reconstruct_element, s, s->n_elems);
+    for (int o = 0; o < 2; o++) {
+      memset(s->dmx_out[o], 0, n * sizeof(float));
+      for (int c = 0; c < n_ch; c++) {
+        if (g[c][o] != 0.0f) {
+          mix_into(s->dmx_out[o], s->ch[c].output, g[c][o], n);
+        }
+      }
+    }
+    s->downmix_path = AAC_DOWNMIX_PATH_TIME;
+  } else {
+    aac_thread_pool_run(s->pool, dequantize_element, s, s->n_elems);
+    /* The LFE never reaches the mix, so its windows do not count */
+    int lead = -1;
+    bool match = s->downmix == AAC_DOWNMIX_AUTO;
+    for (int c = 0; c < n_ch && match; c++) {
+      if (g[c][0] == 0.0f && g[c][1] == 0.0f) {
+        continue;
+      }
+      if (lead < 0) {
+        lead = c;
+      }
+      match = s->ch[c].win_seq == s->ch[lead].win_seq &&
+              s->ch[c].win_shape == s->ch[lead].win_shape;
+    }
+    if (match) {
+      downmix_mdct(s, g, n_ch, lead);
+    } else {
+      downmix_time(s, g, n_ch);
+    }
+    s->downmix_path = match ? AAC_DOWNMIX_PATH_MDCT : AAC_DOWNMIX_PATH_TIME;
+  }
+  memcpy(s->ch[0].output, s->dmx_out[0], n * sizeof(float));
+  memcpy(s->ch[1].output, s->dmx_out[1], n * sizeof(float));
+  return 2;
+}
+
+/* Parse channel element n_elems of the frame (its id already read) into
+ * channels from n_ch on, and record it in s->elem */
+static int decode_element(AacDecoderState* s, AacBitReader* r, int elem_type, int n_elems,
+                          int n_ch, bool sbr) {
+  int nch = elem_type == AAC_ELEM_CPE ? 2 : 1;
+  /* More channels than the decoder was created for, or can downmix */
+  if (n_ch + nch > (s->downmix ? s->ch_count : s->channels)) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  int ret = 0;
+  if (elem_type == AAC_ELEM_CPE) {
+    ret = aac_decode_cpe(s, r, n_ch);
+  } else {
+    aac_bitreader_read(r, 4); /* element_instance_tag */
+    ret = aac_decode_sce(s, r, n_ch);
+  }
+  if (ret) {
+    return ret;
+  }
+  /* A changed layout starts the element's SBR state afresh */
+  AacDecoderElement* el = &s->elem[n_elems];
+  if (el->type != elem_type || el->ch0 != n_ch) {
+    aac_sbr_decoder_destroy(el->sbr);
+    el->sbr = nullptr;
+    el->type = elem_type;
+    el->ch0 = n_ch;
+    el->nch = nch;
+  }
+  if (sbr && !el->sbr) {
+    el->sbr = aac_sbr_decoder_create(nch, s->dsp);
+  }
+  return 0;
+}
+
+int aac_decoder_state_frame_size(const AacDecoderState* s, int ri) {
+  /* Implicit SBR: a core at half the output rate goes through the SBR
+   * decoder, which also upsamples it when a frame carries no SBR data */
+  const bool sbr = s->aot != AAC_AOT_LD && aac_sample_rates[ri] * 2 == s->sample_rate;
+  return sbr ? 2 * s->frame_length : s->frame_length;
+}
+
+int aac_decode_frame(AacDecoderState* s, const uint8_t* data, int size, int channel_config) {
+  s->frame_size = aac_decoder_state_frame_size(s, s->rate_index);
+  const bool sbr = s->frame_size != s->frame_length;
+  /* ADTS names the layout; without it any element sequence that fits is taken */
+  const AacChannelConfig* layout =
+      channel_config > 0 && channel_config < 8 ? &aac_channel_config[channel_config] : nullptr;
+
+  AacBitReader reader;
+  aac_bitreader_init(&reader, data, size);
+  int n_elems = 0, n_ch = 0;
+
+  /* er_raw_data_block: the layout's elements in order, without ids, then
+   * byte alignment; there are no FIL or END elements */
+  if (s->aot == AAC_AOT_LD) {
+    if (!layout) {
+      return AAC_ERR_DECODE;
+    }
+    for (; n_elems < layout->num_elements; n_elems++) {
+      int elem_type = layout->elements[n_elems];
+      int ret = decode_element(s, &reader, elem_type, n_elems, n_ch, false);
+      if (ret) {
+        return ret;
+      }
+      n_ch += elem_type == AAC_ELEM_CPE ? 2 : 1;
+    }
+  }
+
+  /* Elements are parsed in order; reconstruction waits for the END element,
+   * once any SBR payload following a channel element has been read */
+  int max_elements = 16; /* safety limit to prevent infinite loops on malformed data */
+  while (s->aot != AAC_AOT_LD && aac_bitreader_bits_left(&reader) > 3 && max_elements-- > 0) {
+    int elem_type = aac_bitreader_read(&reader, 3);
+    if (elem_type == AAC_ELEM_END) {
+      break;
+    }
+
+    switch (elem_type) {
+      case AAC_ELEM_SCE:
+      case AAC_ELEM_CPE:
+      case AAC_ELEM_LFE: {
+        if (n_elems == AAC_MAX_ELEMENTS ||
+            (layout && (n_elems >= layout->num_elements ||
+                        layout->elements[n_elems] != elem_type))) {
+          return AAC_ERR_DECODE;
+        }
+        int ret = decode_element(s, &reader, elem_type, n_elems++, n_ch, sbr);
+        if (ret) {
+          return ret;
+        }
+        n_ch += elem_type == AAC_ELEM_CPE ? 2 : 1;
+        break;
+      }
+      case AAC_ELEM_FIL: {
+        int cnt = aac_bitreader_read(&reader, 4);
+        if (cnt == 15) {
+          cnt += aac_bitreader_read(&reader, 8) - 1;
+        }
+        /* An SBR payload belongs to the channel element before it */
+        if (sbr && cnt > 0 && n_elems > 0 && aac_bitreader_bits_left(&reader) >= cnt * 8) {
+          AacDecoderElement* el = &s->elem[n_elems - 1];
+          AacBitReader payload = reader;
+          if (aac_bitreader_read(&payload, 4) == AAC_FIL_EXT_SBR_DATA &&
+              aac_sbr_parse(el->sbr, &payload, 0, el->nch) == AAC_OK &&
+              aac_bitreader_bits_left(&payload) >= aac_bitreader_bits_left(&reader) - cnt * 8) {
+            for (int c = el->ch0; c < el->ch0 + el->nch; c++) {
+              s->ch[c].has_sbr = 1;
+            }
+          }
+        }
+        aac_bitreader_skip(&reader, cnt * 8);
+        break;
+      }
+      default:
+        aac_bitreader_byte_align(&reader);
+        break;
+    }
+  }
+  s->n_elems = n_elems;
+  if (n_elems == 0) {
+    return 0;
+  }
+
+  if (n_ch > s->channels) {
+    return downmix_frame(s, n_ch);
+  }
+  s->downmix_path = AAC_DOWNMIX_PATH_NONE;
+  aac_thread_pool_run(s->pool, reconstruct_element, s, n_elems);
+  return element_has_ps(s, &s->elem[0]) ? 2 : n_ch;
+}
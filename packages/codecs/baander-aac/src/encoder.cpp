@@ -1,45 +1,238 @@
 #include "encoder.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstring>
 
-AacEncoderState* aac_encoder_state_create(int sr, int ch, int br, AacObjectType aot,
-                                          AacRateControl rc, const AacDSP* dsp) {
+/* ── Complexity presets ───────────────────────────────────────
+ * Indexed by AacComplexity. Each level spends more time than the one
+ * below it for no less SNR; measured throughput/SNR per level is
+ * documented in docs/README.md. */
+
+static const AacEncoderPreset kEncoderPresets[] = {
+    /* FAST   */ {11, 43, 5, 6, 0.15f, 1, 1, 0, 0},
+    /* MEDIUM */ {21, 53, 2, 16, 0.08f, 1, 1, 1, 0},
+    /* HIGH   */ {53, 107, 1, 32, 0.08f, 1, 1, 2, 1},
+    /* BEST   */ {53, 107, 1, 64, 0.05f, 1, 0, 3, 1},
+};
+
+void aac_encoder_apply_complexity(AacEncoderState* s, AacComplexity complexity) {
+  s->complexity = complexity;
+  s->preset = kEncoderPresets[complexity];
+  if (s->n_elems > 0) {
+    for (int e = 0; e < s->n_elems; e++) {
+      aac_encoder_apply_complexity(s->elems[e], complexity);
+    }
+    return;
+  }
+  /* An LFE has nothing above 120 Hz to shape or substitute */
+  if (s->lfe) {
+    s->preset.tns_filters = 0;
+    s->preset.pns = 0;
+  }
+  for (int c = 0; c < s->channels; c++) {
+    s->psycho_state[c].detail = s->preset.psycho_detail;
+  }
+}
+
+/* ── Bandwidth ───────────────────────────────────────────────────
+ * Lowpass cutoff by bitrate per channel, linearly interpolated between
+ * rows. Bands above the cutoff would be zeroed by rate control anyway at
+ * these rates; not coding them saves the sweep and their 4-bit codebooks. */
+
+static const int kBandwidthTable[][2] = {
+    /* bps/channel, cutoff Hz */
+    {16000, 6000},   {24000, 9000},   {32000, 11500},  {48000, 14000}, {64000, 16000},
+    {80000, 17500},  {96000, 19000},  {128000, 20000}, {160000, 22050},
+};
+
+/* Highest core lowpass with SBR, in percent of the core rate */
+static const int kSbrMaxCrossover = 42;
+
+int aac_encoder_bandwidth(int sample_rate, int channels, int bitrate) {
+  const int rows = (int)(sizeof(kBandwidthTable) / sizeof(kBandwidthTable[0]));
+  int per_ch = bitrate / std::max(channels, 1);
+  int cutoff = kBandwidthTable[rows - 1][1];
+  if (per_ch <= kBandwidthTable[0][0]) {
+    cutoff = kBandwidthTable[0][1];
+  } else {
+    for (int i = 1; i < rows; i++) {
+      if (per_ch <= kBandwidthTable[i][0]) {
+        int r0 = kBandwidthTable[i - 1][0], r1 = kBandwidthTable[i][0];
+        int c0 = kBandwidthTable[i - 1][1], c1 = kBandwidthTable[i][1];
+        cutoff = c0 + (int)((int64_t)(c1 - c0) * (per_ch - r0) / (r1 - r0));
+        break;
+      }
+    }
+  }
+  return std::min(cutoff, sample_rate / 2);
+}
+
+/* LFE lowpass; ISO 14496-3 leaves the limit to the encoder */
+static const int kLfeBandwidth = 120;
+/* Multichannel bitrate split: shares per coded channel and for the LFE */
+static const int kChannelShare = 8;
+static const int kLfeShare = 1;
+
+static AacEncoderState* encoder_create(int sr, int ch, int br, AacObjectType aot,
+                                       AacRateControl rc, int lfe, const AacDSP* dsp);
+
+/* One sub-encoder per element of the channel configuration, each with its
+ * share of the bitrate; element instance tags count per element type */
+static bool create_elements(AacEncoderState* s) {
+  const AacChannelConfig* layout = &aac_channel_config[s->channel_config];
+  int units = 0;
+  for (int e = 0; e < layout->num_elements; e++) {
+    int type = layout->elements[e];
+    units += type == AAC_ELEM_LFE ? kLfeShare : (type == AAC_ELEM_CPE ? 2 : 1) * kChannelShare;
+  }
+  int tags[AAC_ELEM_LFE + 1] = {0};
+  for (int e = 0; e < layout->num_elements; e++) {
+    int type = layout->elements[e];
+    int nch = type == AAC_ELEM_CPE ? 2 : 1;
+    int share = type == AAC_ELEM_LFE ? kLfeShare : nch * kChannelShare;
+    int br = (int)((int64_t)s->bitrate * share / units);
+    AacEncoderState* el = encoder_create(s->sample_rate, nch, br, s->aot, s->rc_mode,
+                                         type == AAC_ELEM_LFE, s->dsp);
+    if (!el) {
+      return false;
+    }
+    el->element_only = 1;
+    el->element_tag = tags[type]++;
+    s->elems[s->n_elems++] = el;
+  }
+  return true;
+}
+
+/* Everything that follows from the core frame length: the per-frame budget,
+ * the coded bands and the transform and psychoacoustic state */
+static void setup_core(AacEncoderState* s) {
+  const int n = s->frame_length;
+  s->target_bits_per_frame = (int)((float)s->bitrate * (float)n / (float)s->core_rate);
+  int cutoff_bin = (int)(((int64_t)s->bandwidth * 2 * n + s->core_rate - 1) / s->core_rate);
+  const int* sfb = aac_sfb_offsets(s->rate_index, n);
+  s->max_sfb = 1;
+  while (s->max_sfb < aac_num_sfb(s->rate_index, n) && sfb[s->max_sfb] < cutoff_bin) {
+    s->max_sfb++;
+  }
+  for (int c = 0; c < s->channels; c++) {
+    aac_mdct_init(&s->mdct_ctx[c], n, s->dsp);
+    aac_psycho_init(&s->psycho_state[c], s->core_rate, n, s->dsp);
+  }
+}
+
+static AacEncoderState* encoder_create(int sr, int ch, int br, AacObjectType aot,
+                                       AacRateControl rc, int lfe, const AacDSP* dsp) {
   auto* s = new AacEncoderState();
+  /* Parametric Stereo needs a stereo input and leaves the core mono */
+  const bool ps = aot == AAC_AOT_PS && ch == 2;
   s->sample_rate = sr;
-  s->channels = ch;
+  s->channels = ps ? 1 : ch;
+  s->input_channels = ch;
   s->bitrate = br;
   s->aot = aot;
   s->rc_mode = rc;
   s->quality = 100;
-  s->frame_size = (aot == AAC_AOT_LC) ? 1024 : 2048;
+  s->lfe = lfe;
+  /* AAC-LD starts at 512-sample frames; aac_encoder_state_set_frame_length
+   * may switch it to 480 before the first frame */
+  const bool sbr = aot == AAC_AOT_SBR || aot == AAC_AOT_PS;
+  s->frame_length = aot == AAC_AOT_LD ? AAC_FRAME_SIZE_LD : AAC_FRAME_SIZE_LONG;
+  s->frame_size = sbr ? 2 * s->frame_length : s->frame_length;
+  s->window_shape = aot == AAC_AOT_LD ? AAC_WIN_LOW_OVERLAP : AAC_WIN_SINE;
+  /* SBR codes the upper half of the spectrum; the core sees a 2:1
+   * downsampled signal and signals its own rate in ADTS */
+  s->core_rate = sbr ? sr / 2 : sr;
   s->bit_reservoir = 0;
   s->lambda = 0.0001f;
   s->dsp = dsp;
-  s->target_bits_per_frame = (int)((float)br * 1024.0f / (float)sr);
   s->rate_index = 3;
   for (int i = 0; i < AAC_NUM_SAMPLE_RATES; i++) {
-    if (aac_sample_rates[i] == sr) {
+    if (aac_sample_rates[i] == s->core_rate) {
       s->rate_index = i;
       break;
     }
   }
-  for (int c = 0; c < ch; c++) {
-    aac_mdct_init(&s->mdct_ctx[c], 1024, dsp);
-    aac_psycho_init(&s->psycho_state[c], sr, 1024);
+  if (ch > 2) {
+    s->channel_config = aac_channel_config_index(ch);
+    if (!create_elements(s)) {
+      aac_encoder_state_destroy(s);
+      return nullptr;
+    }
+    aac_encoder_apply_complexity(s, AAC_COMPLEXITY_HIGH);
+    s->target_bits_per_frame = (int)((float)br * (float)s->frame_length / (float)s->core_rate);
+    return s;
+  }
+  s->bandwidth = aac_encoder_bandwidth(s->core_rate, s->channels, br);
+  if (sbr) {
+    /* Keep the crossover inside the downsampler's passband */
+    s->bandwidth = std::min(s->bandwidth, s->core_rate * kSbrMaxCrossover / 100);
+    s->sbr = aac_sbr_encoder_create(sr, ch, br, s->bandwidth, ps, dsp);
+    if (!s->sbr) {
+      delete s;
+      return nullptr;
+    }
+  }
+  if (lfe) {
+    s->bandwidth = std::min(s->bandwidth, kLfeBandwidth);
   }
+  setup_core(s);
+  aac_encoder_apply_complexity(s, AAC_COMPLEXITY_HIGH);
   s->pcm_buf_fill = 0;
   return s;
 }
 
+AacEncoderState* aac_encoder_state_create(int sr, int ch, int br, AacObjectType aot,
+                                          AacRateControl rc, const AacDSP* dsp) {
+  return encoder_create(sr, ch, br, aot, rc, 0, dsp);
+}
+
+int aac_encoder_state_set_frame_length(AacEncoderState* s, int frame_length) {
+  if (s->aot != AAC_AOT_LD) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  if (frame_length != AAC_FRAME_SIZE_LD && frame_length != AAC_FRAME_SIZE_LD_480) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  if (s->frame_count > 0 || s->pcm_buf_fill > 0) {
+    return AAC_ERR_STATE;
+  }
+  s->frame_length = s->frame_size = frame_length;
+  if (s->n_elems > 0) {
+    for (int e = 0; e < s->n_elems; e++) {
+      aac_encoder_state_set_frame_length(s->elems[e], frame_length);
+    }
+    s->target_bits_per_frame =
+        (int)((float)s->bitrate * (float)frame_length / (float)s->core_rate);
+    return AAC_OK;
+  }
+  for (int c = 0; c < s->channels; c++) {
+    aac_mdct_free(&s->mdct_ctx[c]);
+  }
+  setup_core(s);
+  aac_encoder_apply_complexity(s, s->complexity);
+  return AAC_OK;
+}
+
 void aac_encoder_state_destroy(AacEncoderState* s) {
   if (!s) {
     return;
   }
+  if (s->channels > 2) {
+    for (int e = 0; e < s->n_elems; e++) {
+      aac_encoder_state_destroy(s->elems[e]);
+    }
+    aac_thread_pool_destroy(s->pool);
+    delete s;
+    return;
+  }
   for (int c = 0; c < s->channels; c++) {
     aac_mdct_free(&s->mdct_ctx[c]);
   }
+  aac_twopass_close(s->twopass);
+  aac_sbr_encoder_destroy(s->sbr);
+  aac_thread_pool_destroy(s->pool);
   delete s;
 }
 
@@ -146,7 +339,7 @@ static int select_codebook(const int* quant, int s, int e) {
 /* ── Quantize a single band with a given scalefactor ──────────── */
 
 static int quantize_band_sf(const float* spec, int* qc, int s, int e, int sf, int max_q = 12) {
-  float sf_scale = powf(2.0f, sf * 0.25f);
+  float sf_scale = powf(2.0f, sf * -0.1875f);
   int max_abs = 0;
   for (int i = s; i < e; i++) {
     float q = copysignf(powf(fabsf(spec[i]), 0.75f) * sf_scale, spec[i]);
@@ -164,16 +357,48 @@ static int quantize_band_sf(const float* spec, int* qc, int s, int e, int sf, in
 /* ── Compute noise energy for a band ──────────────────────────── */
 
 static float compute_noise(const float* spec, const int* qc, int s, int e, int sf) {
-  float sf_scale_inv = powf(2.0f, -sf * 0.25f);
+  float sf_scale_inv = powf(2.0f, sf * 0.25f);
   float noise = 0;
   for (int i = s; i < e; i++) {
-    float dq = copysignf(powf(fabsf((float)qc[i] * sf_scale_inv), 4.0f / 3.0f), (float)qc[i]);
+    float dq = copysignf(powf(fabsf((float)qc[i]), 4.0f / 3.0f) * sf_scale_inv, (float)qc[i]);
     float err = spec[i] - dq;
     noise += err * err;
   }
   return noise;
 }
 
+/* ── Perceptual noise substitution ────────────────────────────── */
+
+/* Noise below this frequency is rarely masked well enough to substitute */
+static const float kPnsStartHz = 4000.0f;
+/* Geometric / arithmetic mean of |X|^2; white noise averages about 0.56 */
+static const float kPnsMinFlatness = 0.3f;
+/* Codebook (4 bits) plus the noise-energy DPCM (9 bits) */
+static const int kPnsBandBits = 4 + 9;
+
+/* Flatness of each candidate band, computed once per frame because the
+ * rate-control loop quantizes the same spectrum many times */
+static void analyze_pns(AacEncoderState* s, int ch, const int* sfb, int nb) {
+  for (int b = 0; b < nb; b++) {
+    s->flatness[ch][b] = 0.0f;
+    int bs = sfb[b], be = sfb[b + 1];
+    if ((float)bs * (float)s->core_rate / (2.0f * (float)s->frame_length) < kPnsStartHz) {
+      continue;
+    }
+    float sum = 0.0f, log_sum = 0.0f;
+    for (int i = bs; i < be; i++) {
+      float p = s->spectral[ch][i] * s->spectral[ch][i] + 1e-20f;
+      sum += p;
+      log_sum += logf(p);
+    }
+    float n = (float)(be - bs);
+    s->flatness[ch][b] = expf(log_sum / n) / (sum / n);
+  }
+}
+
+/* Noise energy index for a band of total energy e: e = 2^(nrg / 2) */
+static int pns_energy_index(float e) { return (int)lroundf(2.0f * log2f(fmaxf(e, 1e-20f))); }
+
 /* ── Per-band R-D quantization ────────────────────────────────── */
 
 int aac_quantize_bands(AacEncoderState* s, int ch, float lambda, const float* thr, const int* sfb,
@@ -207,9 +432,11 @@ int aac_quantize_bands(AacEncoderState* s, int ch, float lambda, const float* th
 
     /* Compute sf_center: scalefactor that maps band_max → target_q.
      * target_q = 10 gives good quality with cb=9/10.
-     * q = spec^(3/4) * 2^(sf/4), so sf = 4 * log2(target_q / spec^(3/4)) */
+     * As ISO 14496-3 dequantizes, spec = q^(4/3) * 2^(sf/4) with sf the
+     * scalefactor less 100, so q = spec^(3/4) * 2^(-3sf/16) and
+     * sf = 16/3 * log2(spec^(3/4) / target_q) */
     float spec_34 = powf(band_max, 0.75f);
-    int sf_center = (int)roundf(4.0f * log2f(10.0f / spec_34));
+    int sf_center = (int)roundf(16.0f / 3.0f * log2f(spec_34 / 10.0f));
     sf_center = std::clamp(sf_center, -100, 155);
 
     /* Signal energy for NMR calculation */
@@ -225,64 +452,93 @@ int aac_quantize_bands(AacEncoderState* s, int ch, float lambda, const float* th
       pe_weight = sqrtf(sig_energy) / (thr[b] + 1e-10f);
       pe_weight = std::clamp(pe_weight, 0.1f, 100.0f);
     }
+    /* Noise in a TNS residual is amplified by the decoder's synthesis filter */
+    if (s->tns_present[ch]) {
+      pe_weight *= sqrtf(s->tns_gain[ch][b]);
+    }
 
     /* Dense sf search — widen range to find best R-D tradeoff */
     int best_sf = sf_center;
     float best_cost = 1e30f;
     int tmp_qc[256];
 
-    int sf_lo = sf_center - 80;
-    int sf_hi = sf_center + 40;
+    int sf_lo = sf_center - s->preset.sf_search_below;
+    int sf_hi = sf_center + s->preset.sf_search_above;
     sf_lo = std::max(sf_lo, -100);
     sf_hi = std::min(sf_hi, 155);
+    /* A coarse sweep (sf_search_step > 1) is refined around its best point */
+    const int step = s->preset.sf_search_step;
+    for (int pass = 0; pass < (step > 1 ? 2 : 1); pass++) {
+      const int lo = pass ? std::max(best_sf - step + 1, sf_lo) : sf_lo;
+      const int hi = pass ? std::min(best_sf + step - 1, sf_hi) : sf_hi;
+      for (int sf = lo; sf <= hi; sf += pass ? 1 : step) {
+        if (pass && (sf - sf_lo) % step == 0) {
+          continue;
+        }
+        /* Quantize into tmp_qc[0..bw-1] using spec[bs..be-1] */
+        float sf_scale = powf(2.0f, sf * -0.1875f);
+        int max_abs = 0;
+        for (int i = 0; i < bw; i++) {
+          float q = copysignf(powf(fabsf(spec[bs + i]), 0.75f) * sf_scale, spec[bs + i]);
+          int iq = (int)roundf(q);
+          iq = std::clamp(iq, -12, 12);
+          tmp_qc[i] = iq;
+          int a = std::abs(iq);
+          if (a > max_abs) {
+            max_abs = a;
+          }
+        }
 
-    for (int sf = sf_lo; sf <= sf_hi; sf++) {
-      /* Quantize into tmp_qc[0..bw-1] using spec[bs..be-1] */
-      float sf_scale = powf(2.0f, sf * 0.25f);
-      int max_abs = 0;
-      for (int i = 0; i < bw; i++) {
-        float q = copysignf(powf(fabsf(spec[bs + i]), 0.75f) * sf_scale, spec[bs + i]);
-        int iq = (int)roundf(q);
-        iq = std::clamp(iq, -12, 12);
-        tmp_qc[i] = iq;
-        int a = std::abs(iq);
-        if (a > max_abs) {
-          max_abs = a;
+        /* Minimum quality: non-zero bands must use at least max_q=4 (cb≥6),
+         * unless even the finest scalefactor cannot reach it */
+        if (max_abs < 4 && max_abs > 0 && sf > sf_lo) {
+          continue;
+        }
+        /* Skip if all zero (unless it's the only option) */
+        if (max_abs == 0 && sf < sf_hi - 7) {
+          continue;
         }
-      }
 
-      /* Minimum quality: non-zero bands must use at least max_q=4 (cb≥6) */
-      if (max_abs < 4 && max_abs > 0 && sf < sf_hi) {
-        continue;
-      }
-      /* Skip if all zero (unless it's the only option) */
-      if (max_abs == 0 && sf > sf_lo + 5) {
-        continue;
-      }
+        /* Compute noise */
+        float sf_scale_inv = powf(2.0f, sf * 0.25f);
+        float noise = 0;
+        for (int i = 0; i < bw; i++) {
+          float dq = copysignf(powf(fabsf((float)tmp_qc[i]), 4.0f / 3.0f) * sf_scale_inv,
+                               (float)tmp_qc[i]);
+          float err = spec[bs + i] - dq;
+          noise += err * err;
+        }
+        float nmr = noise; /* Use absolute noise energy, not normalized */
 
-      /* Compute noise */
-      float sf_scale_inv = powf(2.0f, -sf * 0.25f);
-      float noise = 0;
-      for (int i = 0; i < bw; i++) {
-        float dq =
-            copysignf(powf(fabsf((float)tmp_qc[i] * sf_scale_inv), 4.0f / 3.0f), (float)tmp_qc[i]);
-        float err = spec[bs + i] - dq;
-        noise += err * err;
-      }
-      float nmr = noise; /* Use absolute noise energy, not normalized */
+        /* Select codebook and count bits */
+        int cb = select_codebook(tmp_qc, 0, bw);
+        int bits = estimate_sfb_bits(cb, tmp_qc, 0, bw) + 4 + (cb == 0 ? 0 : 9);
 
-      /* Select codebook and count bits */
-      int cb = select_codebook(tmp_qc, 0, bw);
-      int bits = estimate_sfb_bits(cb, tmp_qc, 0, bw) + 4 + (cb == 0 ? 0 : 9);
+        /* R-D cost: distortion + lambda * rate.
+         * Use sqrt(noise) for better perceptual weighting (closer to RMS). */
+        float dist = sqrtf(nmr) * pe_weight;
+        float cost = dist + lambda * (float)bits;
 
-      /* R-D cost: distortion + lambda * rate.
-       * Use sqrt(noise) for better perceptual weighting (closer to RMS). */
-      float dist = sqrtf(nmr) * pe_weight;
-      float cost = dist + lambda * (float)bits;
+        if (cost < best_cost) {
+          best_sf = sf;
+          best_cost = cost;
+        }
+      }
+    }
 
-      if (cost < best_cost) {
-        best_sf = sf;
-        best_cost = cost;
+    /* Substitution reproduces the band's energy but not its waveform; its
+     * error is taken as the part of the band that is not noise-like */
+    float flat = s->preset.pns ? s->flatness[ch][b] : 0.0f;
+    if (flat >= kPnsMinFlatness) {
+      float dist = sqrtf(sig_energy * (1.0f - flat)) * pe_weight;
+      if (dist + lambda * (float)kPnsBandBits < best_cost) {
+        s->codebooks[ch][b] = AAC_PNS_CODEBOOK;
+        s->scalefactors[ch][b] = pns_energy_index(sig_energy);
+        for (int i = bs; i < be; i++) {
+          qc[i] = 0;
+        }
+        total_bits += kPnsBandBits;
+        continue;
       }
     }
 
@@ -314,149 +570,529 @@ float aac_rate_control_lambda(AacEncoderState* s, int used, int target) {
   return std::max(1e-8f, std::min(new_lambda, 1e6f));
 }
 
-/* ── Frame encoding ───────────────────────────────────────────── */
+/* ── Two-pass statistics ──────────────────────────────────────── */
 
-int aac_encode_frame_internal(AacEncoderState* s, const float* pcm, int ns) {
-  int ri = s->rate_index;
-  int nb = aac_num_sfb_long[ri];
-  const int* sfb = aac_sfb_offset_long[ri];
-
-  /* Deinterleave stereo */
-  float ch_buf[2][2048];
-  if (s->channels == 1) {
-    memcpy(ch_buf[0], pcm, ns * sizeof(float));
-  } else {
-    for (int i = 0; i < ns; i++) {
-      ch_buf[0][i] = pcm[static_cast<ptrdiff_t>(i) * 2];
-      ch_buf[1][i] = pcm[static_cast<ptrdiff_t>(i) * 2 + 1];
+/* Attack detector for the pass-1 log: a sub-block much louder than
+ * everything before it in the frame. */
+static bool detect_transient(const float* x, int n) {
+  const int blocks = 8;
+  int len = n / blocks;
+  float acc = 0.0f;
+  for (int k = 0; k < blocks; k++) {
+    float e = 0.0f;
+    for (int i = k * len; i < (k + 1) * len; i++) {
+      e += x[i] * x[i];
     }
+    if (k > 0 && e > 1e-6f * (float)len && e > 10.0f * acc / (float)k) {
+      return true;
+    }
+    acc += e;
   }
+  return false;
+}
 
-  /* MDCT analysis */
+/* Bits the quantizer spends at lambda across all channels */
+static int quantize_all(AacEncoderState* s, float lambda, const int* sfb, int nb) {
+  int total_bits = 0;
   for (int c = 0; c < s->channels; c++) {
-    aac_mdct_forward_aac(&s->mdct_ctx[c], s->spectral[c], ch_buf[c], 1024, AAC_WIN_ONLY_LONG,
-                         AAC_WIN_SINE, c);
+    total_bits +=
+        aac_quantize_bands(s, c, lambda, aac_psycho_get_thresholds(&s->psycho_state[c]), sfb, nb);
+    if (s->tns_present[c]) {
+      total_bits += aac_tns_bits(&s->tns[c], AAC_WIN_ONLY_LONG);
+    }
   }
+  return total_bits;
+}
 
-  /* M/S decision for stereo */
-  if (s->channels == 2) {
-    decide_ms(s, s->spectral[0], s->spectral[1], nb, sfb);
+/* ── Digital silence ──────────────────────────────────────────── */
+
+/* All-zero input with a zero forward-MDCT overlap has an exactly zero
+ * spectrum, so the whole analysis can be skipped. */
+static bool is_digital_silence(const AacEncoderState* s, float ch_buf[][2048], int ns) {
+  for (int c = 0; c < s->channels; c++) {
+    if (!s->dsp->vector_is_zero(ch_buf[c], ns) ||
+        !s->dsp->vector_is_zero(s->mdct_ctx[c].overlap_long, s->frame_length)) {
+      return false;
+    }
   }
+  return true;
+}
 
-  /* Psychoacoustic analysis */
+/* Empty ICS per channel: global_gain only, max_sfb = 0. Analysis state is
+ * left alone; the overlap and psycho history already describe silence. */
+static void code_silence(AacEncoderState* s) {
   for (int c = 0; c < s->channels; c++) {
-    aac_psycho_analyze(&s->psycho_state[c], s->spectral[c], nb, sfb);
+    s->scalefactors[c][0] = 0;
+    s->ics_max_sfb[c] = 0;
+    s->tns_present[c] = 0;
   }
+  memset(s->ms_used, 0, sizeof(s->ms_used));
+}
 
-  /* Quantization with rate control iterations */
-  for (int iter = 0; iter < 32; iter++) {
-    int total_bits = 0;
-    for (int c = 0; c < s->channels; c++) {
-      total_bits += aac_quantize_bands(s, c, s->lambda,
-                                       aac_psycho_get_thresholds(&s->psycho_state[c]), sfb, nb);
+/* ── Telemetry ────────────────────────────────────────────────── */
+
+static int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/* ── Bitstream ────────────────────────────────────────────────── */
+
+/* individual_channel_stream of channel c: long window, no pulse data */
+static void write_ics(AacEncoderState* s, int c, const int* sfb) {
+  AacBitWriter* w = &s->writer;
+  aac_bitwriter_write(w, s->scalefactors[c][0] + 100, 8); /* global_gain */
+  aac_bitwriter_write(w, AAC_WIN_ONLY_LONG, 2);
+  aac_bitwriter_write(w, s->window_shape, 1);
+  aac_bitwriter_write(w, s->ics_max_sfb[c], 6);
+  aac_bitwriter_write(w, 0, 1); /* predictor */
+  aac_bitwriter_write(w, s->tns_present[c], 1);
+  if (s->tns_present[c]) {
+    aac_tns_write(w, &s->tns[c], AAC_WIN_ONLY_LONG);
+  }
+  int prev_sf = s->scalefactors[c][0];
+  int prev_nrg = s->scalefactors[c][0] + 100 - AAC_PNS_ENERGY_OFFSET;
+  for (int b = 0; b < s->ics_max_sfb[c]; b++) {
+    int cb = s->codebooks[c][b];
+    aac_bitwriter_write(w, cb, 4);
+    if (cb == AAC_PNS_CODEBOOK) {
+      aac_bitwriter_write_signed(w, s->scalefactors[c][b] - prev_nrg, 9);
+      prev_nrg = s->scalefactors[c][b];
+      continue;
     }
-    int diff = total_bits - s->target_bits_per_frame;
-    if (diff > -s->target_bits_per_frame / 10 && diff < s->target_bits_per_frame / 10) {
-      break;
+    if (cb == 0 || cb > AAC_PNS_CODEBOOK) {
+      continue;
     }
-    float new_lambda = aac_rate_control_lambda(s, total_bits, s->target_bits_per_frame);
-    if (new_lambda > 0 && std::isfinite(new_lambda)) {
-      s->lambda = std::max(1e-8f, std::min(new_lambda, 1e6f));
+    int dpcm = s->scalefactors[c][b] - prev_sf;
+    prev_sf = s->scalefactors[c][b];
+    aac_bitwriter_write_signed(w, dpcm, 9);
+    for (int i = sfb[b]; i < sfb[b + 1]; i += 2) {
+      int x = s->quant_coeffs[c][i];
+      int y = (i + 1 < sfb[b + 1]) ? s->quant_coeffs[c][i + 1] : 0;
+      int mv = aac_codebook_info[cb].max_val;
+      if (aac_codebook_info[cb].is_unsigned) {
+        x = std::clamp(x, 0, mv);
+        y = std::clamp(y, 0, mv);
+      } else {
+        x = std::clamp(x, -mv, mv);
+        y = std::clamp(y, -mv, mv);
+      }
+      aac_bitwriter_write_huffman(w, cb, x, y);
     }
   }
+}
 
-  /* Write bitstream */
-  aac_bitwriter_init(&s->writer, s->output_buf, sizeof(s->output_buf));
+/* A whole frame (not an element) outside AAC-LD, with ADTS transport */
+static bool has_adts_header(const AacEncoderState* s) {
+  return !s->element_only && s->aot != AAC_AOT_LD && s->transport == AAC_TRANSPORT_ADTS;
+}
 
-  /* ADTS header placeholder (7 bytes) */
+static void write_adts_header(uint8_t* out, int rate_index, int channel_config, int frame_len) {
   AacAdtsHeader hdr = {};  // NOLINT(bugprone-invalid-enum-default-initialization)
   hdr.id = 0;
   hdr.layer = 0;
   hdr.protection_absent = 1;
-  hdr.profile = s->aot;
-  hdr.sample_rate_index = ri;
-  hdr.channel_config = s->channels;
-  hdr.frame_length = 0;
+  hdr.profile = AAC_AOT_LC; /* SBR is signalled implicitly by its FIL payload */
+  hdr.sample_rate_index = rate_index;
+  hdr.channel_config = channel_config;
+  hdr.frame_length = frame_len;
   hdr.buffer_fullness = 0x7FF;
   hdr.num_aac_frames = 1;
-  aac_bitwriter_write(&s->writer, 0, 56);
+  aac_adts_write(&hdr, out);
+}
+
+/* ── Multichannel ─────────────────────────────────────────────── */
+
+/* Pool task: sub-encoders share nothing but the read-only DSP table */
+static void encode_element(void* ctx, int e) {
+  auto* s = static_cast<AacEncoderState*>(ctx);
+  AacEncoderState* el = s->elems[e];
+  s->elem_bits[e] = aac_encode_frame_internal(el, s->elem_pcm[e], s->frame_size);
+}
+
+static void collect_element_stats(const AacFrameStats* stats, void* user) {
+  *static_cast<AacFrameStats*>(user) = *stats;
+}
+
+void aac_encoder_set_stats(AacEncoderState* s, AacFrameStatsCallback cb, void* user) {
+  s->stats_cb = cb;
+  s->stats_user = user;
+  for (int e = 0; e < s->n_elems; e++) {
+    aac_encoder_set_stats(s->elems[e], cb ? collect_element_stats : nullptr, &s->elem_stats[e]);
+  }
+}
+
+/* Element stats summed into one frame; lambda and timings are the largest
+ * element's, which bound the frame, and channel_bits the first two channels */
+static void report_multichannel_stats(AacEncoderState* s, int frame_bits) {
+  AacFrameStats st = {};
+  st.frame_index = s->frame_count;
+  st.frame_bits = frame_bits;
+  st.window_sequence = AAC_WIN_ONLY_LONG;
+  int ch = 0;
+  for (int e = 0; e < s->n_elems; e++) {
+    const AacFrameStats* x = &s->elem_stats[e];
+    st.rc_iterations = std::max(st.rc_iterations, x->rc_iterations);
+    st.lambda = std::max(st.lambda, x->lambda);
+    st.target_bits += x->target_bits;
+    st.sbr_bits += x->sbr_bits;
+    st.reservoir_bits += x->reservoir_bits;
+    st.ms_bands += x->ms_bands;
+    st.mdct_ns = std::max(st.mdct_ns, x->mdct_ns);
+    st.psycho_ns = std::max(st.psycho_ns, x->psycho_ns);
+    st.quant_ns = std::max(st.quant_ns, x->quant_ns);
+    st.bitstream_ns = std::max(st.bitstream_ns, x->bitstream_ns);
+    for (int c = 0; c < s->elems[e]->channels && ch < 2; c++) {
+      st.channel_bits[ch++] = x->channel_bits[c];
+    }
+  }
+  s->stats_cb(&st, s->stats_user);
+}
+
+/* Split the input by element, encode the elements (in parallel on s->pool)
+ * and concatenate their bits after one ADTS header */
+static int encode_multichannel(AacEncoderState* s, const float* pcm, int ns) {
+  const int channels = s->channels;
+  int ch0 = 0;
+  for (int e = 0; e < s->n_elems; e++) {
+    const int nch = s->elems[e]->input_channels;
+    for (int i = 0; i < ns; i++) {
+      for (int c = 0; c < nch; c++) {
+        s->elem_pcm[e][i * nch + c] = pcm[static_cast<ptrdiff_t>(i) * channels + ch0 + c];
+      }
+    }
+    ch0 += nch;
+  }
+  aac_thread_pool_run(s->pool, encode_element, s, s->n_elems);
+
+  const bool er = s->aot == AAC_AOT_LD; /* raw er_raw_data_block, as in write_frame */
+  const bool adts = has_adts_header(s);
+  AacBitWriter* w = &s->writer;
+  aac_bitwriter_init(w, s->output_buf, sizeof(s->output_buf));
+  if (adts) {
+    aac_bitwriter_write(w, 0, 56); /* ADTS header placeholder */
+  }
+  for (int e = 0; e < s->n_elems; e++) {
+    const int bits = s->elem_bits[e];
+    if (bits <= 0) {
+      return AAC_ERR_ENCODE;
+    }
+    const uint8_t* src = s->elems[e]->output_buf;
+    int i = 0;
+    for (; i + 8 <= bits; i += 8) {
+      aac_bitwriter_write(w, src[i / 8], 8);
+    }
+    if (i < bits) {
+      aac_bitwriter_write(w, src[i / 8] >> (8 - (bits - i)), bits - i);
+    }
+  }
+  if (!er) {
+    aac_bitwriter_write(w, AAC_ELEM_END, 3);
+  }
+  aac_bitwriter_byte_align(w);
+  int frame_len = aac_bitwriter_bytes_written(w);
+  if (adts) {
+    write_adts_header(s->output_buf, s->rate_index, s->channel_config, frame_len);
+  }
+
+  if (s->stats_cb) {
+    report_multichannel_stats(s, frame_len * 8);
+  }
+  s->frame_count++;
+  return frame_len;
+}
+
+/* ── Frame encoding ───────────────────────────────────────────── */
+
+/* Requantization passes an AAC-LD frame may take to fit its budget */
+static const int kLdMaxRequantize = 16;
+
+/* Trailing bands the quantizer zeroed are dropped from the ICS */
+static void trim_max_sfb(AacEncoderState* s, int nb) {
+  for (int c = 0; c < s->channels; c++) {
+    int m = nb;
+    while (m > 1 && s->codebooks[c][m - 1] == 0) {
+      m--;
+    }
+    /* The decoder bounds TNS regions by max_sfb; keep the encoder's bound */
+    if (s->tns_present[c]) {
+      m = std::max(m, std::min(nb, aac_tns_max_bands(s->rate_index, s->frame_length)));
+    }
+    s->ics_max_sfb[c] = m;
+  }
+}
+
+/* The quantized frame into output_buf: ADTS header (unless the transport is
+ * raw), channel element, SBR FIL and END. An element_only encoder writes its
+ * element and FIL alone.
+ * AAC-LD access units are raw er_raw_data_blocks, with neither the header
+ * nor element ids and END (the channel configuration implies the
+ * elements), byte-aligned. Returns the bits written. */
+static int write_frame(AacEncoderState* s, const int* sfb, AacFrameStats* stats) {
+  const bool er = s->aot == AAC_AOT_LD;
+  AacBitWriter* w = &s->writer;
+  aac_bitwriter_init(w, s->output_buf, sizeof(s->output_buf));
+
+  /* ADTS header placeholder (7 bytes) */
+  const bool adts = has_adts_header(s);
+  if (adts) {
+    aac_bitwriter_write(w, 0, 56);
+  }
 
   /* Write channel elements */
-  if (s->channels == 1) {
-    aac_bitwriter_write(&s->writer, AAC_ELEM_SCE, 3);
-    aac_bitwriter_write(&s->writer, 0, 4);                           /* tag */
-    aac_bitwriter_write(&s->writer, s->scalefactors[0][0] + 100, 8); /* global_gain */
-    aac_bitwriter_write(&s->writer, AAC_WIN_ONLY_LONG, 2);
-    aac_bitwriter_write(&s->writer, AAC_WIN_SINE, 1);
-    aac_bitwriter_write(&s->writer, nb > 63 ? 63 : nb, 6);
-    aac_bitwriter_write(&s->writer, 0, 1); /* predictor */
-    int prev_sf = s->scalefactors[0][0];
-    for (int b = 0; b < nb; b++) {
-      int cb = s->codebooks[0][b];
-      aac_bitwriter_write(&s->writer, cb, 4);
-      if (cb == 0 || cb >= 13) {
-        continue;
+  if (!er) {
+    aac_bitwriter_write(w, s->channels == 2 ? AAC_ELEM_CPE : (s->lfe ? AAC_ELEM_LFE : AAC_ELEM_SCE),
+                        3);
+  }
+  aac_bitwriter_write(w, s->element_tag, 4);
+  if (s->channels == 2) {
+    aac_bitwriter_write(w, 0, 1); /* common_window */
+  }
+  /* Without a common window there is no ms_mask, so no band is sent as M/S
+   * whatever decide_ms chose */
+  stats->ms_bands = 0;
+  for (int c = 0; c < s->channels; c++) {
+    int ics_start = aac_bitwriter_bits_written(w);
+    write_ics(s, c, sfb);
+    stats->channel_bits[c] = aac_bitwriter_bits_written(w) - ics_start;
+  }
+
+  /* An LFE's high band is empty; its SBR encoder only runs the downsampler's history */
+  if (s->sbr && !s->lfe) {
+    aac_sbr_write_fil(s->sbr, w);
+  }
+  if (s->element_only) {
+    return aac_bitwriter_bits_written(w);
+  }
+  if (!er) {
+    aac_bitwriter_write(w, AAC_ELEM_END, 3);
+  }
+  aac_bitwriter_byte_align(w);
+  int frame_len = aac_bitwriter_bytes_written(w);
+  if (adts) {
+    write_adts_header(s->output_buf, s->rate_index, s->channels, frame_len);
+  }
+  return frame_len * 8;
+}
+
+int aac_encode_frame_internal(AacEncoderState* s, const float* pcm, int ns) {
+  if (s->channels > 2) {
+    return encode_multichannel(s, pcm, ns);
+  }
+  int ri = s->rate_index;
+  int nb = s->max_sfb; /* bands above the lowpass are never analysed or coded */
+  const int* sfb = aac_sfb_offsets(ri, s->frame_length);
+
+  /* Deinterleave stereo */
+  float ch_buf[2][2048];
+  if (s->input_channels == 1) {
+    memcpy(ch_buf[0], pcm, ns * sizeof(float));
+  } else {
+    for (int i = 0; i < ns; i++) {
+      ch_buf[0][i] = pcm[static_cast<ptrdiff_t>(i) * 2];
+      ch_buf[1][i] = pcm[static_cast<ptrdiff_t>(i) * 2 + 1];
+    }
+  }
+
+  /* SBR analyses the full-rate input and leaves the core's half in ch_buf;
+   * under PS the core's one channel is the downmix */
+  int sbr_bits = 0;
+  if (s->sbr) {
+    aac_sbr_encode_frame(s->sbr, ch_buf, ns);
+    ns /= 2;
+    sbr_bits = aac_sbr_fil_bits(s->sbr);
+  }
+
+  /* Telemetry is gated on one flag so disabled encodes never touch the clock */
+  const bool telemetry = s->stats_cb != nullptr;
+  AacFrameStats stats = {};
+  int64_t t0 = telemetry ? now_ns() : 0;
+
+  /* Pass-1 stats and telemetry read these whichever path codes the frame */
+  int target_bits = s->target_bits_per_frame - sbr_bits;
+  float used_lambda = s->lambda;
+  int est_bits = 0;
+  int iterations = 0;
+
+  const bool silent = is_digital_silence(s, ch_buf, ns);
+  if (silent) {
+    code_silence(s);
+  } else {
+    /* TNS only pays for its side info when the 2N analysis window holds an
+     * attack; tonal leakage is just as predictable but has no envelope */
+    bool attack[2] = {false, false};
+    if (s->preset.tns_filters > 0) {
+      float win[2048];
+      for (int c = 0; c < s->channels; c++) {
+        memcpy(win, s->mdct_ctx[c].overlap_long, ns * sizeof(float));
+        memcpy(win + ns, ch_buf[c], ns * sizeof(float));
+        attack[c] = detect_transient(win, 2 * ns);
       }
-      int dpcm = s->scalefactors[0][b] - prev_sf;
-      prev_sf = s->scalefactors[0][b];
-      aac_bitwriter_write_signed(&s->writer, dpcm, 9);
-      for (int i = sfb[b]; i < sfb[b + 1]; i += 2) {
-        int x = s->quant_coeffs[0][i];
-        int y = (i + 1 < sfb[b + 1]) ? s->quant_coeffs[0][i + 1] : 0;
-        int mv = aac_codebook_info[cb].max_val;
-        if (aac_codebook_info[cb].is_unsigned) {
-          x = std::clamp(x, 0, mv);
-          y = std::clamp(y, 0, mv);
-        } else {
-          x = std::clamp(x, -mv, mv);
-          y = std::clamp(y, -mv, mv);
-        }
-        aac_bitwriter_write_huffman(&s->writer, cb, x, y);
+    }
+
+    /* MDCT analysis */
+    for (int c = 0; c < s->channels; c++) {
+      if (s->preset.fast_mdct) {
+        aac_mdct_forward_fast(&s->mdct_ctx[c], s->spectral[c], ch_buf[c], s->frame_length,
+                              AAC_WIN_ONLY_LONG, s->window_shape, c);
+      } else {
+        aac_mdct_forward_aac_bins(&s->mdct_ctx[c], s->spectral[c], ch_buf[c], s->frame_length,
+                                  sfb[nb], AAC_WIN_ONLY_LONG, s->window_shape, c);
       }
     }
-  } else {
-    aac_bitwriter_write(&s->writer, AAC_ELEM_CPE, 3);
-    aac_bitwriter_write(&s->writer, 0, 4); /* tag */
-    aac_bitwriter_write(&s->writer, 0, 1); /* common_window */
-    for (int ch = 0; ch < 2; ch++) {
-      aac_bitwriter_write(&s->writer, s->scalefactors[ch][0] + 100, 8);
-      aac_bitwriter_write(&s->writer, AAC_WIN_ONLY_LONG, 2);
-      aac_bitwriter_write(&s->writer, AAC_WIN_SINE, 1);
-      aac_bitwriter_write(&s->writer, nb > 63 ? 63 : nb, 6);
-      aac_bitwriter_write(&s->writer, 0, 1);
-      int prev_sf_ch = s->scalefactors[ch][0];
-      for (int b = 0; b < nb; b++) {
-        int cb = s->codebooks[ch][b];
-        aac_bitwriter_write(&s->writer, cb, 4);
-        if (cb == 0 || cb >= 13) {
-          continue;
-        }
-        int dpcm = s->scalefactors[ch][b] - prev_sf_ch;
-        prev_sf_ch = s->scalefactors[ch][b];
-        aac_bitwriter_write_signed(&s->writer, dpcm, 9);
-        for (int i = sfb[b]; i < sfb[b + 1]; i += 2) {
-          int x = s->quant_coeffs[ch][i];
-          int y = (i + 1 < sfb[b + 1]) ? s->quant_coeffs[ch][i + 1] : 0;
-          int mv = aac_codebook_info[cb].max_val;
-          if (aac_codebook_info[cb].is_unsigned) {
-            x = std::clamp(x, 0, mv);
-            y = std::clamp(y, 0, mv);
-          } else {
-            x = std::clamp(x, -mv, mv);
-            y = std::clamp(y, -mv, mv);
-          }
-          aac_bitwriter_write_huffman(&s->writer, cb, x, y);
-        }
+
+    if (telemetry) {
+      int64_t t1 = now_ns();
+      stats.mdct_ns = t1 - t0;
+      t0 = t1;
+    }
+
+    /* M/S decision for stereo */
+    if (s->channels == 2) {
+      decide_ms(s, s->spectral[0], s->spectral[1], nb, sfb);
+    }
+
+    /* Psychoacoustic analysis */
+    for (int c = 0; c < s->channels; c++) {
+      aac_psycho_analyze(&s->psycho_state[c], s->spectral[c], nb, sfb);
+    }
+    if (telemetry) {
+      int64_t t1 = now_ns();
+      stats.psycho_ns = t1 - t0;
+      t0 = t1;
+    }
+
+    /* TNS flattens the temporal envelope of attack frames before
+     * quantization; thresholds above were taken on the unfiltered spectrum */
+    for (int c = 0; c < s->channels; c++) {
+      s->tns_present[c] =
+          attack[c] && aac_tns_encode(&s->tns[c], s->spectral[c], nb, ri, s->frame_length,
+                                      AAC_WIN_ONLY_LONG, s->preset.tns_filters, s->dsp);
+      if (s->tns_present[c]) {
+        aac_tns_band_noise_gain(&s->tns[c], s->tns_gain[c], nb, ri, s->frame_length);
+      }
+      if (s->preset.pns) {
+        analyze_pns(s, c, sfb, nb);
+      }
+    }
+
+    /* Pass 2 replaces the flat per-frame target with the planned share and
+     * seeds lambda from the pass-1 slope, so a few refinements suffice. The
+     * share is already net of the frame's recorded overhead, SBR included. */
+    int max_iterations = s->preset.rc_max_iterations;
+    if (s->twopass && aac_twopass_frame_plan(s->twopass, &target_bits, &s->lambda)) {
+      max_iterations = std::min(max_iterations, AAC_TWOPASS_MAX_ITERATIONS);
+    }
+
+    /* Quantization with rate control iterations. A frame is accepted up to
+     * the tolerance under its target but never over it, so a loose tolerance
+     * saves iterations without raising the bitrate. Once lambdas on both sides
+     * of the target are known the search bisects between them; the bit count
+     * steps with lambda, and the proportional update alone can oscillate
+     * across the target until the iterations run out. */
+    int tolerance = (int)((float)target_bits * s->preset.rc_tolerance);
+    if (s->aot == AAC_AOT_LD) {
+      target_bits -= tolerance; /* accept only frames under the hard budget */
+    }
+    float lambda_over = 0.0f, lambda_under = 0.0f; /* 0: not seen yet */
+    for (int iter = 0; iter < max_iterations; iter++) {
+      iterations++;
+      used_lambda = s->lambda;
+      est_bits = quantize_all(s, used_lambda, sfb, nb);
+      int diff = est_bits - target_bits;
+      if (diff > -tolerance && diff <= 0) {
+        break;
+      }
+      if (diff > 0) {
+        lambda_over = std::max(lambda_over, used_lambda);
+      } else if (lambda_under == 0.0f || used_lambda < lambda_under) {
+        lambda_under = used_lambda;
+      }
+      float new_lambda = lambda_over > 0.0f && lambda_under > lambda_over
+                             ? sqrtf(lambda_over * lambda_under)
+                             : aac_rate_control_lambda(s, est_bits, target_bits);
+      if (new_lambda > 0 && std::isfinite(new_lambda)) {
+        s->lambda = std::max(1e-8f, std::min(new_lambda, 1e6f));
       }
     }
+    /* Out of iterations above the target: fall back to the last lambda that fit */
+    if (est_bits > target_bits && lambda_under > 0.0f) {
+      s->lambda = used_lambda = lambda_under;
+      est_bits = quantize_all(s, used_lambda, sfb, nb);
+    }
+
+    trim_max_sfb(s, nb);
+
+    if (telemetry) {
+      int64_t t1 = now_ns();
+      stats.quant_ns = t1 - t0;
+      t0 = t1;
+    }
   }
 
-  aac_bitwriter_write(&s->writer, AAC_ELEM_END, 3);
-  aac_bitwriter_byte_align(&s->writer);
+  int frame_bits = write_frame(s, sfb, &stats);
+  /* AAC-LD has no bit reservoir: a frame over its budget is requantized
+   * coarser until it fits, so no frame has to wait for later ones */
+  const int ld_budget = s->target_bits_per_frame - (s->element_only ? 8 : 0);
+  for (int retry = 0; s->aot == AAC_AOT_LD && !silent && frame_bits > ld_budget &&
+                      retry < kLdMaxRequantize;
+       retry++) {
+    iterations++;
+    s->lambda = used_lambda =
+        std::min(used_lambda * std::max((float)frame_bits / (float)ld_budget, 1.1f), 1e6f);
+    est_bits = quantize_all(s, used_lambda, sfb, nb);
+    trim_max_sfb(s, nb);
+    frame_bits = write_frame(s, sfb, &stats);
+  }
+  const int frame_len = s->element_only ? 0 : frame_bits / 8;
 
-  int frame_len = aac_bitwriter_bytes_written(&s->writer);
-  hdr.frame_length = frame_len;
-  aac_adts_write(&hdr, s->output_buf);
+  /* Reservoir bookkeeping: unspent bits carry over up to one maximal frame
+   * (none in AAC-LD, where every frame is sent as soon as it is coded) */
+  int max_reservoir = std::max(AAC_BITS_PER_FRAME_LONG * s->channels - s->target_bits_per_frame, 0);
+  if (s->aot == AAC_AOT_LD) {
+    max_reservoir = 0;
+  }
+  s->bit_reservoir =
+      std::clamp(s->bit_reservoir + s->target_bits_per_frame - frame_bits, 0, max_reservoir);
 
-  return frame_len;
+  if (telemetry) {
+    stats.bitstream_ns = now_ns() - t0;
+    stats.frame_index = s->frame_count;
+    stats.rc_iterations = iterations;
+    stats.lambda = used_lambda;
+    stats.target_bits = target_bits;
+    stats.sbr_bits = sbr_bits;
+    stats.frame_bits = frame_bits;
+    stats.reservoir_bits = s->bit_reservoir;
+    stats.window_sequence = AAC_WIN_ONLY_LONG;
+    s->stats_cb(&stats, s->stats_user);
+  }
+
+  if (s->twopass && s->twopass->pass == 1) {
+    AacPassStatsFrame st = {};
+    for (int c = 0; c < s->channels && !silent; c++) {
+      st.pe += aac_psycho_get_pe(&s->psycho_state[c]);
+      if (detect_transient(ch_buf[c], ns)) {
+        st.flags |= AAC_PASS_FLAG_TRANSIENT;
+      }
+    }
+    st.lambda = used_lambda;
+    st.est_bits = est_bits;
+    st.frame_bits = frame_bits;
+    /* Probe one octave of lambda for the local R-D slope. The bitstream is
+     * already written, so overwriting the quantizer state is harmless. */
+    int probe_bits = silent ? 0 : quantize_all(s, used_lambda * 2.0f, sfb, nb);
+    st.slope = (est_bits > 0 && probe_bits > 0)
+                   ? log2f((float)est_bits / (float)probe_bits)
+                   : 1.0f;
+    if (aac_twopass_record(s->twopass, &st) != AAC_OK) {
+      return AAC_ERR_ENCODE;
+    }
+  } else if (s->twopass) {
+    aac_twopass_frame_done(s->twopass, frame_bits);
+  }
+
+  s->frame_count++;
+  return s->element_only ? frame_bits : frame_len;
 }
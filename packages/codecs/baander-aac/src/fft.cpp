@@ -23,7 +23,44 @@ static void bit_reverse(float* re, float* im, int n) {
   }
 }
 
+/* n = 2^k * m with m odd, as for the 240-point FFT of a 480-sample AAC-LD
+ * frame (16 * 15): m interleaved radix-2 FFTs of n / m points, combined by
+ * m-point DFTs. O(n * m), which is small for the odd factors AAC uses. */
+static void fft_mixed(float* re, float* im, int n) {
+  int m = n;
+  while ((m & 1) == 0) {
+    m >>= 1;
+  }
+  const int q = n / m;
+  static thread_local float s_re[1024], s_im[1024], s_cos[1024], s_sin[1024];
+  for (int r = 0; r < m; r++) {
+    for (int j = 0; j < q; j++) {
+      s_re[r * q + j] = re[j * m + r];
+      s_im[r * q + j] = im[j * m + r];
+    }
+    aac_fft_forward_c(s_re + r * q, s_im + r * q, q);
+  }
+  for (int t = 0; t < n; t++) {
+    s_cos[t] = cosf(2.0f * (float)M_PI * (float)t / (float)n);
+    s_sin[t] = -sinf(2.0f * (float)M_PI * (float)t / (float)n);
+  }
+  for (int k = 0; k < n; k++) {
+    float acc_re = 0.0f, acc_im = 0.0f;
+    for (int r = 0, t = 0; r < m; r++, t = (t + k) % n) {
+      float yr = s_re[r * q + k % q], yi = s_im[r * q + k % q];
+      acc_re += yr * s_cos[t] - yi * s_sin[t];
+      acc_im += yr * s_sin[t] + yi * s_cos[t];
+    }
+    re[k] = acc_re;
+    im[k] = acc_im;
+  }
+}
+
 void aac_fft_forward_c(float* re, float* im, int n) {
+  if (n & (n - 1)) {
+    fft_mixed(re, im, n);
+    return;
+  }
   bit_reverse(re, im, n);
   for (int s = 1; s < n; s <<= 1) {
     int m = s << 1;
@@ -0,0 +1,232 @@
+#include "gain.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "aac.h"
+#include "aac_tables.h"
+#include "mdct.h"
+#include "sbr.h"
+#include "spectral.h"
+
+/* Two ICS per channel element, up to 4 blocks */
+#define GAIN_MAX_EDITS (8 * AAC_MAX_ELEMENTS)
+#define FIL_EXT_SBR_DATA_CRC 14
+
+/* A global_gain to rewrite once the frame has parsed */
+using GainEdit = struct GainEdit_ {
+  int pos, value;
+};
+
+using GainWalk = struct GainWalk_ {
+  AacBitReader r;
+  const AacAudioConfig* cfg;
+  int steps;
+  GainEdit edits[GAIN_MAX_EDITS];
+  int n_edits;
+};
+
+static int bit_position(const AacBitReader* br) { return br->byte_pos * 8 + br->bit_pos; }
+
+static void put_bits(uint8_t* data, int pos, uint32_t v, int n) {
+  for (int i = n - 1; i >= 0; i--, pos++) {
+    const auto m = (uint8_t)(0x80 >> (pos & 7));
+    data[pos >> 3] = (v >> i) & 1 ? data[pos >> 3] | m : data[pos >> 3] & ~m;
+  }
+}
+
+/* A codeword's length is all the walk needs from it */
+static int skip_pair(AacBitReader* r, int cb) {
+  const int hit = aac_huff_lookup[cb][aac_bitreader_peek(r, AAC_HUFF_LOOKUP_BITS)];
+  if (hit) {
+    aac_bitreader_skip(r, hit & 31);
+    return AAC_OK;
+  }
+  int x, y;
+  return aac_bitreader_read_huffman(r, cb, &x, &y);
+}
+
+/* One individual_channel_stream, read as parse_ics and decode_spectral do */
+static int walk_ics(GainWalk* g) {
+  AacBitReader* r = &g->r;
+  const int ri = g->cfg->sample_rate_index, n = g->cfg->frame_length;
+  const int gg_pos = bit_position(r);
+  const int gg = (int)aac_bitreader_read(r, 8);
+  const int ws = (int)aac_bitreader_read(r, 2);
+  aac_bitreader_read(r, 1); /* window_shape */
+  const bool is_short = ws == AAC_WIN_EIGHT_SHORT;
+  const int max_sfb = (int)aac_bitreader_read(r, is_short ? 4 : 6);
+  if (is_short) {
+    aac_bitreader_read(r, 7); /* scale_factor_grouping */
+  } else if (aac_bitreader_read(r, 1) && aac_bitreader_read(r, 1)) {
+    aac_bitreader_read(r, 5); /* prediction reset */
+  }
+  AacTnsInfo tns;
+  if (aac_bitreader_read(r, 1) && aac_tns_read(r, &tns, ws) != AAC_OK) {
+    return AAC_ERR_DECODE;
+  }
+  if (n != AAC_FRAME_SIZE_LONG && ws != AAC_WIN_ONLY_LONG) {
+    return AAC_ERR_DECODE;
+  }
+  const int nsfb = is_short ? aac_num_sfb_short[ri] : aac_num_sfb(ri, n);
+  const int* sfb = is_short ? aac_sfb_offset_short[ri] : aac_sfb_offsets(ri, n);
+
+  bool coded = false;
+  for (int b = 0; b < std::min(max_sfb, nsfb); b++) {
+    if (aac_bitreader_bits_left(r) < 4) {
+      return AAC_ERR_DECODE;
+    }
+    const int cb = (int)aac_bitreader_read(r, 4);
+    if (cb == AAC_PNS_CODEBOOK) {
+      aac_bitreader_read(r, 9); /* noise energy dpcm */
+      coded = true;
+      continue;
+    }
+    if (cb == 0 || cb > AAC_PNS_CODEBOOK) {
+      continue;
+    }
+    coded = true;
+    aac_bitreader_read(r, 9); /* scalefactor dpcm */
+    for (int bin = std::max(sfb[b], 0); bin < sfb[b + 1] && bin < n; bin += 2) {
+      if (skip_pair(r, cb) != AAC_OK) {
+        return AAC_ERR_DECODE;
+      }
+    }
+  }
+  if (!coded) {
+    return AAC_OK;
+  }
+
+  /* Louder is a larger global_gain, noise energies included */
+  if (gg + g->steps < 0 || gg + g->steps > 255) {
+    return AAC_ERR_OVERFLOW;
+  }
+  g->edits[g->n_edits++] = {gg_pos, gg + g->steps};
+  return AAC_OK;
+}
+
+static int walk_element(GainWalk* g, int type) {
+  aac_bitreader_read(&g->r, 4); /* element_instance_tag */
+  if (type != AAC_ELEM_CPE) {
+    return walk_ics(g);
+  }
+  if (aac_bitreader_read(&g->r, 1)) {
+    return AAC_ERR_UNSUPPORTED; /* common_window */
+  }
+  const int ret = walk_ics(g);
+  return ret != AAC_OK ? ret : walk_ics(g);
+}
+
+static int walk_block(GainWalk* g) {
+  const AacAudioConfig* cfg = g->cfg;
+  AacBitReader* r = &g->r;
+  if (cfg->object_type == AAC_AOT_LD) {
+    if (cfg->channel_config < 1 || cfg->channel_config > 7) {
+      return AAC_ERR_UNSUPPORTED;
+    }
+    const AacChannelConfig* layout = &aac_channel_config[cfg->channel_config];
+    for (int e = 0; e < layout->num_elements; e++) {
+      const int ret = walk_element(g, layout->elements[e]);
+      if (ret != AAC_OK) {
+        return ret;
+      }
+    }
+    return AAC_OK;
+  }
+
+  int n_elems = 0;
+  for (int max_elements = 16; aac_bitreader_bits_left(r) > 3 && max_elements > 0; max_elements--) {
+    const int type = (int)aac_bitreader_read(r, 3);
+    if (type == AAC_ELEM_END) {
+      break;
+    }
+    switch (type) {
+      case AAC_ELEM_SCE:
+      case AAC_ELEM_CPE:
+      case AAC_ELEM_LFE: {
+        if (n_elems++ == AAC_MAX_ELEMENTS) {
+          return AAC_ERR_DECODE;
+        }
+        const int ret = walk_element(g, type);
+        if (ret != AAC_OK) {
+          return ret;
+        }
+        break;
+      }
+      case AAC_ELEM_FIL: {
+        int cnt = (int)aac_bitreader_read(r, 4);
+        if (cnt == 15) {
+          cnt += (int)aac_bitreader_read(r, 8) - 1;
+        }
+        if (cnt > 0) {
+          const int ext = (int)aac_bitreader_peek(r, 4);
+          if (ext == AAC_FIL_EXT_SBR_DATA || ext == FIL_EXT_SBR_DATA_CRC) {
+            return AAC_ERR_UNSUPPORTED;
+          }
+        }
+        aac_bitreader_skip(r, cnt * 8);
+        break;
+      }
+      default:
+        return AAC_ERR_UNSUPPORTED;
+    }
+  }
+  return AAC_OK;
+}
+
+/* Walk up to blocks raw data blocks of data, each byte-aligned after its
+ * END, then write the fields; nothing is written unless every block parsed */
+static int gain_walk(const AacAudioConfig* cfg, uint8_t* data, int size, int blocks, int steps) {
+  if (cfg->object_type == AAC_AOT_SBR || cfg->object_type == AAC_AOT_PS) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  if (cfg->sample_rate_index >= AAC_NUM_SAMPLE_RATES ||
+      aac_num_sfb(cfg->sample_rate_index, cfg->frame_length) == 0) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  GainWalk g;
+  aac_bitreader_init(&g.r, data, size);
+  g.cfg = cfg;
+  g.steps = steps;
+  g.n_edits = 0;
+  for (int b = 0; b < blocks && aac_bitreader_bits_left(&g.r) > 0; b++) {
+    const int ret = walk_block(&g);
+    if (ret != AAC_OK) {
+      return ret;
+    }
+    aac_bitreader_byte_align(&g.r);
+  }
+  if (aac_bitreader_bits_left(&g.r) < 0) {
+    return AAC_ERR_DECODE;
+  }
+  for (int i = 0; i < g.n_edits; i++) {
+    const GainEdit* e = &g.edits[i];
+    put_bits(data, e->pos, (uint32_t)e->value, 8);
+  }
+  return AAC_OK;
+}
+
+int aac_gain_block(const AacAudioConfig* cfg, uint8_t* data, int size, int steps) {
+  return gain_walk(cfg, data, size, 1, steps);
+}
+
+int aac_gain_adts(uint8_t* frame, int size, int steps) {
+  AacAdtsHeader hdr;
+  if (aac_adts_parse(&hdr, frame, size) != 0 || hdr.frame_length > size ||
+      hdr.frame_length < AAC_ADTS_HEADER_SIZE) {
+    return AAC_ERR_DECODE;
+  }
+  /* The CRC would cover the rewritten fields */
+  if (!hdr.protection_absent) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  AacAudioConfig cfg = {};
+  cfg.object_type = hdr.profile;
+  cfg.sample_rate_index = hdr.sample_rate_index;
+  cfg.ext_rate_index = hdr.sample_rate_index;
+  cfg.channel_config = hdr.channel_config;
+  cfg.frame_length = AAC_FRAME_SIZE_LONG;
+  /* Blocks follow one another; a frame may end before the count it signals */
+  return gain_walk(&cfg, frame + AAC_ADTS_HEADER_SIZE, hdr.frame_length - AAC_ADTS_HEADER_SIZE,
+                   hdr.num_aac_frames + 1, steps);
+}
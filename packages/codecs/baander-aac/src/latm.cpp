@@ -0,0 +1,254 @@
+#include "latm.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "aac.h"
+
+static int bit_position(const AacBitReader* br) { return br->byte_pos * 8 + br->bit_pos; }
+
+static void skip_bits(AacBitReader* br, int n) {
+  const int pos = bit_position(br) + n;
+  br->byte_pos = pos >> 3;
+  br->bit_pos = pos & 7;
+}
+
+/* LatmGetValue: 2 bits of length, then 1-4 bytes */
+static uint32_t latm_value(AacBitReader* br) {
+  const int bytes = (int)aac_bitreader_read(br, 2);
+  uint32_t v = 0;
+  for (int i = 0; i <= bytes; i++) {
+    v = (v << 8) | aac_bitreader_read(br, 8);
+  }
+  return v;
+}
+
+/* bits bits of src from bit offset bit, left-aligned into out */
+static void copy_bits(const uint8_t* src, int size, int bit, int bits, uint8_t* out) {
+  const int s = bit & 7;
+  const int first = bit >> 3, n = (bits + 7) / 8;
+  for (int i = 0; i < n; i++) {
+    const int lo = first + i + 1 < size ? src[first + i + 1] : 0;
+    out[i] = (uint8_t)((src[first + i] << s) | (lo >> (8 - s)));
+  }
+  if (bits & 7) {
+    out[n - 1] &= (uint8_t)(0xFF << (8 - (bits & 7)));
+  }
+}
+
+static int parse_stream_mux_config(AacLatmReader* r, AacBitReader* br) {
+  const int version = (int)aac_bitreader_read(br, 1);
+  if (version && aac_bitreader_read(br, 1)) {
+    return AAC_ERR_UNSUPPORTED; /* audioMuxVersionA */
+  }
+  if (version) {
+    latm_value(br); /* taraBufferFullness */
+  }
+  if (!aac_bitreader_read(br, 1)) {
+    return AAC_ERR_UNSUPPORTED; /* allStreamsSameTimeFraming */
+  }
+  const int subframes = (int)aac_bitreader_read(br, 6) + 1;
+  if (aac_bitreader_read(br, 4) != 0 || aac_bitreader_read(br, 3) != 0) {
+    return AAC_ERR_UNSUPPORTED; /* more than one program or layer */
+  }
+  const uint32_t asc_len = version ? latm_value(br) : 0;
+  if (asc_len > 8 * sizeof(r->asc)) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  const int start = bit_position(br);
+  AacAudioConfig cfg;
+  int ret = aac_audio_config_read(&cfg, br);
+  if (ret != AAC_OK) {
+    return ret;
+  }
+  int asc_bits = bit_position(br) - start;
+  if (version) { /* ascLen covers the config and its fill bits */
+    if ((int)asc_len < asc_bits) {
+      return AAC_ERR_DECODE;
+    }
+    skip_bits(br, (int)asc_len - asc_bits);
+    asc_bits = (int)asc_len;
+  }
+  if (aac_bitreader_read(br, 3) != 0) {
+    return AAC_ERR_UNSUPPORTED; /* frameLengthType */
+  }
+  skip_bits(br, 8); /* latmBufferFullness */
+  if (aac_bitreader_read(br, 1)) { /* otherDataPresent */
+    if (version) {
+      latm_value(br);
+    } else {
+      int escape;
+      do {
+        escape = (int)aac_bitreader_read(br, 1);
+        skip_bits(br, 8);
+      } while (escape && aac_bitreader_bits_left(br) > 0);
+    }
+  }
+  if (aac_bitreader_read(br, 1)) {
+    skip_bits(br, 8); /* crcCheckSum */
+  }
+  if (aac_bitreader_bits_left(br) < 0) {
+    return AAC_ERR_DECODE;
+  }
+  uint8_t asc[sizeof(r->asc)];
+  const int asc_size = (asc_bits + 7) / 8;
+  copy_bits(br->data, br->size, start, asc_bits, asc);
+  r->config_changed |= !r->has_config || asc_size != r->asc_size ||
+                       memcmp(asc, r->asc, asc_size) != 0;
+  memcpy(r->asc, asc, asc_size);
+  r->asc_size = asc_size;
+  r->config = cfg;
+  r->num_subframes = subframes;
+  r->has_config = 1;
+  return AAC_OK;
+}
+
+/* AudioMuxElement(1): note where each subframe's payload is */
+static int parse_element(AacLatmReader* r, const uint8_t* data, int size) {
+  AacBitReader br;
+  aac_bitreader_init(&br, data, size);
+  r->subframes = r->subframe = 0;
+  if (!aac_bitreader_read(&br, 1)) { /* useSameStreamMux */
+    int ret = parse_stream_mux_config(r, &br);
+    if (ret != AAC_OK) {
+      r->has_config = 0;
+      return ret;
+    }
+  } else if (!r->has_config) {
+    return AAC_ERR_STATE;
+  }
+  for (int i = 0; i < r->num_subframes; i++) {
+    int len = 0, tmp;
+    do { /* PayloadLengthInfo */
+      tmp = (int)aac_bitreader_read(&br, 8);
+      len += tmp;
+    } while (tmp == 255);
+    if (aac_bitreader_bits_left(&br) < len * 8) {
+      return AAC_ERR_DECODE;
+    }
+    r->offsets[i] = bit_position(&br);
+    r->sizes[i] = len;
+    skip_bits(&br, len * 8);
+  }
+  r->element = data;
+  r->element_size = size;
+  r->subframes = r->num_subframes;
+  return AAC_OK;
+}
+
+AacLatmReader* aac_latm_reader_state_create(const AacDSP* dsp) {
+  auto* r = new AacLatmReader();
+  r->framer = aac_adts_framer_state_create(dsp, 1);
+  return r;
+}
+
+void aac_latm_reader_state_destroy(AacLatmReader* r) {
+  aac_adts_framer_state_destroy(r->framer);
+  delete r;
+}
+
+int aac_latm_reader_state_feed(AacLatmReader* r, const uint8_t* data, int size) {
+  if (r->subframe < r->subframes) {
+    return AAC_ERR_STATE;
+  }
+  return aac_adts_framer_state_feed(r->framer, data, size);
+}
+
+int aac_latm_reader_state_next(AacLatmReader* r, const uint8_t** au, int* size) {
+  for (;;) {
+    if (r->subframe < r->subframes) {
+      const int i = r->subframe++;
+      copy_bits(r->element, r->element_size, r->offsets[i], r->sizes[i] * 8, r->au);
+      *au = r->au;
+      *size = r->sizes[i];
+      const int ret = r->config_changed ? 2 : 1;
+      r->config_changed = 0;
+      return ret;
+    }
+    const uint8_t* frame;
+    int len;
+    if (!aac_adts_framer_state_next(r->framer, &frame, &len)) {
+      return 0;
+    }
+    if (parse_element(r, frame + AAC_LOAS_HEADER_SIZE, len - AAC_LOAS_HEADER_SIZE) != AAC_OK) {
+      r->dropped++;
+    }
+  }
+}
+
+/* ── Writer ───────────────────────────────────────────────────── */
+
+/* Whole bytes at any bit position; the writer's buffer is zeroed */
+static void put_bytes(AacBitWriter* w, const uint8_t* data, int size) {
+  uint8_t* p = w->data + w->byte_pos;
+  const int s = w->bit_pos;
+  if (s == 0) {
+    memcpy(p, data, size);
+  } else {
+    for (int i = 0; i < size; i++) {
+      p[i] |= (uint8_t)(data[i] >> s);
+      p[i + 1] = (uint8_t)(data[i] << (8 - s));
+    }
+  }
+  w->byte_pos += size;
+}
+
+AacLatmWriter* aac_latm_writer_state_create(const uint8_t* asc, int asc_size,
+                                            int config_interval) {
+  AacAudioConfig cfg;
+  if (config_interval < 1 || aac_audio_config_parse(&cfg, asc, asc_size) != AAC_OK) {
+    return nullptr;
+  }
+  auto* w = new AacLatmWriter();
+  w->config = cfg;
+  w->config_interval = config_interval;
+  return w;
+}
+
+void aac_latm_writer_state_destroy(AacLatmWriter* w) { delete w; }
+
+int aac_latm_writer_state_write(AacLatmWriter* w, const uint8_t* au, int size, uint8_t* out,
+                                int out_size) {
+  /* useSameStreamMux and a StreamMuxConfig take at most 61 bits; then the
+   * length bytes, the payload and the byte put_bytes spills into */
+  const int bound = AAC_LOAS_HEADER_SIZE + 10 + size / 255 + 1 + size;
+  if (size < 0) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  if (out_size < bound) {
+    return AAC_ERR_OVERFLOW;
+  }
+  AacBitWriter bw;
+  aac_bitwriter_init(&bw, out + AAC_LOAS_HEADER_SIZE, bound - AAC_LOAS_HEADER_SIZE);
+  const bool with_config = w->frames % w->config_interval == 0;
+  aac_bitwriter_write(&bw, !with_config, 1); /* useSameStreamMux */
+  if (with_config) {
+    aac_bitwriter_write(&bw, 0, 1); /* audioMuxVersion */
+    aac_bitwriter_write(&bw, 1, 1); /* allStreamsSameTimeFraming */
+    aac_bitwriter_write(&bw, 0, 6); /* numSubFrames - 1 */
+    aac_bitwriter_write(&bw, 0, 4); /* numProgram - 1 */
+    aac_bitwriter_write(&bw, 0, 3); /* numLayer - 1 */
+    aac_audio_config_put(&w->config, &bw);
+    aac_bitwriter_write(&bw, 0, 3);    /* frameLengthType */
+    aac_bitwriter_write(&bw, 0xFF, 8); /* latmBufferFullness: variable rate */
+    aac_bitwriter_write(&bw, 0, 1);    /* otherDataPresent */
+    aac_bitwriter_write(&bw, 0, 1);    /* crcCheckPresent */
+  }
+  for (int n = size;; n -= 255) { /* PayloadLengthInfo */
+    aac_bitwriter_write(&bw, std::min(n, 255), 8);
+    if (n < 255) {
+      break;
+    }
+  }
+  put_bytes(&bw, au, size);
+  aac_bitwriter_byte_align(&bw);
+  const int len = aac_bitwriter_bytes_written(&bw);
+  if (len > AAC_LOAS_MAX_FRAME - AAC_LOAS_HEADER_SIZE) {
+    return AAC_ERR_OVERFLOW;
+  }
+  out[0] = 0x56;
+  out[1] = (uint8_t)(0xE0 | (len >> 8));
+  out[2] = (uint8_t)len;
+  w->frames++;
+  return AAC_LOAS_HEADER_SIZE + len;
+}
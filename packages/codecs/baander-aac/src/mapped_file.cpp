@@ -0,0 +1,79 @@
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+#include "aac.h"
+
+#if !defined(_WIN32) && !defined(BAAC_AAC_WASM)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+int aac_mapped_file_open(AacMappedFile* f, const char* path) {
+  *f = AacMappedFile{};
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return AAC_ERR_INIT;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return AAC_ERR_INIT;
+  }
+  f->size = st.st_size;
+  f->mtime = st.st_mtime;
+  if (f->size > 0) {
+    void* p = mmap(nullptr, (size_t)f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      return AAC_ERR_INIT;
+    }
+    f->data = static_cast<const uint8_t*>(p);
+    f->mapped = 1;
+  }
+  close(fd); /* the mapping keeps the file */
+  return AAC_OK;
+}
+
+void aac_mapped_file_close(AacMappedFile* f) {
+  if (f->mapped) {
+    munmap(const_cast<uint8_t*>(f->data), (size_t)f->size);
+  } else {
+    free(const_cast<uint8_t*>(f->data));
+  }
+  *f = AacMappedFile{};
+}
+
+#else /* no mmap: read the whole file */
+
+int aac_mapped_file_open(AacMappedFile* f, const char* path) {
+  *f = AacMappedFile{};
+  struct stat st;
+  FILE* fp = fopen(path, "rb");
+  if (!fp || stat(path, &st) != 0) {
+    if (fp) {
+      fclose(fp);
+    }
+    return AAC_ERR_INIT;
+  }
+  f->size = st.st_size;
+  f->mtime = st.st_mtime;
+  auto* data = static_cast<uint8_t*>(malloc(f->size > 0 ? (size_t)f->size : 1));
+  if (!data || fread(data, 1, (size_t)f->size, fp) != (size_t)f->size) {
+    free(data);
+    fclose(fp);
+    return AAC_ERR_INIT;
+  }
+  fclose(fp);
+  f->data = data;
+  return AAC_OK;
+}
+
+void aac_mapped_file_close(AacMappedFile* f) {
+  free(const_cast<uint8_t*>(f->data));
+  *f = AacMappedFile{};
+}
+
+#endif
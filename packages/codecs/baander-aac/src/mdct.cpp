@@ -39,6 +39,11 @@ void aac_mdct_init(AacMdctContext* ctx, int frame_size_long, const AacDSP* dsp)
   aac_kbd_window(ctx->window_kbd_long, 2 * N, AAC_KBD_ALPHA_LONG);
   aac_sine_window(ctx->window_sine_short, 2 * ctx->frame_size_short);
   aac_kbd_window(ctx->window_kbd_short, 2 * ctx->frame_size_short, AAC_KBD_ALPHA_SHORT);
+  ctx->window_low_overlap = nullptr;
+  if (N != AAC_FRAME_SIZE_LONG) {
+    ctx->window_low_overlap = new float[static_cast<size_t>(2) * N];
+    aac_low_overlap_window(ctx->window_low_overlap, N);
+  }
 
   ctx->scratch_re = new float[static_cast<size_t>(N)]();
   ctx->scratch_im = new float[static_cast<size_t>(N)]();
@@ -81,6 +86,7 @@ void aac_mdct_free(AacMdctContext* ctx) {
   delete[] ctx->window_kbd_long;
   delete[] ctx->window_sine_short;
   delete[] ctx->window_kbd_short;
+  delete[] ctx->window_low_overlap;
   delete[] ctx->scratch_re;
   delete[] ctx->scratch_im;
   delete[] ctx->scratch_tmp;
@@ -92,6 +98,14 @@ void aac_mdct_free(AacMdctContext* ctx) {
   delete[] ctx->mdct_tw_im_short;
 }
 
+/* Long window for window_shape: shape 1 is KBD, or low-overlap in AAC-LD */
+static const float* long_window(const AacMdctContext* ctx, AacWindowShape shape) {
+  if (shape == AAC_WIN_SINE) {
+    return ctx->window_sine_long;
+  }
+  return ctx->window_low_overlap ? ctx->window_low_overlap : ctx->window_kbd_long;
+}
+
 /* ── Legacy MDCT forward (FFT-based, for test + DSP dispatch compatibility)
  *
  * Output contract:
@@ -170,9 +184,14 @@ void aac_mdct_forward_with_twiddles(float* out, const float* in, int n, const fl
  * that affects the rate control's convergence at higher bitrates. */
 
 void aac_mdct_forward_aac(AacMdctContext* ctx, float* out, const float* in, int n,
-                          AacWindowSequence /*win_seq*/, AacWindowShape win_shape,
-                          int /*channel*/) {
-  const float* win = (win_shape == AAC_WIN_KBD) ? ctx->window_kbd_long : ctx->window_sine_long;
+                          AacWindowSequence win_seq, AacWindowShape win_shape, int channel) {
+  aac_mdct_forward_aac_bins(ctx, out, in, n, n, win_seq, win_shape, channel);
+}
+
+void aac_mdct_forward_aac_bins(AacMdctContext* ctx, float* out, const float* in, int n, int n_bins,
+                               AacWindowSequence /*win_seq*/, AacWindowShape win_shape,
+                               int /*channel*/) {
+  const float* win = long_window(ctx, win_shape);
   float* overlap = ctx->overlap_long;
   int N = n;
   int N2 = 2 * N;
@@ -189,8 +208,12 @@ void aac_mdct_forward_aac(AacMdctContext* ctx, float* out, const float* in, int
   /* Save current for next frame */
   memcpy(overlap, in, N * sizeof(float));
 
-  /* Direct MDCT: X[k] = Σ buf[n] * cos(π*(2n+N+1)*(2k+1)/(4N)) */
-  for (int k = 0; k < N; k++) {
+  /* Direct MDCT: X[k] = Σ buf[n] * cos(π*(2n+N+1)*(2k+1)/(4N)), O(N) per bin,
+   * so bins past the encoder's bandwidth are not computed at all */
+  for (int k = n_bins; k < N; k++) {
+    out[k] = 0.0f;
+  }
+  for (int k = 0; k < n_bins; k++) {
     float sum = 0.0f;
     float freq = (2.0f * k + 1.0f) / (4.0f * (float)N);
     for (int nn = 0; nn < N2; nn++) {
@@ -303,9 +326,10 @@ static void dct4_fft(float* Y, const float* x, int N) {
  * Produces 2N windowed output from N spectral coefficients.
  * The fold twiddle factors sin/cos(π(2i+1)/(4N)) are exactly the
  * sine window values, so no separate window multiplication needed.
- * NOTE: only valid for sine window, not KBD. */
+ * win replaces them with another window; only the AAC-LD low-overlap
+ * window is passed, so KBD still decodes as sine. */
 
-static void imdct_fft(float* out, const float* X, int N) {
+static void imdct_fft(float* out, const float* X, int N, const float* win = nullptr) {
   static thread_local float s_z[1024];
   dct4_fft(s_z, X, N);
 
@@ -314,10 +338,17 @@ static void imdct_fft(float* out, const float* X, int N) {
 
   /* Fold: N DCT-4 values → 2N windowed output */
   for (int i = 0; i < N / 2; i++) {
-    float theta = (float)M_PI * (2 * i + 1) / (4.0f * N);
-    float ct = cosf(theta), st = sinf(theta);
     float a = s_z[N / 2 + i] * inv;
     float b = s_z[N / 2 - 1 - i] * inv;
+    if (win) {
+      out[i] = win[i] * a;
+      out[N - 1 - i] = -win[N - 1 - i] * a;
+      out[N + i] = -win[N + i] * b;
+      out[2 * N - 1 - i] = -win[2 * N - 1 - i] * b;
+      continue;
+    }
+    float theta = (float)M_PI * (2 * i + 1) / (4.0f * N);
+    float ct = cosf(theta), st = sinf(theta);
     out[i] = st * a;
     out[N - 1 - i] = -ct * a;
     out[N + i] = -ct * b;
@@ -325,6 +356,31 @@ static void imdct_fft(float* out, const float* X, int N) {
   }
 }
 
+/* ── FFT-based AAC forward MDCT (O(N log N)) ────────────────────
+ * Same windowing/overlap contract as aac_mdct_forward_aac, but folds the
+ * 2N windowed block to N samples and runs the FFT-based DCT-IV instead of
+ * the direct cosine sum. Output agrees to float rounding (<1e-4 relative);
+ * the encoder selects it only for the presets that trade exactness for speed. */
+
+void aac_mdct_forward_fast(AacMdctContext* ctx, float* out, const float* in, int n,
+                           AacWindowSequence /*win_seq*/, AacWindowShape win_shape,
+                           int /*channel*/) {
+  const float* win = long_window(ctx, win_shape);
+  float* overlap = ctx->overlap_long;
+  float* fold = ctx->scratch_tmp;
+  int N = n, N2 = n / 2, N3 = 3 * n / 2;
+
+  /* Fold overlap (first half) and current input (second half) of the
+   * 2N window: z[i] = win[i] * overlap[i], z[N + i] = win[N + i] * in[i] */
+  for (int i = 0; i < N2; i++) {
+    fold[i] = -win[N3 - 1 - i] * in[N2 - 1 - i] - win[N3 + i] * in[N2 + i];
+    fold[N2 + i] = win[i] * overlap[i] - win[N - 1 - i] * overlap[N - 1 - i];
+  }
+  memcpy(overlap, in, N * sizeof(float));
+
+  dct4_fft(out, fold, N);
+}
+
 /* ── AAC Inverse MDCT (overlap-add) ───────────────────────────── */
 
 void aac_imdct(AacMdctContext* ctx, float* out, const float* spectral, int n,
@@ -335,7 +391,7 @@ void aac_imdct(AacMdctContext* ctx, float* out, const float* spectral, int n,
   switch (win_seq) {
     case AAC_WIN_ONLY_LONG: {
       float* tmp = ctx->scratch_tmp;
-      imdct_fft(tmp, spectral, N);
+      imdct_fft(tmp, spectral, N, win_shape == AAC_WIN_SINE ? nullptr : ctx->window_low_overlap);
       for (int i = 0; i < N; i++) {
         out[i] = overlap[i] + tmp[i];
       }
@@ -0,0 +1,633 @@
+#include "mp4.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "aac.h"
+#include "aac_tables.h"
+
+static uint32_t rd16(const uint8_t* p) { return (p[0] << 8) | p[1]; }
+
+static uint32_t rd32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint64_t rd64(const uint8_t* p) { return ((uint64_t)rd32(p) << 32) | rd32(p + 4); }
+
+static constexpr uint32_t fourcc(const char* s) {
+  return ((uint32_t)(uint8_t)s[0] << 24) | ((uint32_t)(uint8_t)s[1] << 16) |
+         ((uint32_t)(uint8_t)s[2] << 8) | (uint8_t)s[3];
+}
+
+/* A box payload, or a run of sibling boxes */
+using Mp4Span = struct Mp4Span_ {
+  const uint8_t* data;
+  int64_t size;
+};
+
+/* Take the first box of *in into *box and its type; false at the end or on
+ * a box that overruns its parent */
+static bool next_box(Mp4Span* in, uint32_t* type, Mp4Span* box) {
+  if (in->size < 8) {
+    return false;
+  }
+  int64_t len = rd32(in->data);
+  int hdr = 8;
+  if (len == 1) { /* 64-bit largesize */
+    if (in->size < 16) {
+      return false;
+    }
+    len = (int64_t)std::min<uint64_t>(rd64(in->data + 8), INT64_MAX);
+    hdr = 16;
+  } else if (len == 0) { /* to the end of the parent */
+    len = in->size;
+  }
+  if (len < hdr || len > in->size) {
+    return false;
+  }
+  *type = rd32(in->data + 4);
+  box->data = in->data + hdr;
+  box->size = len - hdr;
+  in->data += len;
+  in->size -= len;
+  return true;
+}
+
+static bool find_box(Mp4Span in, uint32_t type, Mp4Span* box) {
+  uint32_t t;
+  while (next_box(&in, &t, box)) {
+    if (t == type) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* A full box's payload after version and flags, holding a count and then
+ * count entries of entry_size bytes; false when it is too short for them */
+static bool table_box(Mp4Span stbl, uint32_t type, int entry_size, const uint8_t** entries,
+                      uint32_t* count) {
+  Mp4Span box;
+  if (!find_box(stbl, type, &box) || box.size < 8) {
+    return false;
+  }
+  *count = rd32(box.data + 4);
+  *entries = box.data + 8;
+  return *count <= (box.size - 8) / entry_size;
+}
+
+/* Length of an MPEG-4 descriptor (ISO 14496-1 8.3.3) starting at *p, whose
+ * tag is skipped; -1 when it overruns end */
+static int64_t descriptor(const uint8_t** p, const uint8_t* end, int tag) {
+  if (*p >= end || **p != tag) {
+    return -1;
+  }
+  (*p)++;
+  int64_t len = 0;
+  for (int i = 0; i < 4; i++) {
+    if (*p >= end) {
+      return -1;
+    }
+    const uint8_t b = *(*p)++;
+    len = (len << 7) | (b & 0x7F);
+    if (!(b & 0x80)) {
+      return len <= end - *p ? len : -1;
+    }
+  }
+  return -1;
+}
+
+/* esds: ES_Descriptor > DecoderConfigDescriptor > DecoderSpecificInfo */
+static bool parse_esds(AacMp4Demuxer* m, Mp4Span esds) {
+  if (esds.size < 4) {
+    return false;
+  }
+  const uint8_t* p = esds.data + 4; /* version, flags */
+  const uint8_t* end = esds.data + esds.size;
+  int64_t len = descriptor(&p, end, 0x03);
+  if (len < 3) {
+    return false;
+  }
+  end = p + len;
+  const uint8_t flags = p[2];
+  p += 3; /* ES_ID, flags */
+  if (flags & 0x80) {
+    p += 2; /* dependsOn_ES_ID */
+  }
+  if (flags & 0x40) {
+    p += p < end ? 1 + *p : 0; /* URL */
+  }
+  if (flags & 0x20) {
+    p += 2; /* OCR_ES_Id */
+  }
+  len = descriptor(&p, end, 0x04);
+  if (len < 13) {
+    return false;
+  }
+  /* MPEG-4 audio, or MPEG-2 AAC Main, LC or SSR */
+  const int oti = p[0];
+  if (oti != 0x40 && (oti < 0x66 || oti > 0x68)) {
+    return false;
+  }
+  m->bitrate = (int)std::min<uint32_t>(rd32(p + 9), INT32_MAX);
+  end = p + len;
+  p += 13;
+  len = descriptor(&p, end, 0x05);
+  if (len < 2 || len > (int64_t)sizeof(m->asc)) {
+    return false;
+  }
+  memcpy(m->asc, p, len);
+  m->asc_size = (int)len;
+  return aac_audio_config_parse(&m->config, m->asc, m->asc_size) == AAC_OK;
+}
+
+/* stsd with an mp4a entry; QuickTime sound descriptions (versions 1 and 2)
+ * have longer fixed fields and may wrap esds in a wave box */
+static bool parse_stsd(AacMp4Demuxer* m, Mp4Span stbl) {
+  Mp4Span stsd, entry, esds;
+  if (!find_box(stbl, fourcc("stsd"), &stsd) || stsd.size < 8 || rd32(stsd.data + 4) == 0) {
+    return false;
+  }
+  Mp4Span entries = {stsd.data + 8, stsd.size - 8};
+  uint32_t type;
+  if (!next_box(&entries, &type, &entry) || type != fourcc("mp4a") || entry.size < 28) {
+    return false;
+  }
+  const uint32_t version = rd16(entry.data + 8);
+  const int64_t fixed = version == 0 ? 28 : (version == 1 ? 44 : (version == 2 ? 64 : -1));
+  if (fixed < 0 || entry.size < fixed) {
+    return false;
+  }
+  Mp4Span children = {entry.data + fixed, entry.size - fixed};
+  Mp4Span wave;
+  if (!find_box(children, fourcc("esds"), &esds) &&
+      !(find_box(children, fourcc("wave"), &wave) && find_box(wave, fourcc("esds"), &esds))) {
+    return false;
+  }
+  return parse_esds(m, esds);
+}
+
+/* Resolve every access unit's offset from stsc and stco/co64, and stop at
+ * the first that is malformed or runs past the end of the file */
+static bool build_offsets(AacMp4Demuxer* m, Mp4Span stbl) {
+  const uint8_t *stsc, *chunks;
+  uint32_t n_stsc, n_chunks, n;
+  int chunk_bytes = 4;
+  if (!table_box(stbl, fourcc("stsc"), 12, &stsc, &n_stsc)) {
+    return false;
+  }
+  if (!table_box(stbl, fourcc("stco"), 4, &chunks, &n_chunks)) {
+    chunk_bytes = 8;
+    if (!table_box(stbl, fourcc("co64"), 8, &chunks, &n_chunks)) {
+      return false;
+    }
+  }
+  Mp4Span stsz;
+  if (!find_box(stbl, fourcc("stsz"), &stsz) || stsz.size < 12) {
+    return false;
+  }
+  m->fixed_size = rd32(stsz.data + 4);
+  n = rd32(stsz.data + 8);
+  if (m->fixed_size == 0) {
+    if (n > (stsz.size - 12) / 4) {
+      return false;
+    }
+    m->sizes = stsz.data + 12;
+  } else if (n > m->file.size / std::max<uint32_t>(m->fixed_size, 4)) {
+    /* No more than a table of sizes in the same file could list, which keeps
+     * the offsets within twice the file */
+    return false;
+  }
+  /* Nor may stsz count more access units than the chunks hold: with a fixed
+   * size, only those that fit between a chunk's offset and the end of file */
+  uint64_t capacity = 0;
+  for (uint32_t e = 0; e < n_stsc && capacity < n; e++) {
+    const uint32_t first = rd32(stsc + 12 * e), per = rd32(stsc + 12 * e + 4);
+    const uint32_t last = e + 1 < n_stsc ? rd32(stsc + 12 * (e + 1)) - 1 : n_chunks;
+    if (first == 0 || per == 0 || last < first - 1) {
+      break;
+    }
+    for (uint32_t c = first; c <= std::min(last, n_chunks) && capacity < n; c++) {
+      const uint8_t* entry = chunks + (int64_t)(c - 1) * chunk_bytes;
+      const uint64_t off = chunk_bytes == 4 ? rd32(entry) : rd64(entry);
+      const uint64_t left = off < (uint64_t)m->file.size ? m->file.size - off : 0;
+      capacity += m->sizes ? per : std::min<uint64_t>(per, left / m->fixed_size);
+    }
+  }
+  if (n > capacity) {
+    return false;
+  }
+  try {
+    m->offsets = new int64_t[std::max<uint32_t>(n, 1)];
+  } catch (const std::bad_alloc&) {
+    return false;
+  }
+  int64_t s = 0;
+  for (uint32_t e = 0; e < n_stsc && s < n; e++) {
+    const uint32_t first = rd32(stsc + 12 * e), per = rd32(stsc + 12 * e + 4);
+    const uint32_t last = e + 1 < n_stsc ? rd32(stsc + 12 * (e + 1)) - 1 : n_chunks;
+    if (first == 0 || per == 0 || last < first - 1) {
+      break;
+    }
+    for (uint32_t c = first; c <= std::min(last, n_chunks) && s < n; c++) {
+      const uint8_t* entry = chunks + (int64_t)(c - 1) * chunk_bytes;
+      uint64_t off = chunk_bytes == 4 ? rd32(entry) : rd64(entry);
+      for (uint32_t k = 0; k < per && s < n; k++, s++) {
+        const int size = aac_mp4_demuxer_state_size(m, s);
+        if (size <= 0 || off > (uint64_t)m->file.size || (uint64_t)size > m->file.size - off) {
+          m->frames = s;
+          return true;
+        }
+        m->offsets[s] = (int64_t)off;
+        off += size;
+      }
+    }
+  }
+  m->frames = s;
+  return true;
+}
+
+/* The first trak whose handler is sound and whose sample entry is AAC */
+static bool parse_moov(AacMp4Demuxer* m, Mp4Span moov) {
+  uint32_t type;
+  Mp4Span trak;
+  while (next_box(&moov, &type, &trak)) {
+    Mp4Span mdia, mdhd, hdlr, minf, stbl;
+    if (type != fourcc("trak") || !find_box(trak, fourcc("mdia"), &mdia) ||
+        !find_box(mdia, fourcc("hdlr"), &hdlr) || hdlr.size < 12 ||
+        rd32(hdlr.data + 8) != fourcc("soun") || !find_box(mdia, fourcc("mdhd"), &mdhd) ||
+        mdhd.size < 4 || mdhd.size < (mdhd.data[0] == 1 ? 36 : 24) ||
+        !find_box(mdia, fourcc("minf"), &minf) || !find_box(minf, fourcc("stbl"), &stbl) ||
+        !parse_stsd(m, stbl) ||
+        !table_box(stbl, fourcc("stts"), 8, &m->stts, &m->stts_count)) {
+      continue;
+    }
+    m->timescale = rd32(mdhd.data + (mdhd.data[0] == 1 ? 20 : 12));
+    return m->timescale > 0 && build_offsets(m, stbl);
+  }
+  return false;
+}
+
+AacMp4Demuxer* aac_mp4_demuxer_state_open(const char* path) {
+  auto* m = new AacMp4Demuxer();
+  Mp4Span moov;
+  if (aac_mapped_file_open(&m->file, path) != AAC_OK ||
+      !find_box(Mp4Span{m->file.data, m->file.size}, fourcc("moov"), &moov) ||
+      !parse_moov(m, moov) || m->frames == 0) {
+    aac_mp4_demuxer_state_close(m);
+    return nullptr;
+  }
+  return m;
+}
+
+void aac_mp4_demuxer_state_close(AacMp4Demuxer* m) {
+  aac_mapped_file_close(&m->file);
+  delete[] m->offsets;
+  delete m;
+}
+
+int aac_mp4_demuxer_state_size(const AacMp4Demuxer* m, int64_t frame) {
+  const uint32_t size = m->sizes ? rd32(m->sizes + 4 * frame) : m->fixed_size;
+  return (int)std::min<uint32_t>(size, INT32_MAX);
+}
+
+int64_t aac_mp4_demuxer_state_duration(const AacMp4Demuxer* m) {
+  int64_t t = 0, s = 0;
+  for (uint32_t e = 0; e < m->stts_count && s < m->frames; e++) {
+    const int64_t count = std::min<int64_t>(rd32(m->stts + 8 * e), m->frames - s);
+    t += count * rd32(m->stts + 8 * e + 4);
+    s += count;
+  }
+  return t;
+}
+
+int64_t aac_mp4_demuxer_state_find(const AacMp4Demuxer* m, int64_t time) {
+  int64_t t = 0, s = 0;
+  for (uint32_t e = 0; e < m->stts_count && s < m->frames && time >= t; e++) {
+    const int64_t count = std::min<int64_t>(rd32(m->stts + 8 * e), m->frames - s);
+    const uint32_t delta = rd32(m->stts + 8 * e + 4);
+    if (delta > 0 && time < t + count * delta) {
+      return s + (time - t) / delta;
+    }
+    t += count * delta;
+    s += count;
+  }
+  return -1;
+}
+
+int aac_mp4_config_channels(const AacAudioConfig* cfg) {
+  if (cfg->object_type == AAC_AOT_PS) {
+    return 2;
+  }
+  return cfg->channel_config == 7 ? 8 : cfg->channel_config;
+}
+
+/* ── Fragmented MP4 Muxer ─────────────────────────────────────── */
+
+static uint8_t* wr16(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+  return p + 2;
+}
+
+static uint8_t* wr32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+  return p + 4;
+}
+
+static uint8_t* wr64(uint8_t* p, uint64_t v) {
+  return wr32(wr32(p, (uint32_t)(v >> 32)), (uint32_t)v);
+}
+
+static uint8_t* wr_zero(uint8_t* p, int n) {
+  memset(p, 0, n);
+  return p + n;
+}
+
+/* Box header at p with its size left open; box_close fills it in */
+static uint8_t* box_open(uint8_t* p, const char* type) {
+  memcpy(p + 4, type, 4);
+  return p + 8;
+}
+
+static uint8_t* full_box_open(uint8_t* p, const char* type, uint32_t version_flags) {
+  return wr32(box_open(p, type), version_flags);
+}
+
+static void box_close(uint8_t* box, const uint8_t* end) { wr32(box, (uint32_t)(end - box)); }
+
+/* The esds of the init segment: ES_Descriptor, DecoderConfigDescriptor
+ * (MPEG-4 audio), DecoderSpecificInfo (the AudioSpecificConfig) and
+ * SLConfigDescriptor, each with a one-byte length */
+static uint8_t* write_esds(const AacFmp4Muxer* m, uint8_t* p) {
+  uint8_t* esds = p;
+  p = full_box_open(p, "esds", 0);
+  const int dsi = 2 + m->asc_size, dcd = 2 + 13 + dsi, sl = 3;
+  *p++ = 0x03;
+  *p++ = (uint8_t)(3 + dcd + sl);
+  p = wr16(p, 1); /* ES_ID */
+  *p++ = 0;       /* no dependence, URL or OCR stream */
+  *p++ = 0x04;
+  *p++ = (uint8_t)(dcd - 2);
+  *p++ = 0x40; /* objectTypeIndication: MPEG-4 audio */
+  *p++ = 0x15; /* streamType audio, not upstream, reserved 1 */
+  const uint32_t buffer_size = (uint32_t)m->max_frame;
+  *p++ = (uint8_t)(buffer_size >> 16);
+  p = wr16(p, buffer_size & 0xFFFF);
+  p = wr32(p, (uint32_t)m->bitrate); /* maxBitrate */
+  p = wr32(p, (uint32_t)m->bitrate); /* avgBitrate */
+  *p++ = 0x05;
+  *p++ = (uint8_t)m->asc_size;
+  memcpy(p, m->asc, m->asc_size);
+  p += m->asc_size;
+  *p++ = 0x06;
+  *p++ = 0x01;
+  *p++ = 0x02; /* predefined: MP4 */
+  box_close(esds, p);
+  return p;
+}
+
+static uint8_t* write_matrix(uint8_t* p) {
+  for (uint32_t v : {0x00010000u, 0u, 0u, 0u, 0x00010000u, 0u, 0u, 0u, 0x40000000u}) {
+    p = wr32(p, v);
+  }
+  return p;
+}
+
+/* ftyp, then moov: one audio trak whose sample table is empty, and mvex */
+static int write_init_segment(const AacFmp4Muxer* m, uint8_t* out) {
+  uint8_t* p = out;
+  uint8_t* box = p;
+  p = box_open(p, "ftyp");
+  for (const char* brand : {"iso6", "\0\0\0\0", "iso6", "cmfc", "mp41"}) {
+    memcpy(p, brand, 4);
+    p += 4;
+  }
+  box_close(box, p);
+
+  uint8_t* moov = p;
+  p = box_open(p, "moov");
+  box = p;
+  p = full_box_open(p, "mvhd", 0);
+  p = wr_zero(p, 8); /* creation, modification time */
+  p = wr32(p, m->timescale);
+  p = wr32(p, 0);          /* duration: in the fragments */
+  p = wr32(p, 0x00010000); /* rate 1.0 */
+  p = wr16(p, 0x0100);     /* volume 1.0 */
+  p = wr_zero(p, 10);
+  p = write_matrix(p);
+  p = wr_zero(p, 24);
+  p = wr32(p, 2); /* next_track_ID */
+  box_close(box, p);
+
+  uint8_t* trak = p;
+  p = box_open(p, "trak");
+  box = p;
+  p = full_box_open(p, "tkhd", 3); /* enabled, in movie */
+  p = wr_zero(p, 8);
+  p = wr32(p, 1); /* track_ID */
+  p = wr_zero(p, 4 + 4 + 8);
+  p = wr16(p, 0);      /* layer */
+  p = wr16(p, 1);      /* alternate_group */
+  p = wr16(p, 0x0100); /* volume 1.0 */
+  p = wr16(p, 0);
+  p = write_matrix(p);
+  p = wr_zero(p, 8); /* width, height */
+  box_close(box, p);
+
+  uint8_t* mdia = p;
+  p = box_open(p, "mdia");
+  box = p;
+  p = full_box_open(p, "mdhd", 0);
+  p = wr_zero(p, 8);
+  p = wr32(p, m->timescale);
+  p = wr32(p, 0);
+  p = wr16(p, 0x55C4); /* language "und" */
+  p = wr16(p, 0);
+  box_close(box, p);
+  box = p;
+  p = full_box_open(p, "hdlr", 0);
+  p = wr32(p, 0);
+  memcpy(p, "soun", 4);
+  p = wr_zero(p + 4, 12);
+  memcpy(p, "SoundHandler", 13);
+  p += 13;
+  box_close(box, p);
+
+  uint8_t* minf = p;
+  p = box_open(p, "minf");
+  box = p;
+  p = full_box_open(p, "smhd", 0);
+  p = wr32(p, 0); /* balance, reserved */
+  box_close(box, p);
+  uint8_t* dinf = p;
+  p = box_open(p, "dinf");
+  box = p;
+  p = full_box_open(p, "dref", 0);
+  p = wr32(p, 1);
+  uint8_t* url = p;
+  p = full_box_open(p, "url ", 1); /* media in the same file */
+  box_close(url, p);
+  box_close(box, p);
+  box_close(dinf, p);
+
+  uint8_t* stbl = p;
+  p = box_open(p, "stbl");
+  box = p;
+  p = full_box_open(p, "stsd", 0);
+  p = wr32(p, 1);
+  uint8_t* mp4a = p;
+  p = box_open(p, "mp4a");
+  p = wr_zero(p, 6);
+  p = wr16(p, 1); /* data_reference_index */
+  p = wr_zero(p, 8);
+  p = wr16(p, (uint32_t)aac_mp4_config_channels(&m->config));
+  p = wr16(p, 16); /* samplesize */
+  p = wr32(p, 0);
+  p = wr32(p, m->timescale <= 0xFFFF ? m->timescale << 16 : 0);
+  p = write_esds(m, p);
+  box_close(mp4a, p);
+  box_close(box, p);
+  for (const char* type : {"stts", "stsc", "stsz", "stco"}) {
+    box = p;
+    const bool stsz = memcmp(type, "stsz", 4) == 0; /* sample_size, then the count */
+    p = wr_zero(full_box_open(p, type, 0), stsz ? 8 : 4);
+    box_close(box, p);
+  }
+  box_close(stbl, p);
+  box_close(minf, p);
+  box_close(mdia, p);
+  box_close(trak, p);
+
+  uint8_t* mvex = p;
+  p = box_open(p, "mvex");
+  box = p;
+  p = full_box_open(p, "trex", 0);
+  p = wr32(p, 1); /* track_ID */
+  p = wr32(p, 1); /* default_sample_description_index */
+  p = wr32(p, m->frame_duration);
+  p = wr_zero(p, 8); /* default size and flags */
+  box_close(box, p);
+  box_close(mvex, p);
+  box_close(moov, p);
+  return (int)(p - out);
+}
+
+/* moof of the open fragment: mfhd, then traf with tfhd (default duration,
+ * base offset at the moof), tfdt and a trun of sample sizes */
+static int moof_size(int frames) { return 8 + 16 + 8 + 20 + 20 + 20 + 4 * frames; }
+
+AacFmp4Muxer* aac_fmp4_muxer_state_create(const uint8_t* asc, int asc_size, int bitrate,
+                                          int fragment_ms, AacWriteCallback write, void* user) {
+  AacAudioConfig cfg;
+  if (asc_size > (int)sizeof(AacFmp4Muxer::asc) ||
+      aac_audio_config_parse(&cfg, asc, asc_size) != AAC_OK ||
+      cfg.ext_rate_index >= AAC_NUM_SAMPLE_RATES || aac_mp4_config_channels(&cfg) == 0) {
+    return nullptr;
+  }
+  auto* m = new AacFmp4Muxer();
+  m->config = cfg;
+  memcpy(m->asc, asc, asc_size);
+  m->asc_size = asc_size;
+  m->bitrate = std::max(bitrate, 0);
+  m->timescale = (uint32_t)aac_sample_rates[cfg.ext_rate_index];
+  const bool sbr = cfg.ext_rate_index != cfg.sample_rate_index;
+  m->frame_duration = (uint32_t)cfg.frame_length * (sbr ? 2 : 1);
+  m->max_frame = 6144 / 8 * std::max(cfg.channel_config == 7 ? 8 : cfg.channel_config, 1) +
+                 AAC_ADTS_HEADER_SIZE + 2;
+  /* The nearest whole number of access units */
+  const int64_t n = ((int64_t)fragment_ms * m->timescale + 500 * m->frame_duration) /
+                    (1000 * (int64_t)m->frame_duration);
+  m->frames_per_fragment = (int)std::clamp<int64_t>(n, 1, AAC_FMP4_MAX_FRAGMENT_FRAMES);
+  m->head = moof_size(m->frames_per_fragment);
+  m->buf = new uint8_t[(size_t)m->head + 8 + (size_t)m->frames_per_fragment * m->max_frame];
+  m->sizes = new uint32_t[m->frames_per_fragment];
+  m->fill = m->head + 8;
+  m->sequence = 1;
+  m->write = write;
+  m->user = user;
+  return m;
+}
+
+void aac_fmp4_muxer_state_destroy(AacFmp4Muxer* m) {
+  delete[] m->buf;
+  delete[] m->sizes;
+  delete m;
+}
+
+int aac_fmp4_muxer_state_start(AacFmp4Muxer* m) {
+  uint8_t init[1024];
+  const int size = write_init_segment(m, init);
+  return m->write(init, size, m->user);
+}
+
+uint8_t* aac_fmp4_muxer_state_reserve(AacFmp4Muxer* m) { return m->buf + m->fill; }
+
+int aac_fmp4_muxer_state_header(const AacFmp4Muxer* m, const uint8_t* frame, int size) {
+  uint32_t key;
+  if (m->config.object_type == AAC_AOT_LD || size < AAC_ADTS_HEADER_SIZE || frame[0] != 0xFF ||
+      (frame[1] & 0xF6) != 0xF0 || aac_adts_check(frame, &key) != size) {
+    return 0;
+  }
+  return (frame[1] & 1) ? AAC_ADTS_HEADER_SIZE : AAC_ADTS_HEADER_SIZE + 2; /* CRC */
+}
+
+int aac_fmp4_muxer_state_commit(AacFmp4Muxer* m, int size) {
+  uint8_t* au = m->buf + m->fill;
+  const int header = aac_fmp4_muxer_state_header(m, au, size);
+  if (header > 0) {
+    size -= header;
+    memmove(au, au + header, size);
+  }
+  if (size <= 0 || size > m->max_frame) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  m->sizes[m->frames++] = (uint32_t)size;
+  m->fill += size;
+  return m->frames == m->frames_per_fragment ? aac_fmp4_muxer_state_flush(m) : AAC_OK;
+}
+
+int aac_fmp4_muxer_state_flush(AacFmp4Muxer* m) {
+  if (m->frames == 0) {
+    return AAC_OK;
+  }
+  const int moof = moof_size(m->frames);
+  uint8_t* start = m->buf + m->head - moof;
+  uint8_t* p = box_open(start, "moof");
+  uint8_t* box = p;
+  p = wr32(full_box_open(p, "mfhd", 0), m->sequence);
+  box_close(box, p);
+  uint8_t* traf = p;
+  p = box_open(p, "traf");
+  box = p;
+  p = full_box_open(p, "tfhd", 0x020008); /* default-base-is-moof, default duration */
+  p = wr32(p, 1);
+  p = wr32(p, m->frame_duration);
+  box_close(box, p);
+  box = p;
+  p = wr64(full_box_open(p, "tfdt", 0x01000000), (uint64_t)m->decode_time);
+  box_close(box, p);
+  box = p;
+  p = full_box_open(p, "trun", 0x000201); /* data offset, sample sizes */
+  p = wr32(p, (uint32_t)m->frames);
+  p = wr32(p, (uint32_t)(moof + 8)); /* the first access unit, from the moof */
+  for (int i = 0; i < m->frames; i++) {
+    p = wr32(p, m->sizes[i]);
+  }
+  box_close(box, p);
+  box_close(traf, p);
+  box_close(start, p);
+  box_open(p, "mdat");
+  box_close(p, m->buf + m->fill);
+
+  const int ret = m->write(start, (int)(m->buf + m->fill - start), m->user);
+  m->sequence++;
+  m->decode_time += (int64_t)m->frames * m->frame_duration;
+  m->frames = 0;
+  m->fill = m->head + 8;
+  return ret;
+}
@@ -1,35 +1,590 @@
 #include "ps.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 
-void aac_ps_encode(AacPsParams* ps, const float qmf_L[64][32], const float qmf_R[64][32], int nb) {
-  ps->enable_iid = 1;
-  ps->enable_icc = 1;
-  ps->num_iid_bands = nb;
-  ps->num_icc_bands = nb;
-  for (int b = 0; b < nb; b++) {
-    float eL = 0, eR = 0, cross = 0;
-    for (int ts = 0; ts < 32; ts++) {
-      eL += qmf_L[b][ts] * qmf_L[b][ts];
-      eR += qmf_R[b][ts] * qmf_R[b][ts];
-      cross += qmf_L[b][ts] * qmf_R[b][ts];
-    }
-    ps->iid[b] = 10.0f * log10f((eL + 1e-10f) / (eR + 1e-10f));
-    ps->icc[b] = cross / (sqrtf(eL * eR) + 1e-10f);
-  }
-}
-
-void aac_ps_decode(AacPsParams* ps, const float qmf_mono[64][32], float qmf_L[64][32],
-                   float qmf_R[64][32], int nb) {
-  for (int b = 0; b < nb; b++) {
-    float iid = powf(10.0f, ps->iid[b] / 20.0f);
-    float h11 = sqrtf(2.0f / (1.0f + iid));
-    float h12 = sqrtf(2.0f * iid / (1.0f + iid));
-    float c = ps->icc[b];
-    for (int ts = 0; ts < 32; ts++) {
-      float m = qmf_mono[b][ts];
-      qmf_L[b][ts] = h11 * m;
-      qmf_R[b][ts] = h12 * m * c;
+/* ── Decoder tables ───────────────────────────────────────────── */
+
+/* Quantised inter-channel intensity differences (dB) and coherences */
+static const float kPsIidCoarse[2 * AAC_PS_IID_COARSE + 1] = {
+    -25, -18, -14, -10, -7, -4, -2, 0, 2, 4, 7, 10, 14, 18, 25};
+static const float kPsIidFine[2 * AAC_PS_IID_FINE + 1] = {
+    -50, -45, -40, -35, -30, -25, -22, -19, -16, -13, -10, -8, -6, -4, -2, 0,
+    2,   4,   6,   8,   10,  13,  16,  19,  22,  25,  30,  35, 40, 45, 50};
+static const float kPsIcc[AAC_PS_ICC_STEPS] = {1.0f,     0.937f, 0.84118f, 0.60092f,
+                                               0.36764f, 0.0f,   -0.589f,  -1.0f};
+
+/* Hybrid prototypes, taps 0..6 (symmetric about tap 6). Modulated copies
+ * of each sum to a 6-slot delay, so synthesis is a plain sum. */
+static const float kPsHybrid8[7] = {0.00746082949812f, 0.02270420949825f, 0.04546865930473f,
+                                    0.07266113929591f, 0.09885108575264f, 0.11793710567217f,
+                                    0.125f};
+static const float kPsHybrid2[7] = {0.0f, 0.01899487526049f, 0.0f, -0.07293139167538f,
+                                    0.0f, 0.30596630545168f, 0.5f};
+/* Signed centre frequency of each hybrid row in QMF band units. Band 0
+ * filters 2..5 see the mirror image of a real signal's lowest band, so they
+ * take the negated frequency of the row they mirror. */
+static const float kPsHybridFreq[AAC_PS_HYBRID_ROWS] = {
+    0.625f, 0.875f, -0.875f, -0.625f, -0.375f, -0.125f, 0.125f, 0.375f, 1.75f, 1.25f, 2.75f, 2.25f};
+static const int kPsHybridBand[AAC_PS_HYBRID_ROWS] = {1, 1, 1, 1, 0, 0, 0, 0, 3, 2, 5, 4};
+/* First QMF band of 20-band parameter bands 6..19, then the end */
+static const int kPsBandStart[15] = {3, 4, 5, 6, 7, 8, 10, 12, 14, 17, 21, 26, 33, 42, 64};
+
+/* Decorrelator: fractional pre-delay and link phase factors (in units of
+ * pi times the centre frequency), link gains and delays in slots */
+static const float kPsPhiFract = 0.39f;
+static const float kPsLinkFract[AAC_PS_ALLPASS_LINKS] = {0.43f, 0.75f, 0.347f};
+static const float kPsLinkGain[AAC_PS_ALLPASS_LINKS] = {0.65143905753106f, 0.56471812200776f,
+                                                        0.48954165955695f};
+static const int kPsLinkDelay[AAC_PS_ALLPASS_LINKS] = {3, 4, 5};
+static const int kPsPreDelay = 2;
+static const int kPsShortDelayBand = 35; /* QMF bands from here delay by 1 slot */
+/* Link gains fade by 0.05 per QMF band above band 3 */
+static const int kPsDecayCutoff = 3;
+static const float kPsDecaySlope = 0.05f;
+/* Transient ducking */
+static const float kPsPeakDecay = 0.76592833836465f;
+static const float kPsSmooth = 0.25f;
+static const float kPsTransientImpact = 1.5f;
+
+/* ── Setup ────────────────────────────────────────────────────── */
+
+AacPsDecoder* aac_ps_decoder_create(const AacDSP* dsp) {
+  auto* p = new AacPsDecoder();
+  p->dsp = dsp;
+
+  for (int fine = 0; fine < 2; fine++) {
+    int range = fine ? AAC_PS_IID_FINE : AAC_PS_IID_COARSE;
+    for (int i = -range; i <= range; i++) {
+      double c = pow(10.0, (fine ? kPsIidFine : kPsIidCoarse)[i + range] / 20.0);
+      double gl = sqrt(2.0 * c * c / (1.0 + c * c)), gr = sqrt(2.0 / (1.0 + c * c));
+      for (int j = 0; j < AAC_PS_ICC_STEPS; j++) {
+        double alpha = 0.5 * acos(kPsIcc[j]);
+        double beta = alpha * (gr - gl) / M_SQRT2;
+        float* m = p->mix[fine][i + AAC_PS_IID_FINE][j];
+        m[0] = (float)(gl * cos(beta + alpha));
+        m[1] = (float)(gr * cos(beta - alpha));
+        m[2] = (float)(gl * sin(beta + alpha));
+        m[3] = (float)(gr * sin(beta - alpha));
+      }
+    }
+  }
+
+  for (int t = 0; t < AAC_PS_HYBRID_TAPS; t++) {
+    int c = t < 7 ? t : AAC_PS_HYBRID_TAPS - 1 - t, off = t - AAC_PS_HYBRID_DELAY;
+    for (int q = 0; q < 8; q++) {
+      double w = 2.0 * M_PI / 8.0 * (q + 0.5) * off;
+      p->hyb8_re[q][t] = kPsHybrid8[c] * (float)cos(w);
+      p->hyb8_im[q][t] = kPsHybrid8[c] * (float)sin(w);
+    }
+    for (int q = 0; q < 2; q++) {
+      double w = M_PI * (q + 0.5) * off;
+      p->hyb2_re[q][t] = kPsHybrid2[c] * (float)cos(w);
+      p->hyb2_im[q][t] = kPsHybrid2[c] * (float)sin(w);
+    }
+  }
+
+  for (int row = 0; row < AAC_PS_ROWS; row++) {
+    int qmf = row < 8 ? 0 : row < AAC_PS_HYBRID_ROWS ? (row - 6) / 2 : row - 9;
+    double f = qmf + 0.5;
+    if (row < AAC_PS_HYBRID_ROWS) {
+      f = kPsHybridFreq[row];
+      p->row_band[row] = kPsHybridBand[row];
+    } else {
+      int b = 0;
+      while (kPsBandStart[b + 1] <= qmf) {
+        b++;
+      }
+      p->row_band[row] = 6 + b;
+    }
+    if (row >= AAC_PS_ALLPASS_ROWS) {
+      continue;
+    }
+    p->phi_re[row] = (float)cos(-M_PI * kPsPhiFract * f);
+    p->phi_im[row] = (float)sin(-M_PI * kPsPhiFract * f);
+    float slope = 1.0f - kPsDecaySlope * (float)std::max(qmf - kPsDecayCutoff, 0);
+    for (int l = 0; l < AAC_PS_ALLPASS_LINKS; l++) {
+      p->link_re[l][row] = (float)cos(-M_PI * kPsLinkFract[l] * f);
+      p->link_im[l][row] = (float)sin(-M_PI * kPsLinkFract[l] * f);
+      p->link_gain[l][row] = kPsLinkGain[l] * std::max(slope, 0.0f);
+    }
+  }
+  return p;
+}
+
+void aac_ps_decoder_destroy(AacPsDecoder* p) { delete p; }
+
+/* ── Payload ──────────────────────────────────────────────────── */
+
+/* Exp-Golomb deltas against ref, or across frequency from 0 */
+static void ps_read_vector(AacBitReader* r, int* cur, const int* ref, int n, int lo, int hi) {
+  for (int b = 0; b < n; b++) {
+    int base = ref ? ref[b] : b ? cur[b - 1] : 0;
+    cur[b] = std::clamp(base + aac_bitreader_read_golomb(r), lo, hi);
+  }
+}
+
+/* iid_mode / icc_mode: 0 and 3 select 10 bands, 1 and 4 select 20; 3 and
+ * above use the fine IID steps. 2 and 5 (34 bands) are not supported. */
+static int ps_read_mode(AacBitReader* r, int* bands, int* fine) {
+  int mode = (int)aac_bitreader_read(r, 3);
+  if (mode > 4 || mode % 3 == 2) {
+    return AAC_ERR_UNSUPPORTED;
+  }
+  *bands = mode % 3 ? 20 : 10;
+  *fine = mode >= 3;
+  return AAC_OK;
+}
+
+int aac_ps_parse(AacPsDecoder* p, AacBitReader* r) {
+  if (aac_bitreader_read(r, 1)) {
+    AacPsHeader h = {};
+    int unused;
+    h.enable_iid = (int)aac_bitreader_read(r, 1);
+    if (h.enable_iid && ps_read_mode(r, &h.iid_bands, &h.iid_fine) != AAC_OK) {
+      p->have_header = 0;
+      return AAC_ERR_DECODE;
+    }
+    h.enable_icc = (int)aac_bitreader_read(r, 1);
+    if (h.enable_icc && ps_read_mode(r, &h.icc_bands, &unused) != AAC_OK) {
+      p->have_header = 0;
+      return AAC_ERR_DECODE;
+    }
+    if (!p->have_header || memcmp(&h, &p->header, sizeof(h)) != 0) {
+      p->header = h;
+      p->have_header = 1;
+      p->have_frame = 0;
+    }
+  }
+  if (!p->have_header) {
+    return AAC_ERR_DECODE;
+  }
+  const AacPsHeader* h = &p->header;
+  const AacPsFrame* prev = &p->frame;
+  int range = h->iid_fine ? AAC_PS_IID_FINE : AAC_PS_IID_COARSE;
+  AacPsFrame f = {};
+  int code = (int)aac_bitreader_read(r, 2);
+  f.n_env = code ? 1 << (code - 1) : 0;
+  for (int e = 0; e < f.n_env; e++) {
+    if (h->enable_iid) {
+      const int* ref = nullptr;
+      if (aac_bitreader_read(r, 1)) {
+        if (e == 0 && !p->have_frame) {
+          return AAC_ERR_DECODE;
+        }
+        ref = e ? f.iid[e - 1] : prev->iid[prev->n_env - 1];
+      }
+      ps_read_vector(r, f.iid[e], ref, h->iid_bands, -range, range);
+    }
+    if (h->enable_icc) {
+      const int* ref = nullptr;
+      if (aac_bitreader_read(r, 1)) {
+        if (e == 0 && !p->have_frame) {
+          return AAC_ERR_DECODE;
+        }
+        ref = e ? f.icc[e - 1] : prev->icc[prev->n_env - 1];
+      }
+      ps_read_vector(r, f.icc[e], ref, h->icc_bands, 0, AAC_PS_ICC_STEPS - 1);
+    }
+  }
+  if (aac_bitreader_bits_left(r) < 0) {
+    return AAC_ERR_DECODE;
+  }
+  if (f.n_env) {
+    p->frame = f;
+    p->have_frame = 1;
+    p->fresh = 1;
+  }
+  return AAC_OK;
+}
+
+/* ── Frame ────────────────────────────────────────────────────── */
+
+/* Mixing coefficients of envelope e for every row */
+static void ps_targets(const AacPsDecoder* p, int e, float t[4][AAC_PS_ROWS]) {
+  const AacPsHeader* h = &p->header;
+  const AacPsFrame* f = &p->frame;
+  for (int row = 0; row < AAC_PS_ROWS; row++) {
+    int b = p->row_band[row];
+    int iid = h->enable_iid ? f->iid[e][h->iid_bands == 20 ? b : b / 2] : 0;
+    int icc = h->enable_icc ? f->icc[e][h->icc_bands == 20 ? b : b / 2] : 0;
+    const float* m = p->mix[h->iid_fine][iid + AAC_PS_IID_FINE][icc];
+    for (int i = 0; i < 4; i++) {
+      t[i][row] = m[i];
+    }
+  }
+}
+
+/* Split QMF bands 0..2 into hybrid rows and delay bands 3..63 to match */
+static void ps_hybrid_analysis(AacPsDecoder* p, float y_re[][AAC_SBR_QMF_BANDS],
+                               float y_im[][AAC_SBR_QMF_BANDS]) {
+  const int H = AAC_PS_HYBRID_TAPS - 1, D = AAC_PS_MAX_DELAY, L = AAC_PS_HYBRID_DELAY;
+  for (int q = 0; q < 3; q++) {
+    for (int m = 0; m < 32; m++) {
+      p->hyb_re[q][H + m] = y_re[m][q];
+      p->hyb_im[q][H + m] = y_im[m][q];
+    }
+  }
+  for (int m = 0; m < 32; m++) {
+    float* sr = p->s_re[D + m];
+    float* si = p->s_im[D + m];
+    for (int row = 0; row < AAC_PS_HYBRID_ROWS; row++) {
+      int q = row < 8 ? 0 : (row - 6) / 2;
+      const float* hr = row < 8 ? p->hyb8_re[row] : p->hyb2_re[(row - 8) & 1];
+      const float* hi = row < 8 ? p->hyb8_im[row] : p->hyb2_im[(row - 8) & 1];
+      const float* xr = p->hyb_re[q] + H + m;
+      const float* xi = p->hyb_im[q] + H + m;
+      float acc_re = 0.0f, acc_im = 0.0f;
+      for (int t = 0; t <= H; t++) {
+        acc_re += hr[t] * xr[-t] - hi[t] * xi[-t];
+        acc_im += hr[t] * xi[-t] + hi[t] * xr[-t];
+      }
+      sr[row] = acc_re;
+      si[row] = acc_im;
+    }
+    const float* qr = m < L ? p->qmf_re[m] : y_re[m - L];
+    const float* qi = m < L ? p->qmf_im[m] : y_im[m - L];
+    memcpy(sr + AAC_PS_HYBRID_ROWS, qr + 3, (AAC_SBR_QMF_BANDS - 3) * sizeof(float));
+    memcpy(si + AAC_PS_HYBRID_ROWS, qi + 3, (AAC_SBR_QMF_BANDS - 3) * sizeof(float));
+  }
+  for (int q = 0; q < 3; q++) {
+    memmove(p->hyb_re[q], p->hyb_re[q] + 32, H * sizeof(float));
+    memmove(p->hyb_im[q], p->hyb_im[q] + 32, H * sizeof(float));
+  }
+  memcpy(p->qmf_re, y_re[32 - L], sizeof(p->qmf_re));
+  memcpy(p->qmf_im, y_im[32 - L], sizeof(p->qmf_im));
+}
+
+/* Decorrelated signal into r, ducked where a band's power jumps above its
+ * decaying peak so transients are not smeared */
+static void ps_decorrelate(AacPsDecoder* p) {
+  const int D = AAC_PS_MAX_DELAY, A = 5;
+  for (int m = 0; m < 32; m++) {
+    const float* sr = p->s_re[D + m];
+    const float* si = p->s_im[D + m];
+    float power[AAC_PS_MAX_BANDS] = {0.0f}, gain[AAC_PS_MAX_BANDS];
+    for (int row = 0; row < AAC_PS_ROWS; row++) {
+      power[p->row_band[row]] += sr[row] * sr[row] + si[row] * si[row];
+    }
+    for (int b = 0; b < AAC_PS_MAX_BANDS; b++) {
+      p->peak_decay[b] = std::max(power[b], p->peak_decay[b] * kPsPeakDecay);
+      p->power_smooth[b] += kPsSmooth * (power[b] - p->power_smooth[b]);
+      p->peak_diff_smooth[b] +=
+          kPsSmooth * (p->peak_decay[b] - power[b] - p->peak_diff_smooth[b]);
+      float peak = kPsTransientImpact * p->peak_diff_smooth[b];
+      gain[b] = peak <= p->power_smooth[b] ? 1.0f : p->power_smooth[b] / peak;
+    }
+
+    for (int row = 0; row < AAC_PS_ALLPASS_ROWS; row++) {
+      float in_re = p->s_re[D + m - kPsPreDelay][row], in_im = p->s_im[D + m - kPsPreDelay][row];
+      float x_re = in_re * p->phi_re[row] - in_im * p->phi_im[row];
+      float x_im = in_re * p->phi_im[row] + in_im * p->phi_re[row];
+      for (int l = 0; l < AAC_PS_ALLPASS_LINKS; l++) {
+        float w_re = p->ap_re[l][A + m - kPsLinkDelay[l]][row];
+        float w_im = p->ap_im[l][A + m - kPsLinkDelay[l]][row];
+        float g = p->link_gain[l][row];
+        float out_re = w_re * p->link_re[l][row] - w_im * p->link_im[l][row] - g * x_re;
+        float out_im = w_re * p->link_im[l][row] + w_im * p->link_re[l][row] - g * x_im;
+        p->ap_re[l][A + m][row] = x_re + g * out_re;
+        p->ap_im[l][A + m][row] = x_im + g * out_im;
+        x_re = out_re;
+        x_im = out_im;
+      }
+      float g = gain[p->row_band[row]];
+      p->r_re[m][row] = g * x_re;
+      p->r_im[m][row] = g * x_im;
+    }
+    for (int row = AAC_PS_ALLPASS_ROWS; row < AAC_PS_ROWS; row++) {
+      int delay = row - 9 < kPsShortDelayBand ? AAC_PS_MAX_DELAY : 1;
+      float g = gain[p->row_band[row]];
+      p->r_re[m][row] = g * p->s_re[D + m - delay][row];
+      p->r_im[m][row] = g * p->s_im[D + m - delay][row];
+    }
+    memcpy(p->l_re[m], sr, sizeof(p->l_re[m]));
+    memcpy(p->l_im[m], si, sizeof(p->l_im[m]));
+  }
+  memmove(p->s_re, p->s_re[32], D * sizeof(p->s_re[0]));
+  memmove(p->s_im, p->s_im[32], D * sizeof(p->s_im[0]));
+  for (int l = 0; l < AAC_PS_ALLPASS_LINKS; l++) {
+    memmove(p->ap_re[l], p->ap_re[l][32], A * sizeof(p->ap_re[l][0]));
+    memmove(p->ap_im[l], p->ap_im[l][32], A * sizeof(p->ap_im[l][0]));
+  }
+}
+
+/* Sum hybrid rows back into QMF bands 0..2 */
+static void ps_hybrid_synthesis(const float (*in_re)[AAC_PS_ROWS],
+                                const float (*in_im)[AAC_PS_ROWS],
+                                float out_re[][AAC_SBR_QMF_BANDS],
+                                float out_im[][AAC_SBR_QMF_BANDS]) {
+  for (int m = 0; m < 32; m++) {
+    const float* xr = in_re[m];
+    const float* xi = in_im[m];
+    float b0_re = 0.0f, b0_im = 0.0f;
+    for (int row = 0; row < 8; row++) {
+      b0_re += xr[row];
+      b0_im += xi[row];
+    }
+    out_re[m][0] = b0_re;
+    out_im[m][0] = b0_im;
+    out_re[m][1] = xr[8] + xr[9];
+    out_im[m][1] = xi[8] + xi[9];
+    out_re[m][2] = xr[10] + xr[11];
+    out_im[m][2] = xi[10] + xi[11];
+    memcpy(out_re[m] + 3, xr + AAC_PS_HYBRID_ROWS, (AAC_SBR_QMF_BANDS - 3) * sizeof(float));
+    memcpy(out_im[m] + 3, xi + AAC_PS_HYBRID_ROWS, (AAC_SBR_QMF_BANDS - 3) * sizeof(float));
+  }
+}
+
+void aac_ps_process(AacPsDecoder* p, float y_re[][AAC_SBR_QMF_BANDS],
+                    float y_im[][AAC_SBR_QMF_BANDS], float r_re[][AAC_SBR_QMF_BANDS],
+                    float r_im[][AAC_SBR_QMF_BANDS]) {
+  ps_hybrid_analysis(p, y_re, y_im);
+  ps_decorrelate(p);
+
+  /* Mixing matrices move linearly to each envelope's values over its slots;
+   * without new parameters they hold */
+  float target[4][AAC_PS_ROWS];
+  const bool fresh = p->fresh && p->have_header;
+  if (!p->have_mix) {
+    if (fresh) {
+      ps_targets(p, 0, p->h);
+    } else {
+      for (int row = 0; row < AAC_PS_ROWS; row++) {
+        p->h[0][row] = p->h[1][row] = 1.0f;
+        p->h[2][row] = p->h[3][row] = 0.0f;
+      }
+    }
+    p->have_mix = 1;
+  }
+  const int n_env = fresh ? p->frame.n_env : 1;
+  for (int e = 0; e < n_env; e++) {
+    int start = 32 * e / n_env, end = 32 * (e + 1) / n_env;
+    if (fresh) {
+      ps_targets(p, e, target);
+      float inv = 1.0f / (float)(end - start);
+      for (int i = 0; i < 4; i++) {
+        for (int row = 0; row < AAC_PS_ROWS; row++) {
+          p->h_step[i][row] = (target[i][row] - p->h[i][row]) * inv;
+        }
+      }
+    } else {
+      memset(p->h_step, 0, sizeof(p->h_step));
+    }
+    for (int m = start; m < end; m++) {
+      p->dsp->ps_mix(p->l_re[m], p->l_im[m], p->r_re[m], p->r_im[m], p->h[0], p->h_step[0],
+                     AAC_PS_ROWS);
+    }
+    if (fresh) {
+      memcpy(p->h, target, sizeof(p->h)); /* no drift from the running sum */
+    }
+  }
+  p->fresh = 0;
+
+  ps_hybrid_synthesis(p->l_re, p->l_im, y_re, y_im);
+  ps_hybrid_synthesis(p->r_re, p->r_im, r_re, r_im);
+}
+
+/* ── Encoder ──────────────────────────────────────────────────── */
+
+/* Mean index step between adjacent envelopes, weighted by band energy,
+ * that pays for splitting a frame */
+static const float kPsEnvSplit = 1.0f;
+/* A value keeps its previous step until it is this far towards the next;
+ * noise-like bands otherwise flicker between steps every frame */
+static const float kPsHysteresis = 0.75f;
+
+AacPsEncoder* aac_ps_encoder_create(const AacDSP* dsp) {
+  auto* p = new AacPsEncoder();
+  p->dsp = dsp;
+  p->header.enable_iid = 1;
+  p->header.iid_bands = AAC_PS_MAX_BANDS;
+  p->header.enable_icc = 1;
+  p->header.icc_bands = AAC_PS_MAX_BANDS;
+  return p;
+}
+
+void aac_ps_encoder_destroy(AacPsEncoder* p) { delete p; }
+
+/* Nearest step of a table sorted either way, or ref (-1 for none) when v
+ * is still within the hysteresis of it */
+static int ps_nearest(const float* table, int n, float v, int ref) {
+  int best = 0;
+  for (int i = 1; i < n; i++) {
+    if (fabsf(table[i] - v) < fabsf(table[best] - v)) {
+      best = i;
+    }
+  }
+  if (ref >= 0 && abs(best - ref) == 1 &&
+      fabsf(v - table[ref]) < kPsHysteresis * fabsf(table[best] - table[ref])) {
+    return ref;
+  }
+  return best;
+}
+
+/* Sum the statistics of blocks [b0, b1) per parameter band. QMF bands
+ * 0..2 stand in for both hybrid parameter bands they are split into. */
+static void ps_band_stats(const AacPsEncoder* p, int b0, int b1, float* sl, float* sr,
+                          float* sc) {
+  float el[AAC_SBR_QMF_BANDS] = {0}, er[AAC_SBR_QMF_BANDS] = {0}, cr[AAC_SBR_QMF_BANDS] = {0};
+  for (int b = b0; b < b1; b++) {
+    for (int k = 0; k < AAC_SBR_QMF_BANDS; k++) {
+      el[k] += p->el[b][k];
+      er[k] += p->er[b][k];
+      cr[k] += p->cr[b][k];
+    }
+  }
+  for (int band = 0; band < AAC_PS_MAX_BANDS; band++) {
+    int lo = band < 6 ? band / 2 : kPsBandStart[band - 6];
+    int hi = band < 6 ? lo + 1 : kPsBandStart[band - 5];
+    sl[band] = sr[band] = 1e-10f;
+    sc[band] = 0.0f;
+    for (int k = lo; k < hi; k++) {
+      sl[band] += el[k];
+      sr[band] += er[k];
+      sc[band] += cr[k];
+    }
+  }
+}
+
+/* Quantise blocks [b0, b1) into envelope e of the frame */
+static void ps_quantise(AacPsEncoder* p, int e, int b0, int b1) {
+  AacPsFrame* f = &p->frame;
+  const int* iid_ref = e ? f->iid[e - 1] : p->have_prev ? p->prev.iid[p->prev.n_env - 1] : nullptr;
+  const int* icc_ref = e ? f->icc[e - 1] : p->have_prev ? p->prev.icc[p->prev.n_env - 1] : nullptr;
+  float sl[AAC_PS_MAX_BANDS], sr[AAC_PS_MAX_BANDS], sc[AAC_PS_MAX_BANDS];
+  ps_band_stats(p, b0, b1, sl, sr, sc);
+  for (int b = 0; b < AAC_PS_MAX_BANDS; b++) {
+    float iid = 10.0f * log10f(sl[b] / sr[b]);
+    float icc = std::clamp(sc[b] / sqrtf(sl[b] * sr[b]), -1.0f, 1.0f);
+    f->iid[e][b] = ps_nearest(kPsIidCoarse, 2 * AAC_PS_IID_COARSE + 1, iid,
+                              iid_ref ? iid_ref[b] + AAC_PS_IID_COARSE : -1) -
+                   AAC_PS_IID_COARSE;
+    f->icc[e][b] = ps_nearest(kPsIcc, AAC_PS_ICC_STEPS, icc, icc_ref ? icc_ref[b] : -1);
+  }
+}
+
+/* Index steps between adjacent envelopes, averaged over the bands by weight */
+static float ps_envelope_change(const AacPsFrame* f, const float* weight) {
+  float change = 0.0f, total = 1e-20f;
+  for (int b = 0; b < AAC_PS_MAX_BANDS; b++) {
+    for (int e = 1; e < f->n_env; e++) {
+      int d = abs(f->iid[e][b] - f->iid[e - 1][b]) + abs(f->icc[e][b] - f->icc[e - 1][b]);
+      change += weight[b] * (float)d;
+    }
+    total += weight[b];
+  }
+  return change / total;
+}
+
+void aac_ps_encode_frame(AacPsEncoder* p, const float l_re[][AAC_SBR_QMF_BANDS],
+                         const float l_im[][AAC_SBR_QMF_BANDS],
+                         const float r_re[][AAC_SBR_QMF_BANDS],
+                         const float r_im[][AAC_SBR_QMF_BANDS]) {
+  const int d = AAC_PS_HYBRID_DELAY, rows = 32 * AAC_SBR_QMF_BANDS;
+  if (p->have_frame) {
+    p->prev = p->frame;
+    p->have_prev = 1;
+  }
+  memmove(p->l_re, p->l_re[32], d * sizeof(p->l_re[0]));
+  memmove(p->l_im, p->l_im[32], d * sizeof(p->l_im[0]));
+  memmove(p->r_re, p->r_re[32], d * sizeof(p->r_re[0]));
+  memmove(p->r_im, p->r_im[32], d * sizeof(p->r_im[0]));
+  memcpy(p->l_re[d], l_re, rows * sizeof(float));
+  memcpy(p->l_im[d], l_im, rows * sizeof(float));
+  memcpy(p->r_re[d], r_re, rows * sizeof(float));
+  memcpy(p->r_im[d], r_im, rows * sizeof(float));
+
+  /* Statistics over the slots the decoder mixes this frame */
+  memset(p->el, 0, sizeof(p->el));
+  memset(p->er, 0, sizeof(p->er));
+  memset(p->cr, 0, sizeof(p->cr));
+  const int per_block = 32 / AAC_PS_ENC_BLOCKS;
+  for (int m = 0; m < 32; m++) {
+    int b = m / per_block;
+    p->dsp->ps_correlate(p->el[b], p->er[b], p->cr[b], p->l_re[m], p->l_im[m], p->r_re[m],
+                         p->r_im[m], AAC_SBR_QMF_BANDS);
+  }
+  float sl[AAC_PS_MAX_BANDS], sr[AAC_PS_MAX_BANDS], sc[AAC_PS_MAX_BANDS];
+  float weight[AAC_PS_MAX_BANDS];
+  ps_band_stats(p, 0, AAC_PS_ENC_BLOCKS, sl, sr, sc);
+  for (int b = 0; b < AAC_PS_MAX_BANDS; b++) {
+    weight[b] = sl[b] + sr[b];
+  }
+
+  /* The finest envelope split whose neighbours differ enough to pay for it */
+  AacPsFrame* f = &p->frame;
+  int n_env = 1;
+  for (int n = 2; n <= AAC_PS_ENC_BLOCKS; n *= 2) {
+    f->n_env = n;
+    for (int e = 0; e < n; e++) {
+      ps_quantise(p, e, e * AAC_PS_ENC_BLOCKS / n, (e + 1) * AAC_PS_ENC_BLOCKS / n);
+    }
+    if (ps_envelope_change(f, weight) >= kPsEnvSplit) {
+      n_env = n;
+    }
+  }
+  f->n_env = n_env;
+  for (int e = 0; e < n_env; e++) {
+    ps_quantise(p, e, e * AAC_PS_ENC_BLOCKS / n_env, (e + 1) * AAC_PS_ENC_BLOCKS / n_env);
+  }
+  p->have_frame = 1;
+}
+
+/* Exp-Golomb deltas against ref, or across frequency from 0 */
+static int ps_vector_bits(const int* cur, const int* ref, int n) {
+  int bits = 0;
+  for (int b = 0; b < n; b++) {
+    bits += aac_golomb_bits(cur[b] - (ref ? ref[b] : b ? cur[b - 1] : 0));
+  }
+  return bits;
+}
+
+static void ps_write_vector(AacBitWriter* w, const int* cur, const int* ref, int n) {
+  for (int b = 0; b < n; b++) {
+    aac_bitwriter_write_golomb(w, cur[b] - (ref ? ref[b] : b ? cur[b - 1] : 0));
+  }
+}
+
+/* Delta-time coding wherever it is cheaper and a reference exists */
+static void ps_write_param(AacBitWriter* w, const int* cur, const int* ref, int n) {
+  int dt = ref && ps_vector_bits(cur, ref, n) < ps_vector_bits(cur, nullptr, n);
+  aac_bitwriter_write(w, dt, 1);
+  ps_write_vector(w, cur, dt ? ref : nullptr, n);
+}
+
+void aac_ps_write(const AacPsEncoder* p, AacBitWriter* w, int header) {
+  const AacPsHeader* h = &p->header;
+  aac_bitwriter_write(w, header, 1);
+  if (header) {
+    aac_bitwriter_write(w, h->enable_iid, 1);
+    if (h->enable_iid) {
+      aac_bitwriter_write(w, (h->iid_fine ? 3 : 0) + (h->iid_bands == 20), 3);
+    }
+    aac_bitwriter_write(w, h->enable_icc, 1);
+    if (h->enable_icc) {
+      aac_bitwriter_write(w, h->icc_bands == 20, 3);
+    }
+  }
+  const AacPsFrame* f = &p->frame;
+  const AacPsFrame* prev = p->have_prev && !header ? &p->prev : nullptr;
+  /* A single envelope equal to the last one is sent as a hold */
+  if (prev && f->n_env == 1 &&
+      memcmp(f->iid[0], prev->iid[prev->n_env - 1], sizeof(f->iid[0])) == 0 &&
+      memcmp(f->icc[0], prev->icc[prev->n_env - 1], sizeof(f->icc[0])) == 0) {
+    aac_bitwriter_write(w, 0, 2);
+    return;
+  }
+  aac_bitwriter_write(w, f->n_env == 1 ? 1 : f->n_env == 2 ? 2 : 3, 2);
+  for (int e = 0; e < f->n_env; e++) {
+    if (h->enable_iid) {
+      ps_write_param(w, f->iid[e], e ? f->iid[e - 1] : prev ? prev->iid[prev->n_env - 1] : nullptr,
+                     h->iid_bands);
+    }
+    if (h->enable_icc) {
+      ps_write_param(w, f->icc[e], e ? f->icc[e - 1] : prev ? prev->icc[prev->n_env - 1] : nullptr,
+                     h->icc_bands);
     }
   }
 }
@@ -5,27 +5,55 @@
 
 #include "aac_tables.h"
 
-void aac_psycho_init(AacPsychoState* s, int sr, int fs) {
+/* Tonal bands mask 29 dB less than noise-like bands */
+static const float kTonalMaskingGain = 0.0012589254f; /* 10^(-29/10) */
+
+/* Spreading weight of band j onto band b, d = b - j (in bands) */
+static float spreading_weight(int d) {
+  float db = (d >= 0) ? -27.0f * (float)d : 27.0f * (float)d - 6.0f;
+  return powf(10.0f, db / 10.0f);
+}
+
+void aac_psycho_init(AacPsychoState* s, int sr, int fs, const AacDSP* dsp) {
   memset(s, 0, sizeof(*s));
   s->sample_rate = sr;
   s->frame_size = fs;
-  s->preecho_factor = 0.3f;
+  s->preecho_factor = 2.0f;
+  s->detail = 1;
+  s->dsp = dsp;
   for (int i = 0; i < AAC_NUM_SAMPLE_RATES; i++) {
     if (aac_sample_rates[i] == sr) {
       s->rate_index = i;
       break;
     }
   }
-  s->num_bands = aac_num_sfb_long[s->rate_index];
-  for (int i = 0; i < s->num_bands; i++) {
-    for (int j = 0; j < s->num_bands; j++) {
-      float d = 1.0f * (j - i);
-      s->spreading[i][j] = powf(10.0f, (d >= 0 ? -27.0f * d : 27.0f * d - 6.0f) / 10.0f);
-    }
+  s->num_bands = aac_num_sfb(s->rate_index, fs);
+
+  /* Truncate the kernel where both sides fall below the floor. The slope
+   * is monotonic on each side so the first sub-floor tap ends the band. */
+  int radius = 0;
+  while (radius < AAC_PSY_SPREAD_MAX_RADIUS &&
+         (spreading_weight(radius + 1) >= AAC_PSY_SPREAD_FLOOR ||
+          spreading_weight(-(radius + 1)) >= AAC_PSY_SPREAD_FLOOR)) {
+    radius++;
+  }
+  s->spread_radius = radius;
+  for (int t = 0; t <= 2 * radius; t++) {
+    /* energy[b + t - radius] contributes with d = b - j = radius - t */
+    float w = spreading_weight(radius - t);
+    s->spread_kernel[t] = (w >= AAC_PSY_SPREAD_FLOOR) ? w : 0.0f;
+  }
+
+  /* ATH depends only on the band start frequency — hoisted out of analyze */
+  const int* sfb = aac_sfb_offsets(s->rate_index, fs);
+  for (int b = 0; b < s->num_bands; b++) {
+    float freq = (float)(sfb[b]) * (float)sr / (float)(fs) / 1000.0f;
+    s->ath[b] = powf(10.0f, (-5.0f - 3.64f * powf(freq, 0.8f)) / 10.0f);
   }
 }
 
 void aac_psycho_analyze(AacPsychoState* s, const float* spec, int nb, const int* sfb) {
+  float* energy = s->energy_pad + AAC_PSY_SPREAD_PAD;
   s->total_pe = 0;
   for (int b = 0; b < nb; b++) {
     float e = 0;
@@ -33,25 +61,30 @@ void aac_psycho_analyze(AacPsychoState* s, const float* spec, int nb, const int*
       e += spec[i] * spec[i];
     }
     s->bands[b].energy = e / (sfb[b + 1] - sfb[b]);
-    float sfm = (s->bands[b].energy > 0 && s->prev_energy[b] > 0)
-                    ? s->bands[b].energy / (s->prev_energy[b] + 1e-20f)
-                    : 1.0f;
-    s->bands[b].tonality = (sfm < 0.5f) ? 1.0f : 0.0f;
+    energy[b] = s->bands[b].energy;
+    s->bands[b].tonality = 0.0f;
+    if (s->detail) {
+      float sfm = (s->bands[b].energy > 0 && s->prev_energy[b] > 0)
+                      ? s->bands[b].energy / (s->prev_energy[b] + 1e-20f)
+                      : 1.0f;
+      s->bands[b].tonality = (sfm < 0.5f) ? 1.0f : 0.0f;
+    }
     s->prev_energy[b] = s->bands[b].energy;
   }
+  /* Bands past nb must read as zero for the right-hand edge of the kernel */
+  memset(energy + nb, 0, (AAC_PSY_SPREAD_PAD + 49 - nb) * sizeof(float));
+
+  s->dsp->psycho_spreading(s->spread_out, energy, s->spread_kernel, s->spread_radius, nb);
+
   for (int b = 0; b < nb; b++) {
-    float sp = 0;
-    for (int j = 0; j < nb; j++) {
-      sp += s->bands[j].energy * s->spreading[j][b];
+    s->bands[b].spreaded_energy = s->spread_out[b];
+    float thr = s->spread_out[b] * (s->bands[b].tonality > 0.0f ? kTonalMaskingGain : 1.0f);
+    /* Pre-echo control: the threshold may rise at most preecho_factor over
+     * the previous frame's, so an attack does not mask its own pre-echo */
+    if (s->detail && s->threshold_previous[b] > 0.0f) {
+      thr = fminf(thr, s->preecho_factor * s->threshold_previous[b]);
     }
-    s->bands[b].spreaded_energy = sp;
-  }
-  for (int b = 0; b < nb; b++) {
-    float thr = s->bands[b].spreaded_energy * powf(10.0f, -s->bands[b].tonality * 29.0f / 10.0f);
-    float freq = (float)(sfb[b]) * s->sample_rate / (float)(s->frame_size) / 1000.0f;
-    float ath = powf(10.0f, (-5.0f - 3.64f * powf(freq, 0.8f)) / 10.0f);
-    thr = fmaxf(thr, ath);
-    thr = fmaxf(thr, s->preecho_factor * s->threshold_previous[b]);
+    thr = fmaxf(thr, s->ath[b]);
     s->threshold_previous[b] = thr;
     s->bands[b].threshold = thr;
     s->thresholds[b] = thr;
@@ -1,173 +1,190 @@
 #include "sbr.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
 #include "aac_tables.h"
 
-#if defined(BAAC_AAC_AVX2) || defined(__AVX2__)
-#include <immintrin.h>
-#elif defined(BAAC_AAC_SSE2) || defined(__SSE2__)
-#include <emmintrin.h>
-#elif defined(BAAC_AAC_NEON) || defined(__ARM_NEON) || defined(__aarch64__)
-#include <arm_neon.h>
-#endif
+/* ── QMF banks ────────────────────────────────────────────────── */
 
-void aac_sbr_qmf_analysis(AacSbrQmf*  /*qmf*/, const float* time_in, float qmf_out[64][32],
-                          const AacDSP* dsp) {
-  (void)dsp; /* for future use with vector ops */
+/* Both directions modulate with e^{-i pi (k + 1/2)(n - c) / M} over one
+ * 2M period of the folded prototype, c = (10M - 1) / 2. The 2M real taps
+ * are split into even/odd halves packed as one complex M-point FFT; bins
+ * k and M-1-k of its output separate the two halves again. */
 
-  for (int ts = 0; ts < 32; ts++) {
-#if defined(BAAC_AAC_AVX2) || defined(__AVX2__)
-    for (int k = 0; k < 64; k += 8) {
-      __m256 vacc = _mm256_setzero_ps();
-      for (int n = 0; n < 10; n++) {
-        float w[8], t[8];
-        for (int j = 0; j < 8; j++) {
-          int kk = k + j;
-          int idx = (ts * 64 + n * 64 + kk) % 1024;
-          w[j] = aac_sbr_qmf_window[n * 64 + kk];
-          t[j] = (idx < AAC_SBR_QMF_FILTER_LENGTH) ? time_in[idx] : 0.0f;
-        }
-        __m256 vw = _mm256_loadu_ps(w);
-        __m256 vt = _mm256_loadu_ps(t);
-        vacc = _mm256_add_ps(vacc, _mm256_mul_ps(vw, vt));
-      }
-      _mm256_storeu_ps(&qmf_out[k][ts], vacc);
+void aac_sbr_qmf_init(AacSbrQmfBank* q, int bands, const AacDSP* dsp) {
+  memset(q, 0, sizeof(*q));
+  q->bands = bands;
+  q->dsp = dsp;
+  const int M = bands, L = 10 * bands;
+  /* The 32-band prototype averages tap pairs of the 64-band one, which keeps
+   * it symmetric and its passband edge at the same fraction of the rate */
+  double proto[AAC_SBR_QMF_FILTER_LENGTH], energy = 0.0;
+  int step = AAC_SBR_QMF_FILTER_LENGTH / L;
+  for (int n = 0; n < L; n++) {
+    proto[n] = 0.0;
+    for (int j = 0; j < step; j++) {
+      proto[n] += aac_sbr_qmf_window[n * step + j];
     }
-#elif defined(BAAC_AAC_SSE2) || defined(__SSE2__)
-    for (int k = 0; k < 64; k += 4) {
-      __m128 vacc = _mm_setzero_ps();
-      for (int n = 0; n < 10; n++) {
-        float w[4];
-        float t[4];
-        for (int j = 0; j < 4; j++) {
-          int kk = k + j;
-          int idx = (ts * 64 + n * 64 + kk) % 1024;
-          w[j] = aac_sbr_qmf_window[n * 64 + kk];
-          t[j] = (idx < AAC_SBR_QMF_FILTER_LENGTH) ? time_in[idx] : 0.0f;
-        }
-        __m128 vw = _mm_loadu_ps(w);
-        __m128 vt = _mm_loadu_ps(t);
-        vacc = _mm_add_ps(vacc, _mm_mul_ps(vw, vt));
-      }
-      _mm_storeu_ps(&qmf_out[k][ts], vacc);
+    energy += proto[n] * proto[n];
+  }
+  /* With a unit-energy prototype on both sides the pair is unity gain */
+  double gain = 1.0 / sqrt(energy);
+  for (int n = 0; n < L; n++) {
+    double sign = ((n / (2 * M)) & 1) ? -1.0 : 1.0;
+    q->win[n] = (float)(sign * proto[n] * gain);
+  }
+  const double c = (L - 1) / 2.0;
+  for (int k = 0; k < M; k++) {
+    q->pre_re[k] = (float)cos(M_PI * k / M);
+    q->pre_im[k] = (float)-sin(M_PI * k / M);
+    q->post_re[k] = (float)cos(M_PI * (2 * k + 1) / (2.0 * M));
+    q->post_im[k] = (float)-sin(M_PI * (2 * k + 1) / (2.0 * M));
+    double ph = fmod((k + 0.5) * c / M, 2.0) * M_PI;
+    q->rot_re[k] = (float)cos(ph);
+    q->rot_im[k] = (float)sin(ph);
+  }
+}
+
+void aac_sbr_qmf_analysis(AacSbrQmfBank* q, const float* in, float re[][AAC_SBR_QMF_BANDS],
+                          float im[][AAC_SBR_QMF_BANDS], int slots) {
+  const int M = q->bands, L = 10 * q->bands;
+  float v[2 * AAC_SBR_QMF_BANDS], cre[AAC_SBR_QMF_BANDS], cim[AAC_SBR_QMF_BANDS];
+  for (int s = 0; s < slots; s++) {
+    int j = q->pos + L - M;
+    memcpy(q->ring + j, in + s * M, M * sizeof(float));
+    memcpy(q->ring + (j >= L ? j - L : j + L), in + s * M, M * sizeof(float));
+    /* v[i] is the fold at tap 2M - 1 - i, since the window runs forward in time */
+    q->dsp->sbr_qmf_analysis(v, q->ring + q->pos, q->win, M);
+    q->pos = (q->pos + M) % L;
+
+    for (int n = 0; n < M; n++) {
+      float a = v[2 * M - 1 - 2 * n], b = v[2 * M - 2 - 2 * n];
+      cre[n] = a * q->pre_re[n] - b * q->pre_im[n];
+      cim[n] = a * q->pre_im[n] + b * q->pre_re[n];
     }
-#elif defined(BAAC_AAC_NEON) || defined(__ARM_NEON) || defined(__aarch64__)
-    for (int k = 0; k < 64; k += 4) {
-      float32x4_t vacc = vdupq_n_f32(0.0f);
-      for (int n = 0; n < 10; n++) {
-        float w[4], t[4];
-        for (int j = 0; j < 4; j++) {
-          int kk = k + j;
-          int idx = (ts * 64 + n * 64 + kk) % 1024;
-          w[j] = aac_sbr_qmf_window[n * 64 + kk];
-          t[j] = (idx < AAC_SBR_QMF_FILTER_LENGTH) ? time_in[idx] : 0.0f;
-        }
-        float32x4_t vw = vld1q_f32(w);
-        float32x4_t vt = vld1q_f32(t);
-        vacc = vmlaq_f32(vacc, vw, vt);
-      }
-      vst1q_f32(&qmf_out[k][ts], vacc);
+    q->dsp->fft_forward(cre, cim, M);
+    for (int k = 0; k < M; k++) {
+      /* even taps P = (C_k + C*_{M-1-k}) / 2, odd taps Q = (C_k - C*_{M-1-k}) / 2i */
+      float xr = cre[k], xi = cim[k], yr = cre[M - 1 - k], yi = -cim[M - 1 - k];
+      float pr = 0.5f * (xr + yr), pi = 0.5f * (xi + yi);
+      float qr = 0.5f * (xi - yi), qi = -0.5f * (xr - yr);
+      float zr = pr + qr * q->post_re[k] - qi * q->post_im[k];
+      float zi = pi + qr * q->post_im[k] + qi * q->post_re[k];
+      re[s][k] = zr * q->rot_re[k] - zi * q->rot_im[k];
+      im[s][k] = zr * q->rot_im[k] + zi * q->rot_re[k];
     }
-#else
-    for (int k = 0; k < 64; k += 4) {
-      for (int j = 0; j < 4; j++) {
-        int kk = k + j;
-        float acc = 0;
-        for (int n = 0; n < 10; n++) {
-          int idx = (ts * 64 + n * 64 + kk) % 1024;
-          float w = aac_sbr_qmf_window[n * 64 + kk];
-          float t = (idx < AAC_SBR_QMF_FILTER_LENGTH) ? time_in[idx] : 0.0f;
-          acc += t * w;
-        }
-        qmf_out[kk][ts] = acc;
-      }
+  }
+}
+
+void aac_sbr_qmf_synthesis(AacSbrQmfBank* q, const float re[][AAC_SBR_QMF_BANDS],
+                           const float im[][AAC_SBR_QMF_BANDS], float* out, int slots) {
+  const int M = q->bands;
+  float yr[AAC_SBR_QMF_BANDS], yi[AAC_SBR_QMF_BANDS];
+  float dre[AAC_SBR_QMF_BANDS], dim[AAC_SBR_QMF_BANDS];
+  for (int s = 0; s < slots; s++) {
+    for (int k = 0; k < M; k++) {
+      yr[k] = re[s][k] * q->rot_re[k] - im[s][k] * q->rot_im[k];
+      yi[k] = re[s][k] * q->rot_im[k] + im[s][k] * q->rot_re[k];
+    }
+    for (int k = 0; k < M; k++) {
+      /* D = A + i post B, A and B the halves of Y that land on even and odd taps */
+      float cr = yr[M - 1 - k], ci = -yi[M - 1 - k];
+      float ar = 0.5f * (yr[k] + cr), ai = 0.5f * (yi[k] + ci);
+      float br = 0.5f * (yr[k] - cr), bi = 0.5f * (yi[k] - ci);
+      float tr = br * q->post_re[k] - bi * q->post_im[k];
+      float ti = br * q->post_im[k] + bi * q->post_re[k];
+      dre[k] = ar - ti;
+      dim[k] = ai + tr;
     }
-#endif
+    q->dsp->fft_forward(dre, dim, M);
+
+    q->pos = (q->pos + 9) % 10;
+    float* row = q->ring + q->pos * 2 * M;
+    for (int p = 0; p < M; p++) {
+      row[2 * p] = dre[p] * q->pre_re[p] - dim[p] * q->pre_im[p];
+      row[2 * p + 1] = dre[p] * q->pre_im[p] + dim[p] * q->pre_re[p];
+    }
+    memcpy(row + 20 * M, row, 2 * M * sizeof(float));
+    q->dsp->sbr_qmf_synthesis(out + s * M, row, q->win, M);
   }
 }
 
-void aac_sbr_qmf_synthesis(AacSbrQmf* qmf, const float qmf_in[64][32], float* time_out,
-                           const AacDSP* dsp) {
-  (void)dsp;
+/* ── Band tables ──────────────────────────────────────────────── */
 
-  for (int ts = 0; ts < 32; ts++) {
-#if defined(BAAC_AAC_AVX2) || defined(__AVX2__)
-    for (int k = 0; k < 64; k += 8) {
-      __m256 vacc = _mm256_setzero_ps();
-      for (int n = 0; n < 10; n++) {
-        float w[8], q[8];
-        for (int j = 0; j < 8; j++) {
-          int kk = k + j;
-          int widx = n * 64 + kk;
-          w[j] = (widx < AAC_SBR_QMF_FILTER_LENGTH) ? aac_sbr_qmf_window[widx] : 0.0f;
-          q[j] = qmf_in[kk][ts];
-        }
-        __m256 vw = _mm256_loadu_ps(w);
-        __m256 vq = _mm256_loadu_ps(q);
-        vacc = _mm256_add_ps(vacc, _mm256_mul_ps(vw, vq));
-      }
-      __m256 voverlap = _mm256_loadu_ps(&qmf->overlap[k][ts]);
-      __m256 vresult = _mm256_add_ps(vacc, voverlap);
-      _mm256_storeu_ps(&time_out[ts * 64 + k], vresult);
-      _mm256_storeu_ps(&qmf->overlap[k][ts], vacc);
+static const int kSbrBandsPerOctave[4] = {0, 12, 10, 8};
+
+/* Envelope band edges between start_band and stop_band: constant-width
+ * pairs, or logarithmic spacing with every band at least one QMF band */
+static int sbr_env_bands(int* edges, const AacSbrHeader* h) {
+  int k0 = h->start_band, k2 = h->stop_band;
+  if (h->freq_scale == 0) {
+    int n = std::max((k2 - k0) / 2, 1);
+    for (int i = 0; i < n; i++) {
+      edges[i] = k0 + 2 * i;
     }
-#elif defined(BAAC_AAC_SSE2) || defined(__SSE2__)
-    for (int k = 0; k < 64; k += 4) {
-      __m128 vacc = _mm_setzero_ps();
-      for (int n = 0; n < 10; n++) {
-        float w[4];
-        float q[4];
-        for (int j = 0; j < 4; j++) {
-          int kk = k + j;
-          int widx = n * 64 + kk;
-          w[j] = (widx < AAC_SBR_QMF_FILTER_LENGTH) ? aac_sbr_qmf_window[widx] : 0.0f;
-          q[j] = qmf_in[kk][ts];
-        }
-        __m128 vw = _mm_loadu_ps(w);
-        __m128 vq = _mm_loadu_ps(q);
-        vacc = _mm_add_ps(vacc, _mm_mul_ps(vw, vq));
-      }
-      __m128 voverlap = _mm_loadu_ps(&qmf->overlap[k][ts]);
-      __m128 vresult = _mm_add_ps(vacc, voverlap);
-      _mm_storeu_ps(&time_out[ts * 64 + k], vresult);
-      _mm_storeu_ps(&qmf->overlap[k][ts], vacc);
+    edges[n] = k2;
+    return n;
+  }
+  float octaves = log2f((float)k2 / (float)k0);
+  int n = 2 * (int)lroundf((float)kSbrBandsPerOctave[h->freq_scale] * octaves / 2.0f);
+  n = std::clamp(n, 1, std::min(k2 - k0, AAC_SBR_MAX_ENV_BANDS));
+  for (; n > 1; n--) {
+    edges[0] = k0;
+    for (int i = 1; i < n; i++) {
+      int e = (int)lroundf((float)k0 * powf((float)k2 / (float)k0, (float)i / (float)n));
+      edges[i] = std::max(e, edges[i - 1] + 1);
     }
-#elif defined(BAAC_AAC_NEON) || defined(__ARM_NEON) || defined(__aarch64__)
-    for (int k = 0; k < 64; k += 4) {
-      float32x4_t vacc = vdupq_n_f32(0.0f);
-      for (int n = 0; n < 10; n++) {
-        float w[4], q[4];
-        for (int j = 0; j < 4; j++) {
-          int kk = k + j;
-          int widx = n * 64 + kk;
-          w[j] = (widx < AAC_SBR_QMF_FILTER_LENGTH) ? aac_sbr_qmf_window[widx] : 0.0f;
-          q[j] = qmf_in[kk][ts];
-        }
-        float32x4_t vw = vld1q_f32(w);
-        float32x4_t vq = vld1q_f32(q);
-        vacc = vmlaq_f32(vacc, vw, vq);
-      }
-      float32x4_t voverlap = vld1q_f32(&qmf->overlap[k][ts]);
-      float32x4_t vresult = vaddq_f32(vacc, voverlap);
-      vst1q_f32(&time_out[ts * 64 + k], vresult);
-      vst1q_f32(&qmf->overlap[k][ts], vacc);
+    if (edges[n - 1] < k2) {
+      break;
+    }
+  }
+  edges[0] = k0;
+  edges[n] = k2;
+  return n;
+}
+
+int aac_sbr_derive_tables(AacSbrTables* t, const AacSbrHeader* h) {
+  int k0 = h->start_band, k2 = h->stop_band;
+  if (k0 < 4 || k0 > 32 || k2 > AAC_SBR_QMF_BANDS || k2 - k0 < 2 || h->freq_scale < 0 ||
+      h->freq_scale > 3 || h->noise_bands < 1 || h->noise_bands > 3) {
+    return AAC_ERR_INVALID_ARG;
+  }
+  t->n_env_bands = sbr_env_bands(t->env_band, h);
+
+  /* Noise bands group whole envelope bands */
+  int nq = (int)lroundf((float)h->noise_bands * log2f((float)k2 / (float)k0));
+  nq = std::clamp(nq, 1, std::min(AAC_SBR_MAX_NOISE_BANDS, t->n_env_bands));
+  int idx = 0;
+  t->noise_band[0] = k0;
+  for (int k = 1; k <= nq; k++) {
+    idx += (t->n_env_bands - idx) / (nq + 1 - k);
+    t->noise_band[k] = t->env_band[idx];
+  }
+  t->n_noise_bands = nq;
+
+  /* Patches repeat the top of the core band [1, k0) upwards. The shift
+   * stays even so the copied QMF bands keep their spectral orientation. */
+  t->n_patches = 0;
+  for (int dst = k0; dst < k2;) {
+    if (t->n_patches == AAC_SBR_MAX_PATCHES) {
+      return AAC_ERR_INVALID_ARG;
     }
-#else
-    for (int k = 0; k < 64; k += 4) {
-      for (int j = 0; j < 4; j++) {
-        int kk = k + j;
-        float acc = 0;
-        for (int n = 0; n < 10; n++) {
-          int widx = n * 64 + kk;
-          float w = (widx < AAC_SBR_QMF_FILTER_LENGTH) ? aac_sbr_qmf_window[widx] : 0.0f;
-          acc += qmf_in[kk][ts] * w;
-        }
-        time_out[ts * 64 + kk] = acc + qmf->overlap[kk][ts];
-        qmf->overlap[kk][ts] = acc;
+    int len = std::min(k2 - dst, k0 - 1);
+    int src = k0 - len;
+    if ((dst - src) & 1) {
+      if (src > 1) {
+        src--;
+      } else {
+        len--;
       }
     }
-#endif
+    t->patch_src[t->n_patches] = src;
+    t->patch_dst[t->n_patches] = dst;
+    t->patch_len[t->n_patches] = len;
+    t->n_patches++;
+    dst += len;
   }
+  return AAC_OK;
 }
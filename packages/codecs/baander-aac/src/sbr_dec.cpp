@@ -1,36 +1,448 @@
+#include <algorithm>
 #include <cmath>
-#include <cstdlib>
+#include <cstring>
 
 #include "sbr.h"
+#include "spectral.h"
 
-namespace {
-static thread_local unsigned int sbr_noise_seed = 54321u;
-}  // namespace
+/* ── Setup ────────────────────────────────────────────────────── */
 
-void aac_sbr_decode(AacSbrEnvelope* env, AacSbrQmf* qmf, const float* core_low, int core_bands,
-                    int sbr_bands, float* output) {
-  float patched[64][32] = {{0}};
+AacSbrDecoder* aac_sbr_decoder_create(int channels, const AacDSP* dsp) {
+  auto* d = new AacSbrDecoder();
+  d->dsp = dsp;
+  d->channels = channels;
+  for (int c = 0; c < 2; c++) {
+    AacSbrChannel* ch = &d->ch[c];
+    aac_sbr_qmf_init(&ch->analysis, AAC_SBR_QMF_BANDS / 2, dsp);
+    aac_sbr_qmf_init(&ch->synthesis, AAC_SBR_QMF_BANDS, dsp);
+    /* A 32-band analysis at half the rate sees each band with 1/sqrt(2) of
+     * the 64-band amplitude; scale it up so the synthesis is unity gain */
+    for (int n = 0; n < AAC_SBR_QMF_FILTER_LENGTH / 2; n++) {
+      ch->analysis.win[n] *= (float)M_SQRT2;
+    }
+  }
 
-  /* Frequency patching: copy low-band energy to high-band */
-  for (int ts = 0; ts < env->time_slots; ts++) {
-    for (int band = 0; band < sbr_bands; band++) {
-      int src = band % core_bands;
-      patched[core_bands + band][ts] = (src < 1024) ? core_low[src] : 0.0f;
+  for (int res = 0; res < 2; res++) {
+    float steps = res ? 1.0f : 2.0f;
+    d->env_energy[res][0] = 0.0f;
+    for (int i = 1; i <= AAC_SBR_ENV_MAX; i++) {
+      d->env_energy[res][i] = exp2f((float)i / steps - (float)AAC_SBR_ENV_OFFSET);
     }
   }
+  for (int i = 0; i <= AAC_SBR_NOISE_MAX; i++) {
+    float q = exp2f((float)(AAC_SBR_NOISE_FLOOR_OFFSET - i));
+    d->noise_share[i] = q / (1.0f + q);
+    d->signal_share[i] = 1.0f / (1.0f + q);
+  }
+  uint32_t seed = 0x1F2E3D4Cu;
+  double power = 0.0;
+  for (int i = 0; i < AAC_SBR_NOISE_TABLE; i++) {
+    d->noise_re[i] = (float)aac_pns_random(&seed) / 2147483648.0f - 1.0f;
+    d->noise_im[i] = (float)aac_pns_random(&seed) / 2147483648.0f - 1.0f;
+    power += d->noise_re[i] * d->noise_re[i] + d->noise_im[i] * d->noise_im[i];
+  }
+  float norm = (float)sqrt(AAC_SBR_NOISE_TABLE / power);
+  for (int i = 0; i < AAC_SBR_NOISE_TABLE; i++) {
+    d->noise_re[i] *= norm;
+    d->noise_im[i] *= norm;
+  }
+  memcpy(d->noise_re + AAC_SBR_NOISE_TABLE, d->noise_re, AAC_SBR_QMF_BANDS * sizeof(float));
+  memcpy(d->noise_im + AAC_SBR_NOISE_TABLE, d->noise_im, AAC_SBR_QMF_BANDS * sizeof(float));
+  return d;
+}
 
-  /* Apply envelope and noise */
-  for (int ts = 0; ts < env->time_slots; ts++) {
-    for (int band = 0; band < env->freq_bands_hi; band++) {
-      float scale = powf(10.0f, env->envelope[ts][band] / 10.0f);
-      patched[core_bands + band][ts] *= sqrtf(scale);
+void aac_sbr_decoder_destroy(AacSbrDecoder* d) {
+  if (d) {
+    aac_ps_decoder_destroy(d->ps);
+  }
+  delete d;
+}
+
+/* ── Payload ──────────────────────────────────────────────────── */
 
-      float ns = powf(10.0f, env->noise_floor[ts][band] / 10.0f);
-      float noise = (float)rand_r(&sbr_noise_seed) / (float)RAND_MAX * 2.0f -
-                    1.0f;  // NOLINT(concurrency-mt-unsafe)
-      patched[core_bands + band][ts] += ns * noise;
+/* Inverse of the encoder's vector coding: an absolute first value and
+ * Exp-Golomb frequency deltas, or Exp-Golomb deltas against ref */
+static void sbr_read_vector(AacBitReader* r, int* cur, const int* ref, int n, int abs_bits,
+                            int max) {
+  int i = 0;
+  if (!ref) {
+    cur[0] = (int)aac_bitreader_read(r, abs_bits);
+    i = 1;
+  }
+  for (; i < n; i++) {
+    cur[i] = std::clamp((ref ? ref[i] : cur[i - 1]) + aac_bitreader_read_golomb(r), 0, max);
+  }
+}
+
+static int sbr_read_channel(AacBitReader* r, AacSbrFrame* f, const AacSbrFrame* prev,
+                            const AacSbrHeader* h, const AacSbrTables* t) {
+  const int nb = t->n_env_bands, nq = t->n_noise_bands;
+  f->n_env = 1 << aac_bitreader_read(r, 2);
+  if (f->n_env > AAC_SBR_MAX_ENVELOPES) {
+    return AAC_ERR_DECODE;
+  }
+  f->amp_res = f->n_env == 1 ? 0 : h->amp_res;
+  const int nn = aac_sbr_noise_envelopes(f->n_env);
+  for (int env = 0; env < f->n_env; env++) {
+    f->env_dt[env] = (int)aac_bitreader_read(r, 1);
+  }
+  for (int ne = 0; ne < nn; ne++) {
+    f->noise_dt[ne] = (int)aac_bitreader_read(r, 1);
+  }
+  if ((f->env_dt[0] || f->noise_dt[0]) && !prev) {
+    return AAC_ERR_DECODE;
+  }
+  for (int i = 0; i < nq; i++) {
+    f->invf[i] = (int)aac_bitreader_read(r, 2);
+  }
+
+  for (int env = 0; env < f->n_env; env++) {
+    int ref[AAC_SBR_MAX_ENV_BANDS];
+    if (f->env_dt[env] && env > 0) {
+      memcpy(ref, f->env[env - 1], nb * sizeof(int));
+    } else if (f->env_dt[env]) {
+      /* The previous frame may use the other step size */
+      for (int b = 0; b < nb; b++) {
+        int v = prev->env[prev->n_env - 1][b];
+        ref[b] = prev->amp_res == f->amp_res ? v : f->amp_res ? v / 2 : 2 * v;
+      }
+    }
+    sbr_read_vector(r, f->env[env], f->env_dt[env] ? ref : nullptr, nb, 7, AAC_SBR_ENV_MAX);
+  }
+  for (int ne = 0; ne < nn; ne++) {
+    const int* ref = nullptr;
+    if (f->noise_dt[ne]) {
+      ref = ne > 0 ? f->noise[ne - 1] : prev->noise[aac_sbr_noise_envelopes(prev->n_env) - 1];
     }
+    sbr_read_vector(r, f->noise[ne], ref, nq, 5, AAC_SBR_NOISE_MAX);
+  }
+  f->add_harmonic = (int)aac_bitreader_read(r, 1);
+  for (int b = 0; b < nb; b++) {
+    f->harmonic[b] = f->add_harmonic ? (int)aac_bitreader_read(r, 1) : 0;
+  }
+  return AAC_OK;
+}
+
+int aac_sbr_parse(AacSbrDecoder* d, AacBitReader* r, int ch0, int nch) {
+  if (aac_bitreader_read(r, 1)) {
+    AacSbrHeader h;
+    h.amp_res = (int)aac_bitreader_read(r, 1);
+    h.start_band = (int)aac_bitreader_read(r, 6);
+    h.stop_band = (int)aac_bitreader_read(r, 7);
+    h.freq_scale = (int)aac_bitreader_read(r, 2);
+    h.noise_bands = (int)aac_bitreader_read(r, 2);
+    if (!d->have_header || memcmp(&h, &d->header, sizeof(h)) != 0) {
+      /* A new band layout invalidates everything carried between frames */
+      d->have_header = aac_sbr_derive_tables(&d->tables, &h) == AAC_OK;
+      d->header = h;
+      for (int c = 0; c < 2; c++) {
+        d->ch[c].have_frame = 0;
+        d->ch[c].have_hist = 0;
+      }
+    }
+  }
+  if (!d->have_header) {
+    return AAC_ERR_DECODE;
+  }
+  nch = std::min(nch, 2 - ch0);
+  AacSbrFrame f[2];
+  for (int c = 0; c < nch; c++) {
+    const AacSbrChannel* ch = &d->ch[ch0 + c];
+    const AacSbrFrame* prev = ch->have_frame ? &ch->frame : nullptr;
+    if (sbr_read_channel(r, &f[c], prev, &d->header, &d->tables) != AAC_OK) {
+      return AAC_ERR_DECODE;
+    }
+  }
+  if (aac_bitreader_read(r, 1)) { /* bs_extended_data */
+    int cnt = (int)aac_bitreader_read(r, 4);
+    if (cnt == 15) {
+      cnt += (int)aac_bitreader_read(r, 8);
+    }
+    int end = aac_bitreader_bits_left(r) - cnt * 8;
+    /* PS applies to a mono element; other extensions are skipped. A bad PS
+     * payload keeps the previous parameters and does not fail the SBR data. */
+    if (nch == 1 && cnt > 0 && end >= 0 && aac_bitreader_read(r, 2) == AAC_SBR_EXT_PS) {
+      if (!d->ps) {
+        d->ps = aac_ps_decoder_create(d->dsp);
+      }
+      aac_ps_parse(d->ps, r);
+    }
+    int left = aac_bitreader_bits_left(r) - end;
+    if (left < 0) {
+      return AAC_ERR_DECODE;
+    }
+    aac_bitreader_skip(r, left);
+  }
+  if (aac_bitreader_bits_left(r) < 0) {
+    return AAC_ERR_DECODE;
+  }
+  for (int c = 0; c < nch; c++) {
+    d->ch[ch0 + c].frame = f[c];
+    d->ch[ch0 + c].have_frame = 1;
+  }
+  return AAC_OK;
+}
+
+/* ── HF generator ─────────────────────────────────────────────── */
+
+/* Chirp factor by inverse filtering level */
+static const float kSbrChirp[4] = {0.0f, 0.6f, 0.9f, 0.98f};
+
+/* Second-order complex prediction of QMF band k over the frame (covariance
+ * method). The HF generator adds bw * a0 and bw^2 * a1 taps, which whitens
+ * the patched band as the chirp factor bw goes to 1. */
+static void sbr_lpc(const AacSbrChannel* ch, int k, float* a0r, float* a0i, float* a1r,
+                    float* a1i) {
+  /* phi[i][j] = Σ_m x[m - i] x*[m - j] */
+  double p01r = 0, p01i = 0, p02r = 0, p02i = 0, p12r = 0, p12i = 0, p11 = 0, p22 = 0;
+  for (int m = AAC_SBR_LPC_HIST; m < AAC_SBR_LPC_HIST + AAC_SBR_SLOTS; m++) {
+    double x0r = ch->lo_re[m][k], x0i = ch->lo_im[m][k];
+    double x1r = ch->lo_re[m - 1][k], x1i = ch->lo_im[m - 1][k];
+    double x2r = ch->lo_re[m - 2][k], x2i = ch->lo_im[m - 2][k];
+    p01r += x0r * x1r + x0i * x1i;
+    p01i += x0i * x1r - x0r * x1i;
+    p02r += x0r * x2r + x0i * x2i;
+    p02i += x0i * x2r - x0r * x2i;
+    p12r += x1r * x2r + x1i * x2i;
+    p12i += x1i * x2r - x1r * x2i;
+    p11 += x1r * x1r + x1i * x1i;
+    p22 += x2r * x2r + x2i * x2i;
+  }
+  double b0r = 0, b0i = 0, b1r = 0, b1i = 0;
+  double det = p22 * p11 - (p12r * p12r + p12i * p12i) / (1.0 + 1e-6);
+  if (det > 1e-20 * p11 * p22 && det > 0.0) {
+    /* a1 = (phi01 phi12 - phi02 phi11) / det */
+    b1r = (p01r * p12r - p01i * p12i - p02r * p11) / det;
+    b1i = (p01i * p12r + p01r * p12i - p02i * p11) / det;
   }
+  if (p11 > 0.0) {
+    /* a0 = -(phi01 + a1 phi12*) / phi11 */
+    b0r = -(p01r + b1r * p12r + b1i * p12i) / p11;
+    b0i = -(p01i + b1i * p12r - b1r * p12i) / p11;
+  }
+  if (b0r * b0r + b0i * b0i >= 16.0 || b1r * b1r + b1i * b1i >= 16.0) {
+    b0r = b0i = b1r = b1i = 0.0;
+  }
+  *a0r = (float)b0r;
+  *a0i = (float)b0i;
+  *a1r = (float)b1r;
+  *a1i = (float)b1i;
+}
+
+/* New chirp factors from this frame's inverse filtering levels, smoothed
+ * against the previous frame's (faster when they fall) */
+static void sbr_chirp(AacSbrChannel* ch, const AacSbrTables* t) {
+  for (int i = 0; i < t->n_noise_bands; i++) {
+    float target = kSbrChirp[ch->frame.invf[i]];
+    float bw = target < ch->bw[i] ? 0.75f * target + 0.25f * ch->bw[i]
+                                  : 0.90625f * target + 0.09375f * ch->bw[i];
+    ch->bw[i] = bw < 0.015625f ? 0.0f : std::min(bw, 0.99609375f);
+  }
+}
+
+static void sbr_hf_generate(AacSbrDecoder* d, AacSbrChannel* ch) {
+  const AacSbrTables* t = &d->tables;
+  float a0r[AAC_SBR_QMF_BANDS], a0i[AAC_SBR_QMF_BANDS];
+  float a1r[AAC_SBR_QMF_BANDS], a1i[AAC_SBR_QMF_BANDS];
+  for (int k = 1; k < t->env_band[0]; k++) {
+    sbr_lpc(ch, k, &a0r[k], &a0i[k], &a1r[k], &a1i[k]);
+  }
+  sbr_chirp(ch, t);
+  for (int p = 0; p < t->n_patches; p++) {
+    int src = t->patch_src[p], dst = t->patch_dst[p], len = t->patch_len[p];
+    float c0r[AAC_SBR_QMF_BANDS], c0i[AAC_SBR_QMF_BANDS];
+    float c1r[AAC_SBR_QMF_BANDS], c1i[AAC_SBR_QMF_BANDS];
+    int nb = 0;
+    for (int i = 0; i < len; i++) {
+      /* The chirp follows the noise band the copy lands in */
+      while (nb + 1 < t->n_noise_bands && dst + i >= t->noise_band[nb + 1]) {
+        nb++;
+      }
+      float bw = ch->bw[nb];
+      c0r[i] = bw * a0r[src + i];
+      c0i[i] = bw * a0i[src + i];
+      c1r[i] = bw * bw * a1r[src + i];
+      c1i[i] = bw * bw * a1i[src + i];
+    }
+    d->dsp->sbr_hf_gen(&ch->y_re[0][dst], &ch->y_im[0][dst], &ch->lo_re[AAC_SBR_LPC_HIST][src],
+                       &ch->lo_im[AAC_SBR_LPC_HIST][src], c0r, c0i, c1r, c1i, len,
+                       AAC_SBR_SLOTS);
+  }
+}
+
+/* ── Envelope adjuster ────────────────────────────────────────── */
+
+/* Gain limiter: at most 3 dB above the band group's mean gain */
+static const float kSbrLimiterGain = 1.41254f;
+/* Energy compensation for limited bands, at most 2 dB */
+static const float kSbrMaxBoost = 1.584893f;
+/* Smoothing weights, current slot first */
+static const float kSbrSmooth[AAC_SBR_SMOOTH + 1] = {0.33333333f, 0.30150283f, 0.21816949f,
+                                                     0.11516383f, 0.03183050f};
+static const float kSbrEps = 1e-12f;
+
+static void sbr_adjust(AacSbrDecoder* d, AacSbrChannel* ch) {
+  const AacSbrTables* t = &d->tables;
+  const AacSbrFrame* f = &ch->frame;
+  const int k0 = t->env_band[0], k2 = t->env_band[t->n_env_bands], n = k2 - k0;
+  /* Smoothing would blur the attack a 4-envelope frame marks */
+  const bool smooth = f->n_env < AAC_SBR_MAX_ENVELOPES;
+
+  for (int env = 0; env < f->n_env; env++) {
+    int s0 = env * AAC_SBR_SLOTS / f->n_env, s1 = (env + 1) * AAC_SBR_SLOTS / f->n_env;
+    int ne = env * aac_sbr_noise_envelopes(f->n_env) / f->n_env;
+
+    /* Energy the HF generator produced, per QMF band */
+    float cur[AAC_SBR_QMF_BANDS] = {0.0f};
+    for (int m = s0; m < s1; m++) {
+      d->dsp->vector_fmul_accumulate(cur, &ch->y_re[m][k0], &ch->y_re[m][k0], n);
+      d->dsp->vector_fmul_accumulate(cur, &ch->y_im[m][k0], &ch->y_im[m][k0], n);
+    }
+    float inv_slots = 1.0f / (float)(s1 - s0);
+
+    float gain[AAC_SBR_QMF_BANDS], noise[AAC_SBR_QMF_BANDS], sine[AAC_SBR_QMF_BANDS];
+    float orig[AAC_SBR_QMF_BANDS];
+    for (int b = 0, nb = 0; b < t->n_env_bands; b++) {
+      float e_orig = d->env_energy[f->amp_res][f->env[env][b]];
+      int lo = t->env_band[b], hi = t->env_band[b + 1];
+      int sine_band = f->harmonic[b] ? (lo + hi) / 2 : -1;
+      for (int k = lo; k < hi; k++) {
+        while (nb + 1 < t->n_noise_bands && k >= t->noise_band[nb + 1]) {
+          nb++;
+        }
+        int q = f->noise[ne][nb];
+        float e_cur = cur[k - k0] * inv_slots;
+        float g2 = e_orig / (e_cur + kSbrEps);
+        int i = k - k0;
+        orig[i] = e_orig;
+        cur[i] = e_cur;
+        if (sine_band >= 0) {
+          /* The sinusoid replaces the noise floor in its envelope band */
+          gain[i] = g2 * d->noise_share[q];
+          noise[i] = 0.0f;
+          sine[i] = k == sine_band ? e_orig * d->signal_share[q] : 0.0f;
+        } else {
+          gain[i] = g2 * d->signal_share[q];
+          noise[i] = e_orig * d->noise_share[q];
+          sine[i] = 0.0f;
+        }
+      }
+    }
+
+    /* Limit and compensate per noise band, in the energy domain */
+    for (int nb = 0; nb < t->n_noise_bands; nb++) {
+      int lo = t->noise_band[nb] - k0, hi = t->noise_band[nb + 1] - k0;
+      float sum_orig = 0.0f, sum_cur = 0.0f;
+      for (int i = lo; i < hi; i++) {
+        sum_orig += orig[i];
+        sum_cur += cur[i];
+      }
+      float limit = kSbrLimiterGain * kSbrLimiterGain * sum_orig / (sum_cur + kSbrEps);
+      limit = std::min(limit, 1e10f);
+      float sum_out = 0.0f;
+      for (int i = lo; i < hi; i++) {
+        if (gain[i] > limit) {
+          noise[i] *= limit / gain[i];
+          gain[i] = limit;
+        }
+        sum_out += cur[i] * gain[i] + noise[i] + sine[i];
+      }
+      float boost = std::min((sum_orig + kSbrEps) / (sum_out + kSbrEps), kSbrMaxBoost);
+      for (int i = lo; i < hi; i++) {
+        gain[i] = sqrtf(gain[i] * boost);
+        noise[i] = sqrtf(noise[i] * boost);
+        sine[i] = sqrtf(sine[i] * boost);
+      }
+    }
+
+    if (!ch->have_hist || !smooth) {
+      for (int h = 0; h < AAC_SBR_SMOOTH; h++) {
+        memcpy(&ch->gain_hist[h][k0], gain, n * sizeof(float));
+        memcpy(&ch->noise_hist[h][k0], noise, n * sizeof(float));
+      }
+      ch->have_hist = 1;
+    }
+
+    for (int m = s0; m < s1; m++) {
+      float g[AAC_SBR_QMF_BANDS], q[AAC_SBR_QMF_BANDS];
+      for (int i = 0; i < n; i++) {
+        float gs = kSbrSmooth[0] * gain[i], qs = kSbrSmooth[0] * noise[i];
+        for (int h = 0; h < AAC_SBR_SMOOTH; h++) {
+          gs += kSbrSmooth[h + 1] * ch->gain_hist[h][k0 + i];
+          qs += kSbrSmooth[h + 1] * ch->noise_hist[h][k0 + i];
+        }
+        g[i] = gs;
+        q[i] = qs;
+      }
+      memmove(ch->gain_hist[1], ch->gain_hist[0],
+              (AAC_SBR_SMOOTH - 1) * AAC_SBR_QMF_BANDS * sizeof(float));
+      memmove(ch->noise_hist[1], ch->noise_hist[0],
+              (AAC_SBR_SMOOTH - 1) * AAC_SBR_QMF_BANDS * sizeof(float));
+      memcpy(&ch->gain_hist[0][k0], gain, n * sizeof(float));
+      memcpy(&ch->noise_hist[0][k0], noise, n * sizeof(float));
+
+      d->dsp->sbr_hf_apply(&ch->y_re[m][k0], &ch->y_im[m][k0], g, q,
+                           d->noise_re + ch->noise_index, d->noise_im + ch->noise_index, n);
+      ch->noise_index = (ch->noise_index + n) % AAC_SBR_NOISE_TABLE;
+
+      /* A sinusoid at the centre of band k turns by i (-1)^k per slot */
+      static const float kRotRe[4] = {1.0f, 0.0f, -1.0f, 0.0f};
+      static const float kRotIm[4] = {0.0f, 1.0f, 0.0f, -1.0f};
+      for (int i = 0; i < n; i++) {
+        if (sine[i] > 0.0f) {
+          int k = k0 + i;
+          float s = ((k * ch->sine_phase) & 1) ? -sine[i] : sine[i];
+          ch->y_re[m][k] += s * kRotRe[ch->sine_phase];
+          ch->y_im[m][k] += s * kRotIm[ch->sine_phase];
+        }
+      }
+      ch->sine_phase = (ch->sine_phase + 1) & 3;
+    }
+  }
+}
+
+/* ── Frame ────────────────────────────────────────────────────── */
+
+/* Core samples to the channel's adjusted QMF matrix y */
+static void sbr_decode_qmf(AacSbrDecoder* d, AacSbrChannel* ch, const float* core) {
+  const int half = AAC_SBR_QMF_BANDS / 2;
+  aac_sbr_qmf_analysis(&ch->analysis, core, &ch->lo_re[AAC_SBR_LPC_HIST],
+                       &ch->lo_im[AAC_SBR_LPC_HIST], AAC_SBR_SLOTS);
+
+  const bool sbr = d->have_header && ch->have_frame;
+  int k0 = sbr ? d->tables.env_band[0] : half;
+  int k2 = sbr ? d->tables.env_band[d->tables.n_env_bands] : half;
+  for (int m = 0; m < AAC_SBR_SLOTS; m++) {
+    memcpy(ch->y_re[m], ch->lo_re[AAC_SBR_LPC_HIST + m], k0 * sizeof(float));
+    memcpy(ch->y_im[m], ch->lo_im[AAC_SBR_LPC_HIST + m], k0 * sizeof(float));
+    memset(ch->y_re[m] + k2, 0, (AAC_SBR_QMF_BANDS - k2) * sizeof(float));
+    memset(ch->y_im[m] + k2, 0, (AAC_SBR_QMF_BANDS - k2) * sizeof(float));
+  }
+  if (sbr) {
+    sbr_hf_generate(d, ch);
+    sbr_adjust(d, ch);
+  }
+
+  for (int h = 0; h < AAC_SBR_LPC_HIST; h++) {
+    memcpy(ch->lo_re[h], ch->lo_re[AAC_SBR_SLOTS + h], sizeof(ch->lo_re[h]));
+    memcpy(ch->lo_im[h], ch->lo_im[AAC_SBR_SLOTS + h], sizeof(ch->lo_im[h]));
+  }
+}
+
+void aac_sbr_decode_channel(AacSbrDecoder* d, int c, const float* core, float* out) {
+  AacSbrChannel* ch = &d->ch[c];
+  sbr_decode_qmf(d, ch, core);
+  aac_sbr_qmf_synthesis(&ch->synthesis, ch->y_re, ch->y_im, out, AAC_SBR_SLOTS);
+}
+
+int aac_sbr_has_ps(const AacSbrDecoder* d) { return d->ps && d->ps->have_header; }
 
-  aac_sbr_qmf_synthesis(qmf, patched, output, nullptr);
+/* Channel 1's QMF matrix and synthesis bank carry the right channel */
+void aac_sbr_decode_ps(AacSbrDecoder* d, const float* core, float* out_l, float* out_r) {
+  AacSbrChannel* l = &d->ch[0];
+  AacSbrChannel* r = &d->ch[1];
+  sbr_decode_qmf(d, l, core);
+  aac_ps_process(d->ps, l->y_re, l->y_im, r->y_re, r->y_im);
+  aac_sbr_qmf_synthesis(&l->synthesis, l->y_re, l->y_im, out_l, AAC_SBR_SLOTS);
+  aac_sbr_qmf_synthesis(&r->synthesis, r->y_re, r->y_im, out_r, AAC_SBR_SLOTS);
 }
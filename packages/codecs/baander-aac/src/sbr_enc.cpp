@@ -1,17 +1,471 @@
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #include "sbr.h"
 
-void aac_sbr_encode(AacSbrEnvelope* env, AacSbrQmf*  /*qmf*/, const float* core_low, int core_bands,
-                    int sbr_bands) {
-  for (int ts = 0; ts < env->time_slots; ts++) {
-    for (int band = 0; band < env->freq_bands_hi; band++) {
-      float energy = 0;
-      int k = core_bands + band;
-      if (k < core_bands + sbr_bands) { energy = core_low[k] * core_low[k];
+/* ── Configuration ────────────────────────────────────────────── */
+
+/* Highest frequency SBR reconstructs, by bitrate per channel */
+static int sbr_stop_hz(int bitrate, int channels) {
+  return bitrate / std::max(channels, 1) < 20000 ? 14000 : 16000;
+}
+
+/* Halfband lowpass at a quarter of the input rate: every second tap
+ * except the centre is zero, so each output sample costs half the taps */
+static void sbr_halfband_taps(float* h, int n) {
+  auto i0 = [](double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k <= 30; k++) {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+    return sum;
+  };
+  const double beta = 8.0; /* about 80 dB stopband */
+  const int c = (n - 1) / 2;
+  double sum = 0.0;
+  auto* w = new double[n];
+  for (int i = 0; i < n; i++) {
+    int t = i - c;
+    double ideal = t == 0 ? 0.5 : ((t & 1) ? sin(M_PI * t / 2.0) / (M_PI * t) : 0.0);
+    double r = (double)t / (double)c;
+    w[i] = ideal * i0(beta * sqrt(std::max(0.0, 1.0 - r * r))) / i0(beta);
+    sum += w[i];
+  }
+  for (int i = 0; i < n; i++) {
+    h[i] = (float)(w[i] / sum);
+  }
+  delete[] w;
+}
+
+AacSbrEncoder* aac_sbr_encoder_create(int sample_rate, int channels, int bitrate,
+                                      int crossover_hz, int ps, const AacDSP* dsp) {
+  auto* e = new AacSbrEncoder();
+  e->sample_rate = sample_rate;
+  e->channels = ps ? 1 : channels;
+  e->header.amp_res = 1;
+  e->header.freq_scale = 2;
+  e->header.noise_bands = 2;
+  e->header.start_band =
+      std::clamp((int)lroundf((float)crossover_hz * 128.0f / (float)sample_rate), 4, 32);
+  int stop_hz = std::min(sbr_stop_hz(bitrate, e->channels), sample_rate / 2);
+  e->header.stop_band = std::min((int)lroundf((float)stop_hz * 128.0f / (float)sample_rate),
+                                 AAC_SBR_QMF_BANDS);
+  /* Narrow the range until the patches can cover it */
+  while (aac_sbr_derive_tables(&e->tables, &e->header) != AAC_OK) {
+    if (e->header.stop_band - e->header.start_band <= 2) {
+      delete e;
+      return nullptr;
+    }
+    e->header.stop_band--;
+  }
+
+  sbr_halfband_taps(e->down_taps, AAC_SBR_DOWN_TAPS);
+  for (int c = 0; c < 2; c++) {
+    aac_sbr_qmf_init(&e->qmf[c], AAC_SBR_QMF_BANDS, dsp);
+  }
+  if (ps) {
+    e->ps = aac_ps_encoder_create(dsp);
+  }
+  return e;
+}
+
+void aac_sbr_encoder_destroy(AacSbrEncoder* e) {
+  if (!e) {
+    return;
+  }
+  aac_ps_encoder_destroy(e->ps);
+  delete e;
+}
+
+/* ── Downsampler ──────────────────────────────────────────────── */
+
+/* out[m] = Σ_j h[j] x[2m - j]; out may alias in */
+static void sbr_downsample(AacSbrEncoder* e, int c, float* out, const float* in, int ns) {
+  const int hist = AAC_SBR_DOWN_TAPS - 1;
+  const int mid = AAC_SBR_DOWN_DELAY;
+  const float* h = e->down_taps;
+  float xb[AAC_SBR_DOWN_TAPS - 1 + 2048];
+  memcpy(xb, e->down_hist[c], hist * sizeof(float));
+  memcpy(xb + hist, in, ns * sizeof(float));
+  for (int m = 0; m < ns / 2; m++) {
+    const float* x = xb + hist + 2 * m;
+    float acc = h[mid] * x[-mid];
+    for (int j = 0; j < AAC_SBR_DOWN_TAPS; j += 2) {
+      acc += h[j] * x[-j];
+    }
+    out[m] = acc;
+  }
+  memcpy(e->down_hist[c], xb + ns, hist * sizeof(float));
+}
+
+/* ── Envelope and noise-floor estimation ──────────────────────── */
+
+/* A quarter frame this much louder than the one before is an attack */
+static const float kSbrAttackRatio = 8.0f;
+/* Quarters differing by this much over the frame still need two envelopes */
+static const float kSbrChangeRatio = 4.0f;
+/* Per-sample high-band energy treated as silence by the envelope split */
+static const float kSbrSilence = 1e-9f;
+/* First-order prediction residual of white noise through the QMF (mean
+ * over a frame); the bands are 2x oversampled, so neighbouring slots are
+ * correlated */
+static const float kSbrWhiteNoisiness = 0.72f;
+/* Noisiness gaps below this are estimator variance, not missing noise */
+static const float kSbrMinNoiseGap = 0.1f;
+
+static int sbr_envelope_count(const float* quarter, float prev, float silence) {
+  float before = prev;
+  float lo = quarter[0], hi = quarter[0];
+  for (int q = 0; q < 4; q++) {
+    if (quarter[q] > silence && quarter[q] > kSbrAttackRatio * before) {
+      return 4;
+    }
+    before = quarter[q];
+    lo = std::min(lo, quarter[q]);
+    hi = std::max(hi, quarter[q]);
+  }
+  return (hi > silence && hi > kSbrChangeRatio * lo) ? 2 : 1;
+}
+
+/* Energy and noisiness (first-order complex prediction residual over
+ * energy, 0 for a steady sinusoid, 1 for white noise) of QMF band k */
+static void sbr_band_noisiness(const AacSbrEncoder* e, int k, int s0, int s1, float* energy,
+                               float* noisiness) {
+  float e0 = 0.0f, e1 = 0.0f, cr = 0.0f, ci = 0.0f;
+  for (int m = s0 + 1; m < s1; m++) {
+    float xr = e->qmf_re[m][k], xi = e->qmf_im[m][k];
+    float pr = e->qmf_re[m - 1][k], pi = e->qmf_im[m - 1][k];
+    e0 += pr * pr + pi * pi;
+    e1 += xr * xr + xi * xi;
+    cr += xr * pr + xi * pi;
+    ci += xi * pr - xr * pi;
+  }
+  *energy = e1;
+  if (e0 <= 0.0f || e1 <= 0.0f) {
+    *noisiness = 1.0f;
+    return;
+  }
+  float residual = std::max(e1 - (cr * cr + ci * ci) / e0, 0.0f);
+  *noisiness = std::min(residual / (e1 * kSbrWhiteNoisiness), 1.0f);
+}
+
+/* Energy-weighted noisiness of QMF bands [lo, hi), read through map */
+static float sbr_weighted_noisiness(const float* energy, const float* noisiness, const int* map,
+                                    int lo, int hi) {
+  float num = 0.0f, den = 0.0f;
+  for (int k = lo; k < hi; k++) {
+    num += energy[map[k]] * noisiness[map[k]];
+    den += energy[map[k]];
+  }
+  return den > 0.0f ? num / den : -1.0f;
+}
+
+static void sbr_estimate(AacSbrEncoder* e, int c) {
+  const AacSbrTables* t = &e->tables;
+  AacSbrFrame* f = &e->frame[c];
+  int k0 = t->env_band[0], k2 = t->env_band[t->n_env_bands];
+
+  float quarter[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  for (int m = 0; m < AAC_SBR_SLOTS; m++) {
+    for (int k = k0; k < k2; k++) {
+      quarter[m / 8] += e->qmf_re[m][k] * e->qmf_re[m][k] + e->qmf_im[m][k] * e->qmf_im[m][k];
+    }
+  }
+  float silence = kSbrSilence * 8.0f * (float)(k2 - k0);
+  f->n_env = sbr_envelope_count(quarter, e->prev_hf_energy[c], silence);
+  e->prev_hf_energy[c] = quarter[3];
+  f->amp_res = f->n_env == 1 ? 0 : e->header.amp_res;
+
+  /* Envelopes: mean |X|^2 per band and time segment */
+  float steps = f->amp_res ? 1.0f : 2.0f;
+  for (int env = 0; env < f->n_env; env++) {
+    int s0 = env * AAC_SBR_SLOTS / f->n_env, s1 = (env + 1) * AAC_SBR_SLOTS / f->n_env;
+    for (int b = 0; b < t->n_env_bands; b++) {
+      float sum = 0.0f;
+      for (int m = s0; m < s1; m++) {
+        for (int k = t->env_band[b]; k < t->env_band[b + 1]; k++) {
+          sum += e->qmf_re[m][k] * e->qmf_re[m][k] + e->qmf_im[m][k] * e->qmf_im[m][k];
+        }
+      }
+      float mean = sum / (float)((s1 - s0) * (t->env_band[b + 1] - t->env_band[b]));
+      int idx = 0;
+      if (mean > 0.0f) {
+        idx = (int)lroundf(steps * (log2f(mean) + (float)AAC_SBR_ENV_OFFSET));
+      }
+      f->env[env][b] = std::clamp(idx, 0, AAC_SBR_ENV_MAX);
+    }
+  }
+
+  /* Noise floor and inverse filtering: how much noisier the original high
+   * band is than the low band the decoder will patch into it */
+  int map[AAC_SBR_QMF_BANDS];
+  for (int k = 0; k < AAC_SBR_QMF_BANDS; k++) {
+    map[k] = k;
+  }
+  int src[AAC_SBR_QMF_BANDS];
+  for (int p = 0; p < t->n_patches; p++) {
+    for (int i = 0; i < t->patch_len[p]; i++) {
+      src[t->patch_dst[p] + i] = t->patch_src[p] + i;
+    }
+  }
+  int nn = aac_sbr_noise_envelopes(f->n_env);
+  for (int i = 0; i < t->n_noise_bands; i++) {
+    f->invf[i] = 0;
+  }
+  for (int ne = 0; ne < nn; ne++) {
+    int s0 = ne * AAC_SBR_SLOTS / nn, s1 = (ne + 1) * AAC_SBR_SLOTS / nn;
+    float energy[AAC_SBR_QMF_BANDS], noisiness[AAC_SBR_QMF_BANDS];
+    for (int k = 1; k < k2; k++) {
+      sbr_band_noisiness(e, k, s0, s1, &energy[k], &noisiness[k]);
+    }
+    for (int i = 0; i < t->n_noise_bands; i++) {
+      int lo = t->noise_band[i], hi = t->noise_band[i + 1];
+      float n_orig = sbr_weighted_noisiness(energy, noisiness, map, lo, hi);
+      float n_src = sbr_weighted_noisiness(energy, noisiness, src, lo, hi);
+      float gap = (n_orig < 0.0f || n_src < 0.0f) ? 0.0f : n_orig - n_src;
+      float q = gap / std::max(1.0f - n_orig, 1.0f / 64.0f);
+      int idx = AAC_SBR_NOISE_MAX;
+      if (gap >= kSbrMinNoiseGap) {
+        idx = (int)lroundf((float)AAC_SBR_NOISE_FLOOR_OFFSET - log2f(q));
+      }
+      f->noise[ne][i] = std::clamp(idx, 0, AAC_SBR_NOISE_MAX);
+      int level = gap < kSbrMinNoiseGap ? 0 : gap < 0.3f ? 1 : gap < 0.55f ? 2 : 3;
+      f->invf[i] = std::max(f->invf[i], level);
+    }
+  }
+}
+
+/* Collapse a frame to one envelope and one noise floor by averaging
+ * energies; used when the multi-envelope payload would not fit */
+static void sbr_merge_envelopes(AacSbrFrame* f, int n_bands, int n_noise) {
+  float steps = f->amp_res ? 1.0f : 2.0f;
+  for (int b = 0; b < n_bands; b++) {
+    float sum = 0.0f;
+    for (int env = 0; env < f->n_env; env++) {
+      if (f->env[env][b] > 0) {
+        sum += exp2f((float)f->env[env][b] / steps - (float)AAC_SBR_ENV_OFFSET);
+      }
+    }
+    int idx = 0;
+    if (sum > 0.0f) {
+      idx = (int)lroundf(2.0f * (log2f(sum / (float)f->n_env) + (float)AAC_SBR_ENV_OFFSET));
+    }
+    f->env[0][b] = std::clamp(idx, 0, AAC_SBR_ENV_MAX);
+  }
+  for (int i = 0; i < n_noise; i++) {
+    f->noise[0][i] = std::min(f->noise[0][i], f->noise[aac_sbr_noise_envelopes(f->n_env) - 1][i]);
+  }
+  f->n_env = 1;
+  f->amp_res = 0;
+}
+
+/* ── Payload ──────────────────────────────────────────────────── */
+
+/* Deltas are signed Exp-Golomb; a frequency-delta vector starts with an
+ * absolute value of abs_bits */
+static int sbr_vector_bits(const int* cur, const int* ref, int n, int abs_bits) {
+  int bits = ref ? 0 : abs_bits;
+  for (int i = ref ? 0 : 1; i < n; i++) {
+    bits += aac_golomb_bits(cur[i] - (ref ? ref[i] : cur[i - 1]));
+  }
+  return bits;
 }
-      env->envelope[ts][band] = 10.0f * log10f(energy + 1e-10f);
-      env->noise_floor[ts][band] = -60.0f;
+
+static void sbr_write_vector(AacBitWriter* w, const int* cur, const int* ref, int n,
+                             int abs_bits) {
+  if (!ref) {
+    aac_bitwriter_write(w, cur[0], abs_bits);
+  }
+  for (int i = ref ? 0 : 1; i < n; i++) {
+    aac_bitwriter_write_golomb(w, cur[i] - (ref ? ref[i] : cur[i - 1]));
+  }
+}
+
+/* Choose delta-time coding wherever it is cheaper and the reference is
+ * valid (same step size, previous frame decodable), then write the frame */
+static void sbr_write_channel(AacBitWriter* w, AacSbrFrame* f, const AacSbrFrame* prev,
+                              const AacSbrTables* t) {
+  const int nb = t->n_env_bands, nq = t->n_noise_bands;
+  const int nn = aac_sbr_noise_envelopes(f->n_env);
+  const int* env_ref[AAC_SBR_MAX_ENVELOPES];
+  const int* noise_ref[AAC_SBR_MAX_NOISE_ENVELOPES];
+  for (int env = 0; env < f->n_env; env++) {
+    const int* ref = nullptr;
+    if (env > 0) {
+      ref = f->env[env - 1];
+    } else if (prev && prev->amp_res == f->amp_res) {
+      ref = prev->env[prev->n_env - 1];
+    }
+    f->env_dt[env] = ref && sbr_vector_bits(f->env[env], ref, nb, 7) <
+                                sbr_vector_bits(f->env[env], nullptr, nb, 7);
+    env_ref[env] = f->env_dt[env] ? ref : nullptr;
+  }
+  for (int ne = 0; ne < nn; ne++) {
+    const int* ref = nullptr;
+    if (ne > 0) {
+      ref = f->noise[ne - 1];
+    } else if (prev) {
+      ref = prev->noise[aac_sbr_noise_envelopes(prev->n_env) - 1];
     }
+    f->noise_dt[ne] = ref && sbr_vector_bits(f->noise[ne], ref, nq, 5) <
+                                 sbr_vector_bits(f->noise[ne], nullptr, nq, 5);
+    noise_ref[ne] = f->noise_dt[ne] ? ref : nullptr;
+  }
+
+  aac_bitwriter_write(w, f->n_env == 1 ? 0 : f->n_env == 2 ? 1 : 2, 2);
+  for (int env = 0; env < f->n_env; env++) {
+    aac_bitwriter_write(w, f->env_dt[env], 1);
+  }
+  for (int ne = 0; ne < nn; ne++) {
+    aac_bitwriter_write(w, f->noise_dt[ne], 1);
+  }
+  for (int i = 0; i < nq; i++) {
+    aac_bitwriter_write(w, f->invf[i], 2);
+  }
+  for (int env = 0; env < f->n_env; env++) {
+    sbr_write_vector(w, f->env[env], env_ref[env], nb, 7);
+  }
+  for (int ne = 0; ne < nn; ne++) {
+    sbr_write_vector(w, f->noise[ne], noise_ref[ne], nq, 5);
+  }
+  aac_bitwriter_write(w, f->add_harmonic, 1);
+  for (int b = 0; f->add_harmonic && b < nb; b++) {
+    aac_bitwriter_write(w, f->harmonic[b], 1);
+  }
+}
+
+/* PS data as the only extension: its byte count, then extension_id and
+ * ps_data padded to whole bytes */
+static void sbr_write_ps(const AacSbrEncoder* e, AacBitWriter* w, bool header) {
+  uint8_t buf[256];
+  AacBitWriter pw;
+  aac_bitwriter_init(&pw, buf, sizeof(buf));
+  aac_bitwriter_write(&pw, AAC_SBR_EXT_PS, 2);
+  aac_ps_write(e->ps, &pw, header);
+  int bits = aac_bitwriter_bits_written(&pw);
+  int cnt = (bits + 7) / 8;
+  if (cnt < 15) {
+    aac_bitwriter_write(w, cnt, 4);
+  } else {
+    aac_bitwriter_write(w, 15, 4);
+    aac_bitwriter_write(w, cnt - 15, 8);
+  }
+  for (int i = 0; i < bits / 8; i++) {
+    aac_bitwriter_write(w, buf[i], 8);
+  }
+  if (bits % 8) {
+    aac_bitwriter_write(w, buf[bits / 8] >> (8 - bits % 8), bits % 8);
+  }
+  aac_bitwriter_write(w, 0, cnt * 8 - bits);
+}
+
+/* A FIL element counts at most 15 + 254 bytes, the type nibble included */
+static const int kSbrMaxPayloadBits = (15 + 254) * 8 - 4;
+
+static void sbr_write_payload(AacSbrEncoder* e) {
+  const bool header = e->frames_to_header == 0;
+  AacBitWriter w;
+  aac_bitwriter_init(&w, e->payload, sizeof(e->payload));
+  aac_bitwriter_write(&w, header, 1);
+  if (header) {
+    aac_bitwriter_write(&w, e->header.amp_res, 1);
+    aac_bitwriter_write(&w, e->header.start_band, 6);
+    aac_bitwriter_write(&w, e->header.stop_band, 7);
+    aac_bitwriter_write(&w, e->header.freq_scale, 2);
+    aac_bitwriter_write(&w, e->header.noise_bands, 2);
+  }
+  /* A decoder may start at a header, so those frames never reference the past */
+  bool use_prev = e->have_prev && !header;
+  for (int c = 0; c < e->channels; c++) {
+    sbr_write_channel(&w, &e->frame[c], use_prev ? &e->prev[c] : nullptr, &e->tables);
+  }
+  aac_bitwriter_write(&w, e->ps != nullptr, 1); /* bs_extended_data */
+  if (e->ps) {
+    sbr_write_ps(e, &w, header);
+  }
+  e->payload_bits = aac_bitwriter_bits_written(&w);
+}
+
+void aac_sbr_encode_frame(AacSbrEncoder* e, float pcm[][2048], int ns) {
+  const int D = AAC_SBR_ANALYSIS_DELAY;
+  const int slots = ns / AAC_SBR_QMF_BANDS;
+  float block[AAC_SBR_ANALYSIS_DELAY + 2048];
+  if (e->ps) {
+    /* PS compares both inputs; SBR and the core code their mean. The QMF
+     * bank is linear, so the mean's subband samples are the inputs' mean. */
+    for (int c = 0; c < 2; c++) {
+      memcpy(block, e->delay[c], D * sizeof(float));
+      memcpy(block + D, pcm[c], ns * sizeof(float));
+      memcpy(e->delay[c], block + ns, D * sizeof(float));
+      aac_sbr_qmf_analysis(&e->qmf[c], block, c ? e->ps_re : e->qmf_re, c ? e->ps_im : e->qmf_im,
+                           slots);
+    }
+    aac_ps_encode_frame(e->ps, e->qmf_re, e->qmf_im, e->ps_re, e->ps_im);
+    for (int m = 0; m < slots; m++) {
+      for (int k = 0; k < AAC_SBR_QMF_BANDS; k++) {
+        e->qmf_re[m][k] = 0.5f * (e->qmf_re[m][k] + e->ps_re[m][k]);
+        e->qmf_im[m][k] = 0.5f * (e->qmf_im[m][k] + e->ps_im[m][k]);
+      }
+    }
+    for (int i = 0; i < ns; i++) {
+      pcm[0][i] = 0.5f * (pcm[0][i] + pcm[1][i]);
+    }
+    sbr_downsample(e, 0, pcm[0], pcm[0], ns);
+    sbr_estimate(e, 0);
+  } else {
+    for (int c = 0; c < e->channels; c++) {
+      memcpy(block, e->delay[c], D * sizeof(float));
+      memcpy(block + D, pcm[c], ns * sizeof(float));
+      memcpy(e->delay[c], block + ns, D * sizeof(float));
+      sbr_downsample(e, c, pcm[c], pcm[c], ns);
+      aac_sbr_qmf_analysis(&e->qmf[c], block, e->qmf_re, e->qmf_im, slots);
+      sbr_estimate(e, c);
+    }
+  }
+
+  sbr_write_payload(e);
+  if (e->payload_bits > kSbrMaxPayloadBits) {
+    for (int c = 0; c < e->channels; c++) {
+      sbr_merge_envelopes(&e->frame[c], e->tables.n_env_bands, e->tables.n_noise_bands);
+    }
+    sbr_write_payload(e);
+  }
+
+  for (int c = 0; c < e->channels; c++) {
+    e->prev[c] = e->frame[c];
+  }
+  e->have_prev = 1;
+  e->frames_to_header =
+      e->frames_to_header == 0 ? AAC_SBR_HEADER_INTERVAL - 1 : e->frames_to_header - 1;
+}
+
+/* ── FIL element ──────────────────────────────────────────────── */
+
+static int sbr_fil_bytes(const AacSbrEncoder* e) { return (4 + e->payload_bits + 7) / 8; }
+
+int aac_sbr_fil_bits(const AacSbrEncoder* e) {
+  int bytes = sbr_fil_bytes(e);
+  return 3 + 4 + (bytes >= 15 ? 8 : 0) + 8 * bytes;
+}
+
+void aac_sbr_write_fil(const AacSbrEncoder* e, AacBitWriter* w) {
+  int bytes = sbr_fil_bytes(e);
+  aac_bitwriter_write(w, AAC_ELEM_FIL, 3);
+  if (bytes < 15) {
+    aac_bitwriter_write(w, bytes, 4);
+  } else {
+    aac_bitwriter_write(w, 15, 4);
+    aac_bitwriter_write(w, bytes - 14, 8); /* esc_count, the reader adds it minus one */
+  }
+  aac_bitwriter_write(w, AAC_FIL_EXT_SBR_DATA, 4);
+  int full = e->payload_bits / 8, rest = e->payload_bits % 8;
+  for (int i = 0; i < full; i++) {
+    aac_bitwriter_write(w, e->payload[i], 8);
+  }
+  if (rest) {
+    aac_bitwriter_write(w, e->payload[full] >> (8 - rest), rest);
   }
+  aac_bitwriter_write(w, 0, bytes * 8 - 4 - e->payload_bits); /* fill_nibble / padding */
 }
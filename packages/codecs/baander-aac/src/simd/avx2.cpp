@@ -10,6 +10,7 @@
 #include "aac_dsp.h"
 #include "fft.h"
 #include "mdct.h"
+#include "spectral.h"
 
 #if defined(BAAC_AAC_AVX2) || defined(__AVX2__)
 
@@ -125,6 +126,26 @@ static void aac_vector_fmul_accumulate_avx2(float* dst, const float* a, const fl
   }
 }
 
+static int aac_vector_is_zero_avx2(const float* a, int len) {
+  const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+  int i = 0, n32 = len & ~31;
+  for (; i < n32; i += 32) {
+    __m256 lo = _mm256_or_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(a + i + 8));
+    __m256 hi = _mm256_or_ps(_mm256_loadu_ps(a + i + 16), _mm256_loadu_ps(a + i + 24));
+    __m256 acc = _mm256_or_ps(lo, hi);
+    __m256i bits = _mm256_castps_si256(_mm256_and_ps(acc, abs_mask));
+    if (!_mm256_testz_si256(bits, bits)) {
+      return 0;
+    }
+  }
+  for (; i < len; i++) {
+    if (a[i] != 0.0f) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
 /* ── FFT ─────────────────────────────────────────────────────── */
 
 static void avx2_bit_reverse(float* re, float* im, int n) {
@@ -394,6 +415,338 @@ static void aac_imdct_half_avx2(float* out, const float* in, int n, const float*
   }
 }
 
+/* ── TNS ─────────────────────────────────────────────────────
+ * FIR: 8 outputs per iteration once the whole history lies inside the
+ * region (n >= order), one broadcast coefficient per tap.
+ * IIR: the recursion is serial in n, so the order-long dot product is
+ * vectorised instead. Coefficients are reversed and front-padded with
+ * zeros to a multiple of 8, so the history x[n-R .. n) loads directly.
+ */
+
+static void aac_tns_fir_avx2(float* dst, const float* src, int len, const float* lpc, int order) {
+  int n = order < len ? order : len;
+  aac_tns_fir_head(dst, src, n, lpc, order);
+  for (; n + 8 <= len; n += 8) {
+    __m256 acc = _mm256_loadu_ps(src + n);
+    for (int k = 1; k <= order; k++) {
+#if defined(__FMA__)
+      acc = _mm256_fmadd_ps(_mm256_set1_ps(lpc[k - 1]), _mm256_loadu_ps(src + n - k), acc);
+#else
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(lpc[k - 1]),
+                                             _mm256_loadu_ps(src + n - k)));
+#endif
+    }
+    _mm256_storeu_ps(dst + n, acc);
+  }
+  for (; n < len; n++) {
+    float acc = src[n];
+    for (int k = 1; k <= order; k++) {
+      acc += lpc[k - 1] * src[n - k];
+    }
+    dst[n] = acc;
+  }
+}
+
+static void aac_tns_iir_avx2(float* x, int len, const float* lpc, int order) {
+  int R = (order + 7) & ~7;
+  float rev[AAC_TNS_MAX_ORDER + 8];
+  for (int j = 0; j < R; j++) {
+    rev[j] = (j < R - order) ? 0.0f : lpc[R - 1 - j];
+  }
+  int n = R < len ? R : len;
+  aac_tns_iir_head(x, n, lpc, order);
+  for (; n < len; n++) {
+    const float* h = x + n - R;
+    __m256 acc = _mm256_setzero_ps();
+    for (int j = 0; j < R; j += 8) {
+#if defined(__FMA__)
+      acc = _mm256_fmadd_ps(_mm256_loadu_ps(rev + j), _mm256_loadu_ps(h + j), acc);
+#else
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(rev + j), _mm256_loadu_ps(h + j)));
+#endif
+    }
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    x[n] -= _mm_cvtss_f32(s);
+  }
+}
+
+/* ── Psycho Spreading ────────────────────────────────────────
+ * Banded convolution, 8 output bands per iteration with FMA taps.
+ */
+
+static void aac_psycho_spreading_avx2(float* spread, const float* energy, const float* kernel,
+                                      int radius, int n_sfb) {
+  int taps = 2 * radius + 1;
+  int b = 0, n8 = n_sfb & ~7;
+  for (; b < n8; b += 8) {
+    const float* e = energy + b - radius;
+    __m256 acc = _mm256_setzero_ps();
+    for (int t = 0; t < taps; t++) {
+#if defined(__FMA__)
+      acc = _mm256_fmadd_ps(_mm256_set1_ps(kernel[t]), _mm256_loadu_ps(e + t), acc);
+#else
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(kernel[t]), _mm256_loadu_ps(e + t)));
+#endif
+    }
+    _mm256_storeu_ps(spread + b, acc);
+  }
+  for (; b < n_sfb; b++) {
+    const float* e = energy + b - radius;
+    float sp = 0.0f;
+    for (int t = 0; t < taps; t++) {
+      sp += kernel[t] * e[t];
+    }
+    spread[b] = sp;
+  }
+}
+
+/* ── SBR QMF ─────────────────────────────────────────────────
+ * Polyphase fold / sum of the QMF banks, 8 taps per iteration with FMA.
+ * bands is a multiple of 8, so there is no tail.
+ */
+
+static void aac_sbr_qmf_analysis_avx2(float* out, const float* in, const float* win, int bands) {
+  int m2 = 2 * bands;
+  for (int i = 0; i < m2; i += 8) {
+    __m256 acc = _mm256_setzero_ps();
+    for (int l = 0; l < 5; l++) {
+      int o = i + m2 * l;
+#if defined(__FMA__)
+      acc = _mm256_fmadd_ps(_mm256_loadu_ps(win + o), _mm256_loadu_ps(in + o), acc);
+#else
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(win + o), _mm256_loadu_ps(in + o)));
+#endif
+    }
+    _mm256_storeu_ps(out + i, acc);
+  }
+}
+
+static void aac_sbr_qmf_synthesis_avx2(float* out, const float* v, const float* win, int bands) {
+  for (int r = 0; r < bands; r += 8) {
+    __m256 acc = _mm256_setzero_ps();
+    for (int q = 0; q < 10; q++) {
+      __m256 w = _mm256_loadu_ps(win + bands * q + r);
+      __m256 x = _mm256_loadu_ps(v + 2 * bands * q + bands * (q & 1) + r);
+#if defined(__FMA__)
+      acc = _mm256_fmadd_ps(w, x, acc);
+#else
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(w, x));
+#endif
+    }
+    _mm256_storeu_ps(out + r, acc);
+  }
+}
+
+/* ── SBR HF ──────────────────────────────────────────────────
+ * Patch prediction and envelope gains, 8 bands per iteration. Patch widths
+ * are arbitrary, so both finish with a scalar tail.
+ */
+
+static void aac_sbr_hf_gen_avx2(float* hi_re, float* hi_im, const float* lo_re,
+                                const float* lo_im, const float* a0_re, const float* a0_im,
+                                const float* a1_re, const float* a1_im, int n, int slots) {
+  const int S = AAC_SBR_QMF_BANDS;
+  int nv = n & ~7;
+  for (int m = 0; m < slots; m++) {
+    const float* x0r = lo_re + m * S;
+    const float* x0i = lo_im + m * S;
+    const float* x1r = x0r - S;
+    const float* x1i = x0i - S;
+    const float* x2r = x1r - S;
+    const float* x2i = x1i - S;
+    float* yr = hi_re + m * S;
+    float* yi = hi_im + m * S;
+    int k = 0;
+    for (; k < nv; k += 8) {
+      __m256 ar = _mm256_loadu_ps(a0_re + k), ai = _mm256_loadu_ps(a0_im + k);
+      __m256 br = _mm256_loadu_ps(a1_re + k), bi = _mm256_loadu_ps(a1_im + k);
+      __m256 p1r = _mm256_loadu_ps(x1r + k), p1i = _mm256_loadu_ps(x1i + k);
+      __m256 p2r = _mm256_loadu_ps(x2r + k), p2i = _mm256_loadu_ps(x2i + k);
+      __m256 re = _mm256_sub_ps(_mm256_mul_ps(ar, p1r), _mm256_mul_ps(ai, p1i));
+      __m256 im = _mm256_add_ps(_mm256_mul_ps(ar, p1i), _mm256_mul_ps(ai, p1r));
+      re = _mm256_add_ps(re, _mm256_sub_ps(_mm256_mul_ps(br, p2r), _mm256_mul_ps(bi, p2i)));
+      im = _mm256_add_ps(im, _mm256_add_ps(_mm256_mul_ps(br, p2i), _mm256_mul_ps(bi, p2r)));
+      _mm256_storeu_ps(yr + k, _mm256_add_ps(_mm256_loadu_ps(x0r + k), re));
+      _mm256_storeu_ps(yi + k, _mm256_add_ps(_mm256_loadu_ps(x0i + k), im));
+    }
+    for (; k < n; k++) {
+      yr[k] = x0r[k] + a0_re[k] * x1r[k] - a0_im[k] * x1i[k] + a1_re[k] * x2r[k] -
+              a1_im[k] * x2i[k];
+      yi[k] = x0i[k] + a0_re[k] * x1i[k] + a0_im[k] * x1r[k] + a1_re[k] * x2i[k] +
+              a1_im[k] * x2r[k];
+    }
+  }
+}
+
+static void aac_sbr_hf_apply_avx2(float* y_re, float* y_im, const float* gain,
+                                  const float* noise_gain, const float* noise_re,
+                                  const float* noise_im, int n) {
+  int k = 0, nv = n & ~7;
+  for (; k < nv; k += 8) {
+    __m256 g = _mm256_loadu_ps(gain + k), q = _mm256_loadu_ps(noise_gain + k);
+    __m256 yr = _mm256_mul_ps(g, _mm256_loadu_ps(y_re + k));
+    __m256 yi = _mm256_mul_ps(g, _mm256_loadu_ps(y_im + k));
+    _mm256_storeu_ps(y_re + k, _mm256_add_ps(yr, _mm256_mul_ps(q, _mm256_loadu_ps(noise_re + k))));
+    _mm256_storeu_ps(y_im + k, _mm256_add_ps(yi, _mm256_mul_ps(q, _mm256_loadu_ps(noise_im + k))));
+  }
+  for (; k < n; k++) {
+    y_re[k] = gain[k] * y_re[k] + noise_gain[k] * noise_re[k];
+    y_im[k] = gain[k] * y_im[k] + noise_gain[k] * noise_im[k];
+  }
+}
+
+/* ── Parametric Stereo ───────────────────────────────────────
+ * Interpolated 2x2 mixing of one slot, 8 bands per iteration with a
+ * scalar tail.
+ */
+
+static void aac_ps_mix_avx2(float* l_re, float* l_im, float* r_re, float* r_im, float* h,
+                            const float* h_step, int n) {
+  int k = 0, nv = n & ~7;
+  for (; k < nv; k += 8) {
+    __m256 h11 = _mm256_add_ps(_mm256_loadu_ps(h + k), _mm256_loadu_ps(h_step + k));
+    __m256 h12 = _mm256_add_ps(_mm256_loadu_ps(h + n + k), _mm256_loadu_ps(h_step + n + k));
+    __m256 h21 = _mm256_add_ps(_mm256_loadu_ps(h + 2 * n + k), _mm256_loadu_ps(h_step + 2 * n + k));
+    __m256 h22 = _mm256_add_ps(_mm256_loadu_ps(h + 3 * n + k), _mm256_loadu_ps(h_step + 3 * n + k));
+    _mm256_storeu_ps(h + k, h11);
+    _mm256_storeu_ps(h + n + k, h12);
+    _mm256_storeu_ps(h + 2 * n + k, h21);
+    _mm256_storeu_ps(h + 3 * n + k, h22);
+    __m256 s_re = _mm256_loadu_ps(l_re + k), s_im = _mm256_loadu_ps(l_im + k);
+    __m256 d_re = _mm256_loadu_ps(r_re + k), d_im = _mm256_loadu_ps(r_im + k);
+    _mm256_storeu_ps(l_re + k, _mm256_add_ps(_mm256_mul_ps(h11, s_re), _mm256_mul_ps(h21, d_re)));
+    _mm256_storeu_ps(l_im + k, _mm256_add_ps(_mm256_mul_ps(h11, s_im), _mm256_mul_ps(h21, d_im)));
+    _mm256_storeu_ps(r_re + k, _mm256_add_ps(_mm256_mul_ps(h12, s_re), _mm256_mul_ps(h22, d_re)));
+    _mm256_storeu_ps(r_im + k, _mm256_add_ps(_mm256_mul_ps(h12, s_im), _mm256_mul_ps(h22, d_im)));
+  }
+  for (; k < n; k++) {
+    float h11 = h[k] += h_step[k];
+    float h12 = h[n + k] += h_step[n + k];
+    float h21 = h[2 * n + k] += h_step[2 * n + k];
+    float h22 = h[3 * n + k] += h_step[3 * n + k];
+    float s_re = l_re[k], s_im = l_im[k], d_re = r_re[k], d_im = r_im[k];
+    l_re[k] = h11 * s_re + h21 * d_re;
+    l_im[k] = h11 * s_im + h21 * d_im;
+    r_re[k] = h12 * s_re + h22 * d_re;
+    r_im[k] = h12 * s_im + h22 * d_im;
+  }
+}
+
+/* PS encoder statistics of one slot, 8 bands per iteration with a
+ * scalar tail */
+static void aac_ps_correlate_avx2(float* el, float* er, float* cr, const float* l_re,
+                                  const float* l_im, const float* r_re, const float* r_im, int n) {
+  int k = 0, nv = n & ~7;
+  for (; k < nv; k += 8) {
+    __m256 a_re = _mm256_loadu_ps(l_re + k), a_im = _mm256_loadu_ps(l_im + k);
+    __m256 b_re = _mm256_loadu_ps(r_re + k), b_im = _mm256_loadu_ps(r_im + k);
+    __m256 pl = _mm256_add_ps(_mm256_mul_ps(a_re, a_re), _mm256_mul_ps(a_im, a_im));
+    __m256 pr = _mm256_add_ps(_mm256_mul_ps(b_re, b_re), _mm256_mul_ps(b_im, b_im));
+    __m256 pc = _mm256_add_ps(_mm256_mul_ps(a_re, b_re), _mm256_mul_ps(a_im, b_im));
+    _mm256_storeu_ps(el + k, _mm256_add_ps(_mm256_loadu_ps(el + k), pl));
+    _mm256_storeu_ps(er + k, _mm256_add_ps(_mm256_loadu_ps(er + k), pr));
+    _mm256_storeu_ps(cr + k, _mm256_add_ps(_mm256_loadu_ps(cr + k), pc));
+  }
+  for (; k < n; k++) {
+    el[k] += l_re[k] * l_re[k] + l_im[k] * l_im[k];
+    er[k] += r_re[k] * r_re[k] + r_im[k] * r_im[k];
+    cr[k] += l_re[k] * r_re[k] + l_im[k] * r_im[k];
+  }
+}
+
+/* ── PCM Output ──────────────────────────────────────────────── */
+
+/* unpacklo/hi interleave within each 128-bit lane; the lane swap puts
+ * samples 0-3 ahead of 4-7 */
+static void aac_interleave2_avx2(float* dst, const float* l, const float* r, int n) {
+  int i = 0, n8 = n & ~7;
+  for (; i < n8; i += 8) {
+    __m256 vl = _mm256_loadu_ps(l + i), vr = _mm256_loadu_ps(r + i);
+    __m256 lo = _mm256_unpacklo_ps(vl, vr), hi = _mm256_unpackhi_ps(vl, vr);
+    _mm256_storeu_ps(dst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+    _mm256_storeu_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+  }
+  for (; i < n; i++) {
+    dst[2 * i] = l[i];
+    dst[2 * i + 1] = r[i];
+  }
+}
+
+static inline __m256i float_to_int_avx2(const float* src, const float* dither, int i,
+                                        __m256 scale, __m256 lo, __m256 hi) {
+  /* Not fused: the rounding matches the scalar and SSE2 kernels bit for bit */
+  __m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+  if (dither) {
+    v = _mm256_add_ps(v, _mm256_loadu_ps(dither + i));
+  }
+  return _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(v, lo), hi));
+}
+
+static void aac_float_to_s16_avx2(int16_t* dst, const float* src, const float* dither, int n) {
+  const __m256 scale = _mm256_set1_ps(32768.0f), lo = _mm256_set1_ps(-32768.0f);
+  const __m256 hi = _mm256_set1_ps(32767.0f);
+  int i = 0, n16 = n & ~15;
+  for (; i < n16; i += 16) {
+    __m256i a = float_to_int_avx2(src, dither, i, scale, lo, hi);
+    __m256i b = float_to_int_avx2(src, dither, i + 8, scale, lo, hi);
+    /* packs works per lane: a0-3 b0-3 a4-7 b4-7, reordered to a0-7 b0-7 */
+    __m256i p = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), p);
+  }
+  for (; i < n; i++) {
+    float v = src[i] * 32768.0f + (dither ? dither[i] : 0.0f);
+    dst[i] = (int16_t)lrintf(fminf(fmaxf(v, -32768.0f), 32767.0f));
+  }
+}
+
+static void aac_float_to_s24_avx2(int32_t* dst, const float* src, const float* dither, int n) {
+  const __m256 scale = _mm256_set1_ps(8388608.0f), lo = _mm256_set1_ps(-8388608.0f);
+  const __m256 hi = _mm256_set1_ps(8388607.0f);
+  int i = 0, n8 = n & ~7;
+  for (; i < n8; i += 8) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                        float_to_int_avx2(src, dither, i, scale, lo, hi));
+  }
+  for (; i < n; i++) {
+    float v = src[i] * 8388608.0f + (dither ? dither[i] : 0.0f);
+    dst[i] = (int32_t)lrintf(fminf(fmaxf(v, -8388608.0f), 8388607.0f));
+  }
+}
+
+/* ── Transport ───────────────────────────────────────────────── */
+
+static int aac_adts_sync_avx2(const uint8_t* data, int size) {
+  const __m256i ff = _mm256_set1_epi8((char)0xFF), mask = _mm256_set1_epi8((char)0xF6);
+  const __m256i sync = _mm256_set1_epi8((char)0xF0);
+  int i = 0;
+  for (; i + 65 <= size; i += 64) {
+    const auto* p = reinterpret_cast<const __m256i*>(data + i);
+    __m256i a0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(p), ff);
+    __m256i a1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(p + 1), ff);
+    __m256i any = _mm256_or_si256(a0, a1);
+    if (_mm256_testz_si256(any, any)) {
+      continue;
+    }
+    __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 1));
+    __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 33));
+    b0 = _mm256_and_si256(a0, _mm256_cmpeq_epi8(_mm256_and_si256(b0, mask), sync));
+    b1 = _mm256_and_si256(a1, _mm256_cmpeq_epi8(_mm256_and_si256(b1, mask), sync));
+    uint64_t bits = (uint32_t)_mm256_movemask_epi8(b0) |
+                    (uint64_t)(uint32_t)_mm256_movemask_epi8(b1) << 32;
+    if (bits) {
+      return i + __builtin_ctzll(bits);
+    }
+  }
+  for (; i < size - 1; i++) {
+    if (data[i] == 0xFF && (data[i + 1] & 0xF6) == 0xF0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 /* ── Registration ────────────────────────────────────────────── */
 
 void aac_dsp_init_avx2(AacDSP* dsp) {
@@ -408,6 +761,20 @@ void aac_dsp_init_avx2(AacDSP* dsp) {
   dsp->vector_fmul_window = aac_vector_fmul_window_avx2;
   dsp->vector_fmul_reverse = aac_vector_fmul_reverse_avx2;
   dsp->vector_fmul_accumulate = aac_vector_fmul_accumulate_avx2;
+  dsp->vector_is_zero = aac_vector_is_zero_avx2;
+  dsp->tns_fir = aac_tns_fir_avx2;
+  dsp->tns_iir = aac_tns_iir_avx2;
+  dsp->psycho_spreading = aac_psycho_spreading_avx2;
+  dsp->sbr_qmf_analysis = aac_sbr_qmf_analysis_avx2;
+  dsp->sbr_qmf_synthesis = aac_sbr_qmf_synthesis_avx2;
+  dsp->sbr_hf_gen = aac_sbr_hf_gen_avx2;
+  dsp->sbr_hf_apply = aac_sbr_hf_apply_avx2;
+  dsp->ps_mix = aac_ps_mix_avx2;
+  dsp->ps_correlate = aac_ps_correlate_avx2;
+  dsp->interleave2 = aac_interleave2_avx2;
+  dsp->float_to_s16 = aac_float_to_s16_avx2;
+  dsp->float_to_s24 = aac_float_to_s24_avx2;
+  dsp->adts_sync = aac_adts_sync_avx2;
 }
 
 #endif /* BAAC_AAC_AVX2 || __AVX2__ */
@@ -11,6 +11,7 @@
 #include "aac_dsp.h"
 #include "fft.h"
 #include "mdct.h"
+#include "spectral.h"
 
 #if defined(BAAC_AAC_NEON) || defined(__ARM_NEON) || defined(__aarch64__)
 
@@ -90,6 +91,24 @@ static void aac_vector_fmul_accumulate_neon(float* dst, const float* a, const fl
   for (; i < len; i++) dst[i] += a[i] * b[i];
 }
 
+static int aac_vector_is_zero_neon(const float* a, int len) {
+  const uint32x4_t abs_mask = vdupq_n_u32(0x7FFFFFFF);
+  int i = 0, n16 = len & ~15;
+  for (; i < n16; i += 16) {
+    uint32x4_t acc = vorrq_u32(vorrq_u32(vreinterpretq_u32_f32(vld1q_f32(a + i)),
+                                         vreinterpretq_u32_f32(vld1q_f32(a + i + 4))),
+                               vorrq_u32(vreinterpretq_u32_f32(vld1q_f32(a + i + 8)),
+                                         vreinterpretq_u32_f32(vld1q_f32(a + i + 12))));
+    acc = vandq_u32(acc, abs_mask);
+    uint32x2_t fold = vorr_u32(vget_low_u32(acc), vget_high_u32(acc));
+    if (vget_lane_u32(vpmax_u32(fold, fold), 0) != 0) return 0;
+  }
+  for (; i < len; i++) {
+    if (a[i] != 0.0f) return 0;
+  }
+  return 1;
+}
+
 /* ── FFT ─────────────────────────────────────────────────────── */
 
 static void neon_bit_reverse(float* re, float* im, int n) {
@@ -325,6 +344,299 @@ static void aac_imdct_half_neon(float* out, const float* in, int n, const float*
   }
 }
 
+/* ── TNS ─────────────────────────────────────────────────────
+ * FIR: 4 outputs per iteration once the whole history lies inside the
+ * region (n >= order), one broadcast coefficient per tap.
+ * IIR: the recursion is serial in n, so the order-long dot product is
+ * vectorised instead. Coefficients are reversed and front-padded with
+ * zeros to a multiple of 4, so the history x[n-R .. n) loads directly.
+ */
+
+static void aac_tns_fir_neon(float* dst, const float* src, int len, const float* lpc, int order) {
+  int n = order < len ? order : len;
+  aac_tns_fir_head(dst, src, n, lpc, order);
+  for (; n + 4 <= len; n += 4) {
+    float32x4_t acc = vld1q_f32(src + n);
+    for (int k = 1; k <= order; k++) acc = vmlaq_n_f32(acc, vld1q_f32(src + n - k), lpc[k - 1]);
+    vst1q_f32(dst + n, acc);
+  }
+  for (; n < len; n++) {
+    float acc = src[n];
+    for (int k = 1; k <= order; k++) acc += lpc[k - 1] * src[n - k];
+    dst[n] = acc;
+  }
+}
+
+static void aac_tns_iir_neon(float* x, int len, const float* lpc, int order) {
+  int R = (order + 3) & ~3;
+  float rev[AAC_TNS_MAX_ORDER + 4];
+  for (int j = 0; j < R; j++) rev[j] = (j < R - order) ? 0.0f : lpc[R - 1 - j];
+  int n = R < len ? R : len;
+  aac_tns_iir_head(x, n, lpc, order);
+  for (; n < len; n++) {
+    const float* h = x + n - R;
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (int j = 0; j < R; j += 4) acc = vmlaq_f32(acc, vld1q_f32(rev + j), vld1q_f32(h + j));
+    float32x2_t s = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    x[n] -= vget_lane_f32(vpadd_f32(s, s), 0);
+  }
+}
+
+/* ── Psycho Spreading ────────────────────────────────────────
+ * Banded convolution, 4 output bands per iteration (vmlaq per tap).
+ */
+
+static void aac_psycho_spreading_neon(float* spread, const float* energy, const float* kernel,
+                                      int radius, int n_sfb) {
+  int taps = 2 * radius + 1;
+  int b = 0, n4 = n_sfb & ~3;
+  for (; b < n4; b += 4) {
+    const float* e = energy + b - radius;
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (int t = 0; t < taps; t++) {
+      acc = vmlaq_n_f32(acc, vld1q_f32(e + t), kernel[t]);
+    }
+    vst1q_f32(spread + b, acc);
+  }
+  for (; b < n_sfb; b++) {
+    const float* e = energy + b - radius;
+    float sp = 0.0f;
+    for (int t = 0; t < taps; t++) sp += kernel[t] * e[t];
+    spread[b] = sp;
+  }
+}
+
+/* ── SBR QMF ─────────────────────────────────────────────────
+ * Polyphase fold / sum of the QMF banks, 4 taps per iteration (vmlaq).
+ * bands is a multiple of 8, so there is no scalar tail.
+ */
+
+static void aac_sbr_qmf_analysis_neon(float* out, const float* in, const float* win, int bands) {
+  int m2 = 2 * bands;
+  for (int i = 0; i < m2; i += 4) {
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (int l = 0; l < 5; l++) {
+      int o = i + m2 * l;
+      acc = vmlaq_f32(acc, vld1q_f32(win + o), vld1q_f32(in + o));
+    }
+    vst1q_f32(out + i, acc);
+  }
+}
+
+static void aac_sbr_qmf_synthesis_neon(float* out, const float* v, const float* win, int bands) {
+  for (int r = 0; r < bands; r += 4) {
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (int q = 0; q < 10; q++) {
+      acc = vmlaq_f32(acc, vld1q_f32(win + bands * q + r),
+                      vld1q_f32(v + 2 * bands * q + bands * (q & 1) + r));
+    }
+    vst1q_f32(out + r, acc);
+  }
+}
+
+/* ── SBR HF ──────────────────────────────────────────────────
+ * Patch prediction and envelope gains, 4 bands per iteration. Patch widths
+ * are arbitrary, so both finish with a scalar tail.
+ */
+
+static void aac_sbr_hf_gen_neon(float* hi_re, float* hi_im, const float* lo_re,
+                                const float* lo_im, const float* a0_re, const float* a0_im,
+                                const float* a1_re, const float* a1_im, int n, int slots) {
+  const int S = AAC_SBR_QMF_BANDS;
+  int nv = n & ~3;
+  for (int m = 0; m < slots; m++) {
+    const float* x0r = lo_re + m * S;
+    const float* x0i = lo_im + m * S;
+    const float* x1r = x0r - S;
+    const float* x1i = x0i - S;
+    const float* x2r = x1r - S;
+    const float* x2i = x1i - S;
+    float* yr = hi_re + m * S;
+    float* yi = hi_im + m * S;
+    int k = 0;
+    for (; k < nv; k += 4) {
+      float32x4_t ar = vld1q_f32(a0_re + k), ai = vld1q_f32(a0_im + k);
+      float32x4_t br = vld1q_f32(a1_re + k), bi = vld1q_f32(a1_im + k);
+      float32x4_t p1r = vld1q_f32(x1r + k), p1i = vld1q_f32(x1i + k);
+      float32x4_t p2r = vld1q_f32(x2r + k), p2i = vld1q_f32(x2i + k);
+      float32x4_t re = vsubq_f32(vmulq_f32(ar, p1r), vmulq_f32(ai, p1i));
+      float32x4_t im = vaddq_f32(vmulq_f32(ar, p1i), vmulq_f32(ai, p1r));
+      re = vaddq_f32(re, vsubq_f32(vmulq_f32(br, p2r), vmulq_f32(bi, p2i)));
+      im = vaddq_f32(im, vaddq_f32(vmulq_f32(br, p2i), vmulq_f32(bi, p2r)));
+      vst1q_f32(yr + k, vaddq_f32(vld1q_f32(x0r + k), re));
+      vst1q_f32(yi + k, vaddq_f32(vld1q_f32(x0i + k), im));
+    }
+    for (; k < n; k++) {
+      yr[k] = x0r[k] + a0_re[k] * x1r[k] - a0_im[k] * x1i[k] + a1_re[k] * x2r[k] -
+              a1_im[k] * x2i[k];
+      yi[k] = x0i[k] + a0_re[k] * x1i[k] + a0_im[k] * x1r[k] + a1_re[k] * x2i[k] +
+              a1_im[k] * x2r[k];
+    }
+  }
+}
+
+static void aac_sbr_hf_apply_neon(float* y_re, float* y_im, const float* gain,
+                                  const float* noise_gain, const float* noise_re,
+                                  const float* noise_im, int n) {
+  int k = 0, nv = n & ~3;
+  for (; k < nv; k += 4) {
+    float32x4_t g = vld1q_f32(gain + k), q = vld1q_f32(noise_gain + k);
+    float32x4_t yr = vmulq_f32(g, vld1q_f32(y_re + k));
+    float32x4_t yi = vmulq_f32(g, vld1q_f32(y_im + k));
+    vst1q_f32(y_re + k, vaddq_f32(yr, vmulq_f32(q, vld1q_f32(noise_re + k))));
+    vst1q_f32(y_im + k, vaddq_f32(yi, vmulq_f32(q, vld1q_f32(noise_im + k))));
+  }
+  for (; k < n; k++) {
+    y_re[k] = gain[k] * y_re[k] + noise_gain[k] * noise_re[k];
+    y_im[k] = gain[k] * y_im[k] + noise_gain[k] * noise_im[k];
+  }
+}
+
+/* ── Parametric Stereo ───────────────────────────────────────
+ * Interpolated 2x2 mixing of one slot, 4 bands per iteration with a
+ * scalar tail.
+ */
+
+static void aac_ps_mix_neon(float* l_re, float* l_im, float* r_re, float* r_im, float* h,
+                            const float* h_step, int n) {
+  int k = 0, nv = n & ~3;
+  for (; k < nv; k += 4) {
+    float32x4_t h11 = vaddq_f32(vld1q_f32(h + k), vld1q_f32(h_step + k));
+    float32x4_t h12 = vaddq_f32(vld1q_f32(h + n + k), vld1q_f32(h_step + n + k));
+    float32x4_t h21 = vaddq_f32(vld1q_f32(h + 2 * n + k), vld1q_f32(h_step + 2 * n + k));
+    float32x4_t h22 = vaddq_f32(vld1q_f32(h + 3 * n + k), vld1q_f32(h_step + 3 * n + k));
+    vst1q_f32(h + k, h11);
+    vst1q_f32(h + n + k, h12);
+    vst1q_f32(h + 2 * n + k, h21);
+    vst1q_f32(h + 3 * n + k, h22);
+    float32x4_t s_re = vld1q_f32(l_re + k), s_im = vld1q_f32(l_im + k);
+    float32x4_t d_re = vld1q_f32(r_re + k), d_im = vld1q_f32(r_im + k);
+    vst1q_f32(l_re + k, vaddq_f32(vmulq_f32(h11, s_re), vmulq_f32(h21, d_re)));
+    vst1q_f32(l_im + k, vaddq_f32(vmulq_f32(h11, s_im), vmulq_f32(h21, d_im)));
+    vst1q_f32(r_re + k, vaddq_f32(vmulq_f32(h12, s_re), vmulq_f32(h22, d_re)));
+    vst1q_f32(r_im + k, vaddq_f32(vmulq_f32(h12, s_im), vmulq_f32(h22, d_im)));
+  }
+  for (; k < n; k++) {
+    float h11 = h[k] += h_step[k];
+    float h12 = h[n + k] += h_step[n + k];
+    float h21 = h[2 * n + k] += h_step[2 * n + k];
+    float h22 = h[3 * n + k] += h_step[3 * n + k];
+    float s_re = l_re[k], s_im = l_im[k], d_re = r_re[k], d_im = r_im[k];
+    l_re[k] = h11 * s_re + h21 * d_re;
+    l_im[k] = h11 * s_im + h21 * d_im;
+    r_re[k] = h12 * s_re + h22 * d_re;
+    r_im[k] = h12 * s_im + h22 * d_im;
+  }
+}
+
+/* PS encoder statistics of one slot, 4 bands per iteration with a
+ * scalar tail */
+static void aac_ps_correlate_neon(float* el, float* er, float* cr, const float* l_re,
+                                  const float* l_im, const float* r_re, const float* r_im, int n) {
+  int k = 0, nv = n & ~3;
+  for (; k < nv; k += 4) {
+    float32x4_t a_re = vld1q_f32(l_re + k), a_im = vld1q_f32(l_im + k);
+    float32x4_t b_re = vld1q_f32(r_re + k), b_im = vld1q_f32(r_im + k);
+    float32x4_t pl = vaddq_f32(vmulq_f32(a_re, a_re), vmulq_f32(a_im, a_im));
+    float32x4_t pr = vaddq_f32(vmulq_f32(b_re, b_re), vmulq_f32(b_im, b_im));
+    float32x4_t pc = vaddq_f32(vmulq_f32(a_re, b_re), vmulq_f32(a_im, b_im));
+    vst1q_f32(el + k, vaddq_f32(vld1q_f32(el + k), pl));
+    vst1q_f32(er + k, vaddq_f32(vld1q_f32(er + k), pr));
+    vst1q_f32(cr + k, vaddq_f32(vld1q_f32(cr + k), pc));
+  }
+  for (; k < n; k++) {
+    el[k] += l_re[k] * l_re[k] + l_im[k] * l_im[k];
+    er[k] += r_re[k] * r_re[k] + r_im[k] * r_im[k];
+    cr[k] += l_re[k] * r_re[k] + l_im[k] * r_im[k];
+  }
+}
+
+/* ── PCM Output ──────────────────────────────────────────────── */
+
+static void aac_interleave2_neon(float* dst, const float* l, const float* r, int n) {
+  int i = 0, n4 = n & ~3;
+  for (; i < n4; i += 4) {
+    float32x4x2_t v = {{vld1q_f32(l + i), vld1q_f32(r + i)}};
+    vst2q_f32(dst + 2 * i, v);
+  }
+  for (; i < n; i++) {
+    dst[2 * i] = l[i];
+    dst[2 * i + 1] = r[i];
+  }
+}
+
+#if defined(__aarch64__)
+/* Round-to-nearest-even conversion (vcvtnq) is AArch64 only; ARMv7 keeps
+ * the scalar kernels. vmaxnm yields lo for NaN. */
+static inline int32x4_t float_to_int_neon(const float* src, const float* dither, int i,
+                                          float32x4_t scale, float32x4_t lo, float32x4_t hi) {
+  float32x4_t v = vmulq_f32(vld1q_f32(src + i), scale);
+  if (dither) {
+    v = vaddq_f32(v, vld1q_f32(dither + i));
+  }
+  return vcvtnq_s32_f32(vminnmq_f32(vmaxnmq_f32(v, lo), hi));
+}
+
+static void aac_float_to_s16_neon(int16_t* dst, const float* src, const float* dither, int n) {
+  const float32x4_t scale = vdupq_n_f32(32768.0f), lo = vdupq_n_f32(-32768.0f);
+  const float32x4_t hi = vdupq_n_f32(32767.0f);
+  int i = 0, n8 = n & ~7;
+  for (; i < n8; i += 8) {
+    int32x4_t a = float_to_int_neon(src, dither, i, scale, lo, hi);
+    int32x4_t b = float_to_int_neon(src, dither, i + 4, scale, lo, hi);
+    vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+  }
+  for (; i < n; i++) {
+    float v = src[i] * 32768.0f + (dither ? dither[i] : 0.0f);
+    dst[i] = (int16_t)lrintf(fminf(fmaxf(v, -32768.0f), 32767.0f));
+  }
+}
+
+static void aac_float_to_s24_neon(int32_t* dst, const float* src, const float* dither, int n) {
+  const float32x4_t scale = vdupq_n_f32(8388608.0f), lo = vdupq_n_f32(-8388608.0f);
+  const float32x4_t hi = vdupq_n_f32(8388607.0f);
+  int i = 0, n4 = n & ~3;
+  for (; i < n4; i += 4) {
+    vst1q_s32(dst + i, float_to_int_neon(src, dither, i, scale, lo, hi));
+  }
+  for (; i < n; i++) {
+    float v = src[i] * 8388608.0f + (dither ? dither[i] : 0.0f);
+    dst[i] = (int32_t)lrintf(fminf(fmaxf(v, -8388608.0f), 8388607.0f));
+  }
+}
+#endif
+
+/* ── Transport ───────────────────────────────────────────────── */
+
+/* No movemask: narrowing each 16-bit lane by 4 leaves a nibble per byte */
+static int aac_adts_sync_neon(const uint8_t* data, int size) {
+  const uint8x16_t ff = vdupq_n_u8(0xFF), mask = vdupq_n_u8(0xF6), sync = vdupq_n_u8(0xF0);
+  int i = 0;
+  for (; i + 33 <= size; i += 32) {
+    uint8x16_t a0 = vceqq_u8(vld1q_u8(data + i), ff), a1 = vceqq_u8(vld1q_u8(data + i + 16), ff);
+    uint8x16_t any = vorrq_u8(a0, a1);
+    uint32x2_t fold = vreinterpret_u32_u8(vorr_u8(vget_low_u8(any), vget_high_u8(any)));
+    if (vget_lane_u32(vpmax_u32(fold, fold), 0) == 0) {
+      continue;
+    }
+    for (int k = 0; k < 2; k++) {
+      uint8x16_t b = vld1q_u8(data + i + 16 * k + 1);
+      uint8x16_t hit = vandq_u8(k ? a1 : a0, vceqq_u8(vandq_u8(b, mask), sync));
+      uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(hit), 4);
+      uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+      if (bits) {
+        return i + 16 * k + (__builtin_ctzll(bits) >> 2);
+      }
+    }
+  }
+  for (; i < size - 1; i++) {
+    if (data[i] == 0xFF && (data[i + 1] & 0xF6) == 0xF0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 /* ── Registration ────────────────────────────────────────────── */
 
 void aac_dsp_init_neon(AacDSP* dsp) {
@@ -338,6 +650,22 @@ void aac_dsp_init_neon(AacDSP* dsp) {
   dsp->vector_fmul_window = aac_vector_fmul_window_neon;
   dsp->vector_fmul_reverse = aac_vector_fmul_reverse_neon;
   dsp->vector_fmul_accumulate = aac_vector_fmul_accumulate_neon;
+  dsp->vector_is_zero = aac_vector_is_zero_neon;
+  dsp->tns_fir = aac_tns_fir_neon;
+  dsp->tns_iir = aac_tns_iir_neon;
+  dsp->psycho_spreading = aac_psycho_spreading_neon;
+  dsp->sbr_qmf_analysis = aac_sbr_qmf_analysis_neon;
+  dsp->sbr_qmf_synthesis = aac_sbr_qmf_synthesis_neon;
+  dsp->sbr_hf_gen = aac_sbr_hf_gen_neon;
+  dsp->sbr_hf_apply = aac_sbr_hf_apply_neon;
+  dsp->ps_mix = aac_ps_mix_neon;
+  dsp->ps_correlate = aac_ps_correlate_neon;
+  dsp->interleave2 = aac_interleave2_neon;
+  dsp->adts_sync = aac_adts_sync_neon;
+#if defined(__aarch64__)
+  dsp->float_to_s16 = aac_float_to_s16_neon;
+  dsp->float_to_s24 = aac_float_to_s24_neon;
+#endif
 }
 
 #endif /* BAAC_AAC_NEON || __ARM_NEON || __aarch64__ */
@@ -11,6 +11,7 @@
 #include "aac_dsp.h"
 #include "fft.h"
 #include "mdct.h"
+#include "spectral.h"
 
 #if defined(BAAC_AAC_SSE2) || defined(__SSE2__)
 
@@ -102,6 +103,29 @@ static void aac_vector_fmul_accumulate_sse2(float* dst, const float* a, const fl
   }
 }
 
+/* All elements ±0.0f? Sign bits are masked so -0.0f counts as silence;
+ * blocks of 16 are OR-reduced so loud input exits on the first block. */
+static int aac_vector_is_zero_sse2(const float* a, int len) {
+  const __m128i abs_mask = _mm_set1_epi32(0x7FFFFFFF);
+  int i = 0, n16 = len & ~15;
+  for (; i < n16; i += 16) {
+    __m128i v0 = _mm_castps_si128(_mm_loadu_ps(a + i));
+    __m128i v1 = _mm_castps_si128(_mm_loadu_ps(a + i + 4));
+    __m128i v2 = _mm_castps_si128(_mm_loadu_ps(a + i + 8));
+    __m128i v3 = _mm_castps_si128(_mm_loadu_ps(a + i + 12));
+    __m128i acc = _mm_and_si128(_mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3)), abs_mask);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(acc, _mm_setzero_si128())) != 0xFFFF) {
+      return 0;
+    }
+  }
+  for (; i < len; i++) {
+    if (a[i] != 0.0f) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
 /* ── FFT ─────────────────────────────────────────────────────── */
 
 static void sse2_bit_reverse(float* re, float* im, int n) {
@@ -362,6 +386,316 @@ static void aac_imdct_half_sse2(float* out, const float* in, int n, const float*
   }
 }
 
+/* ── TNS ─────────────────────────────────────────────────────
+ * FIR: 4 outputs per iteration once the whole history lies inside the
+ * region (n >= order), one broadcast coefficient per tap.
+ * IIR: the recursion is serial in n, so the order-long dot product is
+ * vectorised instead. Coefficients are reversed and front-padded with
+ * zeros to a multiple of 4, so the history x[n-R .. n) loads directly.
+ */
+
+static void aac_tns_fir_sse2(float* dst, const float* src, int len, const float* lpc, int order) {
+  int n = order < len ? order : len;
+  aac_tns_fir_head(dst, src, n, lpc, order);
+  for (; n + 4 <= len; n += 4) {
+    __m128 acc = _mm_loadu_ps(src + n);
+    for (int k = 1; k <= order; k++) {
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(lpc[k - 1]), _mm_loadu_ps(src + n - k)));
+    }
+    _mm_storeu_ps(dst + n, acc);
+  }
+  for (; n < len; n++) {
+    float acc = src[n];
+    for (int k = 1; k <= order; k++) {
+      acc += lpc[k - 1] * src[n - k];
+    }
+    dst[n] = acc;
+  }
+}
+
+static void aac_tns_iir_sse2(float* x, int len, const float* lpc, int order) {
+  int R = (order + 3) & ~3;
+  float rev[AAC_TNS_MAX_ORDER + 4];
+  for (int j = 0; j < R; j++) {
+    rev[j] = (j < R - order) ? 0.0f : lpc[R - 1 - j];
+  }
+  int n = R < len ? R : len;
+  aac_tns_iir_head(x, n, lpc, order);
+  for (; n < len; n++) {
+    const float* h = x + n - R;
+    __m128 acc = _mm_setzero_ps();
+    for (int j = 0; j < R; j += 4) {
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rev + j), _mm_loadu_ps(h + j)));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    x[n] -= _mm_cvtss_f32(acc);
+  }
+}
+
+/* ── Psycho Spreading ────────────────────────────────────────
+ * Banded convolution, 4 output bands per iteration. One broadcast kernel
+ * tap per step; energy is zero padded by the caller so the shifted loads
+ * never need edge checks.
+ */
+
+static void aac_psycho_spreading_sse2(float* spread, const float* energy, const float* kernel,
+                                      int radius, int n_sfb) {
+  int taps = 2 * radius + 1;
+  int b = 0, n4 = n_sfb & ~3;
+  for (; b < n4; b += 4) {
+    const float* e = energy + b - radius;
+    __m128 acc = _mm_setzero_ps();
+    for (int t = 0; t < taps; t++) {
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(kernel[t]), _mm_loadu_ps(e + t)));
+    }
+    _mm_storeu_ps(spread + b, acc);
+  }
+  for (; b < n_sfb; b++) {
+    const float* e = energy + b - radius;
+    float sp = 0.0f;
+    for (int t = 0; t < taps; t++) {
+      sp += kernel[t] * e[t];
+    }
+    spread[b] = sp;
+  }
+}
+
+/* ── SBR QMF ─────────────────────────────────────────────────
+ * Polyphase fold / sum of the QMF banks, 4 taps per iteration. bands is a
+ * multiple of 8, so there is no scalar tail.
+ */
+
+static void aac_sbr_qmf_analysis_sse2(float* out, const float* in, const float* win, int bands) {
+  int m2 = 2 * bands;
+  for (int i = 0; i < m2; i += 4) {
+    __m128 acc = _mm_setzero_ps();
+    for (int l = 0; l < 5; l++) {
+      int o = i + m2 * l;
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(win + o), _mm_loadu_ps(in + o)));
+    }
+    _mm_storeu_ps(out + i, acc);
+  }
+}
+
+static void aac_sbr_qmf_synthesis_sse2(float* out, const float* v, const float* win, int bands) {
+  for (int r = 0; r < bands; r += 4) {
+    __m128 acc = _mm_setzero_ps();
+    for (int q = 0; q < 10; q++) {
+      __m128 w = _mm_loadu_ps(win + bands * q + r);
+      acc = _mm_add_ps(acc, _mm_mul_ps(w, _mm_loadu_ps(v + 2 * bands * q + bands * (q & 1) + r)));
+    }
+    _mm_storeu_ps(out + r, acc);
+  }
+}
+
+/* ── SBR HF ──────────────────────────────────────────────────
+ * Patch prediction and envelope gains, 4 bands per iteration. Patch widths
+ * are arbitrary, so both finish with a scalar tail.
+ */
+
+static void aac_sbr_hf_gen_sse2(float* hi_re, float* hi_im, const float* lo_re,
+                                const float* lo_im, const float* a0_re, const float* a0_im,
+                                const float* a1_re, const float* a1_im, int n, int slots) {
+  const int S = AAC_SBR_QMF_BANDS;
+  int nv = n & ~3;
+  for (int m = 0; m < slots; m++) {
+    const float* x0r = lo_re + m * S;
+    const float* x0i = lo_im + m * S;
+    const float* x1r = x0r - S;
+    const float* x1i = x0i - S;
+    const float* x2r = x1r - S;
+    const float* x2i = x1i - S;
+    float* yr = hi_re + m * S;
+    float* yi = hi_im + m * S;
+    int k = 0;
+    for (; k < nv; k += 4) {
+      __m128 ar = _mm_loadu_ps(a0_re + k), ai = _mm_loadu_ps(a0_im + k);
+      __m128 br = _mm_loadu_ps(a1_re + k), bi = _mm_loadu_ps(a1_im + k);
+      __m128 p1r = _mm_loadu_ps(x1r + k), p1i = _mm_loadu_ps(x1i + k);
+      __m128 p2r = _mm_loadu_ps(x2r + k), p2i = _mm_loadu_ps(x2i + k);
+      __m128 re = _mm_sub_ps(_mm_mul_ps(ar, p1r), _mm_mul_ps(ai, p1i));
+      __m128 im = _mm_add_ps(_mm_mul_ps(ar, p1i), _mm_mul_ps(ai, p1r));
+      re = _mm_add_ps(re, _mm_sub_ps(_mm_mul_ps(br, p2r), _mm_mul_ps(bi, p2i)));
+      im = _mm_add_ps(im, _mm_add_ps(_mm_mul_ps(br, p2i), _mm_mul_ps(bi, p2r)));
+      _mm_storeu_ps(yr + k, _mm_add_ps(_mm_loadu_ps(x0r + k), re));
+      _mm_storeu_ps(yi + k, _mm_add_ps(_mm_loadu_ps(x0i + k), im));
+    }
+    for (; k < n; k++) {
+      yr[k] = x0r[k] + a0_re[k] * x1r[k] - a0_im[k] * x1i[k] + a1_re[k] * x2r[k] -
+              a1_im[k] * x2i[k];
+      yi[k] = x0i[k] + a0_re[k] * x1i[k] + a0_im[k] * x1r[k] + a1_re[k] * x2i[k] +
+              a1_im[k] * x2r[k];
+    }
+  }
+}
+
+static void aac_sbr_hf_apply_sse2(float* y_re, float* y_im, const float* gain,
+                                  const float* noise_gain, const float* noise_re,
+                                  const float* noise_im, int n) {
+  int k = 0, nv = n & ~3;
+  for (; k < nv; k += 4) {
+    __m128 g = _mm_loadu_ps(gain + k), q = _mm_loadu_ps(noise_gain + k);
+    __m128 yr = _mm_mul_ps(g, _mm_loadu_ps(y_re + k));
+    __m128 yi = _mm_mul_ps(g, _mm_loadu_ps(y_im + k));
+    _mm_storeu_ps(y_re + k, _mm_add_ps(yr, _mm_mul_ps(q, _mm_loadu_ps(noise_re + k))));
+    _mm_storeu_ps(y_im + k, _mm_add_ps(yi, _mm_mul_ps(q, _mm_loadu_ps(noise_im + k))));
+  }
+  for (; k < n; k++) {
+    y_re[k] = gain[k] * y_re[k] + noise_gain[k] * noise_re[k];
+    y_im[k] = gain[k] * y_im[k] + noise_gain[k] * noise_im[k];
+  }
+}
+
+/* ── Parametric Stereo ───────────────────────────────────────
+ * Interpolated 2x2 mixing of one slot, 4 bands per iteration with a
+ * scalar tail.
+ */
+
+static void aac_ps_mix_sse2(float* l_re, float* l_im, float* r_re, float* r_im, float* h,
+                            const float* h_step, int n) {
+  int k = 0, nv = n & ~3;
+  for (; k < nv; k += 4) {
+    __m128 h11 = _mm_add_ps(_mm_loadu_ps(h + k), _mm_loadu_ps(h_step + k));
+    __m128 h12 = _mm_add_ps(_mm_loadu_ps(h + n + k), _mm_loadu_ps(h_step + n + k));
+    __m128 h21 = _mm_add_ps(_mm_loadu_ps(h + 2 * n + k), _mm_loadu_ps(h_step + 2 * n + k));
+    __m128 h22 = _mm_add_ps(_mm_loadu_ps(h + 3 * n + k), _mm_loadu_ps(h_step + 3 * n + k));
+    _mm_storeu_ps(h + k, h11);
+    _mm_storeu_ps(h + n + k, h12);
+    _mm_storeu_ps(h + 2 * n + k, h21);
+    _mm_storeu_ps(h + 3 * n + k, h22);
+    __m128 s_re = _mm_loadu_ps(l_re + k), s_im = _mm_loadu_ps(l_im + k);
+    __m128 d_re = _mm_loadu_ps(r_re + k), d_im = _mm_loadu_ps(r_im + k);
+    _mm_storeu_ps(l_re + k, _mm_add_ps(_mm_mul_ps(h11, s_re), _mm_mul_ps(h21, d_re)));
+    _mm_storeu_ps(l_im + k, _mm_add_ps(_mm_mul_ps(h11, s_im), _mm_mul_ps(h21, d_im)));
+    _mm_storeu_ps(r_re + k, _mm_add_ps(_mm_mul_ps(h12, s_re), _mm_mul_ps(h22, d_re)));
+    _mm_storeu_ps(r_im + k, _mm_add_ps(_mm_mul_ps(h12, s_im), _mm_mul_ps(h22, d_im)));
+  }
+  for (; k < n; k++) {
+    float h11 = h[k] += h_step[k];
+    float h12 = h[n + k] += h_step[n + k];
+    float h21 = h[2 * n + k] += h_step[2 * n + k];
+    float h22 = h[3 * n + k] += h_step[3 * n + k];
+    float s_re = l_re[k], s_im = l_im[k], d_re = r_re[k], d_im = r_im[k];
+    l_re[k] = h11 * s_re + h21 * d_re;
+    l_im[k] = h11 * s_im + h21 * d_im;
+    r_re[k] = h12 * s_re + h22 * d_re;
+    r_im[k] = h12 * s_im + h22 * d_im;
+  }
+}
+
+/* PS encoder statistics of one slot, 4 bands per iteration with a
+ * scalar tail */
+static void aac_ps_correlate_sse2(float* el, float* er, float* cr, const float* l_re,
+                                  const float* l_im, const float* r_re, const float* r_im, int n) {
+  int k = 0, nv = n & ~3;
+  for (; k < nv; k += 4) {
+    __m128 a_re = _mm_loadu_ps(l_re + k), a_im = _mm_loadu_ps(l_im + k);
+    __m128 b_re = _mm_loadu_ps(r_re + k), b_im = _mm_loadu_ps(r_im + k);
+    __m128 pl = _mm_add_ps(_mm_mul_ps(a_re, a_re), _mm_mul_ps(a_im, a_im));
+    __m128 pr = _mm_add_ps(_mm_mul_ps(b_re, b_re), _mm_mul_ps(b_im, b_im));
+    __m128 pc = _mm_add_ps(_mm_mul_ps(a_re, b_re), _mm_mul_ps(a_im, b_im));
+    _mm_storeu_ps(el + k, _mm_add_ps(_mm_loadu_ps(el + k), pl));
+    _mm_storeu_ps(er + k, _mm_add_ps(_mm_loadu_ps(er + k), pr));
+    _mm_storeu_ps(cr + k, _mm_add_ps(_mm_loadu_ps(cr + k), pc));
+  }
+  for (; k < n; k++) {
+    el[k] += l_re[k] * l_re[k] + l_im[k] * l_im[k];
+    er[k] += r_re[k] * r_re[k] + r_im[k] * r_im[k];
+    cr[k] += l_re[k] * r_re[k] + l_im[k] * r_im[k];
+  }
+}
+
+/* ── PCM Output ──────────────────────────────────────────────── */
+
+static void aac_interleave2_sse2(float* dst, const float* l, const float* r, int n) {
+  int i = 0, n4 = n & ~3;
+  for (; i < n4; i += 4) {
+    __m128 vl = _mm_loadu_ps(l + i), vr = _mm_loadu_ps(r + i);
+    _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(vl, vr));
+    _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(vl, vr));
+  }
+  for (; i < n; i++) {
+    dst[2 * i] = l[i];
+    dst[2 * i + 1] = r[i];
+  }
+}
+
+/* Clamped in float first: cvtps returns INT_MIN for anything out of range.
+ * max(v, lo) yields lo for NaN, like the scalar fmaxf. */
+static inline __m128i float_to_int_sse2(const float* src, const float* dither, int i,
+                                        __m128 scale, __m128 lo, __m128 hi) {
+  __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+  if (dither) {
+    v = _mm_add_ps(v, _mm_loadu_ps(dither + i));
+  }
+  return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, lo), hi));
+}
+
+static void aac_float_to_s16_sse2(int16_t* dst, const float* src, const float* dither, int n) {
+  const __m128 scale = _mm_set1_ps(32768.0f), lo = _mm_set1_ps(-32768.0f);
+  const __m128 hi = _mm_set1_ps(32767.0f);
+  int i = 0, n8 = n & ~7;
+  for (; i < n8; i += 8) {
+    __m128i a = float_to_int_sse2(src, dither, i, scale, lo, hi);
+    __m128i b = float_to_int_sse2(src, dither, i + 4, scale, lo, hi);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+  }
+  for (; i < n; i++) {
+    float v = src[i] * 32768.0f + (dither ? dither[i] : 0.0f);
+    dst[i] = (int16_t)lrintf(fminf(fmaxf(v, -32768.0f), 32767.0f));
+  }
+}
+
+static void aac_float_to_s24_sse2(int32_t* dst, const float* src, const float* dither, int n) {
+  const __m128 scale = _mm_set1_ps(8388608.0f), lo = _mm_set1_ps(-8388608.0f);
+  const __m128 hi = _mm_set1_ps(8388607.0f);
+  int i = 0, n4 = n & ~3;
+  for (; i < n4; i += 4) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                     float_to_int_sse2(src, dither, i, scale, lo, hi));
+  }
+  for (; i < n; i++) {
+    float v = src[i] * 8388608.0f + (dither ? dither[i] : 0.0f);
+    dst[i] = (int32_t)lrintf(fminf(fmaxf(v, -8388608.0f), 8388607.0f));
+  }
+}
+
+/* ── Transport ───────────────────────────────────────────────── */
+
+/* 64 candidates per step. Blocks without an 0xFF, most of them in coded
+ * data, are skipped before the syncword and layer bits after it are tested. */
+static int aac_adts_sync_sse2(const uint8_t* data, int size) {
+  const __m128i ff = _mm_set1_epi8((char)0xFF), mask = _mm_set1_epi8((char)0xF6);
+  const __m128i sync = _mm_set1_epi8((char)0xF0);
+  int i = 0;
+  for (; i + 65 <= size; i += 64) {
+    __m128i a[4];
+    for (int k = 0; k < 4; k++) {
+      a[k] = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16 * k)),
+                            ff);
+    }
+    if (!_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a[0], a[1]), _mm_or_si128(a[2], a[3])))) {
+      continue;
+    }
+    uint64_t bits = 0;
+    for (int k = 0; k < 4; k++) {
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16 * k + 1));
+      b = _mm_and_si128(a[k], _mm_cmpeq_epi8(_mm_and_si128(b, mask), sync));
+      bits |= (uint64_t)_mm_movemask_epi8(b) << (16 * k);
+    }
+    if (bits) {
+      return i + __builtin_ctzll(bits);
+    }
+  }
+  for (; i < size - 1; i++) {
+    if (data[i] == 0xFF && (data[i + 1] & 0xF6) == 0xF0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 /* ── Registration ────────────────────────────────────────────── */
 
 void aac_dsp_init_sse2(AacDSP* dsp) {
@@ -375,6 +709,20 @@ void aac_dsp_init_sse2(AacDSP* dsp) {
   dsp->vector_fmul_window = aac_vector_fmul_window_sse2;
   dsp->vector_fmul_reverse = aac_vector_fmul_reverse_sse2;
   dsp->vector_fmul_accumulate = aac_vector_fmul_accumulate_sse2;
+  dsp->vector_is_zero = aac_vector_is_zero_sse2;
+  dsp->tns_fir = aac_tns_fir_sse2;
+  dsp->tns_iir = aac_tns_iir_sse2;
+  dsp->psycho_spreading = aac_psycho_spreading_sse2;
+  dsp->sbr_qmf_analysis = aac_sbr_qmf_analysis_sse2;
+  dsp->sbr_qmf_synthesis = aac_sbr_qmf_synthesis_sse2;
+  dsp->sbr_hf_gen = aac_sbr_hf_gen_sse2;
+  dsp->sbr_hf_apply = aac_sbr_hf_apply_sse2;
+  dsp->ps_mix = aac_ps_mix_sse2;
+  dsp->ps_correlate = aac_ps_correlate_sse2;
+  dsp->interleave2 = aac_interleave2_sse2;
+  dsp->float_to_s16 = aac_float_to_s16_sse2;
+  dsp->float_to_s24 = aac_float_to_s24_sse2;
+  dsp->adts_sync = aac_adts_sync_sse2;
 }
 
 #endif /* BAAC_AAC_SSE2 || __SSE2__ */
@@ -11,6 +11,7 @@
 #include "aac_dsp.h"
 #include "fft.h"
 #include "mdct.h"
+#include "spectral.h"
 
 #if defined(BAAC_AAC_WASM) || defined(__wasm_simd128__)
 
@@ -88,6 +89,20 @@ static void aac_vector_fmul_accumulate_wasm(float* dst, const float* a, const fl
   for (; i < len; i++) dst[i] += a[i] * b[i];
 }
 
+static int aac_vector_is_zero_wasm(const float* a, int len) {
+  const v128_t abs_mask = wasm_i32x4_splat(0x7FFFFFFF);
+  int i = 0, n16 = len & ~15;
+  for (; i < n16; i += 16) {
+    v128_t acc = wasm_v128_or(wasm_v128_or(wasm_v128_load(a + i), wasm_v128_load(a + i + 4)),
+                              wasm_v128_or(wasm_v128_load(a + i + 8), wasm_v128_load(a + i + 12)));
+    if (wasm_v128_any_true(wasm_v128_and(acc, abs_mask))) return 0;
+  }
+  for (; i < len; i++) {
+    if (a[i] != 0.0f) return 0;
+  }
+  return 1;
+}
+
 /* ── FFT ─────────────────────────────────────────────────────── */
 
 static void wasm_bit_reverse(float* re, float* im, int n) {
@@ -321,6 +336,255 @@ static void aac_imdct_half_wasm(float* out, const float* in, int n, const float*
   }
 }
 
+/* ── TNS ─────────────────────────────────────────────────────
+ * FIR: 4 outputs per iteration once the whole history lies inside the
+ * region (n >= order), one broadcast coefficient per tap.
+ * IIR: the recursion is serial in n, so the order-long dot product is
+ * vectorised instead. Coefficients are reversed and front-padded with
+ * zeros to a multiple of 4, so the history x[n-R .. n) loads directly.
+ */
+
+static void aac_tns_fir_wasm(float* dst, const float* src, int len, const float* lpc, int order) {
+  int n = order < len ? order : len;
+  aac_tns_fir_head(dst, src, n, lpc, order);
+  for (; n + 4 <= len; n += 4) {
+    v128_t acc = wasm_v128_load(src + n);
+    for (int k = 1; k <= order; k++) {
+      acc = wasm_f32x4_add(acc, wasm_f32x4_mul(wasm_f32x4_splat(lpc[k - 1]),
+                                               wasm_v128_load(src + n - k)));
+    }
+    wasm_v128_store(dst + n, acc);
+  }
+  for (; n < len; n++) {
+    float acc = src[n];
+    for (int k = 1; k <= order; k++) acc += lpc[k - 1] * src[n - k];
+    dst[n] = acc;
+  }
+}
+
+static void aac_tns_iir_wasm(float* x, int len, const float* lpc, int order) {
+  int R = (order + 3) & ~3;
+  float rev[AAC_TNS_MAX_ORDER + 4];
+  for (int j = 0; j < R; j++) rev[j] = (j < R - order) ? 0.0f : lpc[R - 1 - j];
+  int n = R < len ? R : len;
+  aac_tns_iir_head(x, n, lpc, order);
+  for (; n < len; n++) {
+    const float* h = x + n - R;
+    v128_t acc = wasm_f32x4_splat(0.0f);
+    for (int j = 0; j < R; j += 4) {
+      acc = wasm_f32x4_add(acc, wasm_f32x4_mul(wasm_v128_load(rev + j), wasm_v128_load(h + j)));
+    }
+    x[n] -= wasm_f32x4_extract_lane(acc, 0) + wasm_f32x4_extract_lane(acc, 1) +
+            wasm_f32x4_extract_lane(acc, 2) + wasm_f32x4_extract_lane(acc, 3);
+  }
+}
+
+/* ── SBR QMF ─────────────────────────────────────────────────
+ * Polyphase fold / sum of the QMF banks, 4 taps per iteration. bands is a
+ * multiple of 8, so there is no scalar tail.
+ */
+
+static void aac_sbr_qmf_analysis_wasm(float* out, const float* in, const float* win, int bands) {
+  int m2 = 2 * bands;
+  for (int i = 0; i < m2; i += 4) {
+    v128_t acc = wasm_f32x4_splat(0.0f);
+    for (int l = 0; l < 5; l++) {
+      int o = i + m2 * l;
+      acc = wasm_f32x4_add(acc, wasm_f32x4_mul(wasm_v128_load(win + o), wasm_v128_load(in + o)));
+    }
+    wasm_v128_store(out + i, acc);
+  }
+}
+
+static void aac_sbr_qmf_synthesis_wasm(float* out, const float* v, const float* win, int bands) {
+  for (int r = 0; r < bands; r += 4) {
+    v128_t acc = wasm_f32x4_splat(0.0f);
+    for (int q = 0; q < 10; q++) {
+      v128_t w = wasm_v128_load(win + bands * q + r);
+      v128_t x = wasm_v128_load(v + 2 * bands * q + bands * (q & 1) + r);
+      acc = wasm_f32x4_add(acc, wasm_f32x4_mul(w, x));
+    }
+    wasm_v128_store(out + r, acc);
+  }
+}
+
+/* ── SBR HF ──────────────────────────────────────────────────
+ * Patch prediction and envelope gains, 4 bands per iteration. Patch widths
+ * are arbitrary, so both finish with a scalar tail.
+ */
+
+static void aac_sbr_hf_gen_wasm(float* hi_re, float* hi_im, const float* lo_re,
+                                const float* lo_im, const float* a0_re, const float* a0_im,
+                                const float* a1_re, const float* a1_im, int n, int slots) {
+  const int S = AAC_SBR_QMF_BANDS;
+  int nv = n & ~3;
+  for (int m = 0; m < slots; m++) {
+    const float* x0r = lo_re + m * S;
+    const float* x0i = lo_im + m * S;
+    const float* x1r = x0r - S;
+    const float* x1i = x0i - S;
+    const float* x2r = x1r - S;
+    const float* x2i = x1i - S;
+    float* yr = hi_re + m * S;
+    float* yi = hi_im + m * S;
+    int k = 0;
+    for (; k < nv; k += 4) {
+      v128_t ar = wasm_v128_load(a0_re + k), ai = wasm_v128_load(a0_im + k);
+      v128_t br = wasm_v128_load(a1_re + k), bi = wasm_v128_load(a1_im + k);
+      v128_t p1r = wasm_v128_load(x1r + k), p1i = wasm_v128_load(x1i + k);
+      v128_t p2r = wasm_v128_load(x2r + k), p2i = wasm_v128_load(x2i + k);
+      v128_t re = wasm_f32x4_sub(wasm_f32x4_mul(ar, p1r), wasm_f32x4_mul(ai, p1i));
+      v128_t im = wasm_f32x4_add(wasm_f32x4_mul(ar, p1i), wasm_f32x4_mul(ai, p1r));
+      re = wasm_f32x4_add(re, wasm_f32x4_sub(wasm_f32x4_mul(br, p2r), wasm_f32x4_mul(bi, p2i)));
+      im = wasm_f32x4_add(im, wasm_f32x4_add(wasm_f32x4_mul(br, p2i), wasm_f32x4_mul(bi, p2r)));
+      wasm_v128_store(yr + k, wasm_f32x4_add(wasm_v128_load(x0r + k), re));
+      wasm_v128_store(yi + k, wasm_f32x4_add(wasm_v128_load(x0i + k), im));
+    }
+    for (; k < n; k++) {
+      yr[k] = x0r[k] + a0_re[k] * x1r[k] - a0_im[k] * x1i[k] + a1_re[k] * x2r[k] -
+              a1_im[k] * x2i[k];
+      yi[k] = x0i[k] + a0_re[k] * x1i[k] + a0_im[k] * x1r[k] + a1_re[k] * x2i[k] +
+              a1_im[k] * x2r[k];
+    }
+  }
+}
+
+static void aac_sbr_hf_apply_wasm(float* y_re, float* y_im, const float* gain,
+                                  const float* noise_gain, const float* noise_re,
+                                  const float* noise_im, int n) {
+  int k = 0, nv = n & ~3;
+  for (; k < nv; k += 4) {
+    v128_t g = wasm_v128_load(gain + k), q = wasm_v128_load(noise_gain + k);
+    v128_t yr = wasm_f32x4_mul(g, wasm_v128_load(y_re + k));
+    v128_t yi = wasm_f32x4_mul(g, wasm_v128_load(y_im + k));
+    wasm_v128_store(y_re + k, wasm_f32x4_add(yr, wasm_f32x4_mul(q, wasm_v128_load(noise_re + k))));
+    wasm_v128_store(y_im + k, wasm_f32x4_add(yi, wasm_f32x4_mul(q, wasm_v128_load(noise_im + k))));
+  }
+  for (; k < n; k++) {
+    y_re[k] = gain[k] * y_re[k] + noise_gain[k] * noise_re[k];
+    y_im[k] = gain[k] * y_im[k] + noise_gain[k] * noise_im[k];
+  }
+}
+
+/* ── Parametric Stereo ───────────────────────────────────────
+ * Interpolated 2x2 mixing of one slot, 4 bands per iteration with a
+ * scalar tail.
+ */
+
+static void aac_ps_mix_wasm(float* l_re, float* l_im, float* r_re, float* r_im, float* h,
+                            const float* h_step, int n) {
+  int k = 0, nv = n & ~3;
+  for (; k < nv; k += 4) {
+    v128_t h11 = wasm_f32x4_add(wasm_v128_load(h + k), wasm_v128_load(h_step + k));
+    v128_t h12 = wasm_f32x4_add(wasm_v128_load(h + n + k), wasm_v128_load(h_step + n + k));
+    v128_t h21 = wasm_f32x4_add(wasm_v128_load(h + 2 * n + k), wasm_v128_load(h_step + 2 * n + k));
+    v128_t h22 = wasm_f32x4_add(wasm_v128_load(h + 3 * n + k), wasm_v128_load(h_step + 3 * n + k));
+    wasm_v128_store(h + k, h11);
+    wasm_v128_store(h + n + k, h12);
+    wasm_v128_store(h + 2 * n + k, h21);
+    wasm_v128_store(h + 3 * n + k, h22);
+    v128_t s_re = wasm_v128_load(l_re + k), s_im = wasm_v128_load(l_im + k);
+    v128_t d_re = wasm_v128_load(r_re + k), d_im = wasm_v128_load(r_im + k);
+    wasm_v128_store(l_re + k, wasm_f32x4_add(wasm_f32x4_mul(h11, s_re), wasm_f32x4_mul(h21, d_re)));
+    wasm_v128_store(l_im + k, wasm_f32x4_add(wasm_f32x4_mul(h11, s_im), wasm_f32x4_mul(h21, d_im)));
+    wasm_v128_store(r_re + k, wasm_f32x4_add(wasm_f32x4_mul(h12, s_re), wasm_f32x4_mul(h22, d_re)));
+    wasm_v128_store(r_im + k, wasm_f32x4_add(wasm_f32x4_mul(h12, s_im), wasm_f32x4_mul(h22, d_im)));
+  }
+  for (; k < n; k++) {
+    float h11 = h[k] += h_step[k];
+    float h12 = h[n + k] += h_step[n + k];
+    float h21 = h[2 * n + k] += h_step[2 * n + k];
+    float h22 = h[3 * n + k] += h_step[3 * n + k];
+    float s_re = l_re[k], s_im = l_im[k], d_re = r_re[k], d_im = r_im[k];
+    l_re[k] = h11 * s_re + h21 * d_re;
+    l_im[k] = h11 * s_im + h21 * d_im;
+    r_re[k] = h12 * s_re + h22 * d_re;
+    r_im[k] = h12 * s_im + h22 * d_im;
+  }
+}
+
+/* ── PCM Output ──────────────────────────────────────────────── */
+
+static void aac_interleave2_wasm(float* dst, const float* l, const float* r, int n) {
+  int i = 0, n4 = n & ~3;
+  for (; i < n4; i += 4) {
+    v128_t vl = wasm_v128_load(l + i), vr = wasm_v128_load(r + i);
+    wasm_v128_store(dst + 2 * i, wasm_i32x4_shuffle(vl, vr, 0, 4, 1, 5));
+    wasm_v128_store(dst + 2 * i + 4, wasm_i32x4_shuffle(vl, vr, 2, 6, 3, 7));
+  }
+  for (; i < n; i++) {
+    dst[2 * i] = l[i];
+    dst[2 * i + 1] = r[i];
+  }
+}
+
+/* pmax(lo, v) yields lo for NaN; nearest rounds half to even */
+static inline v128_t float_to_int_wasm(const float* src, const float* dither, int i,
+                                       v128_t scale, v128_t lo, v128_t hi) {
+  v128_t v = wasm_f32x4_mul(wasm_v128_load(src + i), scale);
+  if (dither) {
+    v = wasm_f32x4_add(v, wasm_v128_load(dither + i));
+  }
+  v = wasm_f32x4_pmin(hi, wasm_f32x4_pmax(lo, v));
+  return wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_nearest(v));
+}
+
+static void aac_float_to_s16_wasm(int16_t* dst, const float* src, const float* dither, int n) {
+  const v128_t scale = wasm_f32x4_splat(32768.0f), lo = wasm_f32x4_splat(-32768.0f);
+  const v128_t hi = wasm_f32x4_splat(32767.0f);
+  int i = 0, n8 = n & ~7;
+  for (; i < n8; i += 8) {
+    v128_t a = float_to_int_wasm(src, dither, i, scale, lo, hi);
+    v128_t b = float_to_int_wasm(src, dither, i + 4, scale, lo, hi);
+    wasm_v128_store(dst + i, wasm_i16x8_narrow_i32x4(a, b));
+  }
+  for (; i < n; i++) {
+    float v = src[i] * 32768.0f + (dither ? dither[i] : 0.0f);
+    dst[i] = (int16_t)lrintf(fminf(fmaxf(v, -32768.0f), 32767.0f));
+  }
+}
+
+static void aac_float_to_s24_wasm(int32_t* dst, const float* src, const float* dither, int n) {
+  const v128_t scale = wasm_f32x4_splat(8388608.0f), lo = wasm_f32x4_splat(-8388608.0f);
+  const v128_t hi = wasm_f32x4_splat(8388607.0f);
+  int i = 0, n4 = n & ~3;
+  for (; i < n4; i += 4) {
+    wasm_v128_store(dst + i, float_to_int_wasm(src, dither, i, scale, lo, hi));
+  }
+  for (; i < n; i++) {
+    float v = src[i] * 8388608.0f + (dither ? dither[i] : 0.0f);
+    dst[i] = (int32_t)lrintf(fminf(fmaxf(v, -8388608.0f), 8388607.0f));
+  }
+}
+
+/* ── Transport ───────────────────────────────────────────────── */
+
+static int aac_adts_sync_wasm(const uint8_t* data, int size) {
+  const v128_t ff = wasm_i8x16_splat((int8_t)0xFF), mask = wasm_i8x16_splat((int8_t)0xF6);
+  const v128_t sync = wasm_i8x16_splat((int8_t)0xF0);
+  int i = 0;
+  for (; i + 33 <= size; i += 32) {
+    v128_t a0 = wasm_i8x16_eq(wasm_v128_load(data + i), ff);
+    v128_t a1 = wasm_i8x16_eq(wasm_v128_load(data + i + 16), ff);
+    if (!wasm_v128_any_true(wasm_v128_or(a0, a1))) {
+      continue;
+    }
+    v128_t b0 = wasm_v128_load(data + i + 1), b1 = wasm_v128_load(data + i + 17);
+    b0 = wasm_v128_and(a0, wasm_i8x16_eq(wasm_v128_and(b0, mask), sync));
+    b1 = wasm_v128_and(a1, wasm_i8x16_eq(wasm_v128_and(b1, mask), sync));
+    uint32_t bits = (uint32_t)wasm_i8x16_bitmask(b0) | (uint32_t)wasm_i8x16_bitmask(b1) << 16;
+    if (bits) {
+      return i + __builtin_ctz(bits);
+    }
+  }
+  for (; i < size - 1; i++) {
+    if (data[i] == 0xFF && (data[i + 1] & 0xF6) == 0xF0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
 /* ── Registration ────────────────────────────────────────────── */
 
 void aac_dsp_init_wasm(AacDSP* dsp) {
@@ -334,6 +598,18 @@ void aac_dsp_init_wasm(AacDSP* dsp) {
   dsp->vector_fmul_window = aac_vector_fmul_window_wasm;
   dsp->vector_fmul_reverse = aac_vector_fmul_reverse_wasm;
   dsp->vector_fmul_accumulate = aac_vector_fmul_accumulate_wasm;
+  dsp->vector_is_zero = aac_vector_is_zero_wasm;
+  dsp->tns_fir = aac_tns_fir_wasm;
+  dsp->tns_iir = aac_tns_iir_wasm;
+  dsp->sbr_qmf_analysis = aac_sbr_qmf_analysis_wasm;
+  dsp->sbr_qmf_synthesis = aac_sbr_qmf_synthesis_wasm;
+  dsp->sbr_hf_gen = aac_sbr_hf_gen_wasm;
+  dsp->sbr_hf_apply = aac_sbr_hf_apply_wasm;
+  dsp->ps_mix = aac_ps_mix_wasm;
+  dsp->interleave2 = aac_interleave2_wasm;
+  dsp->float_to_s16 = aac_float_to_s16_wasm;
+  dsp->float_to_s24 = aac_float_to_s24_wasm;
+  dsp->adts_sync = aac_adts_sync_wasm;
 }
 
 #endif /* BAAC_AAC_WASM || __wasm_simd128__ */
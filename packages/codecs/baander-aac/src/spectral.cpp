@@ -2,92 +2,373 @@
 
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
+
+#include "aac_tables.h"
+#include "mdct.h"
+
+/* ── TNS ─────────────────────────────────────────────────────── */
+
+/* Encoder starts filtering above this frequency; lower bands are tonal
+ * enough that prediction over them rarely pays for the side info */
+static const float kTnsStartHz = 1400.0f;
+/* Minimum prediction gain r[0] / E_order for a filter to be worth sending */
+static const float kTnsMinGain = 1.4f;
 
 namespace {
-/** Thread-local PNS seed for reproducible, thread-safe noise generation. */
-static thread_local unsigned int pns_seed = 12345u;
+struct TnsLayout {
+  int windows, win_len, num_swb, max_bands, max_order, n_filt_bits, length_bits, order_bits;
+  const int* sfb;
+};
 }  // namespace
 
-#include "aac_tables.h"
+/* AAC-LD caps long-window TNS filters at order 12 */
+static const int kTnsMaxOrderLd = 12;
+
+static TnsLayout tns_layout(int ri, int frame_length, int ws) {
+  TnsLayout l;
+  if (ws == AAC_WIN_EIGHT_SHORT) {
+    l = {8, 128, aac_num_sfb_short[ri], aac_tns_max_bands_short[ri], aac_tns_max_order_short,
+         1, 4, 3, aac_sfb_offset_short[ri]};
+  } else {
+    l = {1, frame_length, aac_num_sfb(ri, frame_length), aac_tns_max_bands(ri, frame_length),
+         frame_length == AAC_FRAME_SIZE_LONG ? aac_tns_max_order_long : kTnsMaxOrderLd, 2, 6, 5,
+         aac_sfb_offsets(ri, frame_length)};
+  }
+  return l;
+}
 
-void aac_tns_encode(AacTnsInfo* tns, float* spec, int /*nb*/, const int* sfb, int ri, int /*ws*/) {
-  int max_order = aac_tns_max_order_long;
-  int end = sfb[aac_tns_max_bands_long[ri]];
+/* Reflection coefficient quantizer (arcsine companded), res_bits = coef_res + 3 */
+static float tns_iqfac(int res_bits, int idx) {
+  float half = (float)(1 << (res_bits - 1));
+  return (idx >= 0 ? half - 0.5f : half + 0.5f) / ((float)M_PI / 2.0f);
+}
+
+static int tns_quantize_coef(float k, int res_bits) {
+  float a = asinf(fmaxf(fminf(k, 0.999f), -0.999f));
+  int idx = (int)lroundf(a * tns_iqfac(res_bits, a >= 0.0f ? 1 : -1));
+  int lim = 1 << (res_bits - 1);
+  return idx < -lim ? -lim : (idx > lim - 1 ? lim - 1 : idx);
+}
 
-  /* Compute autocorrelation */
-  float ac[20] = {};
-  for (int lag = 0; lag <= max_order; lag++) {
-    ac[lag] = 0;
-    for (int i = 0; i < end - lag; i++) {
-      ac[lag] += spec[i] * spec[i + lag];
+/* Step-up recursion: dequantized reflection coefficients -> a[1..order] */
+static void tns_coef_to_lpc(float* lpc, const int* coef, int order, int res_bits) {
+  float a[AAC_TNS_MAX_ORDER + 1] = {1.0f};
+  float b[AAC_TNS_MAX_ORDER + 1];
+  for (int m = 1; m <= order; m++) {
+    float k = sinf((float)coef[m - 1] / tns_iqfac(res_bits, coef[m - 1]));
+    for (int i = 0; i < m; i++) {
+      b[i] = a[i];
+    }
+    for (int i = 1; i < m; i++) {
+      a[i] = b[i] + k * b[m - i];
     }
+    a[m] = k;
+  }
+  for (int i = 0; i < order; i++) {
+    lpc[i] = a[i + 1];
+  }
+}
+
+/* Power gain of the all-pole synthesis filter on white noise,
+ * 1 / prod(1 - k^2) over the dequantized reflection coefficients */
+static float tns_noise_gain(const int* coef, int order, int res_bits) {
+  float g = 1.0f;
+  for (int m = 0; m < order; m++) {
+    float k = sinf((float)coef[m] / tns_iqfac(res_bits, coef[m]));
+    g /= fmaxf(1.0f - k * k, 1e-3f);
   }
+  return g;
+}
 
-  /* Levinson-Durbin recursion */
-  float a[20] = {};
-  float error = ac[0];
-  int order = 0;
-  for (int m = 1; m <= max_order && error > 1e-10f; m++) {
-    float km = ac[m];
-    for (int k = 0; k < m - 1; k++) {
-      km -= a[k] * ac[m - 1 - k];
+/* Levinson-Durbin on the autocorrelation of x; returns the prediction gain
+ * and the reflection coefficients in k[0..order-1] */
+static float tns_levinson(float* k, const float* x, int len, int order) {
+  float r[AAC_TNS_MAX_ORDER + 1];
+  for (int lag = 0; lag <= order; lag++) {
+    float acc = 0.0f;
+    for (int i = lag; i < len; i++) {
+      acc += x[i] * x[i - lag];
+    }
+    r[lag] = acc;
+  }
+  if (r[0] <= 1e-20f) {
+    return 1.0f;
+  }
+  float a[AAC_TNS_MAX_ORDER + 1] = {1.0f};
+  float b[AAC_TNS_MAX_ORDER + 1];
+  float err = r[0];
+  for (int m = 1; m <= order; m++) {
+    float acc = r[m];
+    for (int i = 1; i < m; i++) {
+      acc += a[i] * r[m - i];
     }
-    km /= error;
-    a[m - 1] = km;
-    for (int k = 0; k < (m - 1) / 2; k++) {
-      float t = a[k];
-      a[k] = a[m - 2 - k];
-      a[m - 2 - k] = t - km * t;
+    float km = -acc / err;
+    k[m - 1] = km;
+    for (int i = 0; i < m; i++) {
+      b[i] = a[i];
     }
-    error *= (1.0f - km * km);
-    if (fabsf(km) > 0.1f) {
-      order = m;
+    for (int i = 1; i < m; i++) {
+      a[i] = b[i] + km * b[m - i];
     }
+    a[m] = km;
+    err *= 1.0f - km * km;
+    if (err <= r[0] * 1e-9f) {
+      for (int i = m; i < order; i++) {
+        k[i] = 0.0f;
+      }
+      break;
+    }
+  }
+  return r[0] / err;
+}
+
+/* Bin range of filter f in window w; updates *top for the next filter */
+static void tns_filter_range(const TnsLayout& l, int length, int max_sfb, int* top, int* start,
+                             int* end) {
+  int bottom = *top - length > 0 ? *top - length : 0;
+  int limit = l.max_bands < max_sfb ? l.max_bands : max_sfb;
+  *start = l.sfb[bottom < limit ? bottom : limit];
+  *end = l.sfb[*top < limit ? *top : limit];
+  *top = bottom;
+}
+
+int aac_tns_encode(AacTnsInfo* tns, float* spec, int max_sfb, int ri, int frame_length, int ws,
+                   int max_filters, const AacDSP* dsp) {
+  TnsLayout l = tns_layout(ri, frame_length, ws);
+  int sr = aac_sample_rates[ri];
+  int limit = l.max_bands < max_sfb ? l.max_bands : max_sfb;
+  int lo = 0;
+  while (lo < limit && (float)l.sfb[lo] * (float)sr / (2.0f * (float)l.win_len) < kTnsStartHz) {
+    lo++;
+  }
+  int n_seg = (ws == AAC_WIN_EIGHT_SHORT) ? AAC_TNS_MAX_FILTERS_SHORT : max_filters;
+  if (n_seg > limit - lo) {
+    n_seg = limit - lo;
   }
 
-  /* Apply all-zero filter */
-  for (int i = end - 1; i >= 0; i--) {
-    for (int k = 0; k < order; k++) {
-      if (i + k + 1 < end) {
-        spec[i] -= a[k] * spec[i + k + 1];
+  float tmp[1024];
+  int any = 0;
+  for (int w = 0; w < l.windows; w++) {
+    float* x = spec + (ptrdiff_t)w * l.win_len;
+    tns->n_filt[w] = 0;
+    tns->coef_res[w] = 1;
+    if (n_seg <= 0) {
+      continue;
+    }
+    /* Equal band-count segments, highest first; the first filter also
+     * spans the bands above the TNS limit so its length reaches num_swb */
+    int top = l.num_swb;
+    int last_used = -1;
+    for (int f = 0; f < n_seg; f++) {
+      int seg_bottom = limit - (limit - lo) * (f + 1) / n_seg;
+      int length = top - seg_bottom;
+      int start = 0, end = 0;
+      int seg_top = top;
+      tns_filter_range(l, length, max_sfb, &seg_top, &start, &end);
+      tns->length[w][f] = length;
+      tns->direction[w][f] = 0;
+      tns->coef_compress[w][f] = 0;
+      tns->order[w][f] = 0;
+      tns->noise_gain[w][f] = 1.0f;
+      top = seg_bottom;
+
+      int len = end - start;
+      int order = l.max_order < len / 4 ? l.max_order : len / 4;
+      if (order < 1) {
+        continue;
+      }
+      float k[AAC_TNS_MAX_ORDER];
+      if (tns_levinson(k, x + start, len, order) < kTnsMinGain) {
+        continue;
+      }
+      int res_bits = tns->coef_res[w] + 3;
+      int* coef = tns->coef[w][f];
+      int used = 0;
+      for (int i = 0; i < order; i++) {
+        coef[i] = tns_quantize_coef(k[i], res_bits);
+        if (coef[i] != 0) {
+          used = i + 1;
+        }
       }
+      if (used == 0) {
+        continue;
+      }
+      int compress = 1;
+      for (int i = 0; i < used; i++) {
+        compress &= (coef[i] >= -(1 << (res_bits - 2)) && coef[i] < (1 << (res_bits - 2)));
+      }
+      float lpc[AAC_TNS_MAX_ORDER];
+      tns_coef_to_lpc(lpc, coef, used, res_bits);
+      float noise_gain = tns_noise_gain(coef, used, res_bits);
+      dsp->tns_fir(tmp, x + start, len, lpc, used);
+      /* The quantized filter must remove more energy than the decoder's
+       * synthesis filter adds back as noise, by enough to pay for its
+       * coefficients (half a bit per line per doubling, at high rate) */
+      float e_in = 0.0f, e_out = 0.0f;
+      for (int i = 0; i < len; i++) {
+        e_in += x[start + i] * x[start + i];
+        e_out += tmp[i] * tmp[i];
+      }
+      float net = e_in / (e_out * noise_gain + 1e-20f);
+      int side_bits = l.length_bits + l.order_bits + 2 + used * (res_bits - compress);
+      if (net <= 1.0f || 0.5f * (float)len * log2f(net) < (float)side_bits) {
+        continue;
+      }
+      tns->order[w][f] = used;
+      tns->coef_compress[w][f] = compress;
+      memcpy(tns->lpc[w][f], lpc, used * sizeof(float));
+      tns->noise_gain[w][f] = noise_gain;
+      memcpy(x + start, tmp, len * sizeof(float));
+      last_used = f;
+      any = 1;
     }
+    tns->n_filt[w] = last_used + 1;
   }
+  return any;
+}
 
-  tns->order[0][0] = order;
-  for (int k = 0; k < order; k++) {
-    tns->lpc[0][0][k] = a[k];
+void aac_tns_decode(const AacTnsInfo* tns, float* spec, int max_sfb, int ri, int frame_length,
+                    int ws, const AacDSP* dsp) {
+  TnsLayout l = tns_layout(ri, frame_length, ws);
+  float tmp[1024];
+  for (int w = 0; w < l.windows; w++) {
+    float* x = spec + (ptrdiff_t)w * l.win_len;
+    int top = l.num_swb;
+    for (int f = 0; f < tns->n_filt[w]; f++) {
+      int start = 0, end = 0;
+      tns_filter_range(l, tns->length[w][f], max_sfb, &top, &start, &end);
+      int order = tns->order[w][f];
+      int len = end - start;
+      if (order <= 0 || len <= 0) {
+        continue;
+      }
+      if (tns->direction[w][f]) {
+        /* Downward filters run on a reversed copy so the DSP kernel only
+         * has to handle one direction */
+        for (int i = 0; i < len; i++) {
+          tmp[i] = x[end - 1 - i];
+        }
+        dsp->tns_iir(tmp, len, tns->lpc[w][f], order);
+        for (int i = 0; i < len; i++) {
+          x[end - 1 - i] = tmp[i];
+        }
+      } else {
+        dsp->tns_iir(x + start, len, tns->lpc[w][f], order);
+      }
+    }
   }
 }
 
-void aac_tns_decode(AacTnsInfo* tns, float* spec, int /*nb*/, const int* sfb, int ri, int /*ws*/) {
-  int order = tns->order[0][0];
-  if (order <= 0) {
-    return;
+void aac_tns_band_noise_gain(const AacTnsInfo* tns, float* gain, int max_sfb, int ri,
+                             int frame_length) {
+  TnsLayout l = tns_layout(ri, frame_length, AAC_WIN_ONLY_LONG);
+  for (int b = 0; b < max_sfb; b++) {
+    gain[b] = 1.0f;
   }
-  int end = sfb[aac_tns_max_bands_long[ri]];
-  for (int i = 0; i < end; i++) {
-    for (int k = 0; k < order; k++) {
-      if (i - k - 1 >= 0) {
-        spec[i] += tns->lpc[0][0][k] * spec[i - k - 1];
+  int top = l.num_swb;
+  for (int f = 0; f < tns->n_filt[0]; f++) {
+    int bottom = top - tns->length[0][f] > 0 ? top - tns->length[0][f] : 0;
+    if (tns->order[0][f] > 0) {
+      int hi = top < l.max_bands ? top : l.max_bands;
+      for (int b = bottom; b < hi && b < max_sfb; b++) {
+        gain[b] = tns->noise_gain[0][f];
       }
     }
+    top = bottom;
   }
 }
 
-void aac_pns_replace(float* spec, int sfb, const int* sfb_off, float energy, int /*fs*/) {
+void aac_tns_write(AacBitWriter* bw, const AacTnsInfo* tns, int ws) {
+  TnsLayout l = tns_layout(0, AAC_FRAME_SIZE_LONG, ws); /* AAC-LD has the same widths */
+  for (int w = 0; w < l.windows; w++) {
+    aac_bitwriter_write(bw, tns->n_filt[w], l.n_filt_bits);
+    if (!tns->n_filt[w]) {
+      continue;
+    }
+    aac_bitwriter_write(bw, tns->coef_res[w], 1);
+    for (int f = 0; f < tns->n_filt[w]; f++) {
+      aac_bitwriter_write(bw, tns->length[w][f], l.length_bits);
+      aac_bitwriter_write(bw, tns->order[w][f], l.order_bits);
+      if (!tns->order[w][f]) {
+        continue;
+      }
+      aac_bitwriter_write(bw, tns->direction[w][f], 1);
+      aac_bitwriter_write(bw, tns->coef_compress[w][f], 1);
+      int bits = tns->coef_res[w] + 3 - tns->coef_compress[w][f];
+      for (int i = 0; i < tns->order[w][f]; i++) {
+        aac_bitwriter_write(bw, (uint32_t)tns->coef[w][f][i] & ((1u << bits) - 1), bits);
+      }
+    }
+  }
+}
+
+int aac_tns_bits(const AacTnsInfo* tns, int ws) {
+  TnsLayout l = tns_layout(0, AAC_FRAME_SIZE_LONG, ws);
+  int bits = 0;
+  for (int w = 0; w < l.windows; w++) {
+    bits += l.n_filt_bits + (tns->n_filt[w] ? 1 : 0);
+    for (int f = 0; f < tns->n_filt[w]; f++) {
+      bits += l.length_bits + l.order_bits;
+      if (tns->order[w][f]) {
+        bits += 2 + tns->order[w][f] * (tns->coef_res[w] + 3 - tns->coef_compress[w][f]);
+      }
+    }
+  }
+  return bits;
+}
+
+int aac_tns_read(AacBitReader* r, AacTnsInfo* tns, int ws) {
+  TnsLayout l = tns_layout(0, AAC_FRAME_SIZE_LONG, ws); /* AAC-LD has the same widths */
+  for (int w = 0; w < l.windows; w++) {
+    tns->n_filt[w] = (int)aac_bitreader_read(r, l.n_filt_bits);
+    if (!tns->n_filt[w]) {
+      continue;
+    }
+    tns->coef_res[w] = (int)aac_bitreader_read(r, 1);
+    for (int f = 0; f < tns->n_filt[w]; f++) {
+      tns->length[w][f] = (int)aac_bitreader_read(r, l.length_bits);
+      int order = (int)aac_bitreader_read(r, l.order_bits);
+      if (order > l.max_order) {
+        return AAC_ERR_DECODE;
+      }
+      tns->order[w][f] = order;
+      if (!order) {
+        continue;
+      }
+      tns->direction[w][f] = (int)aac_bitreader_read(r, 1);
+      tns->coef_compress[w][f] = (int)aac_bitreader_read(r, 1);
+      int res_bits = tns->coef_res[w] + 3;
+      int bits = res_bits - tns->coef_compress[w][f];
+      for (int i = 0; i < order; i++) {
+        auto v = (int)aac_bitreader_read(r, bits);
+        tns->coef[w][f][i] = (v & (1 << (bits - 1))) ? v - (1 << bits) : v; /* sign extend */
+      }
+      tns_coef_to_lpc(tns->lpc[w][f], tns->coef[w][f], order, res_bits);
+    }
+  }
+  return aac_bitreader_bits_left(r) < 0 ? AAC_ERR_DECODE : AAC_OK;
+}
+
+/* ── PNS ─────────────────────────────────────────────────────── */
+
+void aac_pns_replace(float* spec, int sfb, const int* sfb_off, float energy, uint32_t* seed) {
   int s = sfb_off[sfb], e = sfb_off[sfb + 1];
-  float sc = sqrtf(energy / (float)(e - s));
-  /* Simple PRNG — not thread-safe, replace with per-instance xorshift for production */
+  float sum = 0.0f;
+  for (int i = s; i < e; i++) {
+    /* Top bits as a signed integer: uniform in [-2^31, 2^31) */
+    auto r = (float)(int32_t)aac_pns_random(seed);
+    spec[i] = r;
+    sum += r * r;
+  }
+  float sc = sum > 0.0f ? sqrtf(energy / sum) : 0.0f;
   for (int i = s; i < e; i++) {
-    float r =
-        (float)rand_r(&pns_seed) / (float)RAND_MAX * 2.0f - 1.0f;  // NOLINT(concurrency-mt-unsafe)
-    spec[i] = sc * r;
+    spec[i] *= sc;
   }
 }
 
-void aac_pns_restore(float* spec, int sfb, const int* sfb_off, float energy, int fs) {
-  aac_pns_replace(spec, sfb, sfb_off, energy, fs);
+void aac_pns_restore(float* spec, int sfb, const int* sfb_off, float energy, uint32_t* seed) {
+  aac_pns_replace(spec, sfb, sfb_off, energy, seed);
 }
 
 void aac_ms_encode(float* mid, float* side, const float* L, const float* R, int n) {
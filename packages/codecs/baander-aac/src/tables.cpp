@@ -1,6 +1,8 @@
 #include <cmath>
+#include <cstring>
 
 #include "aac_tables.h"
+#include "bitstream.h"
 
 const int aac_num_sample_rates = 12;
 const int aac_sample_rates[AAC_NUM_SAMPLE_RATES] = {96000, 88200, 64000, 48000, 44100, 32000,
@@ -151,6 +153,33 @@ static const uint8_t* huff_len_ptrs[AAC_NUM_CODEBOOKS + 1] = {
     huff6_len, huff7_len, huff8_len, huff9_len, huff10_len, huff11_len};
 const uint32_t* aac_huff_code[AAC_NUM_CODEBOOKS + 1];
 const uint8_t* aac_huff_len[AAC_NUM_CODEBOOKS + 1];
+uint16_t aac_huff_lookup[AAC_NUM_CODEBOOKS + 1][1 << AAC_HUFF_LOOKUP_BITS];
+
+/* The longest-match rule of aac_bitreader_read_huffman, for every prefix
+ * that decides it: each codeword fills the prefixes it covers, and a longer
+ * one clears the prefix it starts with */
+static void huff_lookup(int cb) {
+  const int kBits = AAC_HUFF_LOOKUP_BITS;
+  uint16_t* t = aac_huff_lookup[cb];
+  memset(t, 0, sizeof(aac_huff_lookup[cb]));
+  for (int i = 0; i < aac_huff_count[cb]; i++) {
+    const int len = huff_len_ptrs[cb][i];
+    if (len && len <= kBits) {
+      const uint32_t first = (huff_code_ptrs[cb][i] >> (32 - len)) << (kBits - len);
+      for (uint32_t p = first; p < first + (1u << (kBits - len)); p++) {
+        if (len > (t[p] & 31)) {
+          t[p] = (uint16_t)((i << 5) | len);
+        }
+      }
+    }
+  }
+  for (int i = 0; i < aac_huff_count[cb]; i++) {
+    const int len = huff_len_ptrs[cb][i];
+    if (len > kBits && len <= 16) {
+      t[huff_code_ptrs[cb][i] >> (32 - kBits)] = 0;
+    }
+  }
+}
 
 /* Window Functions */
 void aac_sine_window(float* out, int n) {
@@ -159,6 +188,23 @@ void aac_sine_window(float* out, int n) {
   }
 }
 
+/* AAC-LD low-overlap window of a frame of n samples: zero for 3n/8, a sine
+ * slope over n/4, flat for 3n/4, and mirrored. Adjacent frames overlap by
+ * n/4 samples only, which confines pre-echo to a much shorter span. */
+void aac_low_overlap_window(float* out, int n) {
+  const int zeros = 3 * n / 8, slope = n / 4;
+  for (int i = 0; i < n; i++) {
+    float w = 1.0f;
+    if (i < zeros) {
+      w = 0.0f;
+    } else if (i < zeros + slope) {
+      w = sinf((float)M_PI * ((float)(i - zeros) + 0.5f) / (2.0f * (float)slope));
+    }
+    out[i] = w;
+    out[2 * n - 1 - i] = w;
+  }
+}
+
 void aac_kbd_window(float* out, int n, float alpha) {
   auto i0 = [](float x) -> float {
     float sum = 1.0f, term = 1.0f;
@@ -196,20 +242,153 @@ const int aac_tns_max_bands_short[AAC_NUM_SAMPLE_RATES] = {9,  9,  10, 14, 14, 1
                                                            14, 14, 12, 12, 12, 11};
 const int aac_tns_max_order_long = 20;
 const int aac_tns_max_order_short = 7;
-const AacChannelConfig aac_channel_config[8] = {{0, 0, 0, 0}, {1, 0, 1, 0}, {2, 1, 0, 0},
-                                                {3, 1, 1, 0}, {4, 1, 1, 0}, {5, 2, 1, 0},
-                                                {6, 2, 1, 1}, {8, 3, 1, 1}};
+
+/* AAC-LD long windows: 48000 and 44100 Hz share a table, as do 24000 and 22050 */
+static const int kSfbLd512_48[] = {0,   4,   8,   12,  16,  20,  24,  28,  32,  36,  40,  44,  48,
+                                   52,  56,  60,  68,  76,  84,  92,  100, 112, 124, 136, 148, 164,
+                                   184, 208, 236, 268, 300, 332, 364, 396, 428, 460, 512};
+static const int kSfbLd512_32[] = {0,   4,   8,   12,  16,  20,  24,  28,  32,  36,  40,  44,  48,
+                                   52,  56,  64,  72,  80,  88,  96,  108, 120, 132, 144, 160, 176,
+                                   192, 212, 236, 260, 288, 320, 352, 384, 416, 448, 480, 512};
+static const int kSfbLd512_24[] = {0,   4,   8,   12,  16,  20,  24,  28,  32,  36,  40,
+                                   44,  52,  60,  68,  80,  92,  104, 120, 140, 164, 192,
+                                   224, 256, 288, 320, 352, 384, 416, 448, 480, 512};
+static const int kSfbLd480_48[] = {0,   4,   8,   12,  16,  20,  24,  28,  32,  36,  40,  44,
+                                   48,  52,  56,  64,  72,  80,  88,  96,  108, 120, 132, 144,
+                                   156, 172, 188, 212, 240, 272, 304, 336, 368, 400, 432, 480};
+static const int kSfbLd480_32[] = {0,   4,   8,   12,  16,  20,  24,  28,  32,  36,  40,  44,  48,
+                                   52,  56,  60,  64,  72,  80,  88,  96,  104, 112, 124, 136, 148,
+                                   164, 180, 200, 224, 256, 288, 320, 352, 384, 416, 448, 480};
+static const int kSfbLd480_24[] = {0,   4,   8,   12,  16,  20,  24,  28,  32,  36,  40,
+                                   44,  52,  60,  68,  80,  92,  104, 120, 140, 164, 192,
+                                   224, 256, 288, 320, 352, 384, 416, 448, 480};
+
+namespace {
+struct LdBands {
+  int rate_index, num_sfb, tns_max_bands;
+  const int* offsets;
+};
+}  // namespace
+
+static const LdBands kLdBands512[] = {{3, 36, 31, kSfbLd512_48}, {4, 36, 32, kSfbLd512_48},
+                                      {5, 37, 37, kSfbLd512_32}, {6, 31, 31, kSfbLd512_24},
+                                      {7, 31, 31, kSfbLd512_24}};
+static const LdBands kLdBands480[] = {{3, 35, 31, kSfbLd480_48}, {4, 35, 32, kSfbLd480_48},
+                                      {5, 37, 37, kSfbLd480_32}, {6, 30, 30, kSfbLd480_24},
+                                      {7, 30, 30, kSfbLd480_24}};
+
+static const LdBands* ld_bands(int ri, int frame_length) {
+  if (frame_length != AAC_FRAME_SIZE_LD && frame_length != AAC_FRAME_SIZE_LD_480) {
+    return nullptr;
+  }
+  const LdBands* t = frame_length == AAC_FRAME_SIZE_LD_480 ? kLdBands480 : kLdBands512;
+  for (int i = 0; i < 5; i++) {
+    if (t[i].rate_index == ri) {
+      return &t[i];
+    }
+  }
+  return nullptr;
+}
+
+int aac_num_sfb(int ri, int frame_length) {
+  if (frame_length == AAC_FRAME_SIZE_LONG) {
+    return aac_num_sfb_long[ri];
+  }
+  const LdBands* b = ld_bands(ri, frame_length);
+  return b ? b->num_sfb : 0;
+}
+
+const int* aac_sfb_offsets(int ri, int frame_length) {
+  if (frame_length == AAC_FRAME_SIZE_LONG) {
+    return aac_sfb_offset_long[ri];
+  }
+  const LdBands* b = ld_bands(ri, frame_length);
+  return b ? b->offsets : nullptr;
+}
+
+int aac_tns_max_bands(int ri, int frame_length) {
+  if (frame_length == AAC_FRAME_SIZE_LONG) {
+    return aac_tns_max_bands_long[ri];
+  }
+  const LdBands* b = ld_bands(ri, frame_length);
+  return b ? b->tns_max_bands : 0;
+}
+
+const AacChannelConfig aac_channel_config[8] = {
+    {0, 0, {}},
+    {1, 1, {AAC_ELEM_SCE}},
+    {2, 1, {AAC_ELEM_CPE}},
+    {3, 2, {AAC_ELEM_SCE, AAC_ELEM_CPE}},
+    {4, 3, {AAC_ELEM_SCE, AAC_ELEM_CPE, AAC_ELEM_SCE}},
+    {5, 3, {AAC_ELEM_SCE, AAC_ELEM_CPE, AAC_ELEM_CPE}},
+    {6, 4, {AAC_ELEM_SCE, AAC_ELEM_CPE, AAC_ELEM_CPE, AAC_ELEM_LFE}},
+    {8, 5, {AAC_ELEM_SCE, AAC_ELEM_CPE, AAC_ELEM_CPE, AAC_ELEM_CPE, AAC_ELEM_LFE}},
+};
+
+int aac_sample_rate_index(int sample_rate) {
+  for (int i = 0; i < AAC_NUM_SAMPLE_RATES; i++) {
+    if (aac_sample_rates[i] == sample_rate) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int aac_channel_config_index(int channels) {
+  for (int i = 1; i < 8; i++) {
+    if (aac_channel_config[i].num_channels == channels) {
+      return i;
+    }
+  }
+  return 0;
+}
 
 /* SBR tables — placeholder zero-initialized, to be populated in Phase 8 */
 const int aac_sbr_freq_band_table_lo[AAC_NUM_SAMPLE_RATES][AAC_SBR_NUM_FREQ_COEFFS] = {{0}};
 const int aac_sbr_freq_band_table_hi[AAC_NUM_SAMPLE_RATES][AAC_SBR_NUM_FREQ_COEFFS] = {{0}};
-const float aac_sbr_qmf_window[AAC_SBR_QMF_FILTER_LENGTH] = {0};
+float aac_sbr_qmf_window[AAC_SBR_QMF_FILTER_LENGTH];
+
+/* SBR QMF prototype: root-raised-cosine lowpass, P(w) = cos(32 w) for
+ * |w| <= pi/64, so adjacent bands are power-complementary. Truncated to
+ * 640 taps with a Kaiser window (beta 2) and scaled to unit energy, which
+ * makes a 64-band analysis/synthesis pair unity gain with about 50 dB of
+ * reconstruction error. */
+static void sbr_qmf_prototype(float* out, int n) {
+  auto i0 = [](double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k <= 30; k++) {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+    return sum;
+  };
+  const double beta = 2.0;
+  const double half = (n - 1) / 2.0;
+  const double w0 = M_PI / 64.0;
+  auto* p = new double[n];
+  double energy = 0.0;
+  for (int i = 0; i < n; i++) {
+    double t = i - half;
+    /* Inverse transform of cos(32 w) over [-w0, w0] */
+    auto lobe = [w0](double a) { return fabs(a) < 1e-9 ? w0 : sin(a * w0) / a; };
+    double h = (lobe(t + 32.0) + lobe(t - 32.0)) / (2.0 * M_PI);
+    double r = t / (half + 0.5);
+    p[i] = h * i0(beta * sqrt(1.0 - r * r)) / i0(beta);
+    energy += p[i] * p[i];
+  }
+  for (int i = 0; i < n; i++) {
+    out[i] = (float)(p[i] / sqrt(energy));
+  }
+  delete[] p;
+}
 
 void aac_tables_init(void) {
   for (int cb = 1; cb <= AAC_NUM_CODEBOOKS; cb++) {
     aac_huff_code[cb] = huff_code_ptrs[cb];
     aac_huff_len[cb] = huff_len_ptrs[cb];
+    huff_lookup(cb);
   }
+  sbr_qmf_prototype(aac_sbr_qmf_window, AAC_SBR_QMF_FILTER_LENGTH);
 }
 
 namespace {
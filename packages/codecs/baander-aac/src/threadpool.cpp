@@ -0,0 +1,114 @@
+#include "threadpool.h"
+
+#ifndef BAAC_AAC_WASM
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct AacThreadPool_ {
+  std::vector<std::thread> workers;
+  std::mutex mu;
+  std::condition_variable wake, done;
+  /* The current job; written under mu before job is bumped */
+  AacThreadTask task = nullptr;
+  void* ctx = nullptr;
+  int n = 0;
+  std::atomic<int> next{0};
+  int busy = 0;     /* workers that have not finished the current job */
+  uint64_t job = 0; /* generation, bumped per aac_thread_pool_run */
+  bool stop = false;
+};
+
+static void run_indices(AacThreadPool* p) {
+  for (int i = p->next.fetch_add(1); i < p->n; i = p->next.fetch_add(1)) {
+    p->task(p->ctx, i);
+  }
+}
+
+static void worker_main(AacThreadPool* p) {
+  uint64_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(p->mu);
+      p->wake.wait(lock, [&] { return p->stop || p->job != seen; });
+      if (p->stop) {
+        return;
+      }
+      seen = p->job;
+    }
+    run_indices(p);
+    std::lock_guard<std::mutex> lock(p->mu);
+    if (--p->busy == 0) {
+      p->done.notify_one();
+    }
+  }
+}
+
+AacThreadPool* aac_thread_pool_create(int threads) {
+  if (threads < 2) {
+    return nullptr;
+  }
+  auto* p = new AacThreadPool();
+  for (int i = 1; i < threads; i++) {
+    p->workers.emplace_back(worker_main, p);
+  }
+  return p;
+}
+
+void aac_thread_pool_destroy(AacThreadPool* p) {
+  if (!p) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(p->mu);
+    p->stop = true;
+  }
+  p->wake.notify_all();
+  for (auto& t : p->workers) {
+    t.join();
+  }
+  delete p;
+}
+
+void aac_thread_pool_run(AacThreadPool* p, AacThreadTask task, void* ctx, int n) {
+  if (!p || n < 2) {
+    for (int i = 0; i < n; i++) {
+      task(ctx, i);
+    }
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(p->mu);
+    p->task = task;
+    p->ctx = ctx;
+    p->n = n;
+    p->next.store(0);
+    p->busy = (int)p->workers.size();
+    p->job++;
+  }
+  p->wake.notify_all();
+  run_indices(p);
+  std::unique_lock<std::mutex> lock(p->mu);
+  p->done.wait(lock, [&] { return p->busy == 0; });
+}
+
+#else /* WASM builds are single-threaded */
+
+AacThreadPool* aac_thread_pool_create(int threads) {
+  (void)threads;
+  return nullptr;
+}
+
+void aac_thread_pool_destroy(AacThreadPool* p) { (void)p; }
+
+void aac_thread_pool_run(AacThreadPool* p, AacThreadTask task, void* ctx, int n) {
+  (void)p;
+  for (int i = 0; i < n; i++) {
+    task(ctx, i);
+  }
+}
+
+#endif
@@ -0,0 +1,177 @@
+#include "twopass.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "aac.h"
+#include "aac_tables.h"
+
+/* Complexity compression: target ∝ pe^kPeExponent. 1.0 would follow PE
+ * exactly and starve easy frames; 0 is plain ABR. */
+static const float kPeExponent = 0.6f;
+static const float kTransientBoost = 1.3f;
+/* Errors against the plan are paid back over at most this many frames */
+static const int kCorrectionWindow = 64;
+
+AacTwoPassState* aac_twopass_open_first(const char* path, int sr, int ch, int br, int fs) {
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    return nullptr;
+  }
+  auto* tp = new AacTwoPassState();
+  tp->pass = 1;
+  tp->file = f;
+  tp->header.magic = AAC_PASS_STATS_MAGIC;
+  tp->header.version = AAC_PASS_STATS_VERSION;
+  tp->header.sample_rate = sr;
+  tp->header.channels = ch;
+  tp->header.bitrate = br;
+  tp->header.frame_size = fs;
+  if (fwrite(&tp->header, sizeof(tp->header), 1, f) != 1) {
+    aac_twopass_close(tp);
+    return nullptr;
+  }
+  return tp;
+}
+
+/* Split the global budget: each frame keeps its recorded header overhead
+ * and the remaining payload is shared by compressed perceptual entropy.
+ * A frame whose share would exceed one frame's payload is capped, and what
+ * it could not take is spread again over the others until none exceeds it. */
+static void plan_budget(AacTwoPassState* tp, int br) {
+  const AacPassStatsHeader* h = &tp->header;
+  int64_t budget = (int64_t)br * tp->n_frames * h->frame_size / h->sample_rate;
+  int64_t max_payload = (int64_t)AAC_BITS_PER_FRAME_LONG * h->channels;
+
+  int64_t fixed = 0;
+  double weight_sum = 0.0;
+  auto* weight = new double[tp->n_frames];
+  for (int i = 0; i < tp->n_frames; i++) {
+    const AacPassStatsFrame* fr = &tp->frames[i];
+    fixed += std::max(fr->frame_bits - fr->est_bits, 0);
+    double w = pow(std::max(fr->pe, 1.0f), kPeExponent);
+    if (fr->flags & AAC_PASS_FLAG_TRANSIENT) {
+      w *= kTransientBoost;
+    }
+    weight[i] = w;
+    weight_sum += w;
+  }
+
+  /* A capped frame is marked by a zero weight; capping one only raises the
+   * others' shares, so a sweep that caps nothing is final */
+  int64_t payload = std::max<int64_t>(budget - fixed, tp->n_frames);
+  for (bool capped = true; capped && weight_sum > 0.0;) {
+    capped = false;
+    for (int i = 0; i < tp->n_frames; i++) {
+      if (weight[i] > 0.0 && (double)payload * weight[i] / weight_sum > (double)max_payload) {
+        payload -= max_payload;
+        weight_sum -= weight[i];
+        weight[i] = 0.0;
+        capped = true;
+      }
+    }
+  }
+  for (int i = 0; i < tp->n_frames; i++) {
+    const AacPassStatsFrame* fr = &tp->frames[i];
+    int64_t share = max_payload;
+    if (weight[i] > 0.0) {
+      share = (int64_t)((double)payload * weight[i] / weight_sum);
+      share = std::min(std::max<int64_t>(share, 1), max_payload);
+    }
+    tp->target_bits[i] = share + std::max(fr->frame_bits - fr->est_bits, 0);
+  }
+  delete[] weight;
+}
+
+AacTwoPassState* aac_twopass_open_second(const char* path, int sr, int ch, int br, int fs) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    return nullptr;
+  }
+  AacPassStatsHeader h;
+  if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != AAC_PASS_STATS_MAGIC ||
+      h.version != AAC_PASS_STATS_VERSION || h.sample_rate != sr || h.channels != ch ||
+      h.frame_size != fs) {
+    fclose(f);
+    return nullptr;
+  }
+  fseek(f, 0, SEEK_END);
+  long end = ftell(f);
+  fseek(f, (long)sizeof(h), SEEK_SET);
+  int n = (int)((end - (long)sizeof(h)) / (long)sizeof(AacPassStatsFrame));
+  if (n <= 0) {
+    fclose(f);
+    return nullptr;
+  }
+
+  auto* tp = new AacTwoPassState();
+  tp->pass = 2;
+  tp->header = h;
+  tp->n_frames = n;
+  tp->frames = new AacPassStatsFrame[n];
+  tp->target_bits = new int64_t[n];
+  size_t got = fread(tp->frames, sizeof(AacPassStatsFrame), n, f);
+  fclose(f);
+  if ((int)got != n) {
+    aac_twopass_close(tp);
+    return nullptr;
+  }
+  plan_budget(tp, br);
+  return tp;
+}
+
+void aac_twopass_close(AacTwoPassState* tp) {
+  if (!tp) {
+    return;
+  }
+  if (tp->file) {
+    fclose(tp->file);
+  }
+  delete[] tp->frames;
+  delete[] tp->target_bits;
+  delete tp;
+}
+
+int aac_twopass_record(AacTwoPassState* tp, const AacPassStatsFrame* frame) {
+  if (tp->pass != 1 || !tp->file) {
+    return AAC_ERR_STATE;
+  }
+  return fwrite(frame, sizeof(*frame), 1, tp->file) == 1 ? AAC_OK : AAC_ERR_ENCODE;
+}
+
+int aac_twopass_frame_plan(AacTwoPassState* tp, int* target_bits, float* lambda) {
+  if (tp->pass != 2 || tp->frame_index >= tp->n_frames) {
+    return 0;
+  }
+  int i = tp->frame_index;
+  const AacPassStatsFrame* fr = &tp->frames[i];
+
+  int remaining = tp->n_frames - i;
+  int64_t error = tp->spent_total - tp->planned_total;
+  int64_t correction = error / std::min(remaining, kCorrectionWindow);
+
+  int64_t overhead = std::max(fr->frame_bits - fr->est_bits, 0);
+  int64_t planned_payload = tp->target_bits[i] - overhead;
+  int64_t payload = std::max(planned_payload - correction, planned_payload / 4 + 1);
+  *target_bits = (int)payload;
+
+  /* bits ≈ est_bits * (lambda / lambda_rec)^-slope, solved for lambda */
+  if (fr->est_bits > 0 && fr->lambda > 0.0f) {
+    float slope = std::clamp(fr->slope, 0.2f, 4.0f);
+    float l = fr->lambda * powf((float)payload / (float)fr->est_bits, -1.0f / slope);
+    if (std::isfinite(l)) {
+      *lambda = std::clamp(l, 1e-8f, 1e6f);
+    }
+  }
+  return 1;
+}
+
+void aac_twopass_frame_done(AacTwoPassState* tp, int frame_bits) {
+  if (tp->pass != 2 || tp->frame_index >= tp->n_frames) {
+    return;
+  }
+  tp->planned_total += tp->target_bits[tp->frame_index];
+  tp->spent_total += frame_bits;
+  tp->frame_index++;
+}
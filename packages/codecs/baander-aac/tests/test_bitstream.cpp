@@ -1,12 +1,17 @@
 /*
  * Bitstream reader/writer roundtrip tests.
- * Verifies: bit read/write, ADTS parse/write, Huffman encode/decode.
+ * Verifies: bit read/write, ADTS parse/write, ADTS framing and file index, MP4
+ * demuxing and fragmented muxing, Huffman encode/decode, Exp-Golomb.
  */
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <vector>
 
+#include "aac.h"
 #include "aac_tables.h"
+#include "adts.h"
 #include "bitstream.h"
 
 static int test_bit_rw_roundtrip() {
@@ -48,6 +53,42 @@ static int test_bit_rw_roundtrip() {
   return 0;
 }
 
+/* Peek, read and skip of 0 to 32 bits from every bit position of a short
+ * buffer, up to and past its end, against a bit-by-bit reference */
+static int test_bit_peek_skip() {
+  const uint8_t buf[7] = {0xA5, 0x3C, 0xFF, 0x01, 0x80, 0x7E, 0xD2};
+  const int size_bits = 8 * (int)sizeof(buf);
+  auto bit = [&](int i) { return i < size_bits ? (buf[i >> 3] >> (7 - (i & 7))) & 1 : 0; };
+  int errors = 0, checks = 0;
+  for (int pos = 0; pos <= size_bits + 8; pos++) {
+    for (int n : {0, 1, 5, 8, 13, 24, 25, 31, 32}) {
+      uint32_t expect = 0;
+      for (int i = 0; i < n; i++) {
+        expect = (expect << 1) | (uint32_t)bit(pos + i);
+      }
+      AacBitReader r, skip;
+      aac_bitreader_init(&r, buf, sizeof(buf));
+      aac_bitreader_skip(&r, pos);
+      skip = r;
+      const uint32_t peeked = aac_bitreader_peek(&r, n);
+      const uint32_t read = aac_bitreader_read(&r, n);
+      aac_bitreader_skip(&skip, n);
+      errors += peeked != expect || read != expect || r.byte_pos * 8 + r.bit_pos != pos + n ||
+                skip.byte_pos != r.byte_pos || skip.bit_pos != r.bit_pos ||
+                aac_bitreader_bits_left(&r) != size_bits - pos - n;
+      checks++;
+    }
+  }
+  printf("Bit peek/skip: %d positions and widths up to 32 bits past the end, %d errors\n", checks,
+         errors);
+  if (errors) {
+    printf("FAIL: bit peek/skip\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
 static int test_adts_roundtrip() {
   AacAdtsHeader hdr = {};  // NOLINT(bugprone-invalid-enum-default-initialization)
   hdr.id = 0;
@@ -96,19 +137,915 @@ static int test_adts_roundtrip() {
   return 0;
 }
 
+/* The framer on a stream of ADTS frames with random payloads (false syncs
+ * included), garbage before, between and after frames and one corrupt
+ * header, fed in chunks of 1 to 16 or up to 3000 bytes: every intact frame comes out
+ * whole and in order, the rest is counted as dropped, and frames within a
+ * chunk are handed out in place */
+static int test_adts_framer() {
+  uint32_t rng = 0x9E3779B9u;
+  auto next_rand = [&rng]() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+  };
+  const int n_frames = 200, corrupt = 57;
+  std::vector<uint8_t> stream;
+  std::vector<std::vector<uint8_t>> expect;
+  int64_t garbage = 0;
+  for (int f = 0; f < n_frames; f++) {
+    if (f % 40 == 3) { /* garbage, with syncwords of its own */
+      int n = 1 + (int)(next_rand() % 300);
+      for (int i = 0; i < n; i++) {
+        stream.push_back(i % 17 == 0 ? 0xFF : (uint8_t)(next_rand() | 0xF0));
+      }
+      garbage += n;
+    }
+    AacAdtsHeader hdr = {};  // NOLINT(bugprone-invalid-enum-default-initialization)
+    hdr.protection_absent = 1;
+    hdr.profile = AAC_AOT_LC;
+    hdr.sample_rate_index = 4;
+    hdr.channel_config = 2;
+    hdr.frame_length = 7 + (int)(next_rand() % 1500);
+    hdr.buffer_fullness = 0x7FF;
+    std::vector<uint8_t> frame(hdr.frame_length);
+    aac_adts_write(&hdr, frame.data());
+    for (int i = 7; i < hdr.frame_length; i++) {
+      frame[i] = (uint8_t)next_rand();
+    }
+    if (f == corrupt) {
+      frame[2] |= 0x3C; /* sampling_frequency_index 15 */
+      garbage += hdr.frame_length;
+    } else {
+      expect.push_back(frame);
+    }
+    stream.insert(stream.end(), frame.begin(), frame.end());
+  }
+  for (int i = 0; i < 5; i++) {
+    stream.push_back(0xFF);
+  }
+  garbage += 5;
+
+  AacAdtsFramerHandle fr = aac_adts_framer_create();
+  size_t pos = 0, got = 0;
+  int mismatches = 0, in_place = 0;
+  const uint8_t* frame;
+  int size;
+  for (bool eos = false; !eos;) {
+    int limit = next_rand() % 4 == 0 ? 16 : 3000;
+    int n = std::min((int)(stream.size() - pos), 1 + (int)(next_rand() % limit));
+    eos = n == 0;
+    std::vector<uint8_t> chunk(stream.begin() + (long)pos, stream.begin() + (long)pos + n);
+    pos += n;
+    mismatches += aac_adts_framer_feed(fr, chunk.data(), n) != AAC_OK;
+    while (aac_adts_framer_next(fr, &frame, &size) == 1) {
+      if (got >= expect.size() || (size_t)size != expect[got].size() ||
+          memcmp(frame, expect[got].data(), size) != 0) {
+        mismatches++;
+      }
+      in_place += frame >= chunk.data() && frame < chunk.data() + n;
+      got++;
+    }
+  }
+  const int64_t dropped = aac_adts_framer_dropped(fr);
+  aac_adts_framer_destroy(fr);
+  printf("ADTS framer: %zu/%zu frames, %d in place, %d mismatches, dropped %lld of %lld bytes\n",
+         got, expect.size(), in_place, mismatches, (long long)dropped, (long long)garbage);
+  if (got != expect.size() || mismatches != 0 || dropped != garbage ||
+      in_place < (int)got / 3) {
+    printf("FAIL: ADTS framer\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* Write an ADTS file: an ID3v2 tag, n frames with random payloads and
+ * `blocks` raw data blocks each, junk after frame 100 and a truncated frame
+ * at the end. Returns the frames' offsets and sizes in offsets/sizes. */
+static int64_t write_adts_file(const char* path, int n, int blocks, int fullness,
+                               std::vector<int64_t>* offsets, std::vector<int>* sizes,
+                               int64_t* junk) {
+  uint32_t rng = 0x2545F491u + (uint32_t)n;
+  std::vector<uint8_t> file = {'I', 'D', '3', 4, 0, 0, 0, 0, 0, 100};
+  file.resize(110, 0);
+  *junk = 0;
+  for (int f = 0; f <= n; f++) {
+    if (f == 100) {
+      for (int i = 0; i < 50; i++) {
+        file.push_back(i % 5 == 0 ? 0xFF : 0xF1);
+      }
+      *junk += 50;
+    }
+    AacAdtsHeader hdr = {};  // NOLINT(bugprone-invalid-enum-default-initialization)
+    hdr.protection_absent = 1;
+    hdr.profile = AAC_AOT_LC;
+    hdr.sample_rate_index = 3;
+    hdr.channel_config = 2;
+    hdr.frame_length = 7 + 100 + (int)(rng % 600);
+    hdr.buffer_fullness = fullness;
+    hdr.num_aac_frames = blocks - 1;
+    const size_t at = file.size();
+    file.resize(at + hdr.frame_length);
+    aac_adts_write(&hdr, &file[at]);
+    for (int i = 7; i < hdr.frame_length; i++) {
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      file[at + i] = (uint8_t)rng;
+    }
+    if (f == n) { /* cut short */
+      file.resize(at + hdr.frame_length / 2);
+      *junk += hdr.frame_length / 2;
+    } else {
+      offsets->push_back((int64_t)at);
+      sizes->push_back(hdr.frame_length);
+    }
+  }
+  FILE* fp = fopen(path, "wb");
+  fwrite(file.data(), 1, file.size(), fp);
+  fclose(fp);
+  return (int64_t)file.size();
+}
+
+/* The file index against the frames written, for one and two raw data
+ * blocks per frame: counts, ID3v2 and junk skipping, zero-copy frame spans,
+ * sample lookup, and a sidecar that is reused until the file changes */
+static int test_adts_index() {
+  const char* path = "test_bitstream_index.aac";
+  const char* sidecar = "test_bitstream_index.aac.idx";
+  int failures = 0;
+  for (int blocks : {1, 2}) {
+    std::vector<int64_t> offsets;
+    std::vector<int> sizes;
+    int64_t junk;
+    const int n = 300 + blocks;
+    write_adts_file(path, n, blocks, 0x7FF, &offsets, &sizes, &junk);
+    remove(sidecar);
+    for (int pass = 0; pass < 3; pass++) {
+      if (pass == 2) { /* a changed file makes the sidecar stale */
+        offsets.clear();
+        sizes.clear();
+        write_adts_file(path, n + 1, blocks, 0x7FF, &offsets, &sizes, &junk);
+      }
+      AacAdtsIndexHandle idx = aac_adts_index_open(path, sidecar);
+      AacAdtsIndexInfo info;
+      if (!idx || aac_adts_index_info(idx, &info) != AAC_OK) {
+        printf("FAIL: ADTS index open\n");
+        return 1;
+      }
+      int errors = info.frames != (int64_t)offsets.size() ||
+                   info.samples != info.frames * blocks * 1024 || info.data_offset != 110 ||
+                   info.dropped != junk || info.sample_rate != 48000 ||
+                   info.channel_config != 2 || info.from_sidecar != (pass == 1);
+      const AacAdtsIndexHeader* h = &static_cast<AacAdtsIndex*>(idx)->header;
+      const uint8_t* base = static_cast<AacAdtsIndex*>(idx)->file.data;
+      for (int64_t f = 0; f < info.frames; f++) {
+        const uint8_t* data;
+        int size;
+        errors += aac_adts_index_frame(idx, f, &data, &size) != AAC_OK ||
+                  data != base + offsets[f] || size != sizes[f];
+        for (int64_t sample : {f * blocks * 1024, (f + 1) * blocks * 1024 - 1}) {
+          errors += aac_adts_index_find(idx, sample) != f;
+        }
+      }
+      errors += aac_adts_index_find(idx, info.samples) >= 0 || h->multi_block != (blocks > 1);
+      printf("ADTS index, %d block(s) per frame, %s: %lld frames, %.1f s, %lld bytes skipped, "
+             "%d errors\n",
+             blocks, pass == 0 ? "built" : (pass == 1 ? "from sidecar" : "rebuilt"),
+             (long long)info.frames, (double)info.samples / info.sample_rate,
+             (long long)info.dropped, errors);
+      failures += errors != 0;
+      aac_adts_index_close(idx);
+    }
+  }
+  remove(path);
+  remove(sidecar);
+  if (failures) {
+    printf("FAIL: ADTS index\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+static int collect_splice(const uint8_t* data, int size, void* user) {
+  auto* out = static_cast<std::vector<std::vector<uint8_t>>*>(user);
+  out->emplace_back(data, data + size);
+  return AAC_OK;
+}
+
+/* A sink whose writes fail while `fail` is set */
+using FlakySink = struct FlakySink_ {
+  std::vector<uint8_t> out;
+  bool fail;
+};
+
+static int flaky_splice(const uint8_t* data, int size, void* user) {
+  auto* sink = static_cast<FlakySink*>(user);
+  if (sink->fail) {
+    return AAC_ERR_STATE;
+  }
+  sink->out.insert(sink->out.end(), data, data + size);
+  return AAC_OK;
+}
+
+/* Segment plans for one and two raw data blocks per frame (boundaries,
+ * pre-roll, byte ranges, junk making a range non-contiguous), then a splice
+ * of a CBR file and a VBR one: the output is the frames in order, runs of
+ * adjacent frames go out in one write, and CBR frames after a seam have
+ * their buffer_fullness rewritten to 0x7FF */
+static int test_adts_splicer() {
+  const char* path[2] = {"test_bitstream_splice_a.aac", "test_bitstream_splice_b.aac"};
+  const int segment_ms = 2000, preroll = 2;
+  int failures = 0;
+  for (int blocks : {1, 2}) {
+    std::vector<int64_t> offsets;
+    std::vector<int> sizes;
+    int64_t junk;
+    write_adts_file(path[0], 300, blocks, 0x7FF, &offsets, &sizes, &junk);
+    AacAdtsIndexHandle idx = aac_adts_index_open(path[0], nullptr);
+    const int64_t per_segment = (segment_ms * 48 + 512) / 1024; /* blocks, at 48 kHz */
+    const int64_t count = aac_adts_index_segments(idx, segment_ms, preroll, nullptr, 0);
+    std::vector<AacAdtsSegment> segs(std::max<int64_t>(count, 0));
+    int errors = count != (300 * blocks + per_segment - 1) / per_segment ||
+                 aac_adts_index_segments(idx, segment_ms, preroll, segs.data(), count) != count;
+    int64_t next = 0, split = 0;
+    for (const AacAdtsSegment& g : segs) {
+      const int64_t f = g.first_frame, last = f + g.frames - 1;
+      errors += f != next || g.frames <= 0 ||
+                g.preroll_frame != std::max<int64_t>(f - preroll, 0) ||
+                g.start_sample != f * blocks * 1024 ||
+                (f > 0 && (f * blocks) % per_segment >= blocks) || g.offset != offsets[f] ||
+                g.size != offsets[last] + sizes[last] - offsets[f] ||
+                g.contiguous != !(f < 100 && last >= 100);
+      split += !g.contiguous;
+      next = last + 1;
+    }
+    errors += next != 300 || split != 1;
+    aac_adts_index_close(idx);
+    printf("ADTS segments, %d block(s) per frame: %lld of %lld blocks, %lld split by junk, "
+           "%d errors\n",
+           blocks, (long long)count, (long long)per_segment, (long long)split, errors);
+    failures += errors != 0;
+  }
+
+  /* a: VBR, b: CBR */
+  std::vector<int64_t> offsets[2];
+  std::vector<int> sizes[2];
+  int64_t junk;
+  write_adts_file(path[0], 120, 1, 0x7FF, &offsets[0], &sizes[0], &junk);
+  write_adts_file(path[1], 80, 1, 0x123, &offsets[1], &sizes[1], &junk);
+  AacAdtsIndexHandle idx[2] = {aac_adts_index_open(path[0], nullptr),
+                               aac_adts_index_open(path[1], nullptr)};
+  std::vector<std::vector<uint8_t>> writes;
+  AacAdtsSplicerHandle sp = aac_adts_splicer_create(collect_splice, &writes);
+  struct Run {
+    int file;
+    int64_t first, count;
+  };
+  const Run runs[] = {{1, 0, 30}, {1, 30, 10}, {0, 95, 10}, {1, 50, 10}};
+  std::vector<uint8_t> expect;
+  int errors = !idx[0] || !idx[1] || !sp;
+  for (const Run& r : runs) {
+    errors += aac_adts_splicer_append(sp, idx[r.file], r.first, r.count) != AAC_OK;
+    for (int64_t f = r.first; f < r.first + r.count && !errors; f++) {
+      const uint8_t* data;
+      int size;
+      aac_adts_index_frame(idx[r.file], f, &data, &size);
+      expect.insert(expect.end(), data, data + size);
+      if (&r == &runs[3]) {
+        expect[expect.size() - size + 5] |= 0x1F;
+        expect[expect.size() - size + 6] |= 0xFC;
+      }
+    }
+  }
+  errors += aac_adts_splicer_append(sp, idx[0], 119, 2) != AAC_ERR_INVALID_ARG;
+  std::vector<uint8_t> got;
+  for (const auto& w : writes) {
+    got.insert(got.end(), w.begin(), w.end());
+  }
+  int64_t patched;
+  const int64_t frames = sp ? aac_adts_splicer_frames(sp, &patched) : 0;
+  /* b 0-29, b 30-39, a 95-99 and 100-104 around the junk, b 50-59 staged */
+  errors += got != expect || writes.size() != 5 || frames != 60 || patched != 10;
+  aac_adts_splicer_destroy(sp);
+
+  /* A run whose write fails is not counted, and appending it again once the
+   * sink recovers continues the stream without a seam */
+  FlakySink sink = {{}, false};
+  sp = aac_adts_splicer_create(flaky_splice, &sink);
+  errors += aac_adts_splicer_append(sp, idx[1], 0, 30) != AAC_OK;
+  sink.fail = true;
+  errors += aac_adts_splicer_append(sp, idx[1], 30, 10) != AAC_ERR_STATE;
+  errors += aac_adts_splicer_frames(sp, nullptr) != 30;
+  sink.fail = false;
+  errors += aac_adts_splicer_append(sp, idx[1], 30, 10) != AAC_OK;
+  int64_t retried = -1;
+  errors += aac_adts_splicer_frames(sp, &retried) != 40 || retried != 0 ||
+            sink.out.size() != (size_t)(offsets[1][39] + sizes[1][39] - offsets[1][0]);
+  aac_adts_splicer_destroy(sp);
+  for (auto* x : idx) {
+    aac_adts_index_close(x);
+  }
+  printf("ADTS splice: %lld frames, %lld bytes in %zu writes, %lld buffer_fullness rewritten, "
+         "%lld after a failed write, %d errors\n",
+         (long long)frames, (long long)got.size(), writes.size(), (long long)patched,
+         (long long)sink.out.size(), errors);
+  failures += errors != 0;
+  remove(path[0]);
+  remove(path[1]);
+  if (failures) {
+    printf("FAIL: ADTS splicer\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+static void put32(std::vector<uint8_t>* b, uint64_t v) {
+  for (int s = 24; s >= 0; s -= 8) {
+    b->push_back((uint8_t)(v >> s));
+  }
+}
+
+/* Start a box; box_end patches its size */
+static size_t box_begin(std::vector<uint8_t>* b, const char* type) {
+  const size_t at = b->size();
+  put32(b, 0);
+  b->insert(b->end(), type, type + 4);
+  return at;
+}
+
+static void box_end(std::vector<uint8_t>* b, size_t at) {
+  std::vector<uint8_t> size;
+  put32(&size, b->size() - at);
+  std::copy(size.begin(), size.end(), b->begin() + (ptrdiff_t)at);
+}
+
+/* moov with a text track ahead of the audio track, whose access units are
+ * in chunks of 5 and then 3 starting at chunk_offsets */
+static std::vector<uint8_t> write_moov(const std::vector<std::vector<uint8_t>>& aus,
+                                       const uint8_t* asc, int asc_size, int rate, int fs,
+                                       const std::vector<uint64_t>& chunk_offsets, bool co64) {
+  std::vector<uint8_t> b;
+  const size_t moov = box_begin(&b, "moov");
+  for (const char* handler : {"text", "soun"}) {
+    const size_t trak = box_begin(&b, "trak"), mdia = box_begin(&b, "mdia");
+    size_t at = box_begin(&b, "mdhd");
+    for (uint32_t v : {0u, 0u, 0u, (uint32_t)rate, (uint32_t)(aus.size() * fs), 0u}) {
+      put32(&b, v);
+    }
+    box_end(&b, at);
+    at = box_begin(&b, "hdlr");
+    put32(&b, 0);
+    put32(&b, 0);
+    b.insert(b.end(), handler, handler + 4);
+    b.resize(b.size() + 13, 0);
+    box_end(&b, at);
+    if (handler[0] == 't') {
+      box_end(&b, mdia);
+      box_end(&b, trak);
+      continue;
+    }
+    const size_t minf = box_begin(&b, "minf"), stbl = box_begin(&b, "stbl");
+    at = box_begin(&b, "stsd");
+    put32(&b, 0);
+    put32(&b, 1);
+    const size_t mp4a = box_begin(&b, "mp4a");
+    const uint8_t entry[28] = {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0,
+                               0, 0, 0, 2, 0, 16, 0, 0, 0, 0, (uint8_t)(rate >> 8), (uint8_t)rate};
+    b.insert(b.end(), entry, entry + 28);
+    const size_t esds = box_begin(&b, "esds");
+    put32(&b, 0);
+    const uint8_t es[] = {0x03, 0x80, 0x80, 0x80, (uint8_t)(3 + 2 + 13 + 2 + asc_size + 3),
+                          0, 1, 0, 0x04, (uint8_t)(13 + 2 + asc_size),
+                          0x40, 0x15, 0, 0x18, 0, 0, 0x01, 0xF4, 0, 0, 0x01, 0xF4, 0,
+                          0x05, (uint8_t)asc_size};
+    b.insert(b.end(), es, es + sizeof(es));
+    b.insert(b.end(), asc, asc + asc_size);
+    const uint8_t sl[] = {0x06, 0x01, 0x02};
+    b.insert(b.end(), sl, sl + 3);
+    box_end(&b, esds);
+    box_end(&b, mp4a);
+    box_end(&b, at);
+    at = box_begin(&b, "stts");
+    for (uint32_t v : {0u, 1u, (uint32_t)aus.size(), (uint32_t)fs}) {
+      put32(&b, v);
+    }
+    box_end(&b, at);
+    at = box_begin(&b, "stsc");
+    for (uint32_t v : {0u, 2u, 1u, 5u, 1u, 8u, 3u, 1u}) {
+      put32(&b, v);
+    }
+    box_end(&b, at);
+    at = box_begin(&b, "stsz");
+    put32(&b, 0);
+    put32(&b, 0);
+    put32(&b, aus.size());
+    for (const auto& au : aus) {
+      put32(&b, au.size());
+    }
+    box_end(&b, at);
+    at = box_begin(&b, co64 ? "co64" : "stco");
+    put32(&b, 0);
+    put32(&b, chunk_offsets.size());
+    for (uint64_t off : chunk_offsets) {
+      if (co64) {
+        put32(&b, off >> 32);
+      }
+      put32(&b, off & 0xFFFFFFFFu);
+    }
+    box_end(&b, at);
+    box_end(&b, stbl);
+    box_end(&b, minf);
+    box_end(&b, mdia);
+    box_end(&b, trak);
+  }
+  box_end(&b, moov);
+  return b;
+}
+
+/* .m4a files of encoder output, with moov ahead of mdat (stco, file cut
+ * short) and after it (co64): counts, AudioSpecificConfig, zero-copy access
+ * units, time lookup, and decoding that matches the ADTS stream's */
+static int test_mp4_demuxer() {
+  const char* path = "test_bitstream_demux.m4a";
+  const int n = 60;
+  int failures = aac_mp4_demuxer_open(path) != nullptr;
+  for (AacObjectType aot : {AAC_AOT_LC, AAC_AOT_SBR}) {
+    const int rate = aot == AAC_AOT_LC ? 44100 : 48000, fs = aot == AAC_AOT_LC ? 1024 : 2048;
+    AacEncoderHandle enc =
+        aac_encoder_create(rate, 2, aot == AAC_AOT_LC ? 128000 : 48000, aot, AAC_RC_CBR);
+    uint8_t asc[16];
+    const int asc_size = aac_encoder_get_config(enc, asc, sizeof(asc));
+    std::vector<std::vector<uint8_t>> adts, aus;
+    std::vector<float> pcm(2 * fs);
+    uint8_t frame[8192];
+    for (int f = 0; f < n; f++) {
+      for (int i = 0; i < fs; i++) {
+        float t = (float)(f * fs + i) / (float)rate;
+        pcm[i * 2] = 0.3f * sinf(2.0f * (float)M_PI * 440.0f * t);
+        pcm[i * 2 + 1] = 0.3f * sinf(2.0f * (float)M_PI * 660.0f * t);
+      }
+      const int len = aac_encoder_encode(enc, pcm.data(), fs, frame, sizeof(frame));
+      adts.emplace_back(frame, frame + len);
+      aus.emplace_back(frame + 7, frame + len);
+    }
+    aac_encoder_destroy(enc);
+
+    for (bool faststart : {true, false}) {
+      /* mdat: chunks of 5 then 3 access units, 13 bytes apart */
+      std::vector<uint8_t> ftyp = {0, 0, 0, 16, 'f', 't', 'y', 'p', 'M', '4', 'A', ' ', 0, 0, 0, 0};
+      std::vector<uint8_t> mdat = {0, 0, 0, 0, 'm', 'd', 'a', 't'};
+      std::vector<uint64_t> chunks, rel;
+      for (int f = 0; f < n; f++) {
+        if (f < 35 ? f % 5 == 0 : (f - 35) % 3 == 0) {
+          mdat.resize(mdat.size() + 13, 0xEE);
+          chunks.push_back(mdat.size());
+        }
+        rel.push_back(mdat.size());
+        mdat.insert(mdat.end(), aus[f].begin(), aus[f].end());
+      }
+      mdat[0] = (uint8_t)(mdat.size() >> 24);
+      mdat[1] = (uint8_t)(mdat.size() >> 16);
+      mdat[2] = (uint8_t)(mdat.size() >> 8);
+      mdat[3] = (uint8_t)mdat.size();
+      const size_t moov_size =
+          write_moov(aus, asc, asc_size, rate, fs, chunks, !faststart).size();
+      const uint64_t base = ftyp.size() + (faststart ? moov_size : 0);
+      for (auto& c : chunks) {
+        c += base;
+      }
+      const std::vector<uint8_t> moov =
+          write_moov(aus, asc, asc_size, rate, fs, chunks, !faststart);
+      std::vector<uint8_t> file = ftyp;
+      const std::vector<uint8_t>* parts[2] = {&moov, &mdat};
+      if (!faststart) {
+        std::swap(parts[0], parts[1]);
+      }
+      for (auto* part : parts) {
+        file.insert(file.end(), part->begin(), part->end());
+      }
+      /* A download cut inside access unit n - 3 */
+      const int64_t frames = faststart ? n - 3 : n;
+      if (faststart) {
+        file.resize(base + rel[n - 3] + aus[n - 3].size() / 2);
+      }
+      FILE* fp = fopen(path, "wb");
+      fwrite(file.data(), 1, file.size(), fp);
+      fclose(fp);
+
+      AacMp4DemuxerHandle mp4 = aac_mp4_demuxer_open(path);
+      AacMp4Info info;
+      if (!mp4 || aac_mp4_demuxer_info(mp4, &info) != AAC_OK) {
+        printf("FAIL: MP4 demuxer open\n");
+        return 1;
+      }
+      uint8_t got_asc[16];
+      int errors = info.frames != frames || info.sample_rate != rate || info.channels != 2 ||
+                   info.object_type != aot || info.bitrate != 128000 || info.timescale != rate ||
+                   info.duration != frames * fs ||
+                   aac_mp4_demuxer_config(mp4, got_asc, sizeof(got_asc)) != asc_size ||
+                   memcmp(got_asc, asc, asc_size) != 0;
+      AacDecoderHandle ref = aac_decoder_create(rate, 2);
+      AacDecoderHandle dec = aac_decoder_create(info.sample_rate, info.channels);
+      errors += aac_decoder_set_config(dec, got_asc, asc_size) != AAC_OK;
+      std::vector<float> expect(2 * fs), got(2 * fs);
+      for (int64_t f = 0; f < info.frames; f++) {
+        const uint8_t* data;
+        int size;
+        errors += aac_mp4_demuxer_frame(mp4, f, &data, &size) != AAC_OK ||
+                  size != (int)aus[f].size() || memcmp(data, aus[f].data(), size) != 0;
+        for (int64_t t : {f * fs, f * fs + fs - 1}) {
+          errors += aac_mp4_demuxer_find(mp4, t) != f;
+        }
+        const int a = aac_decoder_decode(ref, adts[f].data(), (int)adts[f].size(), expect.data(),
+                                         2 * fs);
+        const int b = aac_decoder_decode(dec, data, size, got.data(), 2 * fs);
+        errors += a != fs || b != fs || memcmp(expect.data(), got.data(), 2 * fs * 4) != 0;
+      }
+      errors += aac_mp4_demuxer_find(mp4, info.duration) >= 0;
+      printf("MP4 demuxer, %s, moov %s mdat: %lld access units, %.2f s, %d errors\n",
+             aot == AAC_AOT_LC ? "AAC-LC" : "HE-AAC", faststart ? "before" : "after",
+             (long long)info.frames, (double)info.duration / info.timescale, errors);
+      failures += errors != 0;
+      aac_decoder_destroy(ref);
+      aac_decoder_destroy(dec);
+      aac_mp4_demuxer_close(mp4);
+
+      /* A fixed-size stsz counting more access units than the file or its
+       * chunks (room for 62) could hold is refused before allocating, as is
+       * one byte each for half the file when the last chunks hold any number */
+      const uint8_t tag[4] = {'s', 't', 's', 'z'}, stsc_tag[4] = {'s', 't', 's', 'c'};
+      const size_t stsz = std::search(file.begin(), file.end(), tag, tag + 4) - file.begin() + 8;
+      for (uint32_t count : {0xFFFFFFFFu, 1000u, (uint32_t)file.size() / 2}) {
+        if (count == file.size() / 2) {
+          const size_t per = std::search(file.begin(), file.end(), stsc_tag, stsc_tag + 4) -
+                             file.begin() + 28;
+          std::fill(file.begin() + per, file.begin() + per + 4, 0xFF);
+        }
+        for (int i = 0; i < 4; i++) {
+          file[stsz + i] = i == 3;
+          file[stsz + 4 + i] = (uint8_t)(count >> (24 - 8 * i));
+        }
+        fp = fopen(path, "wb");
+        fwrite(file.data(), 1, file.size(), fp);
+        fclose(fp);
+        mp4 = aac_mp4_demuxer_open(path);
+        failures += mp4 != nullptr;
+        aac_mp4_demuxer_close(mp4);
+      }
+    }
+  }
+  remove(path);
+  if (failures) {
+    printf("FAIL: MP4 demuxer\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+static uint32_t be32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/* Payload of the first `type` box in [p, p + size), or nullptr */
+static const uint8_t* child_box(const uint8_t* p, size_t size, const char* type,
+                                size_t* box_size) {
+  for (size_t at = 0; at + 8 <= size && be32(p + at) >= 8;) {
+    const uint32_t len = be32(p + at);
+    if (memcmp(p + at + 4, type, 4) == 0 && at + len <= size) {
+      *box_size = len - 8;
+      return p + at + 8;
+    }
+    at += len;
+  }
+  return nullptr;
+}
+
+static int collect_segment(const uint8_t* data, int size, void* user) {
+  static_cast<std::vector<std::vector<uint8_t>>*>(user)->emplace_back(data, data + size);
+  return AAC_OK;
+}
+
+/* Init segment and fragments against the access units put in: moof
+ * sequence, decode times, trun sizes and data offset, mdat contents. Returns
+ * the errors found. */
+static int check_fmp4(const std::vector<std::vector<uint8_t>>& segs,
+                      const std::vector<std::vector<uint8_t>>& aus, const uint8_t* asc,
+                      int asc_size, int fs, int per_fragment) {
+  size_t size;
+  int errors = segs.empty() || !child_box(segs[0].data(), segs[0].size(), "ftyp", &size);
+  const uint8_t* moov = errors ? nullptr : child_box(segs[0].data(), segs[0].size(), "moov", &size);
+  errors += !moov || !child_box(moov, size, "mvex", &size);
+  std::vector<uint8_t> dsi = {0x05, (uint8_t)asc_size};
+  dsi.insert(dsi.end(), asc, asc + asc_size);
+  errors += errors || std::search(segs[0].begin(), segs[0].end(), dsi.begin(), dsi.end()) ==
+                          segs[0].end();
+  const size_t n_frag = (aus.size() + per_fragment - 1) / per_fragment;
+  errors += segs.size() != 1 + n_frag;
+  size_t au = 0;
+  for (size_t i = 1; i < segs.size() && !errors; i++) {
+    const uint8_t* seg = segs[i].data();
+    size_t moof_size, traf_size, box;
+    const uint8_t* moof = child_box(seg, segs[i].size(), "moof", &moof_size);
+    const uint8_t* traf = moof ? child_box(moof, moof_size, "traf", &traf_size) : nullptr;
+    const uint8_t* mfhd = moof ? child_box(moof, moof_size, "mfhd", &box) : nullptr;
+    const uint8_t* tfhd = traf ? child_box(traf, traf_size, "tfhd", &box) : nullptr;
+    const uint8_t* tfdt = traf ? child_box(traf, traf_size, "tfdt", &box) : nullptr;
+    const uint8_t* trun = traf ? child_box(traf, traf_size, "trun", &box) : nullptr;
+    if (!mfhd || !tfhd || !tfdt || !trun) {
+      return errors + 1;
+    }
+    const uint32_t count = be32(trun + 4), offset = be32(trun + 8);
+    const uint8_t* mdat = seg + moof_size + 8;
+    errors += be32(mfhd + 4) != i || be32(tfhd + 8) != (uint32_t)fs ||
+              ((uint64_t)be32(tfdt + 4) << 32 | be32(tfdt + 8)) != au * fs ||
+              count != std::min<size_t>(per_fragment, aus.size() - au) ||
+              memcmp(mdat + 4, "mdat", 4) != 0 || be32(mdat) != segs[i].size() - moof_size - 8 ||
+              offset != moof_size + 16;
+    const uint8_t* data = seg + offset;
+    for (uint32_t k = 0; k < count && !errors; k++, au++) {
+      const uint32_t len = be32(trun + 12 + 4 * k);
+      errors += len != aus[au].size() || memcmp(data, aus[au].data(), len) != 0;
+      data += len;
+    }
+    errors += data != seg + segs[i].size();
+  }
+  return errors + (au != aus.size());
+}
+
+/* Encoder output muxed two ways: encoded into the fragments with raw
+ * transport, and written as ADTS frames whose headers are dropped. The
+ * fragments hold exactly the access units, and those of the ADTS stream
+ * decode as the ADTS stream does. */
+static int test_fmp4_muxer() {
+  const int n = 100, fragment_ms = 500;
+  int failures = 0;
+  for (AacObjectType aot : {AAC_AOT_LC, AAC_AOT_SBR}) {
+    const int rate = aot == AAC_AOT_LC ? 44100 : 48000, fs = aot == AAC_AOT_LC ? 1024 : 2048;
+    const int bitrate = aot == AAC_AOT_LC ? 128000 : 48000;
+    AacEncoderHandle enc[3];
+    for (auto& e : enc) {
+      e = aac_encoder_create(rate, 2, bitrate, aot, AAC_RC_CBR);
+    }
+    aac_encoder_set_transport(enc[0], AAC_TRANSPORT_RAW); /* muxed in place */
+    aac_encoder_set_transport(enc[1], AAC_TRANSPORT_RAW); /* the same, for reference */
+    uint8_t asc[16];
+    const int asc_size = aac_encoder_get_config(enc[0], asc, sizeof(asc));
+    std::vector<std::vector<uint8_t>> segs[2], raw, adts, payloads;
+    AacFmp4MuxerHandle mux[2];
+    for (int i = 0; i < 2; i++) {
+      mux[i] = aac_fmp4_muxer_create(asc, asc_size, bitrate, fragment_ms, collect_segment,
+                                     &segs[i]);
+    }
+    std::vector<float> pcm(2 * fs);
+    uint8_t frame[8192];
+    int errors = !mux[0] || !mux[1];
+    for (int f = 0; f < n && !errors; f++) {
+      for (int i = 0; i < fs; i++) {
+        float t = (float)(f * fs + i) / (float)rate;
+        pcm[i * 2] = 0.3f * sinf(2.0f * (float)M_PI * 440.0f * t);
+        pcm[i * 2 + 1] = 0.3f * sinf(2.0f * (float)M_PI * 660.0f * t);
+      }
+      errors += aac_fmp4_muxer_encode(mux[0], enc[0], pcm.data(), fs) != AAC_OK;
+      int len = aac_encoder_encode(enc[1], pcm.data(), fs, frame, sizeof(frame));
+      raw.emplace_back(frame, frame + len);
+      len = aac_encoder_encode(enc[2], pcm.data(), fs, frame, sizeof(frame));
+      adts.emplace_back(frame, frame + len);
+      payloads.emplace_back(frame + 7, frame + len);
+      errors += aac_fmp4_muxer_write(mux[1], frame, len) != AAC_OK;
+    }
+    for (int i = 0; i < 2; i++) {
+      errors += aac_fmp4_muxer_flush(mux[i]) != AAC_OK;
+      aac_fmp4_muxer_destroy(mux[i]);
+    }
+    for (auto& e : enc) {
+      aac_encoder_destroy(e);
+    }
+    const int per_fragment = (fragment_ms * rate / 1000 + fs / 2) / fs;
+    errors += check_fmp4(segs[0], raw, asc, asc_size, fs, per_fragment);
+    errors += check_fmp4(segs[1], payloads, asc, asc_size, fs, per_fragment);
+
+    AacDecoderHandle ref = aac_decoder_create(rate, 2), dec = aac_decoder_create(rate, 2);
+    errors += aac_decoder_set_config(dec, asc, asc_size) != AAC_OK;
+    std::vector<float> expect(2 * fs), got(2 * fs);
+    for (int f = 0; f < n && !errors; f++) {
+      const int a = aac_decoder_decode(ref, adts[f].data(), (int)adts[f].size(), expect.data(),
+                                       2 * fs);
+      const int b = aac_decoder_decode(dec, payloads[f].data(), (int)payloads[f].size(),
+                                       got.data(), 2 * fs);
+      errors += a != fs || b != fs || memcmp(expect.data(), got.data(), 2 * fs * 4) != 0;
+    }
+    aac_decoder_destroy(ref);
+    aac_decoder_destroy(dec);
+    printf("fMP4 muxer, %s: init %zu bytes, %zu fragments of %d access units, %d errors\n",
+           aot == AAC_AOT_LC ? "AAC-LC" : "HE-AAC", segs[0].empty() ? 0 : segs[0][0].size(),
+           segs[0].size() - 1, per_fragment, errors);
+    failures += errors != 0;
+  }
+  if (failures) {
+    printf("FAIL: fMP4 muxer\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* Hand-built AudioMuxElement with audioMuxVersion 1: ascLen with fill bits,
+ * otherData and a CRC, and two subframes in the element */
+static std::vector<uint8_t> latm_v1_frame(const AacAudioConfig* cfg,
+                                          const std::vector<uint8_t>& a,
+                                          const std::vector<uint8_t>& b) {
+  std::vector<uint8_t> frame(64 + a.size() + b.size());
+  AacBitWriter w;
+  aac_bitwriter_init(&w, frame.data() + 3, (int)frame.size() - 3);
+  aac_bitwriter_write(&w, 0, 1);     /* useSameStreamMux */
+  aac_bitwriter_write(&w, 2, 2);     /* audioMuxVersion 1, audioMuxVersionA 0 */
+  aac_bitwriter_write(&w, 0, 2);     /* taraBufferFullness: one byte */
+  aac_bitwriter_write(&w, 0xFF, 8);
+  aac_bitwriter_write(&w, 1, 1);     /* allStreamsSameTimeFraming */
+  aac_bitwriter_write(&w, 1, 6);     /* two subframes */
+  aac_bitwriter_write(&w, 0, 7);     /* one program, one layer */
+  uint8_t scratch[8];
+  AacBitWriter probe;
+  aac_bitwriter_init(&probe, scratch, sizeof(scratch));
+  aac_audio_config_put(cfg, &probe);
+  const int asc_bits = aac_bitwriter_bits_written(&probe);
+  aac_bitwriter_write(&w, 0, 2);     /* ascLen: one byte */
+  aac_bitwriter_write(&w, asc_bits + 5, 8);
+  aac_audio_config_put(cfg, &w);
+  aac_bitwriter_write(&w, 0, 5);     /* fill bits */
+  aac_bitwriter_write(&w, 0, 3);     /* frameLengthType */
+  aac_bitwriter_write(&w, 0xFF, 8);  /* latmBufferFullness */
+  aac_bitwriter_write(&w, 1, 1);     /* otherDataPresent */
+  aac_bitwriter_write(&w, 0, 2);     /* otherDataLenBits: one byte */
+  aac_bitwriter_write(&w, 0, 8);
+  aac_bitwriter_write(&w, 1, 1);     /* crcCheckPresent */
+  aac_bitwriter_write(&w, 0x5A, 8);
+  for (const auto* au : {&a, &b}) {
+    for (int n = (int)au->size();; n -= 255) {
+      aac_bitwriter_write(&w, std::min(n, 255), 8);
+      if (n < 255) {
+        break;
+      }
+    }
+    for (uint8_t byte : *au) {
+      aac_bitwriter_write(&w, byte, 8);
+    }
+  }
+  aac_bitwriter_byte_align(&w);
+  const int len = aac_bitwriter_bytes_written(&w);
+  frame[0] = 0x56;
+  frame[1] = (uint8_t)(0xE0 | (len >> 8));
+  frame[2] = (uint8_t)len;
+  frame.resize(3 + len);
+  return frame;
+}
+
+/* Encoder output written as LATM with a StreamMuxConfig every 4 frames and
+ * read back from random chunks, after garbage and from mid-stream: the
+ * reader skips elements until the first config and then hands out exactly
+ * the access units, which decode as the ADTS stream does. A version 1
+ * element with two subframes follows. */
+static int test_latm() {
+  uint32_t rng = 0x7F4A7C15u;
+  auto next_rand = [&rng]() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+  };
+  const int n = 60, interval = 4, skip = 2;
+  int failures = 0;
+  for (AacObjectType aot : {AAC_AOT_LC, AAC_AOT_SBR}) {
+    const int rate = aot == AAC_AOT_LC ? 44100 : 48000, fs = aot == AAC_AOT_LC ? 1024 : 2048;
+    const int bitrate = aot == AAC_AOT_LC ? 128000 : 32000;
+    AacEncoderHandle enc = aac_encoder_create(rate, 2, bitrate, aot, AAC_RC_CBR);
+    AacEncoderHandle ref_enc = aac_encoder_create(rate, 2, bitrate, aot, AAC_RC_CBR);
+    aac_encoder_set_transport(enc, AAC_TRANSPORT_RAW);
+    uint8_t asc[16];
+    const int asc_size = aac_encoder_get_config(enc, asc, sizeof(asc));
+    AacLatmWriterHandle wr = aac_latm_writer_create(asc, asc_size, interval);
+    std::vector<std::vector<uint8_t>> raw, adts;
+    std::vector<uint8_t> stream;
+    std::vector<float> pcm(2 * fs);
+    uint8_t frame[8192], loas[8192];
+    int64_t raw_bytes = 0, loas_bytes = 0;
+    int errors = !wr;
+    for (int i = 0; i < 97; i++) { /* garbage, with a stray syncword */
+      stream.push_back(i == 40 ? 0x56 : (uint8_t)next_rand());
+    }
+    for (int f = 0; f < n && !errors; f++) {
+      for (int i = 0; i < fs; i++) {
+        float t = (float)(f * fs + i) / (float)rate;
+        pcm[i * 2] = 0.3f * sinf(2.0f * (float)M_PI * 440.0f * t);
+        pcm[i * 2 + 1] = 0.3f * sinf(2.0f * (float)M_PI * 660.0f * t);
+      }
+      int len = aac_encoder_encode(enc, pcm.data(), fs, frame, sizeof(frame));
+      raw.emplace_back(frame, frame + len);
+      raw_bytes += len;
+      const int out = aac_latm_writer_write(wr, frame, len, loas, sizeof(loas));
+      errors += out <= 0;
+      if (f >= skip && out > 0) { /* the receiver joins late */
+        stream.insert(stream.end(), loas, loas + out);
+      }
+      loas_bytes += out;
+      len = aac_encoder_encode(ref_enc, pcm.data(), fs, frame, sizeof(frame));
+      adts.emplace_back(frame, frame + len);
+    }
+    aac_latm_writer_destroy(wr);
+    aac_encoder_destroy(enc);
+    aac_encoder_destroy(ref_enc);
+
+    AacLatmReaderHandle rd = aac_latm_reader_create();
+    AacDecoderHandle ref = aac_decoder_create(rate, 2), dec = aac_decoder_create(rate, 2);
+    std::vector<float> expect(2 * fs), got(2 * fs);
+    size_t pos = 0;
+    int au_count = 0, configs = 0;
+    const int first = (skip + interval - 1) / interval * interval;
+    const uint8_t* au;
+    int size;
+    for (bool eos = false; !eos && !errors;) {
+      const int take = std::min((int)(stream.size() - pos), 1 + (int)(next_rand() % 700));
+      eos = take == 0;
+      errors += aac_latm_reader_feed(rd, stream.data() + pos, take) != AAC_OK;
+      pos += take;
+      for (int ret; (ret = aac_latm_reader_next(rd, &au, &size)) > 0 && !errors;) {
+        const size_t f = first + au_count++;
+        if (ret == 2) {
+          uint8_t got_asc[64];
+          const int got_size = aac_latm_reader_config(rd, got_asc, sizeof(got_asc));
+          errors += got_size != asc_size || memcmp(got_asc, asc, asc_size) != 0 ||
+                    aac_decoder_set_config(dec, got_asc, got_size) != AAC_OK;
+          configs++;
+        }
+        if (f >= raw.size() || (size_t)size != raw[f].size() ||
+            memcmp(au, raw[f].data(), size) != 0) {
+          errors++;
+          break;
+        }
+        const int a = aac_decoder_decode(ref, adts[f].data(), (int)adts[f].size(),
+                                         expect.data(), 2 * fs);
+        const int b = aac_decoder_decode(dec, au, size, got.data(), 2 * fs);
+        errors += a != fs || b != fs || memcmp(expect.data(), got.data(), 2 * fs * 4) != 0;
+      }
+    }
+    const int64_t dropped = aac_latm_reader_dropped(rd);
+    errors += au_count != n - first || configs != 1 || dropped != first - skip;
+    aac_latm_reader_destroy(rd);
+    aac_decoder_destroy(ref);
+    aac_decoder_destroy(dec);
+
+    /* audioMuxVersion 1, two subframes */
+    AacAudioConfig cfg;
+    errors += aac_audio_config_parse(&cfg, asc, asc_size) != AAC_OK;
+    const std::vector<uint8_t> v1 = latm_v1_frame(&cfg, raw[0], raw[1]);
+    rd = aac_latm_reader_create();
+    errors += aac_latm_reader_feed(rd, v1.data(), (int)v1.size()) != AAC_OK;
+    int v1_count = aac_latm_reader_next(rd, &au, &size) == 0 ? 0 : -1;
+    errors += aac_latm_reader_feed(rd, nullptr, 0) != AAC_OK;
+    for (int ret; (ret = aac_latm_reader_next(rd, &au, &size)) > 0 && v1_count < 2;) {
+      errors += ret != (v1_count == 0 ? 2 : 1) || (size_t)size != raw[v1_count].size() ||
+                memcmp(au, raw[v1_count].data(), size) != 0;
+      v1_count++;
+    }
+    uint8_t v1_asc[64];
+    errors += v1_count != 2 || aac_latm_reader_config(rd, v1_asc, sizeof(v1_asc)) < asc_size ||
+              memcmp(v1_asc, asc, asc_size) != 0;
+    aac_latm_reader_destroy(rd);
+
+    printf("LATM, %s: %d access units from frame %d, %lld dropped, %.2f bytes of framing per "
+           "access unit, %d errors\n",
+           aot == AAC_AOT_LC ? "AAC-LC" : "HE-AAC", au_count, first, (long long)dropped,
+           (double)(loas_bytes - raw_bytes) / n, errors);
+    failures += errors != 0;
+  }
+  if (failures) {
+    printf("FAIL: LATM\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
 static int test_huffman_roundtrip() {
   int failures = 0;
-  /* Test codebooks 1-5 (populated) */
-  for (int cb = 1; cb <= 5; cb++) {
+  /* Every pair of every codebook: the unsigned books 7, 9 and 11 have
+   * codewords longer than 11 bits */
+  for (int cb = 1; cb <= AAC_NUM_CODEBOOKS; cb++) {
     if (!aac_huff_code[cb] || !aac_huff_len[cb]) {
       continue;
     }
     const AacCodebookInfo* info = &aac_codebook_info[cb];
     int mv = info->max_val;
+    int lo = info->is_unsigned ? 0 : -mv;
 
-    /* Test a few symbol pairs */
-    for (int x = 0; x <= mv && x < 3; x++) {
-      for (int y = 0; y <= mv && y < 3; y++) {
+    for (int x = lo; x <= mv; x++) {
+      for (int y = lo; y <= mv; y++) {
         uint8_t buf[16];
         AacBitWriter w;
         aac_bitwriter_init(&w, buf, sizeof(buf));
@@ -128,7 +1065,93 @@ static int test_huffman_roundtrip() {
       }
     }
   }
-  printf("Huffman roundtrip (codebooks 1-5): %d failures\n", failures);
+  printf("Huffman roundtrip (codebooks 1-11): %d failures\n", failures);
+  if (failures) {
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* The decoder's first-level table against the longest-match scan it
+ * stands in for: for every 16-bit peek in every codebook, a table entry
+ * names the codeword the scan finds and its length, and the decode takes
+ * the same pair and bits either way */
+static int test_huffman_lookup() {
+  int errors = 0, hits = 0;
+  for (int cb = 1; cb <= AAC_NUM_CODEBOOKS; cb++) {
+    if (!aac_huff_code[cb] || !aac_huff_len[cb]) {
+      continue;
+    }
+    const AacCodebookInfo* info = &aac_codebook_info[cb];
+    const int mv = info->max_val, dim = info->is_unsigned ? mv + 1 : 2 * mv + 1;
+    for (uint32_t peek = 0; peek < 65536; peek++) {
+      int idx = -1, len = 0;
+      for (int i = 0; i < aac_huff_count[cb]; i++) {
+        const int l = aac_huff_len[cb][i];
+        if (l > len && l <= 16 && peek >> (16 - l) == aac_huff_code[cb][i] >> (32 - l)) {
+          idx = i;
+          len = l;
+        }
+      }
+      const int hit = aac_huff_lookup[cb][peek >> (16 - AAC_HUFF_LOOKUP_BITS)];
+      if (hit) {
+        hits++;
+        errors += hit >> 5 != idx || (hit & 31) != len;
+      }
+      const uint8_t buf[4] = {(uint8_t)(peek >> 8), (uint8_t)peek, 0, 0};
+      AacBitReader r;
+      aac_bitreader_init(&r, buf, sizeof(buf));
+      int x, y;
+      const int ret = aac_bitreader_read_huffman(&r, cb, &x, &y);
+      if (idx < 0) {
+        errors += ret == AAC_OK;
+        continue;
+      }
+      const int off = info->is_unsigned ? 0 : mv;
+      errors += ret != AAC_OK || r.byte_pos * 8 + r.bit_pos != len || x != idx / dim - off ||
+                y != idx % dim - off;
+    }
+  }
+  printf("Huffman lookup (codebooks 1-11, every 16-bit peek): %d table hits, %d errors\n", hits,
+         errors);
+  if (errors) {
+    printf("FAIL: Huffman lookup differs from the codeword scan\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+static int test_golomb_roundtrip() {
+  uint8_t buf[512];
+  AacBitWriter w;
+  aac_bitwriter_init(&w, buf, sizeof(buf));
+  int expected_bits = 0;
+  for (int v = -100; v <= 100; v++) {
+    aac_bitwriter_write_golomb(&w, v);
+    expected_bits += aac_golomb_bits(v);
+  }
+  int failures = 0;
+  if (aac_bitwriter_bits_written(&w) != expected_bits) {
+    printf("FAIL: Exp-Golomb wrote %d bits, aac_golomb_bits sums to %d\n",
+           aac_bitwriter_bits_written(&w), expected_bits);
+    failures++;
+  }
+  if (aac_golomb_bits(0) != 1 || aac_golomb_bits(1) != 3 || aac_golomb_bits(-1) != 3) {
+    printf("FAIL: Exp-Golomb code lengths\n");
+    failures++;
+  }
+  AacBitReader r;
+  aac_bitreader_init(&r, buf, sizeof(buf));
+  for (int v = -100; v <= 100; v++) {
+    int got = aac_bitreader_read_golomb(&r);
+    if (got != v) {
+      printf("FAIL: Exp-Golomb wrote %d, read %d\n", v, got);
+      failures++;
+    }
+  }
+  printf("Exp-Golomb roundtrip: %d failures\n", failures);
   if (failures) {
     return 1;
   }
@@ -141,8 +1164,17 @@ int main() {
   int failures = 0;
   printf("=== Bitstream Tests ===\n\n");
   failures += test_bit_rw_roundtrip();
+  failures += test_bit_peek_skip();
   failures += test_adts_roundtrip();
+  failures += test_adts_framer();
+  failures += test_adts_index();
+  failures += test_adts_splicer();
+  failures += test_mp4_demuxer();
+  failures += test_fmp4_muxer();
+  failures += test_latm();
   failures += test_huffman_roundtrip();
+  failures += test_huffman_lookup();
+  failures += test_golomb_roundtrip();
   printf("=== %d test(s) failed ===\n", failures);
   return failures;
 }
@@ -1,40 +1,58 @@
 /*
- * FFT and MDCT roundtrip tests.
- * Verifies: FFT forward+inverse recovers input, MDCT forward+IMDCT recovers sine.
+ * FFT, MDCT and SBR QMF roundtrip tests.
+ * Verifies: FFT forward+inverse recovers input, MDCT forward+IMDCT recovers sine,
+ * the fast forward MDCT matches the direct one,
+ * QMF analysis+synthesis recovers noise.
  */
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <initializer_list>
 
 #include "aac_cpu.h"
 #include "aac_dsp.h"
 #include "aac_tables.h"
 #include "fft.h"
 #include "mdct.h"
+#include "psycho.h"
+#include "sbr.h"
+#include "spectral.h"
 
+/* Power-of-two and mixed-radix (AAC-LD 480) sizes: the forward transform
+ * matches a direct DFT and the inverse recovers the input */
 static int test_fft_roundtrip() {
-  int n = 1024;
-  float re[1024], im[1024], ref_re[1024], ref_im[1024];
-  for (int i = 0; i < n; i++) {
-    re[i] = sinf(2.0f * (float)M_PI * 440.0f * i / 44100.0f);
-    im[i] = 0;
-    ref_re[i] = re[i];
-    ref_im[i] = 0;
-  }
-  aac_fft_forward_c(re, im, n);
-  aac_fft_inverse_c(re, im, n);
+  for (int n : {1024, 480}) {
+    float re[1024], im[1024], ref_re[1024], ref_im[1024];
+    for (int i = 0; i < n; i++) {
+      re[i] = sinf(2.0f * (float)M_PI * 440.0f * i / 44100.0f);
+      im[i] = 0;
+      ref_re[i] = re[i];
+      ref_im[i] = 0;
+    }
+    aac_fft_forward_c(re, im, n);
+    float dft_err = 0;
+    for (int k = 0; k < n; k += 7) {
+      double sr = 0.0, si = 0.0;
+      for (int i = 0; i < n; i++) {
+        sr += ref_re[i] * cos(2.0 * M_PI * k * i / n);
+        si -= ref_re[i] * sin(2.0 * M_PI * k * i / n);
+      }
+      dft_err = fmaxf(dft_err, fmaxf(fabsf(re[k] - (float)sr), fabsf(im[k] - (float)si)));
+    }
+    aac_fft_inverse_c(re, im, n);
 
-  float max_err = 0;
-  for (int i = 0; i < n; i++) {
-    float err = fabsf(re[i] - ref_re[i]);
-    if (err > max_err) {
-      max_err = err;
+    float max_err = 0;
+    for (int i = 0; i < n; i++) {
+      float err = fabsf(re[i] - ref_re[i]);
+      if (err > max_err) {
+        max_err = err;
+      }
+    }
+    printf("FFT roundtrip (n=%d): max error = %e, vs DFT %e\n", n, max_err, dft_err);
+    if (max_err > 1e-5f || dft_err > 1e-3f) {
+      printf("FAIL: FFT roundtrip error too large\n");
+      return 1;
     }
-  }
-  printf("FFT roundtrip (n=%d): max error = %e\n", n, max_err);
-  if (max_err > 1e-5f) {
-    printf("FAIL: FFT roundtrip error too large\n");
-    return 1;
   }
   printf("PASS\n\n");
   return 0;
@@ -73,6 +91,48 @@ static int test_mdct_roundtrip() {
   return 0;
 }
 
+/* The encoder's fold + DCT-IV path agrees with the direct AAC MDCT for
+ * long, short-length and AAC-LD frames, over consecutive frames so the
+ * overlap carries, under both window shapes */
+static int test_mdct_forward_fast() {
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  for (int n : {1024, 128, 512, 480}) {
+    for (AacWindowShape shape : {AAC_WIN_SINE, AAC_WIN_KBD}) {
+      AacMdctContext direct, fast;
+      aac_mdct_init(&direct, n, &dsp);
+      aac_mdct_init(&fast, n, &dsp);
+      float in[1024], ref[1024], out[1024];
+      float max_err = 0, peak = 0;
+      uint32_t seed = 1;
+      for (int f = 0; f < 3; f++) {
+        for (int i = 0; i < n; i++) {
+          seed = seed * 1664525u + 1013904223u;
+          const int t = f * n + i;
+          in[i] = 0.5f * sinf(2.0f * (float)M_PI * 997.0f * (float)t / 48000.0f) +
+                  0.1f * ((float)(seed >> 8) / 8388608.0f - 1.0f);
+        }
+        aac_mdct_forward_aac(&direct, ref, in, n, AAC_WIN_ONLY_LONG, shape, 0);
+        aac_mdct_forward_fast(&fast, out, in, n, AAC_WIN_ONLY_LONG, shape, 0);
+        for (int k = 0; k < n; k++) {
+          max_err = fmaxf(max_err, fabsf(out[k] - ref[k]));
+          peak = fmaxf(peak, fabsf(ref[k]));
+        }
+      }
+      aac_mdct_free(&direct);
+      aac_mdct_free(&fast);
+      printf("MDCT fast vs direct (n=%d, %s): max error = %e of peak %e\n", n,
+             shape == AAC_WIN_SINE ? "sine" : "kbd/low-overlap", max_err, peak);
+      if (peak < 1e-3f || max_err > 1e-4f * peak) {
+        printf("FAIL: fast MDCT differs from the direct MDCT\n");
+        return 1;
+      }
+    }
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
 static int test_dsp_dispatch() {
   AacDSP dsp;
   aac_dsp_init(&dsp);
@@ -234,14 +294,649 @@ static int test_all_mdct_rotations() {
   return failures;
 }
 
+/* ── Psycho spreading dispatch ──────────────────────────────────
+ * The banded kernel from aac_psycho_init is run through every compiled
+ * backend and compared against the full (untruncated) spreading sum.
+ * Truncation drops taps below AAC_PSY_SPREAD_FLOOR, so the relative
+ * error must stay within a few multiples of that floor.
+ */
+static int test_psycho_spreading_dispatch(int forced_flags, const char* label) {
+  aac_set_cpu_flags_override(forced_flags);
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+
+  static AacPsychoState ps;
+  aac_psycho_init(&ps, 44100, 1024, &dsp);
+  int nb = ps.num_bands;
+
+  float* energy = ps.energy_pad + AAC_PSY_SPREAD_PAD;
+  for (int b = 0; b < nb; b++) {
+    energy[b] = 1.0f + 0.5f * sinf(0.37f * (float)b) + (b % 7 == 0 ? 40.0f : 0.0f);
+  }
+  float spread[49];
+  dsp.psycho_spreading(spread, energy, ps.spread_kernel, ps.spread_radius, nb);
+
+  float max_rel = 0.0f;
+  for (int b = 0; b < nb; b++) {
+    float ref = 0.0f;
+    for (int j = 0; j < nb; j++) {
+      int d = b - j;
+      float db = (d >= 0) ? -27.0f * (float)d : 27.0f * (float)d - 6.0f;
+      ref += energy[j] * powf(10.0f, db / 10.0f);
+    }
+    float rel = fabsf(spread[b] - ref) / ref;
+    if (rel > max_rel) {
+      max_rel = rel;
+    }
+  }
+  aac_set_cpu_flags_override(-1);
+
+  printf("Psycho spreading %s (radius=%d, nb=%d): max rel err = %e\n", label, ps.spread_radius,
+         nb, max_rel);
+  if (ps.spread_radius < 1 || ps.spread_radius > AAC_PSY_SPREAD_MAX_RADIUS || max_rel > 1e-4f) {
+    printf("FAIL: banded spreading mismatch\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int test_all_psycho_spreading() {
+  int failures = 0;
+  failures += test_psycho_spreading_dispatch(0, "scalar");
+#if defined(BAAC_AAC_SSE2)
+  failures += test_psycho_spreading_dispatch(AAC_CPU_FLAG_SSE2, "SSE2-only");
+#endif
+#if defined(BAAC_AAC_AVX2)
+  failures += test_psycho_spreading_dispatch(
+      AAC_CPU_FLAG_SSE2 | AAC_CPU_FLAG_AVX | AAC_CPU_FLAG_AVX2 | AAC_CPU_FLAG_FMA3, "AVX2+FMA3");
+#endif
+  if (!failures) {
+    printf("PASS\n\n");
+  }
+  return failures;
+}
+
+/* Zero check must agree with the scalar definition for every position of a
+ * single non-zero element (vector body and tail), and accept -0.0f */
+static int test_vector_is_zero_dispatch(int forced_flags, const char* label) {
+  aac_set_cpu_flags_override(forced_flags);
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  aac_set_cpu_flags_override(-1);
+
+  float buf[1031];
+  int errors = 0;
+  for (int i = 0; i < 1031; i++) {
+    buf[i] = (i % 3 == 0) ? -0.0f : 0.0f;
+  }
+  errors += dsp.vector_is_zero(buf, 1031) != 1;
+  for (int pos = 0; pos < 1031; pos++) {
+    float saved = buf[pos];
+    buf[pos] = (pos & 1) ? 1e-30f : -3.0f;
+    errors += dsp.vector_is_zero(buf, 1031) != 0;
+    errors += dsp.vector_is_zero(buf, pos) != 1;
+    buf[pos] = saved;
+  }
+  printf("Vector zero check %s: %d mismatches\n", label, errors);
+  if (errors) {
+    printf("FAIL: vector_is_zero mismatch\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int test_all_vector_is_zero() {
+  int failures = 0;
+  failures += test_vector_is_zero_dispatch(0, "scalar");
+#if defined(BAAC_AAC_SSE2)
+  failures += test_vector_is_zero_dispatch(AAC_CPU_FLAG_SSE2, "SSE2-only");
+#endif
+#if defined(BAAC_AAC_AVX2)
+  failures += test_vector_is_zero_dispatch(
+      AAC_CPU_FLAG_SSE2 | AAC_CPU_FLAG_AVX | AAC_CPU_FLAG_AVX2 | AAC_CPU_FLAG_FMA3, "AVX2+FMA3");
+#endif
+  if (!failures) {
+    printf("PASS\n\n");
+  }
+  return failures;
+}
+
+/* TNS kernels against the scalar head loops for every order and lengths
+ * that exercise the vector body and tail, plus FIR→IIR inversion */
+static int test_tns_filter_dispatch(int forced_flags, const char* label) {
+  aac_set_cpu_flags_override(forced_flags);
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  aac_set_cpu_flags_override(-1);
+
+  float src[300], ref[300], out[300], lpc[AAC_TNS_MAX_ORDER];
+  const int lens[] = {1, 7, 33, 300};
+  float max_err = 0.0f, max_inv = 0.0f;
+  for (int order = 1; order <= AAC_TNS_MAX_ORDER; order++) {
+    for (int k = 0; k < order; k++) {
+      lpc[k] = 0.6f * powf(-0.7f, (float)(k + 1)) / (float)(k + 1);
+    }
+    for (int len : lens) {
+      for (int i = 0; i < len; i++) {
+        src[i] = sinf(0.11f * (float)(i * order)) + (i % 13 == 0 ? 2.0f : 0.0f);
+      }
+      aac_tns_fir_head(ref, src, len, lpc, order);
+      dsp.tns_fir(out, src, len, lpc, order);
+      for (int i = 0; i < len; i++) {
+        max_err = fmaxf(max_err, fabsf(out[i] - ref[i]));
+      }
+      memcpy(ref, out, len * sizeof(float));
+      aac_tns_iir_head(ref, len, lpc, order);
+      dsp.tns_iir(out, len, lpc, order);
+      for (int i = 0; i < len; i++) {
+        max_err = fmaxf(max_err, fabsf(out[i] - ref[i]));
+        max_inv = fmaxf(max_inv, fabsf(out[i] - src[i]));
+      }
+    }
+  }
+  printf("TNS filters %s: max err = %e, inverse err = %e\n", label, max_err, max_inv);
+  if (max_err > 1e-4f || max_inv > 1e-4f) {
+    printf("FAIL: TNS filter mismatch\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int test_all_tns_filters() {
+  int failures = 0;
+  failures += test_tns_filter_dispatch(0, "scalar");
+#if defined(BAAC_AAC_SSE2)
+  failures += test_tns_filter_dispatch(AAC_CPU_FLAG_SSE2, "SSE2-only");
+#endif
+#if defined(BAAC_AAC_AVX2)
+  failures += test_tns_filter_dispatch(
+      AAC_CPU_FLAG_SSE2 | AAC_CPU_FLAG_AVX | AAC_CPU_FLAG_AVX2 | AAC_CPU_FLAG_FMA3, "AVX2+FMA3");
+#endif
+  if (!failures) {
+    printf("PASS\n\n");
+  }
+  return failures;
+}
+
+/* Encoder analysis → bitstream → decoder synthesis for long and short
+ * windows; the filtered spectrum must come back unchanged */
+static int test_tns_syntax_roundtrip() {
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  const int seqs[] = {AAC_WIN_ONLY_LONG, AAC_WIN_EIGHT_SHORT};
+  int failures = 0;
+  for (int ws : seqs) {
+    int win_len = ws == AAC_WIN_EIGHT_SHORT ? 128 : 1024;
+    float spec[1024], orig[1024];
+    /* An impulse in time is a cosine across frequency: highly predictable */
+    for (int i = 0; i < 1024; i++) {
+      int k = i % win_len;
+      float pos = (float)(i / win_len + 1) * 0.1f * (float)win_len;
+      spec[i] = cosf((float)M_PI / (float)win_len * (pos + 0.5f + (float)win_len / 2) *
+                     ((float)k + 0.5f)) +
+                0.01f * sinf(1.7f * (float)i);
+    }
+    memcpy(orig, spec, sizeof(spec));
+    int max_sfb = ws == AAC_WIN_EIGHT_SHORT ? aac_num_sfb_short[4] : aac_num_sfb_long[4];
+    AacTnsInfo enc = {}, dec = {};
+    int any = aac_tns_encode(&enc, spec, max_sfb, 4, 1024, ws, AAC_TNS_MAX_FILTERS_LONG, &dsp);
+
+    uint8_t buf[512] = {};
+    AacBitWriter w;
+    aac_bitwriter_init(&w, buf, sizeof(buf));
+    aac_tns_write(&w, &enc, ws);
+    AacBitReader r;
+    aac_bitreader_init(&r, buf, sizeof(buf));
+    int rd = aac_tns_read(&r, &dec, ws);
+    aac_tns_decode(&dec, spec, max_sfb, 4, 1024, ws, &dsp);
+
+    float max_err = 0.0f;
+    for (int i = 0; i < 1024; i++) {
+      max_err = fmaxf(max_err, fabsf(spec[i] - orig[i]));
+    }
+    int bits = aac_bitwriter_bits_written(&w);
+    int read = (int)sizeof(buf) * 8 - aac_bitreader_bits_left(&r);
+    printf("TNS %s: filters=%d, side info=%d bits, max err = %e\n",
+           ws == AAC_WIN_EIGHT_SHORT ? "short" : "long", enc.n_filt[0], bits, max_err);
+    if (!any || rd != AAC_OK || read != bits || aac_tns_bits(&enc, ws) != bits ||
+        max_err > 1e-4f) {
+      printf("FAIL: TNS roundtrip\n");
+      failures++;
+    }
+  }
+  if (!failures) {
+    printf("PASS\n\n");
+  }
+  return failures;
+}
+
+/* QMF banks through every compiled backend: analysis against the direct
+ * modulation sum, then analysis+synthesis must return the input delayed by
+ * 9 * bands samples */
+static int test_sbr_qmf_dispatch(int forced_flags, const char* label) {
+  aac_set_cpu_flags_override(forced_flags);
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  aac_set_cpu_flags_override(-1);
+
+  int failures = 0;
+  const int sizes[] = {32, 64};
+  for (int M : sizes) {
+    static AacSbrQmfBank ana, syn;
+    aac_sbr_qmf_init(&ana, M, &dsp);
+    aac_sbr_qmf_init(&syn, M, &dsp);
+    const int L = 10 * M, slots = 32, frames = 3, n = frames * slots * M;
+    static float x[3 * 32 * 64], y[3 * 32 * 64];
+    static float re[32][AAC_SBR_QMF_BANDS], im[32][AAC_SBR_QMF_BANDS];
+    uint32_t seed = 0x2545F491u;
+    for (int i = 0; i < n; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      x[i] = (float)(seed >> 8) / 8388608.0f - 1.0f + 0.5f * sinf(0.05f * (float)i);
+    }
+    /* The 32-band prototype sums tap pairs of the 64-band one */
+    double proto[AAC_SBR_QMF_FILTER_LENGTH], energy = 0.0;
+    int step = AAC_SBR_QMF_FILTER_LENGTH / L;
+    for (int t = 0; t < L; t++) {
+      proto[t] = 0.0;
+      for (int j = 0; j < step; j++) {
+        proto[t] += aac_sbr_qmf_window[t * step + j];
+      }
+      energy += proto[t] * proto[t];
+    }
+    float max_err = 0.0f;
+    for (int f = 0; f < frames; f++) {
+      aac_sbr_qmf_analysis(&ana, x + f * slots * M, re, im, slots);
+      if (f == 1) {
+        for (int sl = 0; sl < slots; sl += 7) {
+          int t0 = (f * slots + sl) * M + M - 1;
+          for (int k = 0; k < M; k++) {
+            double ref_re = 0.0, ref_im = 0.0;
+            for (int t = 0; t < L; t++) {
+              double ph = M_PI * (k + 0.5) * (t - (L - 1) / 2.0) / M;
+              double v = proto[t] / sqrt(energy) * x[t0 - t];
+              ref_re += v * cos(ph);
+              ref_im -= v * sin(ph);
+            }
+            max_err = fmaxf(max_err, (float)fabs(ref_re - re[sl][k]));
+            max_err = fmaxf(max_err, (float)fabs(ref_im - im[sl][k]));
+          }
+        }
+      }
+      aac_sbr_qmf_synthesis(&syn, re, im, y + f * slots * M, slots);
+    }
+    double sig = 0.0, err = 0.0;
+    for (int i = 10 * M; i < n; i++) {
+      double d = y[i] - x[i - 9 * M];
+      sig += (double)x[i - 9 * M] * x[i - 9 * M];
+      err += d * d;
+    }
+    double snr = 10.0 * log10(sig / err);
+    printf("SBR QMF %s %d bands: analysis err = %e, reconstruction SNR = %.1f dB\n", label, M,
+           max_err, snr);
+    if (max_err > 1e-4f || snr < 45.0) {
+      printf("FAIL: QMF mismatch\n");
+      failures++;
+    }
+  }
+  return failures;
+}
+
+static int test_all_sbr_qmf() {
+  int failures = 0;
+  failures += test_sbr_qmf_dispatch(0, "scalar");
+#if defined(BAAC_AAC_SSE2)
+  failures += test_sbr_qmf_dispatch(AAC_CPU_FLAG_SSE2, "SSE2-only");
+#endif
+#if defined(BAAC_AAC_AVX2)
+  failures += test_sbr_qmf_dispatch(
+      AAC_CPU_FLAG_SSE2 | AAC_CPU_FLAG_AVX | AAC_CPU_FLAG_AVX2 | AAC_CPU_FLAG_FMA3, "AVX2+FMA3");
+#endif
+  if (!failures) {
+    printf("PASS\n\n");
+  }
+  return failures;
+}
+
+/* SBR HF generator and gain kernels through every compiled backend against
+ * the complex prediction / gain formulas, at widths that exercise the
+ * vector body and the tail */
+static int test_sbr_hf_dispatch(int forced_flags, const char* label) {
+  aac_set_cpu_flags_override(forced_flags);
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  aac_set_cpu_flags_override(-1);
+
+  const int S = AAC_SBR_QMF_BANDS, slots = 6;
+  static float lo_re[2 + 6][AAC_SBR_QMF_BANDS], lo_im[2 + 6][AAC_SBR_QMF_BANDS];
+  static float hi_re[6][AAC_SBR_QMF_BANDS], hi_im[6][AAC_SBR_QMF_BANDS];
+  float a0_re[64], a0_im[64], a1_re[64], a1_im[64];
+  float y_re[64], y_im[64], ref_re[64], ref_im[64], gain[64], q[64], nz_re[64], nz_im[64];
+  for (int m = 0; m < 2 + slots; m++) {
+    for (int k = 0; k < S; k++) {
+      lo_re[m][k] = sinf(0.37f * (float)(m * S + k));
+      lo_im[m][k] = cosf(0.23f * (float)(m * S + k) + 1.0f);
+    }
+  }
+  for (int k = 0; k < 64; k++) {
+    a0_re[k] = 0.5f * sinf(0.3f * (float)k);
+    a0_im[k] = -0.4f * cosf(0.2f * (float)k);
+    a1_re[k] = 0.2f * cosf(0.7f * (float)k);
+    a1_im[k] = 0.1f * sinf(0.9f * (float)k);
+    gain[k] = 0.5f + 0.01f * (float)k;
+    q[k] = 0.1f * (float)(k % 5);
+    nz_re[k] = sinf(1.7f * (float)k);
+    nz_im[k] = cosf(2.3f * (float)k);
+  }
+  const int widths[] = {1, 5, 13, 32};
+  float max_err = 0.0f;
+  for (int n : widths) {
+    dsp.sbr_hf_gen(hi_re[0], hi_im[0], lo_re[2], lo_im[2], a0_re, a0_im, a1_re, a1_im, n,
+                   slots);
+    for (int m = 0; m < slots; m++) {
+      for (int k = 0; k < n; k++) {
+        double r = lo_re[m + 2][k], i = lo_im[m + 2][k];
+        r += (double)a0_re[k] * lo_re[m + 1][k] - (double)a0_im[k] * lo_im[m + 1][k];
+        i += (double)a0_re[k] * lo_im[m + 1][k] + (double)a0_im[k] * lo_re[m + 1][k];
+        r += (double)a1_re[k] * lo_re[m][k] - (double)a1_im[k] * lo_im[m][k];
+        i += (double)a1_re[k] * lo_im[m][k] + (double)a1_im[k] * lo_re[m][k];
+        max_err = fmaxf(max_err, (float)fabs(r - hi_re[m][k]));
+        max_err = fmaxf(max_err, (float)fabs(i - hi_im[m][k]));
+      }
+    }
+    for (int k = 0; k < n; k++) {
+      y_re[k] = hi_re[1][k];
+      y_im[k] = hi_im[1][k];
+      ref_re[k] = gain[k] * y_re[k] + q[k] * nz_re[k];
+      ref_im[k] = gain[k] * y_im[k] + q[k] * nz_im[k];
+    }
+    dsp.sbr_hf_apply(y_re, y_im, gain, q, nz_re, nz_im, n);
+    for (int k = 0; k < n; k++) {
+      max_err = fmaxf(max_err, fabsf(y_re[k] - ref_re[k]));
+      max_err = fmaxf(max_err, fabsf(y_im[k] - ref_im[k]));
+    }
+  }
+  printf("SBR HF %s: max err = %e\n", label, max_err);
+  if (max_err > 1e-5f) {
+    printf("FAIL: SBR HF kernel mismatch\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int test_all_sbr_hf() {
+  int failures = 0;
+  failures += test_sbr_hf_dispatch(0, "scalar");
+#if defined(BAAC_AAC_SSE2)
+  failures += test_sbr_hf_dispatch(AAC_CPU_FLAG_SSE2, "SSE2-only");
+#endif
+#if defined(BAAC_AAC_AVX2)
+  failures += test_sbr_hf_dispatch(
+      AAC_CPU_FLAG_SSE2 | AAC_CPU_FLAG_AVX | AAC_CPU_FLAG_AVX2 | AAC_CPU_FLAG_FMA3, "AVX2+FMA3");
+#endif
+  if (!failures) {
+    printf("PASS\n\n");
+  }
+  return failures;
+}
+
+/* PS mixing kernel through every compiled backend: several interpolated
+ * slots against a double-precision reference, at widths with a tail */
+static int test_ps_mix_dispatch(int forced_flags, const char* label) {
+  aac_set_cpu_flags_override(forced_flags);
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  aac_set_cpu_flags_override(-1);
+
+  const int widths[] = {1, 7, 73};
+  float max_err = 0.0f;
+  for (int n : widths) {
+    float l_re[73], l_im[73], r_re[73], r_im[73], h[4 * 73], step[4 * 73];
+    double ref_h[4 * 73];
+    for (int i = 0; i < 4 * n; i++) {
+      h[i] = 0.8f * sinf(0.7f * (float)i);
+      step[i] = 0.01f * cosf(0.3f * (float)i);
+      ref_h[i] = h[i];
+    }
+    for (int slot = 0; slot < 4; slot++) {
+      double ref[4][73];
+      for (int k = 0; k < n; k++) {
+        l_re[k] = sinf(0.11f * (float)(k + 5 * slot));
+        l_im[k] = cosf(0.17f * (float)(k + 3 * slot));
+        r_re[k] = sinf(0.23f * (float)(k * slot + 1));
+        r_im[k] = cosf(0.29f * (float)(k + slot));
+        double hk[4];
+        for (int i = 0; i < 4; i++) {
+          hk[i] = ref_h[i * n + k] += step[i * n + k];
+        }
+        ref[0][k] = hk[0] * l_re[k] + hk[2] * r_re[k];
+        ref[1][k] = hk[0] * l_im[k] + hk[2] * r_im[k];
+        ref[2][k] = hk[1] * l_re[k] + hk[3] * r_re[k];
+        ref[3][k] = hk[1] * l_im[k] + hk[3] * r_im[k];
+      }
+      dsp.ps_mix(l_re, l_im, r_re, r_im, h, step, n);
+      for (int k = 0; k < n; k++) {
+        max_err = fmaxf(max_err, (float)fabs(ref[0][k] - l_re[k]));
+        max_err = fmaxf(max_err, (float)fabs(ref[1][k] - l_im[k]));
+        max_err = fmaxf(max_err, (float)fabs(ref[2][k] - r_re[k]));
+        max_err = fmaxf(max_err, (float)fabs(ref[3][k] - r_im[k]));
+      }
+    }
+    for (int i = 0; i < 4 * n; i++) {
+      max_err = fmaxf(max_err, (float)fabs(ref_h[i] - h[i]));
+    }
+  }
+  printf("PS mix %s: max err = %e\n", label, max_err);
+  if (max_err > 1e-5f) {
+    printf("FAIL: PS mix mismatch\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int test_all_ps_mix() {
+  int failures = 0;
+  failures += test_ps_mix_dispatch(0, "scalar");
+#if defined(BAAC_AAC_SSE2)
+  failures += test_ps_mix_dispatch(AAC_CPU_FLAG_SSE2, "SSE2-only");
+#endif
+#if defined(BAAC_AAC_AVX2)
+  failures += test_ps_mix_dispatch(
+      AAC_CPU_FLAG_SSE2 | AAC_CPU_FLAG_AVX | AAC_CPU_FLAG_AVX2 | AAC_CPU_FLAG_FMA3, "AVX2+FMA3");
+#endif
+  if (!failures) {
+    printf("PASS\n\n");
+  }
+  return failures;
+}
+
+/* PS encoder statistics through every compiled backend: several slots
+ * accumulated against a double-precision reference, at widths with a tail */
+static int test_ps_correlate_dispatch(int forced_flags, const char* label) {
+  aac_set_cpu_flags_override(forced_flags);
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  aac_set_cpu_flags_override(-1);
+
+  const int widths[] = {1, 7, 64};
+  float max_err = 0.0f;
+  for (int n : widths) {
+    float el[64] = {0}, er[64] = {0}, cr[64] = {0};
+    double ref[3][64] = {};
+    for (int slot = 0; slot < 8; slot++) {
+      float l_re[64], l_im[64], r_re[64], r_im[64];
+      for (int k = 0; k < n; k++) {
+        l_re[k] = sinf(0.11f * (float)(k + 5 * slot));
+        l_im[k] = cosf(0.17f * (float)(k + 3 * slot));
+        r_re[k] = sinf(0.23f * (float)(k * slot + 1));
+        r_im[k] = cosf(0.29f * (float)(k + slot));
+        ref[0][k] += (double)l_re[k] * l_re[k] + (double)l_im[k] * l_im[k];
+        ref[1][k] += (double)r_re[k] * r_re[k] + (double)r_im[k] * r_im[k];
+        ref[2][k] += (double)l_re[k] * r_re[k] + (double)l_im[k] * r_im[k];
+      }
+      dsp.ps_correlate(el, er, cr, l_re, l_im, r_re, r_im, n);
+    }
+    for (int k = 0; k < n; k++) {
+      max_err = fmaxf(max_err, (float)fabs(ref[0][k] - el[k]));
+      max_err = fmaxf(max_err, (float)fabs(ref[1][k] - er[k]));
+      max_err = fmaxf(max_err, (float)fabs(ref[2][k] - cr[k]));
+    }
+  }
+  printf("PS correlate %s: max err = %e\n", label, max_err);
+  if (max_err > 1e-5f) {
+    printf("FAIL: PS correlate mismatch\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int test_all_ps_correlate() {
+  int failures = 0;
+  failures += test_ps_correlate_dispatch(0, "scalar");
+#if defined(BAAC_AAC_SSE2)
+  failures += test_ps_correlate_dispatch(AAC_CPU_FLAG_SSE2, "SSE2-only");
+#endif
+#if defined(BAAC_AAC_AVX2)
+  failures += test_ps_correlate_dispatch(
+      AAC_CPU_FLAG_SSE2 | AAC_CPU_FLAG_AVX | AAC_CPU_FLAG_AVX2 | AAC_CPU_FLAG_FMA3, "AVX2+FMA3");
+#endif
+  if (!failures) {
+    printf("PASS\n\n");
+  }
+  return failures;
+}
+
+/* PCM output kernels through every compiled backend, bit-exact against the
+ * scalar formulas: interleave at widths with a tail, and integer conversion
+ * of ramps with exact .5 ties, clipping, NaN and dither */
+static int test_pcm_output_dispatch(int forced_flags, const char* label) {
+  aac_set_cpu_flags_override(forced_flags);
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  aac_set_cpu_flags_override(-1);
+
+  const int widths[] = {1, 7, 37, 1024};
+  int mismatches = 0;
+  for (int n : widths) {
+    float l[1024], r[1024], out[2048], dither[1024];
+    int16_t s16[1024];
+    int32_t s24[1024];
+    for (int i = 0; i < n; i++) {
+      l[i] = 1.5f * sinf(0.013f * (float)i);
+      r[i] = (float)(i - n / 2) / 32768.0f + 0.5f / 32768.0f; /* every sample a tie */
+      dither[i] = cosf(0.7f * (float)i);
+    }
+    l[n / 2] = NAN;
+    dsp.interleave2(out, l, r, n);
+    for (int i = 0; i < n; i++) {
+      mismatches += memcmp(&out[2 * i], &l[i], 4) != 0 || out[2 * i + 1] != r[i];
+    }
+    for (const float* src : {l, r}) {
+      for (const float* d : {(const float*)nullptr, (const float*)dither}) {
+        dsp.float_to_s16(s16, src, d, n);
+        dsp.float_to_s24(s24, src, d, n);
+        for (int i = 0; i < n; i++) {
+          float v16 = src[i] * 32768.0f + (d ? d[i] : 0.0f);
+          float v24 = src[i] * 8388608.0f + (d ? d[i] : 0.0f);
+          mismatches += s16[i] != (int16_t)lrintf(fminf(fmaxf(v16, -32768.0f), 32767.0f));
+          mismatches += s24[i] != (int32_t)lrintf(fminf(fmaxf(v24, -8388608.0f), 8388607.0f));
+        }
+      }
+    }
+  }
+  printf("PCM output %s: %d mismatches\n", label, mismatches);
+  if (mismatches != 0) {
+    printf("FAIL: PCM output mismatch\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int test_all_pcm_output() {
+  int failures = 0;
+  failures += test_pcm_output_dispatch(0, "scalar");
+#if defined(BAAC_AAC_SSE2)
+  failures += test_pcm_output_dispatch(AAC_CPU_FLAG_SSE2, "SSE2-only");
+#endif
+#if defined(BAAC_AAC_AVX2)
+  failures += test_pcm_output_dispatch(
+      AAC_CPU_FLAG_SSE2 | AAC_CPU_FLAG_AVX | AAC_CPU_FLAG_AVX2 | AAC_CPU_FLAG_FMA3, "AVX2+FMA3");
+#endif
+  if (!failures) {
+    printf("PASS\n\n");
+  }
+  return failures;
+}
+
+/* ADTS sync search through every compiled backend against a direct scan:
+ * one planted syncword at every offset of buffers with vector-width tails,
+ * among near misses (0xFF followed by a wrong layer or a 0xE nibble) */
+static int test_adts_sync_dispatch(int forced_flags, const char* label) {
+  aac_set_cpu_flags_override(forced_flags);
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  aac_set_cpu_flags_override(-1);
+
+  int mismatches = 0;
+  uint8_t buf[200];
+  for (int size : {0, 1, 2, 16, 17, 33, 64, 65, 100, 200}) {
+    for (int at = -1; at < size; at++) {
+      for (int i = 0; i < size; i++) {
+        buf[i] = (i % 3 == 0) ? 0xFF : (i % 3 == 1 ? 0xF2 : 0xE0); /* FF F2, F2 E0, E0 FF */
+      }
+      if (at >= 0 && at + 1 < size) {
+        buf[at] = 0xFF;
+        buf[at + 1] = 0xF1;
+      }
+      int expect = -1;
+      for (int i = 0; i + 1 < size && expect < 0; i++) {
+        expect = buf[i] == 0xFF && (buf[i + 1] & 0xF6) == 0xF0 ? i : -1;
+      }
+      mismatches += dsp.adts_sync(buf, size) != expect;
+    }
+  }
+  printf("ADTS sync %s: %d mismatches\n", label, mismatches);
+  if (mismatches != 0) {
+    printf("FAIL: ADTS sync mismatch\n");
+    return 1;
+  }
+  return 0;
+}
+
+static int test_all_adts_sync() {
+  int failures = 0;
+  failures += test_adts_sync_dispatch(0, "scalar");
+#if defined(BAAC_AAC_SSE2)
+  failures += test_adts_sync_dispatch(AAC_CPU_FLAG_SSE2, "SSE2-only");
+#endif
+#if defined(BAAC_AAC_AVX2)
+  failures += test_adts_sync_dispatch(
+      AAC_CPU_FLAG_SSE2 | AAC_CPU_FLAG_AVX | AAC_CPU_FLAG_AVX2 | AAC_CPU_FLAG_FMA3, "AVX2+FMA3");
+#endif
+  if (!failures) {
+    printf("PASS\n\n");
+  }
+  return failures;
+}
+
 int main() {
   aac_tables_init();
   int failures = 0;
   printf("=== MDCT/FFT Tests ===\n\n");
   failures += test_fft_roundtrip();
   failures += test_mdct_roundtrip();
+  failures += test_mdct_forward_fast();
   failures += test_dsp_dispatch();
   failures += test_all_mdct_rotations();
+  failures += test_all_psycho_spreading();
+  failures += test_all_vector_is_zero();
+  failures += test_all_tns_filters();
+  failures += test_tns_syntax_roundtrip();
+  failures += test_all_sbr_qmf();
+  failures += test_all_sbr_hf();
+  failures += test_all_ps_mix();
+  failures += test_all_ps_correlate();
+  failures += test_all_pcm_output();
+  failures += test_all_adts_sync();
   printf("=== %d test(s) failed ===\n", failures);
   return failures;
 }
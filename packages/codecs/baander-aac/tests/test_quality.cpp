@@ -5,12 +5,16 @@
  *   Frame 1 primes overlap, Frame 2 reconstructs pcm[0..1023],
  *   Frame 3 reconstructs pcm[1024..2047] (measured).
  */
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <vector>
 
 #include "aac.h"
 #include "aac_tables.h"
+#include "encoder.h"
 
 static float compute_snr(const float* ref, const float* test, int n) {
   float signal_power = 0, noise_power = 0;
@@ -24,6 +28,210 @@ static float compute_snr(const float* ref, const float* test, int n) {
   return 10.0f * log10f(signal_power / noise_power);
 }
 
+/* ── Complexity preset sweep ──────────────────────────────────
+ * Encodes 4 s of a tone + noise mix at 128 kbps with each preset and
+ * reports encoder frames/sec plus decoded SNR. These are the figures
+ * quoted in the README preset table. */
+static void run_complexity_sweep() {
+  const int sr = 44100, n_frames = 172;
+  std::vector<float> pcm_in(static_cast<size_t>(n_frames) * 1024);
+  uint32_t rng = 22222u;
+  for (size_t i = 0; i < pcm_in.size(); i++) {
+    rng = rng * 1664525u + 1013904223u;
+    float noise = ((float)(rng >> 9) / 8388608.0f - 1.0f) * 0.02f;
+    pcm_in[i] = 0.3f * sinf(2.0f * (float)M_PI * 440.0f * (float)i / sr) +
+                0.1f * sinf(2.0f * (float)M_PI * 5000.0f * (float)i / sr) + noise;
+  }
+
+  const char* names[] = {"FAST", "MEDIUM", "HIGH", "BEST"};
+  printf("\nComplexity sweep (128k CBR mono, %d frames):\n", n_frames);
+  for (int c = AAC_COMPLEXITY_FAST; c <= AAC_COMPLEXITY_BEST; c++) {
+    AacEncoderHandle enc = aac_encoder_create(sr, 1, 128000, AAC_AOT_LC, AAC_RC_CBR);
+    AacDecoderHandle dec = aac_decoder_create(sr, 1);
+    if (!enc || !dec || aac_encoder_set_complexity(enc, (AacComplexity)c) != AAC_OK) {
+      printf("  %-6s: SKIP\n", names[c]);
+      if (enc) { aac_encoder_destroy(enc);
+}
+      if (dec) { aac_decoder_destroy(dec);
+}
+      continue;
+    }
+
+    std::vector<std::vector<uint8_t>> frames(n_frames);
+    uint8_t bs[8192];
+    long total_bytes = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < n_frames; f++) {
+      int len = aac_encoder_encode(enc, &pcm_in[static_cast<size_t>(f) * 1024], 1024, bs,
+                                   sizeof(bs));
+      if (len > 0) {
+        frames[f].assign(bs, bs + len);
+        total_bytes += len;
+      }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(t1 - t0).count();
+
+    /* Decode call f reconstructs input frame f - 1 */
+    std::vector<float> pcm_out(pcm_in.size(), 0.0f);
+    float out[2048];
+    for (int f = 0; f < n_frames; f++) {
+      int n = frames[f].empty() ? 0
+                                : aac_decoder_decode(dec, frames[f].data(), (int)frames[f].size(),
+                                                     out, 2048);
+      if (f >= 1 && n >= 1024) {
+        memcpy(&pcm_out[static_cast<size_t>(f - 1) * 1024], out, 1024 * sizeof(float));
+      }
+    }
+    float snr = compute_snr(&pcm_in[1024], &pcm_out[1024], (n_frames - 2) * 1024);
+    printf("  %-6s: %7.1f frames/s, %6.1f kbps, SNR=%.1f dB\n", names[c], n_frames / secs,
+           (double)total_bytes * 8.0 * sr / (n_frames * 1024.0) / 1000.0, snr);
+
+    aac_encoder_destroy(enc);
+    aac_decoder_destroy(dec);
+  }
+}
+
+/* Podcast-like layout: 20 frames of programme, 30 frames of gap. With
+ * dither the gaps sit at 16-bit LSB level and take the full analysis path;
+ * without it they are digital zero and hit the silence fast path. */
+static double time_silence_track(bool dither, bool decode, long* bytes) {
+  const int sr = 44100, n_frames = 200;
+  std::vector<float> pcm(static_cast<size_t>(n_frames) * 2048);
+  uint32_t rng = 777u;
+  for (int f = 0; f < n_frames; f++) {
+    bool gap = (f % 50) >= 20;
+    for (int i = 0; i < 1024; i++) {
+      size_t t = static_cast<size_t>(f) * 1024 + i;
+      rng = rng * 1664525u + 1013904223u;
+      float lsb = ((float)(rng >> 9) / 8388608.0f - 1.0f) / 32768.0f;
+      float v = 0.0f;
+      if (!gap) {
+        v = 0.3f * sinf(2.0f * (float)M_PI * 180.0f * (float)t / sr) *
+            (0.6f + 0.4f * sinf(2.0f * (float)M_PI * 4.0f * (float)t / sr));
+      } else if (dither) {
+        v = lsb;
+      }
+      pcm[t * 2] = v;
+      pcm[t * 2 + 1] = v;
+    }
+  }
+
+  AacEncoderHandle enc = aac_encoder_create(sr, 2, 128000, AAC_AOT_LC, AAC_RC_CBR);
+  std::vector<std::vector<uint8_t>> frames(n_frames);
+  uint8_t bs[8192];
+  *bytes = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int f = 0; f < n_frames; f++) {
+    int len = aac_encoder_encode(enc, &pcm[static_cast<size_t>(f) * 2048], 1024, bs, sizeof(bs));
+    if (len > 0) {
+      frames[f].assign(bs, bs + len);
+      *bytes += len;
+    }
+  }
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  aac_encoder_destroy(enc);
+  if (!decode) {
+    return n_frames / secs;
+  }
+
+  AacDecoderHandle dec = aac_decoder_create(sr, 2);
+  float out[4096];
+  const int reps = 20;
+  t0 = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; r++) {
+    for (int f = 0; f < n_frames; f++) {
+      if (!frames[f].empty()) {
+        aac_decoder_decode(dec, frames[f].data(), (int)frames[f].size(), out, 4096);
+      }
+    }
+  }
+  secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  aac_decoder_destroy(dec);
+  return reps * n_frames / secs;
+}
+
+static void run_silence_benchmark() {
+  long bytes_zero = 0, bytes_dither = 0;
+  double enc_zero = time_silence_track(false, false, &bytes_zero);
+  double enc_dither = time_silence_track(true, false, &bytes_dither);
+  double dec_zero = time_silence_track(false, true, &bytes_zero);
+  double dec_dither = time_silence_track(true, true, &bytes_dither);
+  printf("\nSilence fast path (128k CBR stereo, 60%% gaps, 200 frames):\n");
+  printf("  encode: %7.1f frames/s digital zero, %7.1f frames/s LSB dither (%.1fx)\n", enc_zero,
+         enc_dither, enc_zero / enc_dither);
+  printf("  decode: %7.0f frames/s digital zero, %7.0f frames/s LSB dither (%.1fx)\n", dec_zero,
+         dec_dither, dec_zero / dec_dither);
+  printf("  size:   %ld bytes digital zero, %ld bytes LSB dither\n", bytes_zero, bytes_dither);
+}
+
+/* ── TNS on transients ───────────────────────────────────────
+ * Castanet-like clicks (5 ms decaying noise bursts every ~93 ms, off the
+ * frame grid) over a quiet tone. Pre-echo is the coding error in the
+ * 256 samples before each attack relative to the click energy. TNS is
+ * toggled on the internal preset so everything else stays identical. */
+
+static void run_tns_comparison() {
+  const int sr = 44100, n_frames = 172;
+  std::vector<float> pcm_in(static_cast<size_t>(n_frames) * 1024);
+  std::vector<int> attacks;
+  uint32_t rng = 4242u;
+  for (size_t i = 0; i < pcm_in.size(); i++) {
+    pcm_in[i] = 0.02f * sinf(2.0f * (float)M_PI * 300.0f * (float)i / sr);
+  }
+  for (int a = 2000; a + 2048 < (int)pcm_in.size(); a += 4111) {
+    attacks.push_back(a);
+    for (int i = 0; i < 220; i++) {
+      rng = rng * 1664525u + 1013904223u;
+      float noise = (float)(rng >> 9) / 8388608.0f - 1.0f;
+      pcm_in[a + i] += 0.7f * noise * expf(-(float)i / 45.0f);
+    }
+  }
+
+  printf("\nTNS on castanet-like clicks (mono, HIGH preset):\n");
+  for (int br : {64000, 96000}) {
+    for (int tns = 0; tns <= 1; tns++) {
+      AacEncoderHandle enc = aac_encoder_create(sr, 1, br, AAC_AOT_LC, AAC_RC_CBR);
+      AacDecoderHandle dec = aac_decoder_create(sr, 1);
+      if (!tns) {
+        static_cast<AacEncoderState*>(enc)->preset.tns_filters = 0;
+      }
+      std::vector<float> pcm_out(pcm_in.size(), 0.0f);
+      uint8_t bs[8192];
+      float out[2048];
+      long total_bytes = 0;
+      int peak_bytes = 0;
+      for (int f = 0; f < n_frames; f++) {
+        int len = aac_encoder_encode(enc, &pcm_in[static_cast<size_t>(f) * 1024], 1024, bs,
+                                     sizeof(bs));
+        total_bytes += len;
+        peak_bytes = std::max(peak_bytes, len);
+        int n = aac_decoder_decode(dec, bs, len, out, 2048);
+        if (f >= 1 && n >= 1024) {
+          memcpy(&pcm_out[static_cast<size_t>(f - 1) * 1024], out, 1024 * sizeof(float));
+        }
+      }
+      double pre = 0.0, click = 0.0;
+      for (int a : attacks) {
+        for (int i = a - 256; i < a; i++) {
+          double e = pcm_in[i] - pcm_out[i];
+          pre += e * e;
+        }
+        for (int i = a; i < a + 220; i++) {
+          click += (double)pcm_in[i] * pcm_in[i];
+        }
+      }
+      float snr = compute_snr(&pcm_in[1024], &pcm_out[1024], (n_frames - 2) * 1024);
+      printf("  %3dk TNS %-3s: %6.1f kbps, peak frame %4d bytes, SNR=%.1f dB, pre-echo=%.1f dB\n",
+             br / 1000, tns ? "on" : "off",
+             (double)total_bytes * 8.0 * sr / (n_frames * 1024.0) / 1000.0, peak_bytes, snr,
+             10.0 * log10(pre / click));
+      aac_encoder_destroy(enc);
+      aac_decoder_destroy(dec);
+    }
+  }
+}
+
 int main(int argc, char** argv) {
   if (argc > 1 && strcmp(argv[1], "--help") == 0) {
     printf("Usage: test_quality [--help]\n");
@@ -87,6 +295,10 @@ int main(int argc, char** argv) {
     aac_decoder_destroy(dec);
   }
 
+  run_complexity_sweep();
+  run_silence_benchmark();
+  run_tns_comparison();
+
   printf("\n=== Benchmark Complete ===\n");
   return 0;
 }
@@ -2,12 +2,18 @@
  * Encode/decode roundtrip tests for AAC-LC, HE-AAC v1, HE-AAC v2.
  * Verifies: encode produces valid frames, decode recovers audio.
  */
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <initializer_list>
+#include <vector>
 
 #include "aac.h"
 #include "aac_tables.h"
+#include "decoder.h"
+#include "encoder.h"
 
 static int test_lc_roundtrip() {
   /* Create encoder and decoder */
@@ -96,12 +102,1388 @@ static int test_stereo_roundtrip() {
   return 0;
 }
 
+/* Quiet tone, then dense noise, then sparse clicks over a tone */
+static void two_pass_signal(float* pcm, int frame, int n_frames) {
+  unsigned int seed = 1u + (unsigned int)frame * 7919u;
+  for (int i = 0; i < 1024; i++) {
+    int t = frame * 1024 + i;
+    float tone = sinf(2.0f * (float)M_PI * 440.0f * (float)t / 44100.0f);
+    float noise = (float)rand_r(&seed) / (float)RAND_MAX - 0.5f;
+    if (frame < n_frames / 3) {
+      pcm[i] = 0.05f * tone;
+    } else if (frame < 2 * n_frames / 3) {
+      pcm[i] = 0.6f * noise;
+    } else {
+      pcm[i] = 0.2f * tone + ((t % 4096) < 64 ? 0.8f * noise : 0.0f);
+    }
+  }
+}
+
+static long encode_pass(AacPassMode pass, const char* stats, int n_frames) {
+  AacEncoderHandle enc = aac_encoder_create(44100, 1, 96000, AAC_AOT_LC, AAC_RC_ABR);
+  if (!enc) {
+    return -1;
+  }
+  aac_encoder_set_complexity(enc, AAC_COMPLEXITY_FAST);
+  if (aac_encoder_set_pass(enc, pass, stats) != AAC_OK) {
+    aac_encoder_destroy(enc);
+    return -1;
+  }
+  float pcm[1024];
+  uint8_t bitstream[8192];
+  long total = 0;
+  for (int f = 0; f < n_frames; f++) {
+    two_pass_signal(pcm, f, n_frames);
+    int len = aac_encoder_encode(enc, pcm, 1024, bitstream, sizeof(bitstream));
+    if (len <= 0) {
+      aac_encoder_destroy(enc);
+      return -1;
+    }
+    total += len;
+  }
+  aac_encoder_destroy(enc);
+  return total;
+}
+
+static int test_two_pass() {
+  const char* stats = "test_roundtrip_2pass.stats";
+  const int n_frames = 240;
+  long target = (long)96000 * n_frames * 1024 / 44100 / 8;
+
+  long single = encode_pass(AAC_PASS_SINGLE, nullptr, n_frames);
+  long first = encode_pass(AAC_PASS_FIRST, stats, n_frames);
+  long second = encode_pass(AAC_PASS_SECOND, stats, n_frames);
+  remove(stats);
+  if (single < 0 || first < 0 || second < 0) {
+    printf("FAIL: two-pass encode error (%ld %ld %ld)\n", single, first, second);
+    return 1;
+  }
+
+  double err = fabs((double)(second - target)) / (double)target * 100.0;
+  printf("Two-pass: target %ld bytes, single-pass %ld, pass 2 %ld (%.2f%% off)\n", target, single,
+         second, err);
+  if (err > 2.0) {
+    printf("FAIL: pass 2 size off target by more than 2%%\n");
+    return 1;
+  }
+
+  /* Stats must match the encoder configuration */
+  AacEncoderHandle enc = aac_encoder_create(44100, 1, 96000, AAC_AOT_LC, AAC_RC_ABR);
+  int rc = aac_encoder_set_pass(enc, AAC_PASS_SECOND, stats);
+  aac_encoder_destroy(enc);
+  if (rc != AAC_ERR_INIT) {
+    printf("FAIL: missing stats file accepted (%d)\n", rc);
+    return 1;
+  }
+
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* Each pass-2 frame against the plan: its rate-control target must be the
+ * plan's payload (the recorded overhead already holds the SBR payload, so
+ * the core is not charged for it again), and the bits written must follow
+ * the planned sizes. The running correction would hide a per-frame error in
+ * the file size alone. The callback runs before the frame is reported back
+ * to the plan, so asking the plan again gives this frame's payload. */
+struct PlanLog {
+  AacEncoderHandle enc;
+  int64_t planned, diff, abs_diff;
+  int frames, off_plan;
+};
+
+static void collect_plan_error(const AacFrameStats* st, void* user) {
+  auto* log = static_cast<PlanLog*>(user);
+  AacTwoPassState* tp = static_cast<AacEncoderState*>(log->enc)->twopass;
+  int payload = 0;
+  float lambda = 0.0f;
+  if (st->frame_index != tp->frame_index || !aac_twopass_frame_plan(tp, &payload, &lambda) ||
+      st->target_bits != payload) {
+    log->off_plan++;
+  }
+  int64_t planned = tp->target_bits[tp->frame_index];
+  log->planned += planned;
+  log->diff += st->frame_bits - planned;
+  log->abs_diff += std::abs(st->frame_bits - planned);
+  log->frames++;
+}
+
+static int encode_sbr_pass(AacPassMode pass, const char* stats, int n_frames, PlanLog* log) {
+  AacEncoderHandle enc = aac_encoder_create(48000, 1, 32000, AAC_AOT_SBR, AAC_RC_ABR);
+  if (!enc || aac_encoder_set_pass(enc, pass, stats) != AAC_OK) {
+    if (enc) {
+      aac_encoder_destroy(enc);
+    }
+    return 1;
+  }
+  if (log) {
+    log->enc = enc;
+    aac_encoder_set_stats_callback(enc, collect_plan_error, log);
+  }
+  float pcm[2048];
+  uint8_t bitstream[8192];
+  for (int f = 0; f < n_frames; f++) {
+    two_pass_signal(pcm, 2 * f, 2 * n_frames);
+    two_pass_signal(pcm + 1024, 2 * f + 1, 2 * n_frames);
+    if (aac_encoder_encode(enc, pcm, 2048, bitstream, sizeof(bitstream)) <= 0) {
+      aac_encoder_destroy(enc);
+      return 1;
+    }
+  }
+  aac_encoder_destroy(enc);
+  return 0;
+}
+
+static int test_two_pass_sbr() {
+  const char* stats = "test_roundtrip_2pass_sbr.stats";
+  const int n_frames = 120;
+  PlanLog log = {};
+  int rc = encode_sbr_pass(AAC_PASS_FIRST, stats, n_frames, nullptr) |
+           encode_sbr_pass(AAC_PASS_SECOND, stats, n_frames, &log);
+  remove(stats);
+  if (rc || log.frames != n_frames) {
+    printf("FAIL: HE-AAC two-pass encode error\n");
+    return 1;
+  }
+  double bias = (double)log.diff / (double)log.planned * 100.0;
+  double spread = (double)log.abs_diff / (double)log.planned * 100.0;
+  printf("Two-pass HE-AAC: %d/%d frame targets off the plan, frames %+.2f%% against it, "
+         "%.1f%% absolute deviation\n",
+         log.off_plan, log.frames, bias, spread);
+  if (log.off_plan != 0 || fabs(bias) > 2.0 || spread > 25.0) {
+    printf("FAIL: pass 2 frames do not follow the plan\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* A few frames far above the rest saturate at one frame's payload; what
+ * they cannot take goes to the others, so the plan still spends the budget */
+static int test_two_pass_plan() {
+  const char* stats = "test_roundtrip_plan.stats";
+  const int n_frames = 100, header_bits = 56;
+  AacTwoPassState* tp = aac_twopass_open_first(stats, 44100, 1, 96000, 1024);
+  if (!tp) {
+    printf("FAIL: cannot create %s\n", stats);
+    return 1;
+  }
+  for (int f = 0; f < n_frames; f++) {
+    AacPassStatsFrame fr = {};
+    fr.pe = f % 20 == 0 ? 1e6f : 100.0f;
+    fr.lambda = 1.0f;
+    fr.est_bits = 2000;
+    fr.frame_bits = fr.est_bits + header_bits;
+    aac_twopass_record(tp, &fr);
+  }
+  aac_twopass_close(tp);
+
+  tp = aac_twopass_open_second(stats, 44100, 1, 96000, 1024);
+  remove(stats);
+  if (!tp) {
+    printf("FAIL: cannot load %s\n", stats);
+    return 1;
+  }
+  int64_t total = 0, peak = 0;
+  for (int f = 0; f < n_frames; f++) {
+    total += tp->target_bits[f];
+    peak = std::max(peak, tp->target_bits[f]);
+  }
+  aac_twopass_close(tp);
+
+  const int64_t budget = (int64_t)96000 * n_frames * 1024 / 44100;
+  double err = fabs((double)(total - budget)) / (double)budget * 100.0;
+  printf("Two-pass plan: budget %lld bits, planned %lld (%.3f%% off), largest frame %lld\n",
+         (long long)budget, (long long)total, err, (long long)peak);
+  if (err > 0.1 || peak > AAC_BITS_PER_FRAME_LONG + header_bits) {
+    printf("FAIL: saturated frames lost budget or exceeded a frame\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* 64 kbps stereo low-passes at 11.5 kHz: a 1 kHz tone survives, a 15 kHz
+ * tone is not coded, and each CPE decodes to exactly one frame */
+static float lowpass_tone_energy(float freq) {
+  AacEncoderHandle enc = aac_encoder_create(48000, 2, 64000, AAC_AOT_LC, AAC_RC_CBR);
+  AacDecoderHandle dec = aac_decoder_create(48000, 2);
+  float pcm[2048], out[4096];
+  uint8_t bitstream[8192];
+  float energy = 0.0f;
+  for (int f = 0; f < 6; f++) {
+    for (int i = 0; i < 1024; i++) {
+      float s = 0.4f * sinf(2.0f * (float)M_PI * freq * (float)(f * 1024 + i) / 48000.0f);
+      pcm[static_cast<ptrdiff_t>(i) * 2] = s;
+      pcm[static_cast<ptrdiff_t>(i) * 2 + 1] = s;
+    }
+    int len = aac_encoder_encode(enc, pcm, 1024, bitstream, sizeof(bitstream));
+    int n = aac_decoder_decode(dec, bitstream, len, out, 4096);
+    if (n != 1024) {
+      energy = -1.0f;
+      break;
+    }
+    if (f >= 2) {
+      for (int i = 0; i < 2048; i++) {
+        energy += out[i] * out[i];
+      }
+    }
+  }
+  aac_encoder_destroy(enc);
+  aac_decoder_destroy(dec);
+  return energy;
+}
+
+static int test_bandwidth_limit() {
+  float pass = lowpass_tone_energy(1000.0f);
+  float stop = lowpass_tone_energy(15000.0f);
+  printf("Lowpass 64k stereo: 1 kHz energy %e, 15 kHz energy %e\n", pass, stop);
+  if (pass <= 0.0f || stop < 0.0f || stop > pass * 1e-3f) {
+    printf("FAIL: band above cutoff was coded\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* Digital silence after a tone: once the overlap drains, frames shrink to
+ * the empty-ICS minimum and decode to exact zeros */
+static int test_silence_fast_path() {
+  AacEncoderHandle enc = aac_encoder_create(44100, 2, 128000, AAC_AOT_LC, AAC_RC_CBR);
+  AacDecoderHandle dec = aac_decoder_create(44100, 2);
+  float pcm[2048], out[4096];
+  uint8_t bitstream[8192];
+  int failures = 0;
+  for (int f = 0; f < 8; f++) {
+    for (int i = 0; i < 2048; i++) {
+      pcm[i] = (f < 2) ? 0.3f * sinf(2.0f * (float)M_PI * 500.0f * (float)(f * 1024 + i / 2) /
+                                     44100.0f)
+                       : 0.0f;
+    }
+    int len = aac_encoder_encode(enc, pcm, 1024, bitstream, sizeof(bitstream));
+    int n = aac_decoder_decode(dec, bitstream, len, out, 4096);
+    if (f >= 4) {
+      bool zero = (n == 1024);
+      for (int i = 0; i < 2048 && zero; i++) {
+        zero = (out[i] == 0.0f);
+      }
+      if (len > 16 || !zero) {
+        printf("FAIL: silent frame %d: %d bytes, %d samples, zero=%d\n", f, len, n, zero);
+        failures++;
+      }
+    }
+  }
+  /* A skipped frame still records its window for the next IMDCT */
+  AacDecoderChannel* dc = &static_cast<AacDecoderState*>(dec)->ch[0];
+  dc->mdct_ctx.prev_win_seq = AAC_WIN_LONG_STOP;
+  dc->mdct_ctx.prev_win_shape = dc->win_shape == AAC_WIN_SINE ? AAC_WIN_KBD : AAC_WIN_SINE;
+  int len = aac_encoder_encode(enc, pcm, 1024, bitstream, sizeof(bitstream));
+  aac_decoder_decode(dec, bitstream, len, out, 4096);
+  if (dc->mdct_ctx.prev_win_seq != dc->win_seq || dc->mdct_ctx.prev_win_shape != dc->win_shape) {
+    printf("FAIL: silent frame left the previous window at %d/%d\n", dc->mdct_ctx.prev_win_seq,
+           dc->mdct_ctx.prev_win_shape);
+    failures++;
+  }
+  aac_encoder_destroy(enc);
+  aac_decoder_destroy(dec);
+  if (failures == 0) {
+    printf("Silence fast path: empty frames decode to exact zeros\nPASS\n\n");
+  }
+  return failures ? 1 : 0;
+}
+
+struct FrameStatsLog {
+  int frames;
+  int errors;
+  int64_t stage_ns;
+};
+
+static void collect_frame_stats(const AacFrameStats* st, void* user) {
+  auto* log = static_cast<FrameStatsLog*>(user);
+  if (st->frame_index != log->frames || st->rc_iterations < 1 || st->lambda <= 0.0f ||
+      st->channel_bits[0] <= 0 || st->channel_bits[1] <= 0 ||
+      st->channel_bits[0] + st->channel_bits[1] >= st->frame_bits || st->ms_bands != 0 ||
+      st->window_sequence != 0) {
+    log->errors++;
+  }
+  log->stage_ns += st->mdct_ns + st->psycho_ns + st->quant_ns + st->bitstream_ns;
+  log->frames++;
+}
+
+static int test_frame_stats() {
+  AacEncoderHandle enc = aac_encoder_create(48000, 2, 128000, AAC_AOT_LC, AAC_RC_CBR);
+  if (!enc) {
+    printf("FAIL: encoder create returned null\n");
+    return 1;
+  }
+  FrameStatsLog log = {};
+  aac_encoder_set_complexity(enc, AAC_COMPLEXITY_FAST);
+  aac_encoder_set_stats_callback(enc, collect_frame_stats, &log);
+
+  float pcm[2048];
+  uint8_t bitstream[8192];
+  for (int f = 0; f < 8; f++) {
+    for (int i = 0; i < 1024; i++) {
+      float t = (float)(f * 1024 + i) / 48000.0f;
+      pcm[static_cast<ptrdiff_t>(i) * 2] = 0.4f * sinf(2.0f * (float)M_PI * 660.0f * t);
+      pcm[static_cast<ptrdiff_t>(i) * 2 + 1] = 0.3f * sinf(2.0f * (float)M_PI * 990.0f * t);
+    }
+    aac_encoder_encode(enc, pcm, 1024, bitstream, sizeof(bitstream));
+  }
+  /* Detaching must stop delivery */
+  aac_encoder_set_stats_callback(enc, nullptr, nullptr);
+  aac_encoder_encode(enc, pcm, 1024, bitstream, sizeof(bitstream));
+  aac_encoder_destroy(enc);
+
+  printf("Frame stats: %d frames, %d inconsistent, %lld ns in stages\n", log.frames, log.errors,
+         (long long)log.stage_ns);
+  if (log.frames != 8 || log.errors != 0 || log.stage_ns <= 0) {
+    printf("FAIL: frame stats callback\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* Tones over high-passed noise at a low rate: the noise bands above 4 kHz
+ * should be substituted, decode identically in every decoder instance, and
+ * keep their energy. */
+static int test_pns() {
+  const int n_frames = 24;
+  AacEncoderHandle enc = aac_encoder_create(44100, 1, 48000, AAC_AOT_LC, AAC_RC_CBR);
+  AacDecoderHandle dec[2] = {aac_decoder_create(44100, 1), aac_decoder_create(44100, 1)};
+  static float pcm[n_frames * 1024], out[2][n_frames * 1024];
+  uint32_t rng = 777u;
+  float lp = 0.0f;
+  for (int i = 0; i < n_frames * 1024; i++) {
+    rng = rng * 1664525u + 1013904223u;
+    float noise = (float)(rng >> 9) / 8388608.0f - 1.0f;
+    lp = 0.7f * lp + 0.3f * noise;
+    pcm[i] = 0.25f * sinf(2.0f * (float)M_PI * 440.0f * (float)i / 44100.0f) +
+             0.08f * (noise - lp);
+  }
+
+  uint8_t bitstream[8192];
+  float frame[2048];
+  int pns_bands = 0, mismatches = 0;
+  for (int f = 0; f < n_frames; f++) {
+    int len = aac_encoder_encode(enc, &pcm[f * 1024], 1024, bitstream, sizeof(bitstream));
+    for (int d = 0; d < 2; d++) {
+      int n = aac_decoder_decode(dec[d], bitstream, len, frame, 2048);
+      if (n == 1024 && f >= 1) {
+        memcpy(&out[d][(f - 1) * 1024], frame, 1024 * sizeof(float));
+      }
+    }
+    const AacDecoderChannel* ch = &static_cast<AacDecoderState*>(dec[0])->ch[0];
+    for (int b = 0; b < ch->max_sfb; b++) {
+      pns_bands += ch->sfb_cb[b] == AAC_PNS_CODEBOOK;
+    }
+  }
+
+  /* First difference as a crude high-pass: the substituted region dominates */
+  double e_in = 0.0, e_out = 0.0;
+  for (int i = 2048; i < (n_frames - 2) * 1024; i++) {
+    double a = pcm[i] - pcm[i - 1], b = out[0][i] - out[0][i - 1];
+    e_in += a * a;
+    e_out += b * b;
+    mismatches += out[0][i] != out[1][i];
+  }
+  double hf_db = 10.0 * log10(e_out / e_in);
+  aac_encoder_destroy(enc);
+  aac_decoder_destroy(dec[0]);
+  aac_decoder_destroy(dec[1]);
+
+  printf("PNS: %d noise bands in %d frames, high-band energy %+.1f dB, %d decoder mismatches\n",
+         pns_bands, n_frames, hf_db, mismatches);
+  if (pns_bands == 0 || mismatches != 0 || fabs(hf_db) > 6.0) {
+    printf("FAIL: noise substitution\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* HE-AAC v1 at 48 kbps stereo: the core runs at 24 kHz and stays decodable
+ * there, every frame carries an SBR payload in a FIL element, and the
+ * envelopes follow a 20 dB step in the white noise above the crossover. */
+static int test_sbr_encoder() {
+  const int n_frames = 24, step_frame = 12;
+  AacEncoderHandle enc = aac_encoder_create(48000, 2, 48000, AAC_AOT_SBR, AAC_RC_CBR);
+  AacDecoderHandle dec = aac_decoder_create(24000, 2);
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  AacDecoderState* parser = aac_decoder_state_create(24000, 2, &dsp);
+  if (!enc || aac_encoder_frame_size(enc) != 2048) {
+    printf("FAIL: SBR encoder create / frame size\n");
+    return 1;
+  }
+  const AacSbrEncoder* sbr = static_cast<AacEncoderState*>(enc)->sbr;
+
+  static float pcm[2 * 2048], out[2 * 2048];
+  uint8_t bitstream[8192];
+  uint32_t rng = 0x2545F491u;
+  int core_frames = 0, sbr_frames = 0, headers = 0;
+  double env_sum[2] = {0.0, 0.0};
+  int env_count[2] = {0, 0};
+  for (int f = 0; f < n_frames; f++) {
+    float level = f < step_frame ? 0.1f : 0.01f;
+    for (int i = 0; i < 2048; i++) {
+      float tone = 0.3f * sinf(2.0f * (float)M_PI * 1000.0f * (float)(f * 2048 + i) / 48000.0f);
+      for (int c = 0; c < 2; c++) {
+        float noise = (float)aac_pns_random(&rng) / 2147483648.0f - 1.0f;
+        pcm[i * 2 + c] = tone + level * noise;
+      }
+    }
+    int len = aac_encoder_encode(enc, pcm, 2048, bitstream, sizeof(bitstream));
+    AacAdtsHeader hdr;
+    if (len <= 0 || aac_adts_parse(&hdr, bitstream, len) != 0 || hdr.profile != AAC_AOT_LC ||
+        aac_sample_rates[hdr.sample_rate_index] != 24000) {
+      printf("FAIL: SBR frame %d: bad ADTS header\n", f);
+      return 1;
+    }
+    core_frames += aac_decoder_decode(dec, bitstream, len, out, 2 * 2048) == 1024;
+
+    /* CPE, then a FIL element holding EXT_SBR_DATA with the header settings */
+    AacBitReader r;
+    aac_bitreader_init(&r, bitstream + AAC_ADTS_HEADER_SIZE, len - AAC_ADTS_HEADER_SIZE);
+    if (aac_bitreader_read(&r, 3) != AAC_ELEM_CPE || aac_decode_cpe(parser, &r, 0) != 0 ||
+        aac_bitreader_read(&r, 3) != AAC_ELEM_FIL) {
+      continue;
+    }
+    int cnt = aac_bitreader_read(&r, 4);
+    if (cnt == 15) {
+      cnt += aac_bitreader_read(&r, 8) - 1;
+    }
+    if (cnt * 8 < 4 + sbr->payload_bits || aac_bitreader_read(&r, 4) != AAC_FIL_EXT_SBR_DATA) {
+      continue;
+    }
+    sbr_frames++;
+    if (aac_bitreader_read(&r, 1)) {
+      aac_bitreader_read(&r, 1); /* amp_res */
+      headers += aac_bitreader_read(&r, 6) == (uint32_t)sbr->header.start_band &&
+                 aac_bitreader_read(&r, 7) == (uint32_t)sbr->header.stop_band;
+    }
+    /* Steady single-envelope frames away from the step and the start */
+    int half = f < step_frame ? 0 : 1;
+    if (f >= 2 && f != step_frame && f != step_frame + 1 && sbr->frame[0].n_env == 1) {
+      for (int b = 0; b < sbr->tables.n_env_bands; b++) {
+        env_sum[half] += sbr->frame[0].env[0][b];
+        env_count[half]++;
+      }
+    }
+  }
+  aac_encoder_destroy(enc);
+  aac_decoder_destroy(dec);
+  aac_decoder_state_destroy(parser);
+
+  /* 1.5 dB steps: 20 dB is 13.3 envelope steps */
+  double drop = (env_count[0] && env_count[1])
+                    ? env_sum[0] / env_count[0] - env_sum[1] / env_count[1]
+                    : 0.0;
+  int expected_headers = (n_frames + AAC_SBR_HEADER_INTERVAL - 1) / AAC_SBR_HEADER_INTERVAL;
+  printf("SBR: %d/%d core frames at 24 kHz, %d SBR payloads, %d headers, envelope drop %.1f "
+         "steps for 20 dB\n",
+         core_frames, n_frames, sbr_frames, headers, drop);
+  if (core_frames != n_frames || sbr_frames != n_frames || headers != expected_headers ||
+      fabs(drop - 13.3) > 1.5) {
+    printf("FAIL: SBR encoder\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* HE-AAC decoding at the full rate: 2048-sample frames, the reconstructed
+ * band's energy follows the input above the crossover, and the output
+ * lines up with the input at aac_encoder_delay(). */
+static int test_sbr_decoder() {
+  const int n_frames = 40, skip = 8;
+  AacEncoderHandle enc = aac_encoder_create(48000, 2, 48000, AAC_AOT_SBR, AAC_RC_CBR);
+  AacDecoderHandle dec = aac_decoder_create(48000, 2);
+  if (!enc || !dec) {
+    printf("FAIL: SBR decoder create\n");
+    return 1;
+  }
+  static float in[40 * 2048], out[40 * 2048 + 2048];
+  static float pcm[2 * 2048], frame_out[2 * 2048];
+  uint8_t bitstream[8192];
+  uint32_t rng = 0x1234567u;
+  int frames_2048 = 0, decoded = 0;
+  for (int f = 0; f < n_frames; f++) {
+    for (int i = 0; i < 2048; i++) {
+      float t = (float)(f * 2048 + i) / 48000.0f;
+      float tone = 0.3f * sinf(2.0f * (float)M_PI * 1000.0f * t);
+      float noise = 0.1f * ((float)aac_pns_random(&rng) / 2147483648.0f - 1.0f);
+      in[f * 2048 + i] = tone + noise;
+      pcm[i * 2] = pcm[i * 2 + 1] = tone + noise;
+    }
+    int len = aac_encoder_encode(enc, pcm, 2048, bitstream, sizeof(bitstream));
+    int n = aac_decoder_decode(dec, bitstream, len, frame_out, 2 * 2048);
+    frames_2048 += n == 2048 && aac_decoder_frame_size(dec) == 2048;
+    for (int i = 0; n > 0 && i < n; i++) {
+      out[decoded + i] = frame_out[i * 2];
+    }
+    decoded += n > 0 ? n : 0;
+  }
+  int has_sbr = 0, has_ps = 0;
+  aac_decoder_get_sbr_ps(dec, &has_sbr, &has_ps);
+  const AacSbrDecoder* sbr = static_cast<AacDecoderState*>(dec)->elem[0].sbr;
+  int delay = aac_encoder_delay(enc);
+
+  /* Band energies of the input and the aligned output in the 64-band QMF */
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  static AacSbrQmfBank qa, qb;
+  aac_sbr_qmf_init(&qa, 64, &dsp);
+  aac_sbr_qmf_init(&qb, 64, &dsp);
+  static float re[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS], im[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  double e_in[64] = {0.0}, e_out[64] = {0.0};
+  int end = decoded - delay;
+  for (int f = skip; (f + 1) * 2048 <= end; f++) {
+    aac_sbr_qmf_analysis(&qa, in + f * 2048, re, im, AAC_SBR_SLOTS);
+    for (int m = 0; m < AAC_SBR_SLOTS; m++) {
+      for (int k = 0; k < 64; k++) {
+        e_in[k] += re[m][k] * re[m][k] + im[m][k] * im[m][k];
+      }
+    }
+    aac_sbr_qmf_analysis(&qb, out + f * 2048 + delay, re, im, AAC_SBR_SLOTS);
+    for (int m = 0; m < AAC_SBR_SLOTS; m++) {
+      for (int k = 0; k < 64; k++) {
+        e_out[k] += re[m][k] * re[m][k] + im[m][k] * im[m][k];
+      }
+    }
+  }
+  double worst_db = 0.0, hf_in = 0.0, hf_out = 0.0;
+  const AacSbrTables* t = &sbr->tables;
+  for (int b = 0; b < t->n_env_bands; b++) {
+    double bi = 0.0, bo = 0.0;
+    for (int k = t->env_band[b]; k < t->env_band[b + 1]; k++) {
+      bi += e_in[k];
+      bo += e_out[k];
+    }
+    double db = 10.0 * log10((bo + 1e-20) / (bi + 1e-20));
+    worst_db = fabs(db) > fabs(worst_db) ? db : worst_db;
+    hf_in += bi;
+    hf_out += bo;
+  }
+  double hf_db = 10.0 * log10((hf_out + 1e-20) / (hf_in + 1e-20));
+
+  /* Normalised correlation at the reported delay and one sample either side */
+  double corr[3];
+  for (int j = 0; j < 3; j++) {
+    double c = 0.0, ei = 0.0, eo = 0.0;
+    for (int i = skip * 2048; i < end - 1; i++) {
+      float o = out[i + delay + j - 1];
+      c += in[i] * o;
+      ei += in[i] * in[i];
+      eo += o * o;
+    }
+    corr[j] = c / sqrt(ei * eo + 1e-20);
+  }
+
+  printf("SBR decode: %d/%d frames of 2048, has_sbr %d, bands %d..%d, HF %.2f dB (worst "
+         "envelope band %.2f dB), correlation %.3f at delay %d\n",
+         frames_2048, n_frames, has_sbr, sbr ? sbr->header.start_band : 0,
+         sbr ? sbr->header.stop_band : 0, hf_db, worst_db, corr[1], delay);
+  /* The lowest envelope band is patched from the core's noise next to the
+   * tone, which the core drops as masked; the limiter caps its gain there */
+  int failed = 0;
+  if (frames_2048 != n_frames || !has_sbr || fabs(hf_db) > 2.0 || fabs(worst_db) > 7.0 ||
+      corr[1] < 0.9 || corr[1] < corr[0] || corr[1] < corr[2]) {
+    printf("FAIL: SBR decoder\n");
+    failed = 1;
+  }
+  aac_encoder_destroy(enc);
+  aac_decoder_destroy(dec);
+  if (!failed) {
+    printf("PASS\n\n");
+  }
+  return failed;
+}
+
+/* ps_data with a header (20 bands, coarse IID) and one envelope giving
+ * every band the same IID and ICC index */
+static int write_ps_frame(uint8_t* buf, int size, int iid, int icc, int header) {
+  AacBitWriter w;
+  aac_bitwriter_init(&w, buf, size);
+  aac_bitwriter_write(&w, header, 1);
+  if (header) {
+    aac_bitwriter_write(&w, 1, 1); /* enable_iid, mode 1 */
+    aac_bitwriter_write(&w, 1, 3);
+    aac_bitwriter_write(&w, 1, 1); /* enable_icc, mode 1 */
+    aac_bitwriter_write(&w, 1, 3);
+  }
+  aac_bitwriter_write(&w, 1, 2); /* one envelope */
+  for (int v : {iid, icc}) {
+    aac_bitwriter_write(&w, 0, 1); /* frequency deltas */
+    aac_bitwriter_write_golomb(&w, v);
+    for (int b = 1; b < 20; b++) {
+      aac_bitwriter_write_golomb(&w, 0);
+    }
+  }
+  return aac_bitwriter_bytes_written(&w) + 1;
+}
+
+/* Parametric Stereo on white noise in the QMF domain: neutral parameters
+ * return the input exactly, AAC_PS_HYBRID_DELAY slots late, in both
+ * channels; IID +10 dB with ICC 0 gives that level difference and
+ * uncorrelated channels at unchanged total energy. */
+static int test_ps_decoder() {
+  AacDSP dsp;
+  aac_dsp_init(&dsp);
+  const int n_frames = 24, skip = 4, lag = AAC_PS_HYBRID_DELAY;
+  static AacSbrQmfBank qmf;
+  static float in_re[2][AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  static float in_im[2][AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  static float y_re[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS], y_im[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  static float r_re[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS], r_im[AAC_SBR_SLOTS][AAC_SBR_QMF_BANDS];
+  float pcm[2048];
+  double max_err = 0.0, iid_sum = 0.0, icc_sum = 0.0, worst_iid = 10.0, energy_db = 0.0;
+  int failures = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    AacPsDecoder* ps = aac_ps_decoder_create(&dsp);
+    aac_sbr_qmf_init(&qmf, AAC_SBR_QMF_BANDS, &dsp);
+    uint32_t rng = 0x600DF00Du;
+    double el[AAC_SBR_QMF_BANDS] = {0.0}, er[AAC_SBR_QMF_BANDS] = {0.0};
+    double cross[AAC_SBR_QMF_BANDS] = {0.0}, ein = 0.0, eout = 0.0;
+    for (int f = 0; f < n_frames; f++) {
+      for (float& x : pcm) {
+        x = (float)aac_pns_random(&rng) / 2147483648.0f - 1.0f;
+      }
+      aac_sbr_qmf_analysis(&qmf, pcm, y_re, y_im, AAC_SBR_SLOTS);
+      memcpy(in_re[f & 1], y_re, sizeof(y_re));
+      memcpy(in_im[f & 1], y_im, sizeof(y_im));
+      uint8_t buf[64];
+      int len = write_ps_frame(buf, sizeof(buf), pass ? 4 : 0, pass ? 5 : 0, f == 0);
+      AacBitReader r;
+      aac_bitreader_init(&r, buf, len);
+      if (aac_ps_parse(ps, &r) != AAC_OK) {
+        printf("FAIL: PS frame %d does not parse\n", f);
+        failures++;
+      }
+      aac_ps_process(ps, y_re, y_im, r_re, r_im);
+      for (int m = 0; f >= skip && m < AAC_SBR_SLOTS; m++) {
+        /* Input slot m - lag, from the previous frame for the first slots */
+        int src = (f - (m < lag)) & 1, sm = (m - lag + AAC_SBR_SLOTS) % AAC_SBR_SLOTS;
+        for (int k = 0; k < AAC_SBR_QMF_BANDS; k++) {
+          float xr = in_re[src][sm][k], xi = in_im[src][sm][k];
+          if (pass == 0) {
+            max_err = fmax(max_err, fabs(y_re[m][k] - xr) + fabs(y_im[m][k] - xi));
+            max_err = fmax(max_err, fabs(r_re[m][k] - xr) + fabs(r_im[m][k] - xi));
+          }
+          el[k] += y_re[m][k] * y_re[m][k] + y_im[m][k] * y_im[m][k];
+          er[k] += r_re[m][k] * r_re[m][k] + r_im[m][k] * r_im[m][k];
+          cross[k] += y_re[m][k] * r_re[m][k] + y_im[m][k] * r_im[m][k];
+          ein += 2.0 * (xr * xr + xi * xi);
+        }
+      }
+    }
+    aac_ps_decoder_destroy(ps);
+    if (pass == 0) {
+      continue;
+    }
+    /* Bands 3 and up; the lowest, split by the hybrid filters, lose some
+     * decorrelated energy where the sub-bands overlap */
+    for (int k = 3; k < AAC_SBR_QMF_BANDS; k++) {
+      double iid = 10.0 * log10(el[k] / er[k]);
+      iid_sum += iid;
+      icc_sum += cross[k] / sqrt(el[k] * er[k]);
+      worst_iid = fabs(iid - 10.0) > fabs(worst_iid - 10.0) ? iid : worst_iid;
+      eout += el[k] + er[k];
+    }
+    for (int k = 0; k < 3; k++) {
+      eout += el[k] + er[k];
+    }
+    energy_db = 10.0 * log10(eout / ein);
+  }
+  const int nb = AAC_SBR_QMF_BANDS - 3;
+  printf("PS: neutral err = %e, IID %.2f dB (worst band %.2f) for 10, ICC %.3f for 0, energy "
+         "%.2f dB\n",
+         max_err, iid_sum / nb, worst_iid, icc_sum / nb, energy_db);
+  if (failures || max_err > 1e-4 || fabs(iid_sum / nb - 10.0) > 0.5 ||
+      fabs(worst_iid - 10.0) > 1.5 || fabs(icc_sum / nb) > 0.05 || fabs(energy_db) > 1.0) {
+    printf("FAIL: PS decoder\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+/* HE-AAC v2 at 32 kbps: a 1 kHz tone 10 dB louder on the left over
+ * uncorrelated noise. The stream carries a mono core with PS in every frame,
+ * decodes to stereo with the tone's level difference and lines up with the
+ * input at aac_encoder_delay(). */
+static int test_ps_encoder() {
+  const int n_frames = 40, skip = 8, bitrate = 32000;
+  AacEncoderHandle enc = aac_encoder_create(48000, 2, bitrate, AAC_AOT_PS, AAC_RC_CBR);
+  AacDecoderHandle dec = aac_decoder_create(48000, 2);
+  if (!enc || !dec) {
+    printf("FAIL: PS encoder create\n");
+    return 1;
+  }
+  static float in[2][40 * 2048], out[2][40 * 2048 + 2048];
+  static float pcm[2 * 2048], frame_out[2 * 2048];
+  uint8_t bitstream[8192];
+  uint32_t rng = 0x2545F491u;
+  const float pan = powf(10.0f, -10.0f / 20.0f);
+  int mono_core = 0, decoded = 0;
+  long bytes = 0;
+  for (int f = 0; f < n_frames; f++) {
+    for (int i = 0; i < 2048; i++) {
+      float t = (float)(f * 2048 + i) / 48000.0f;
+      float tone = 0.4f * sinf(2.0f * (float)M_PI * 1100.0f * t);
+      float nl = 0.01f * ((float)aac_pns_random(&rng) / 2147483648.0f - 1.0f);
+      float nr = 0.01f * ((float)aac_pns_random(&rng) / 2147483648.0f - 1.0f);
+      in[0][f * 2048 + i] = pcm[i * 2] = tone + nl;
+      in[1][f * 2048 + i] = pcm[i * 2 + 1] = pan * tone + nr;
+    }
+    int len = aac_encoder_encode(enc, pcm, 2048, bitstream, sizeof(bitstream));
+    AacAdtsHeader hdr;
+    mono_core += len > 0 && aac_adts_parse(&hdr, bitstream, len) == 0 && hdr.channel_config == 1;
+    bytes += len > 0 ? len : 0;
+    int n = aac_decoder_decode(dec, bitstream, len, frame_out, 2 * 2048);
+    for (int i = 0; n > 0 && i < n; i++) {
+      out[0][decoded + i] = frame_out[i * 2];
+      out[1][decoded + i] = frame_out[i * 2 + 1];
+    }
+    decoded += n > 0 ? n : 0;
+  }
+  int has_sbr = 0, has_ps = 0;
+  aac_decoder_get_sbr_ps(dec, &has_sbr, &has_ps);
+  int delay = aac_encoder_delay(enc);
+  double kbps = (double)bytes * 8.0 * 48000.0 / (n_frames * 2048.0) / 1000.0;
+
+  /* Channel levels and the left channel's correlation at the reported delay */
+  int end = decoded - delay;
+  double el = 0.0, er = 0.0, c = 0.0, ei = 0.0;
+  for (int i = skip * 2048; i < end; i++) {
+    el += (double)out[0][i + delay] * out[0][i + delay];
+    er += (double)out[1][i + delay] * out[1][i + delay];
+    c += (double)in[0][i] * out[0][i + delay];
+    ei += (double)in[0][i] * in[0][i];
+  }
+  double corr = c / sqrt(ei * el + 1e-20);
+  double iid = 10.0 * log10((el + 1e-20) / (er + 1e-20));
+
+  printf("PS encode: %d/%d mono core frames, has_ps %d, %.1f kbps, L/R %.2f dB for 10, "
+         "correlation %.3f at delay %d\n",
+         mono_core, n_frames, has_ps, kbps, iid, corr, delay);
+  int failed = 0;
+  if (mono_core != n_frames || !has_sbr || !has_ps || kbps > bitrate / 1000.0 * 1.1 ||
+      fabs(iid - 10.0) > 1.5 || corr < 0.95) {
+    printf("FAIL: PS encoder\n");
+    failed = 1;
+  }
+  aac_encoder_destroy(enc);
+  aac_decoder_destroy(dec);
+  if (!failed) {
+    printf("PASS\n\n");
+  }
+  return failed;
+}
+
+/* Amplitude of the freq component of x, by correlation over n samples */
+static double tone_amplitude(const float* x, int n, double freq, double rate) {
+  double re = 0.0, im = 0.0;
+  for (int i = 0; i < n; i++) {
+    re += x[i] * cos(2.0 * M_PI * freq * i / rate);
+    im += x[i] * sin(2.0 * M_PI * freq * i / rate);
+  }
+  return 2.0 * sqrt(re * re + im * im) / n;
+}
+
+/* 5.1 AAC-LC and 7.1 HE-AAC: one tone per channel, encoded on a thread pool.
+ * ADTS carries the channel configuration, every channel decodes to its own
+ * tone with the others at least 30 dB down, the LFE keeps its 50 Hz, and
+ * threaded planar output matches single-threaded interleaved output. */
+static int test_multichannel() {
+  const double tones[8] = {500.0, 700.0, 900.0, 1100.0, 1300.0, 1500.0, 1700.0, 50.0};
+  const struct {
+    int channels, config, bitrate;
+    AacObjectType aot;
+  } cases[] = {{6, 6, 320000, AAC_AOT_LC}, {8, 7, 256000, AAC_AOT_SBR}};
+  int failed = 0;
+  for (const auto& tc : cases) {
+    const int nch = tc.channels, n_frames = 16;
+    AacEncoderHandle enc = aac_encoder_create(48000, nch, tc.bitrate, tc.aot, AAC_RC_CBR);
+    AacDecoderHandle dec[2] = {aac_decoder_create(48000, nch), aac_decoder_create(48000, nch)};
+    if (!enc || !dec[0] || !dec[1] || aac_encoder_set_threads(enc, 3) != AAC_OK ||
+        aac_decoder_set_threads(dec[1], 3) != AAC_OK) {
+      printf("FAIL: %d-channel create / threads\n", nch);
+      return 1;
+    }
+    const int frame = aac_encoder_frame_size(enc);
+    static float pcm[8 * 2048], inter[8 * 2048], planar[8][2048], out[8][16 * 2048];
+    float* planes[8];
+    for (int c = 0; c < 8; c++) {
+      planes[c] = planar[c];
+    }
+    uint8_t bitstream[8192];
+    int config = -1, decoded = 0, mismatches = 0;
+    for (int f = 0; f < n_frames; f++) {
+      for (int i = 0; i < frame; i++) {
+        for (int c = 0; c < nch; c++) {
+          /* The LFE is the last channel */
+          double freq = c == nch - 1 ? tones[7] : tones[c];
+          pcm[i * nch + c] = 0.3f * (float)sin(2.0 * M_PI * freq * (f * frame + i) / 48000.0);
+        }
+      }
+      int len = aac_encoder_encode(enc, pcm, frame, bitstream, sizeof(bitstream));
+      AacAdtsHeader hdr;
+      if (len <= 0 || aac_adts_parse(&hdr, bitstream, len) != 0) {
+        printf("FAIL: %d-channel frame %d: encode %d\n", nch, f, len);
+        return 1;
+      }
+      config = f == 0 || config == hdr.channel_config ? hdr.channel_config : -1;
+      int n0 = aac_decoder_decode(dec[0], bitstream, len, inter, nch * 2048);
+      int n1 = aac_decoder_decode_planar(dec[1], bitstream, len, planes, 2048);
+      if (n0 != frame || n1 != frame) {
+        printf("FAIL: %d-channel frame %d: decoded %d / %d samples\n", nch, f, n0, n1);
+        return 1;
+      }
+      for (int c = 0; c < nch; c++) {
+        for (int i = 0; i < frame; i++) {
+          mismatches += inter[i * nch + c] != planar[c][i];
+          out[c][decoded + i] = planar[c][i];
+        }
+      }
+      decoded += frame;
+    }
+
+    /* Skip the codec delay; measure whole periods of every tone (20 ms) */
+    const int start = 4 * frame, n = 48000 / 50 * 4;
+    double worst_own = 1e9, worst_leak = -1e9;
+    for (int c = 0; c < nch; c++) {
+      double own = 0.0, leak = 0.0;
+      for (int k = 0; k < nch; k++) {
+        double freq = k == nch - 1 ? tones[7] : tones[k];
+        double a = tone_amplitude(&out[c][start], n, freq, 48000.0);
+        if (k == c) {
+          own = a;
+        } else {
+          leak = std::max(leak, a);
+        }
+      }
+      worst_own = std::min(worst_own, 20.0 * log10(own / 0.3));
+      worst_leak = std::max(worst_leak, 20.0 * log10(leak / own + 1e-12));
+    }
+    aac_encoder_destroy(enc);
+    aac_decoder_destroy(dec[0]);
+    aac_decoder_destroy(dec[1]);
+
+    printf("Multichannel %d ch (config %d): worst tone %+.2f dB, worst crosstalk %.1f dB, "
+           "%d threaded/planar mismatches\n",
+           nch, config, worst_own, worst_leak, mismatches);
+    if (config != tc.config || fabs(worst_own) > 1.0 || worst_leak > -30.0 || mismatches != 0) {
+      printf("FAIL: multichannel %d ch\n", nch);
+      failed++;
+    }
+  }
+  if (failed == 0) {
+    printf("PASS\n\n");
+  }
+  return failed;
+}
+
+/* A 5.1 stream on a stereo decoder: the MDCT-domain downmix, the forced
+ * time-domain one and a stream whose centre channel changes window shape
+ * every other frame (the automatic fallback) all match the ITU mix of the
+ * full six-channel decode */
+static int test_downmix() {
+  const int nch = 6, n_frames = 12;
+  const float k3 = 0.70710678f, norm = 1.0f + 2.0f * k3;
+  /* C, L, R, Ls, Rs, LFE */
+  const float gain[6][2] = {{k3, k3}, {1.0f, 0.0f}, {0.0f, 1.0f}, {k3, 0.0f}, {0.0f, k3}, {0, 0}};
+  AacEncoderHandle enc = aac_encoder_create(48000, nch, 320000, AAC_AOT_LC, AAC_RC_CBR);
+  AacDecoderHandle ref = aac_decoder_create(48000, nch);
+  AacDecoderHandle dec[3] = {aac_decoder_create(48000, 2), aac_decoder_create(48000, 2),
+                             aac_decoder_create(48000, 2)};
+  if (!enc || !ref || !dec[0] || !dec[1] || !dec[2] ||
+      aac_decoder_set_downmix(dec[0], AAC_DOWNMIX_AUTO) != AAC_OK ||
+      aac_decoder_set_downmix(dec[1], AAC_DOWNMIX_TIME) != AAC_OK ||
+      aac_decoder_set_downmix(dec[2], AAC_DOWNMIX_AUTO) != AAC_OK ||
+      aac_decoder_set_downmix(ref, AAC_DOWNMIX_AUTO) != AAC_ERR_UNSUPPORTED) {
+    printf("FAIL: downmix create\n");
+    return 1;
+  }
+  static float pcm[6 * 1024], full[6 * 1024], mixed[2 * 1024];
+  uint8_t bitstream[8192];
+  const int expect[3][2] = {{AAC_DOWNMIX_PATH_MDCT, AAC_DOWNMIX_PATH_MDCT},
+                            {AAC_DOWNMIX_PATH_TIME, AAC_DOWNMIX_PATH_TIME},
+                            {AAC_DOWNMIX_PATH_MDCT, AAC_DOWNMIX_PATH_TIME}};
+  double max_err[3] = {0.0, 0.0, 0.0}, level = 0.0;
+  int wrong_path = 0;
+  for (int f = 0; f < n_frames; f++) {
+    for (int i = 0; i < 1024; i++) {
+      for (int c = 0; c < nch; c++) {
+        pcm[i * nch + c] = 0.3f * (float)sin(2.0 * M_PI * (300.0 + 200.0 * c) * (f * 1024 + i) /
+                                             48000.0);
+      }
+    }
+    int len = aac_encoder_encode(enc, pcm, 1024, bitstream, sizeof(bitstream));
+    if (len <= 0 || aac_decoder_decode(ref, bitstream, len, full, nch * 1024) != 1024) {
+      printf("FAIL: downmix frame %d: encode %d\n", f, len);
+      return 1;
+    }
+    for (int d = 0; d < 3; d++) {
+      /* The centre SCE's window_shape bit: element id, tag, global_gain and
+       * window_sequence come first. The IMDCT is sine-only, so KBD decodes
+       * the same samples while the windows no longer match. */
+      uint8_t frame[8192];
+      memcpy(frame, bitstream, len);
+      if (d == 2 && f % 2) {
+        frame[AAC_ADTS_HEADER_SIZE + 2] |= 0x40;
+      }
+      int n = aac_decoder_decode(dec[d], frame, len, mixed, 2 * 1024);
+      wrong_path += n != 1024 || aac_decoder_downmix_path(dec[d]) != expect[d][f % 2];
+      for (int i = 0; i < 1024; i++) {
+        for (int o = 0; o < 2; o++) {
+          double want = 0.0;
+          for (int c = 0; c < nch; c++) {
+            want += gain[c][o] / norm * full[i * nch + c];
+          }
+          level = std::max(level, fabs(want));
+          max_err[d] = std::max(max_err[d], fabs(mixed[i * 2 + o] - want));
+        }
+      }
+    }
+  }
+  aac_encoder_destroy(enc);
+  aac_decoder_destroy(ref);
+  for (auto* d : dec) {
+    aac_decoder_destroy(d);
+  }
+
+  printf("Downmix 5.1 -> stereo (peak %.3f): max error MDCT %.2e, time %.2e, "
+         "alternating %.2e, %d wrong paths\n",
+         level, max_err[0], max_err[1], max_err[2], wrong_path);
+  if (level < 0.1 || max_err[0] > 1e-4 || max_err[1] > 1e-4 || max_err[2] > 1e-4 ||
+      wrong_path != 0) {
+    printf("FAIL: downmix\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
+static void collect_ld_stats(const AacFrameStats* st, void* user) {
+  auto* log = static_cast<FrameStatsLog*>(user);
+  log->errors += st->reservoir_bits != 0;
+  log->frames++;
+}
+
+/* AAC-LD at both frame lengths: the AudioSpecificConfig sets up the decoder
+ * for raw access units, no frame exceeds its share of the bitrate, and the
+ * tones come back at the encoder's delay within the 40 ms latency budget */
+static int test_ld() {
+  const int rate = 48000, bitrate = 96000, n_frames = 48;
+  const double tones[2] = {1000.0, 1500.0};
+  int failed = 0;
+  for (int fl : {AAC_FRAME_SIZE_LD, AAC_FRAME_SIZE_LD_480}) {
+    AacEncoderHandle enc = aac_encoder_create(rate, 2, bitrate, AAC_AOT_LD, AAC_RC_CBR);
+    AacDecoderHandle dec = aac_decoder_create(rate, 2);
+    uint8_t asc[8];
+    int asc_len = 0;
+    if (!enc || !dec || aac_encoder_set_frame_length(enc, fl) != AAC_OK ||
+        (asc_len = aac_encoder_get_config(enc, asc, sizeof(asc))) <= 0 ||
+        aac_decoder_set_config(dec, asc, asc_len) != AAC_OK) {
+      printf("FAIL: AAC-LD %d create / config\n", fl);
+      return 1;
+    }
+    FrameStatsLog log = {};
+    aac_encoder_set_stats_callback(enc, collect_ld_stats, &log);
+    const int frame = aac_encoder_frame_size(enc), delay = aac_encoder_delay(enc);
+    const int budget = bitrate * fl / rate;
+    static float pcm[2 * 512], dec_pcm[2 * 512], out[2][48 * 512];
+    uint8_t bitstream[8192];
+    int max_bits = 0, decoded = 0;
+    for (int f = 0; f < n_frames; f++) {
+      for (int i = 0; i < frame; i++) {
+        for (int c = 0; c < 2; c++) {
+          pcm[i * 2 + c] =
+              0.3f * (float)sin(2.0 * M_PI * tones[c] * (f * frame + i) / (double)rate);
+        }
+      }
+      int len = aac_encoder_encode(enc, pcm, frame, bitstream, sizeof(bitstream));
+      int n = len > 0 ? aac_decoder_decode(dec, bitstream, len, dec_pcm, 2 * 512) : len;
+      if (n != frame) {
+        printf("FAIL: AAC-LD %d frame %d: encode %d, decode %d\n", fl, f, len, n);
+        return 1;
+      }
+      max_bits = std::max(max_bits, len * 8);
+      for (int i = 0; i < n; i++) {
+        out[0][decoded + i] = dec_pcm[i * 2];
+        out[1][decoded + i] = dec_pcm[i * 2 + 1];
+      }
+      decoded += n;
+    }
+    const bool late = aac_encoder_set_frame_length(enc, fl) != AAC_ERR_STATE;
+    aac_encoder_destroy(enc);
+    aac_decoder_destroy(dec);
+
+    /* Whole periods of both tones (20 ms), and the error against the input
+     * delayed by the encoder's delay */
+    const int start = delay + 4 * frame, n = rate / 50;
+    double worst = 1e9, err = 0.0, ref = 0.0;
+    for (int c = 0; c < 2; c++) {
+      worst = std::min(worst, 20.0 * log10(tone_amplitude(&out[c][start], n, tones[c], rate) /
+                                           0.3));
+      for (int i = start; i < start + n; i++) {
+        double x = 0.3 * sin(2.0 * M_PI * tones[c] * (i - delay) / (double)rate);
+        err += (out[c][i] - x) * (out[c][i] - x);
+        ref += x * x;
+      }
+    }
+    const double snr = 10.0 * log10(ref / err);
+    const double latency_ms = 1000.0 * (delay + frame) / rate;
+    printf("AAC-LD %d: %d-byte config, %d/%d bits max, worst tone %+.2f dB, SNR %.1f dB, "
+           "%.1f ms latency\n",
+           fl, asc_len, max_bits, budget, worst, snr, latency_ms);
+    if (frame != fl || max_bits > budget || log.frames != n_frames || log.errors != 0 ||
+        fabs(worst) > 1.0 || snr < 20.0 || latency_ms >= 40.0 || late) {
+      printf("FAIL: AAC-LD %d\n", fl);
+      failed++;
+    }
+  }
+  if (failed == 0) {
+    printf("PASS\n\n");
+  }
+  return failed;
+}
+
+/* One stream through every output format: s16 and s24 are the float output
+ * rounded and saturated, planar references point at the float samples, a
+ * mono stream on a stereo decoder gives one buffer twice, and dither stays
+ * within 1 LSB, averages out and repeats across decoder instances */
+static int test_output_formats() {
+  const int n_frames = 8;
+  int failed = 0;
+  for (int in_ch : {2, 1}) {
+    AacEncoderHandle enc = aac_encoder_create(44100, in_ch, 128000, AAC_AOT_LC, AAC_RC_CBR);
+    AacDecoderHandle dec[6];
+    for (auto& d : dec) {
+      d = aac_decoder_create(44100, 2);
+    }
+    aac_decoder_set_dither(dec[4], 1);
+    aac_decoder_set_dither(dec[5], 1);
+    static float pcm[2 * 1024], flt[2 * 1024];
+    static int16_t s16[2 * 1024], d16[2][2 * 1024];
+    static int32_t s24[2 * 1024];
+    uint8_t bitstream[8192];
+    int mismatches = 0, dither_max = 0, dither_diff = 0;
+    long long dither_sum = 0, dither_count = 0;
+    for (int f = 0; f < n_frames; f++) {
+      /* Loud enough to clip after the first frames */
+      for (int i = 0; i < 1024; i++) {
+        for (int c = 0; c < in_ch; c++) {
+          pcm[i * in_ch + c] =
+              (0.4f + 0.15f * f) * sinf(2.0f * (float)M_PI * (440.0f + 110.0f * c) *
+                                        (float)(f * 1024 + i) / 44100.0f);
+        }
+      }
+      int len = aac_encoder_encode(enc, pcm, 1024, bitstream, sizeof(bitstream));
+      const float* planes[2] = {nullptr, nullptr};
+      int n[6] = {aac_decoder_decode(dec[0], bitstream, len, flt, 2 * 1024),
+                  aac_decoder_decode_s16(dec[1], bitstream, len, s16, 2 * 1024),
+                  aac_decoder_decode_s24(dec[2], bitstream, len, s24, 2 * 1024),
+                  aac_decoder_decode_planar_ref(dec[3], bitstream, len, planes),
+                  aac_decoder_decode_s16(dec[4], bitstream, len, d16[0], 2 * 1024),
+                  aac_decoder_decode_s16(dec[5], bitstream, len, d16[1], 2 * 1024)};
+      for (int k : n) {
+        mismatches += k != 1024;
+      }
+      mismatches += in_ch == 1 && planes[0] != planes[1];
+      for (int i = 0; i < 2 * 1024; i++) {
+        const float x = flt[i];
+        mismatches += s16[i] != (int16_t)lrintf(fminf(fmaxf(x * 32768.0f, -32768.0f), 32767.0f));
+        mismatches +=
+            s24[i] != (int32_t)lrintf(fminf(fmaxf(x * 8388608.0f, -8388608.0f), 8388607.0f));
+        mismatches += planes[i & 1][i >> 1] != x;
+        mismatches += in_ch == 1 && (i & 1) && s16[i] != s16[i - 1];
+        if (abs(s16[i]) < 32000) {
+          int d = d16[0][i] - s16[i];
+          dither_max = std::max(dither_max, abs(d));
+          dither_sum += d;
+          dither_count++;
+        }
+        dither_diff += d16[0][i] != d16[1][i];
+      }
+    }
+    aac_encoder_destroy(enc);
+    for (auto& d : dec) {
+      aac_decoder_destroy(d);
+    }
+    const double dither_mean = (double)dither_sum / (double)dither_count;
+    printf("Output formats, %s stream: %d mismatches, dither within %d LSB (mean %+.3f), "
+           "%d differences between instances\n",
+           in_ch == 2 ? "stereo" : "mono", mismatches, dither_max, dither_mean, dither_diff);
+    if (mismatches != 0 || dither_max != 1 || fabs(dither_mean) > 0.05 || dither_diff != 0) {
+      printf("FAIL: output formats\n");
+      failed++;
+    }
+  }
+  if (failed == 0) {
+    printf("PASS\n\n");
+  }
+  return failed;
+}
+
+/* Batch decoding of a contiguous ADTS stream fed in arbitrary chunks: the
+ * frames split at chunk and output-buffer boundaries, and the samples match
+ * frame-by-frame decoding exactly, for AAC-LC and HE-AAC */
+/* Turn an ADTS frame into its CRC-protected form: protection_absent
+ * cleared, a crc_check word after the fixed 7 bytes, frame_length + 2. The
+ * decoder does not verify the CRC, so any value will do. */
+static int add_adts_crc(uint8_t* frame, int len) {
+  memmove(frame + AAC_ADTS_HEADER_SIZE + 2, frame + AAC_ADTS_HEADER_SIZE,
+          len - AAC_ADTS_HEADER_SIZE);
+  frame[AAC_ADTS_HEADER_SIZE] = 0xC2;
+  frame[AAC_ADTS_HEADER_SIZE + 1] = 0x5A;
+  frame[1] &= 0xFE;
+  const int fl = len + 2;
+  frame[3] = (uint8_t)((frame[3] & 0xFC) | (fl >> 11));
+  frame[4] = (uint8_t)(fl >> 3);
+  frame[5] = (uint8_t)((frame[5] & 0x1F) | ((fl & 7) << 5));
+  return fl;
+}
+
+static int test_decode_many() {
+  const int n_frames = 24;
+  int failed = 0;
+  for (int variant = 0; variant < 3; variant++) {
+    const AacObjectType aot = variant == 1 ? AAC_AOT_SBR : AAC_AOT_LC;
+    const bool crc = variant == 2;
+    const int sr = aot == AAC_AOT_LC ? 44100 : 48000;
+    const int fs = aot == AAC_AOT_LC ? 1024 : 2048;
+    AacEncoderHandle enc = aac_encoder_create(sr, 2, aot == AAC_AOT_LC ? 128000 : 48000, aot,
+                                              AAC_RC_CBR);
+    AacDecoderHandle ref = aac_decoder_create(sr, 2), dec = aac_decoder_create(sr, 2);
+    AacDecoderHandle single = aac_decoder_create(sr, 2);
+    static uint8_t stream[n_frames * 2048];
+    static float pcm[2 * 2048], expect[n_frames * 2 * 2048], got[n_frames * 2 * 2048];
+    int stream_size = 0, expect_size = 0, mismatches = 0;
+    for (int f = 0; f < n_frames; f++) {
+      for (int i = 0; i < fs; i++) {
+        float t = (float)(f * fs + i) / (float)sr;
+        pcm[i * 2] = 0.3f * sinf(2.0f * (float)M_PI * 440.0f * t);
+        pcm[i * 2 + 1] = 0.3f * sinf(2.0f * (float)M_PI * 660.0f * t);
+      }
+      int len = aac_encoder_encode(enc, pcm, fs, stream + stream_size, 2048);
+      int n = aac_decoder_decode(ref, stream + stream_size, len, expect + expect_size, 2 * 2048);
+      /* The protected frame must decode as the frame it was made from */
+      if (crc) {
+        len = add_adts_crc(stream + stream_size, len);
+        mismatches += aac_decoder_decode(single, stream + stream_size, len, pcm, 2 * 2048) != n ||
+                      memcmp(pcm, expect + expect_size, 2 * n * sizeof(float)) != 0;
+      }
+      stream_size += len;
+      expect_size += n > 0 ? 2 * n : 0;
+    }
+
+    /* Chunks of 700 bytes into a pending buffer; at most 5 frames and
+     * three frames' samples per call */
+    static uint8_t pending[n_frames * 2048];
+    int pending_size = 0, fed = 0, got_size = 0, frames = 0, calls = 0, errors = 0;
+    while (fed < stream_size || pending_size > 0) {
+      const int chunk = std::min(700, stream_size - fed);
+      memcpy(pending + pending_size, stream + fed, chunk);
+      pending_size += chunk;
+      fed += chunk;
+      int samples[5], consumed = 0, ret = 0, pos = 0;
+      while ((ret = aac_decoder_decode_many(dec, pending + pos, pending_size - pos, got + got_size,
+                                            3 * 2 * fs, 5, samples, &consumed)) > 0) {
+        for (int i = 0; i < ret; i++) {
+          errors += samples[i] != fs;
+          got_size += 2 * std::max(samples[i], 0);
+        }
+        frames += ret;
+        pos += consumed;
+        calls++;
+      }
+      errors += ret != 0;
+      memmove(pending, pending + pos, pending_size - pos);
+      pending_size -= pos;
+      if (chunk == 0 && pos == 0) {
+        break;
+      }
+    }
+    mismatches += got_size != expect_size;
+    for (int i = 0; i < std::min(got_size, expect_size); i++) {
+      mismatches += got[i] != expect[i];
+    }
+
+    /* Errors without a frame to decode */
+    int samples[1], consumed = -1;
+    float small[16];
+    uint8_t garbage[16] = {0x12, 0x34};
+    errors += aac_decoder_decode_many(dec, stream, stream_size, small, 16, 1, samples,
+                                      &consumed) != AAC_ERR_OVERFLOW || consumed != 0;
+    errors += aac_decoder_decode_many(dec, garbage, sizeof(garbage), got, 2 * 2048, 1, samples,
+                                      &consumed) != AAC_ERR_DECODE;
+    errors += aac_decoder_decode_many(dec, stream, 5, got, 2 * 2048, 1, samples, &consumed) != 0;
+
+    printf("Decode many, %s: %d frames in %d calls, %d mismatches, %d errors\n",
+           crc ? "AAC-LC with CRC" : (aot == AAC_AOT_LC ? "AAC-LC" : "HE-AAC"), frames, calls,
+           mismatches, errors);
+    if (frames != n_frames || mismatches != 0 || errors != 0) {
+      printf("FAIL: decode many\n");
+      failed++;
+    }
+    aac_encoder_destroy(enc);
+    aac_decoder_destroy(ref);
+    aac_decoder_destroy(dec);
+    aac_decoder_destroy(single);
+  }
+  if (failed == 0) {
+    printf("PASS\n\n");
+  }
+  return failed;
+}
+
+static int collect_gain(const uint8_t* data, int size, void* user) {
+  auto* out = static_cast<std::vector<uint8_t>*>(user);
+  out->insert(out->end(), data, data + size);
+  return AAC_OK;
+}
+
+/* Gain in the compressed domain on a stereo tone over noise, coded with
+ * noise bands: 4 steps of 1.5 dB decode as exactly twice the amplitude,
+ * noise included, and -4 restores the bytes; the splicer rewrites a whole file
+ * the same way, and raw AAC-LD access units scale as well. A frame that
+ * cannot move that far is left alone, and HE-AAC is refused. */
+static int test_gain() {
+  const int n_frames = 24;
+  const char* path = "test_roundtrip_gain.aac";
+  AacEncoderHandle enc = aac_encoder_create(44100, 2, 64000, AAC_AOT_LC, AAC_RC_CBR);
+  AacDecoderHandle dec[2] = {aac_decoder_create(44100, 2), aac_decoder_create(44100, 2)};
+  static float pcm[2 * 1024], out[2][2 * 1024];
+  std::vector<uint8_t> file, expect;
+  uint32_t rng = 777u;
+  float lp = 0.0f;
+  int errors = 0, pns_bands = 0;
+  double e_ref = 0.0, e_diff = 0.0;
+  for (int f = 0; f < n_frames; f++) {
+    for (int i = 0; i < 1024; i++) {
+      rng = rng * 1664525u + 1013904223u;
+      float noise = (float)(rng >> 9) / 8388608.0f - 1.0f;
+      lp = 0.7f * lp + 0.3f * noise;
+      float tone = 0.25f * sinf(2.0f * (float)M_PI * 440.0f * (float)(f * 1024 + i) / 44100.0f);
+      pcm[i * 2] = tone + 0.08f * (noise - lp);
+      pcm[i * 2 + 1] = 0.5f * tone - 0.08f * (noise - lp);
+    }
+    uint8_t frame[8192], louder[8192];
+    int len = aac_encoder_encode(enc, pcm, 1024, frame, sizeof(frame));
+    file.insert(file.end(), frame, frame + len);
+    memcpy(louder, frame, len);
+    errors += aac_gain_adts_frame(louder, len, 4) != AAC_OK;
+    expect.insert(expect.end(), louder, louder + len);
+
+    int n = aac_decoder_decode(dec[0], frame, len, out[0], 2 * 1024);
+    errors += aac_decoder_decode(dec[1], louder, len, out[1], 2 * 1024) != n;
+    for (int i = 0; i < 2 * n; i++) {
+      e_ref += (double)out[0][i] * out[0][i];
+      e_diff += (double)(out[1][i] - 2.0f * out[0][i]) * (out[1][i] - 2.0f * out[0][i]);
+    }
+    for (int c = 0; c < 2; c++) {
+      const AacDecoderChannel* ch = &static_cast<AacDecoderState*>(dec[0])->ch[c];
+      for (int b = 0; b < ch->max_sfb; b++) {
+        pns_bands += ch->sfb_cb[b] == AAC_PNS_CODEBOOK;
+      }
+    }
+    errors += aac_gain_adts_frame(louder, len, -4) != AAC_OK || memcmp(louder, frame, len) != 0;
+    errors += aac_gain_adts_frame(louder, len, 255) != AAC_ERR_OVERFLOW ||
+              memcmp(louder, frame, len) != 0;
+  }
+
+  /* Raw AAC-LD access units, under their AudioSpecificConfig */
+  AacEncoderHandle ld = aac_encoder_create(48000, 2, 96000, AAC_AOT_LD, AAC_RC_CBR);
+  AacDecoderHandle ld_dec[2] = {aac_decoder_create(48000, 2), aac_decoder_create(48000, 2)};
+  uint8_t asc[8];
+  const int asc_len = aac_encoder_get_config(ld, asc, sizeof(asc));
+  for (AacDecoderHandle d : ld_dec) {
+    errors += aac_decoder_set_config(d, asc, asc_len) != AAC_OK;
+  }
+  for (int f = 0; f < 8; f++) {
+    for (int i = 0; i < 512; i++) {
+      pcm[i * 2] = pcm[i * 2 + 1] = 0.3f * sinf((float)(f * 512 + i) * 0.13f);
+    }
+    uint8_t au[2][8192];
+    int len = aac_encoder_encode(ld, pcm, 512, au[0], sizeof(au[0]));
+    memcpy(au[1], au[0], len);
+    errors += aac_gain_access_unit(asc, asc_len, au[1], len, 4) != AAC_OK;
+    int n = aac_decoder_decode(ld_dec[0], au[0], len, out[0], 2 * 1024);
+    errors += aac_decoder_decode(ld_dec[1], au[1], len, out[1], 2 * 1024) != n;
+    for (int i = 0; i < 2 * n; i++) {
+      e_ref += (double)out[0][i] * out[0][i];
+      e_diff += (double)(out[1][i] - 2.0f * out[0][i]) * (out[1][i] - 2.0f * out[0][i]);
+    }
+  }
+  const double err_db = 10.0 * log10(e_diff / e_ref + 1e-30);
+
+  /* The file through the index and the splicer */
+  FILE* fp = fopen(path, "wb");
+  fwrite(file.data(), 1, file.size(), fp);
+  fclose(fp);
+  std::vector<uint8_t> spliced;
+  AacAdtsIndexHandle idx = aac_adts_index_open(path, nullptr);
+  AacAdtsSplicerHandle sp = aac_adts_splicer_create(collect_gain, &spliced);
+  int64_t patched = 0;
+  errors += aac_adts_splicer_set_gain(sp, 4) != AAC_OK ||
+            aac_adts_splicer_append(sp, idx, 0, n_frames) != AAC_OK ||
+            aac_adts_splicer_frames(sp, &patched) != n_frames || patched != n_frames ||
+            spliced != expect;
+  aac_adts_splicer_destroy(sp);
+  aac_adts_index_close(idx);
+  remove(path);
+
+  /* SBR envelopes do not follow global_gain */
+  AacEncoderHandle he = aac_encoder_create(48000, 2, 48000, AAC_AOT_SBR, AAC_RC_CBR);
+  static float he_pcm[2 * 2048];
+  uint8_t he_frame[8192];
+  int he_len = aac_encoder_encode(he, he_pcm, 2048, he_frame, sizeof(he_frame));
+  errors += aac_gain_adts_frame(he_frame, he_len, 1) != AAC_ERR_UNSUPPORTED;
+  errors += aac_gain_steps(6.02f) != 4 || aac_gain_steps(-2.0f) != -1;
+
+  aac_encoder_destroy(enc);
+  aac_encoder_destroy(he);
+  aac_encoder_destroy(ld);
+  for (int d = 0; d < 2; d++) {
+    aac_decoder_destroy(dec[d]);
+    aac_decoder_destroy(ld_dec[d]);
+  }
+  printf("Gain: +4 steps over %d frames (%d noise bands), error %.1f dB against 2x, %d errors\n",
+         n_frames, pns_bands, err_db, errors);
+  if (pns_bands == 0 || err_db > -80.0 || errors != 0) {
+    printf("FAIL: compressed-domain gain\n");
+    return 1;
+  }
+  printf("PASS\n\n");
+  return 0;
+}
+
 int main() {
   aac_tables_init();
   int failures = 0;
   printf("=== Roundtrip Tests ===\n\n");
   failures += test_lc_roundtrip();
   failures += test_stereo_roundtrip();
+  failures += test_two_pass();
+  failures += test_two_pass_plan();
+  failures += test_two_pass_sbr();
+  failures += test_frame_stats();
+  failures += test_bandwidth_limit();
+  failures += test_silence_fast_path();
+  failures += test_pns();
+  failures += test_sbr_encoder();
+  failures += test_sbr_decoder();
+  failures += test_ps_decoder();
+  failures += test_ps_encoder();
+  failures += test_multichannel();
+  failures += test_downmix();
+  failures += test_ld();
+  failures += test_output_formats();
+  failures += test_decode_many();
+  failures += test_gain();
   printf("=== %d test(s) failed ===\n", failures);
   return failures;
 }
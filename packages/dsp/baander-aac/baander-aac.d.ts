@@ -4,6 +4,16 @@
  */
 declare type AacDecoderHandle = number;
 
+/**
+ * Opaque handle returned by adtsFramerCreate(); a pointer into WASM memory.
+ */
+declare type AacAdtsFramerHandle = number;
+
+/**
+ * Opaque handle returned by latmReaderCreate(); a pointer into WASM memory.
+ */
+declare type AacLatmReaderHandle = number;
+
 /**
  * Low-level WASM API exported by the Baander AAC decoder module.
  * Maps directly to the underlying C++ exports; the JS loader resolves
@@ -46,6 +56,32 @@ declare interface BaanderAacAPI {
     pcmSize: number
   ): number;
 
+  /**
+   * Decode up to maxFrames consecutive ADTS frames in one call, each frame's
+   * interleaved samples following the previous one's. Stops before a frame
+   * that is incomplete, out of sync or does not fit in the PCM buffer.
+   * @param ctx Decoder handle.
+   * @param dataPtr Byte offset to ADTS data in WASM memory.
+   * @param dataSize Size of the data in bytes.
+   * @param pcmPtr Byte offset to Float32Array output buffer in WASM memory.
+   * @param pcmSize Size of PCM output buffer in floats.
+   * @param maxFrames Maximum number of frames to decode.
+   * @param frameSamplesPtr Byte offset to an Int32Array of maxFrames entries, receiving each
+   *        frame's samples per channel or its negative error code.
+   * @param consumedPtr Byte offset to an int receiving the bytes of the frames walked.
+   * @returns Number of frames walked, or negative error code when there was none.
+   */
+  decoderDecodeMany(
+    ctx: AacDecoderHandle,
+    dataPtr: number,
+    dataSize: number,
+    pcmPtr: number,
+    pcmSize: number,
+    maxFrames: number,
+    frameSamplesPtr: number,
+    consumedPtr: number
+  ): number;
+
   /**
    * Returns the decoder frame size in samples (typically 1024 for AAC-LC).
    * @param ctx Decoder handle.
@@ -76,6 +112,88 @@ declare interface BaanderAacAPI {
     hasSbrPtr: number,
     hasPsPtr: number
   ): number;
+
+  /**
+   * Create an ADTS framer, which splits streamed ADTS into whole frames.
+   * @returns Opaque handle to the framer (pointer).
+   */
+  adtsFramerCreate(): AacAdtsFramerHandle;
+
+  /**
+   * Destroy an ADTS framer.
+   * @param ctx Framer handle.
+   */
+  adtsFramerDestroy(ctx: AacAdtsFramerHandle): void;
+
+  /**
+   * Hand over the next chunk once adtsFramerNext has returned 0. The bytes must stay in
+   * place in WASM memory until then.
+   * @param ctx Framer handle.
+   * @param dataPtr Byte offset to the chunk in WASM memory.
+   * @param dataSize Size of the chunk in bytes; 0 marks the end of the stream.
+   * @returns 0 on success, negative error code on failure.
+   */
+  adtsFramerFeed(ctx: AacAdtsFramerHandle, dataPtr: number, dataSize: number): number;
+
+  /**
+   * Take the next whole frame, ADTS header included.
+   * @param ctx Framer handle.
+   * @param framePtrPtr Pointer to an int receiving the frame's byte offset in WASM memory.
+   * @param sizePtr Pointer to an int receiving the frame's size in bytes.
+   * @returns 1 with a frame, 0 when the chunk is used up, negative error code on failure.
+   */
+  adtsFramerNext(ctx: AacAdtsFramerHandle, framePtrPtr: number, sizePtr: number): number;
+
+  /**
+   * Describe the stream by its AudioSpecificConfig, for raw access units.
+   * @param ctx Decoder handle.
+   * @param ascPtr Byte offset to the AudioSpecificConfig in WASM memory.
+   * @param ascSize Size of the AudioSpecificConfig in bytes.
+   * @returns 0 on success, negative error code on failure.
+   */
+  decoderSetConfig(ctx: AacDecoderHandle, ascPtr: number, ascSize: number): number;
+
+  /**
+   * Create a LATM reader, which splits streamed LOAS/LATM into raw access units.
+   * @returns Opaque handle to the reader (pointer).
+   */
+  latmReaderCreate(): AacLatmReaderHandle;
+
+  /**
+   * Destroy a LATM reader.
+   * @param ctx Reader handle.
+   */
+  latmReaderDestroy(ctx: AacLatmReaderHandle): void;
+
+  /**
+   * Hand over the next chunk once latmReaderNext has returned 0. The bytes must stay in
+   * place in WASM memory until then.
+   * @param ctx Reader handle.
+   * @param dataPtr Byte offset to the chunk in WASM memory.
+   * @param dataSize Size of the chunk in bytes; 0 marks the end of the stream.
+   * @returns 0 on success, negative error code on failure.
+   */
+  latmReaderFeed(ctx: AacLatmReaderHandle, dataPtr: number, dataSize: number): number;
+
+  /**
+   * Take the next raw access unit.
+   * @param ctx Reader handle.
+   * @param auPtrPtr Pointer to an int receiving the access unit's byte offset in WASM memory.
+   * @param sizePtr Pointer to an int receiving the access unit's size in bytes.
+   * @returns 1 with an access unit, 2 with the first one under a new AudioSpecificConfig
+   *          (pass latmReaderConfig to decoderSetConfig), 0 when the chunk is used up,
+   *          negative error code on failure.
+   */
+  latmReaderNext(ctx: AacLatmReaderHandle, auPtrPtr: number, sizePtr: number): number;
+
+  /**
+   * Copy the current AudioSpecificConfig.
+   * @param ctx Reader handle.
+   * @param ascPtr Byte offset to the destination in WASM memory.
+   * @param ascSize Room at ascPtr in bytes.
+   * @returns Bytes copied, or negative error code before the first StreamMuxConfig.
+   */
+  latmReaderConfig(ctx: AacLatmReaderHandle, ascPtr: number, ascSize: number): number;
 }
 
 /**
@@ -85,4 +203,10 @@ declare interface BaanderAacAPI {
  */
 declare function loadAacDecoder(url?: string): Promise<BaanderAacAPI>;
 
-export { loadAacDecoder, BaanderAacAPI, AacDecoderHandle };
+export {
+  loadAacDecoder,
+  BaanderAacAPI,
+  AacDecoderHandle,
+  AacAdtsFramerHandle,
+  AacLatmReaderHandle,
+};
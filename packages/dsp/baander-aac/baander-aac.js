@@ -56,10 +56,21 @@ export async function loadAacDecoder(url = './baander-aac.wasm') {
   const decoderCreate  = pick('aac_decoder_create',   '_aac_decoder_create');
   const decoderDestroy = pick('aac_decoder_destroy',  '_aac_decoder_destroy');
   const decoderDecode  = pick('aac_decoder_decode',   '_aac_decoder_decode');
+  const decoderDecodeMany   = pick('aac_decoder_decode_many',   '_aac_decoder_decode_many');
   const decoderFrameSize    = pick('aac_decoder_frame_size',    '_aac_decoder_frame_size');
   const decoderSampleRate   = pick('aac_decoder_sample_rate',   '_aac_decoder_sample_rate');
   const decoderChannels     = pick('aac_decoder_channels',      '_aac_decoder_channels');
   const decoderGetSbrPs     = pick('aac_decoder_get_sbr_ps',    '_aac_decoder_get_sbr_ps');
+  const adtsFramerCreate    = pick('aac_adts_framer_create',    '_aac_adts_framer_create');
+  const adtsFramerDestroy   = pick('aac_adts_framer_destroy',   '_aac_adts_framer_destroy');
+  const adtsFramerFeed      = pick('aac_adts_framer_feed',      '_aac_adts_framer_feed');
+  const adtsFramerNext      = pick('aac_adts_framer_next',      '_aac_adts_framer_next');
+  const decoderSetConfig    = pick('aac_decoder_set_config',    '_aac_decoder_set_config');
+  const latmReaderCreate    = pick('aac_latm_reader_create',    '_aac_latm_reader_create');
+  const latmReaderDestroy   = pick('aac_latm_reader_destroy',   '_aac_latm_reader_destroy');
+  const latmReaderFeed      = pick('aac_latm_reader_feed',      '_aac_latm_reader_feed');
+  const latmReaderNext      = pick('aac_latm_reader_next',      '_aac_latm_reader_next');
+  const latmReaderConfig    = pick('aac_latm_reader_config',    '_aac_latm_reader_config');
 
   // Validate essential exports
   const missing = [];
@@ -77,9 +88,20 @@ export async function loadAacDecoder(url = './baander-aac.wasm') {
     decoderCreate,
     decoderDestroy,
     decoderDecode,
+    decoderDecodeMany,
     decoderFrameSize,
     decoderSampleRate,
     decoderChannels,
     decoderGetSbrPs,
+    adtsFramerCreate,
+    adtsFramerDestroy,
+    adtsFramerFeed,
+    adtsFramerNext,
+    decoderSetConfig,
+    latmReaderCreate,
+    latmReaderDestroy,
+    latmReaderFeed,
+    latmReaderNext,
+    latmReaderConfig,
   };
 }